@@ -0,0 +1,734 @@
+/**
+ * Host micro-benchmarks of the advertiser hot paths
+ *
+ * The application modules run against the host simulation shims, see
+ * adv_shim.h. Three suites are run:
+ *
+ * - trace: cost of pa_trace_printf(), and messages lost under bursts, for
+ *   several UARTE drain rates;
+ * - dispatch: cost of a SoftDevice event, from the observer invoked in the
+ *   SoftDevice interrupt to the end of its deferred processing, per event
+ *   type;
+ * - authorize: latency from a read or write authorization request to its
+ *   reply.
+ *
+ * Durations are host wall clock times, which only compare with each other;
+ * the SoftDevice call counts are exact.
+ *
+ * @file adv_bench.c
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "app_error.h"
+#include "app_scheduler.h"
+#include "app_timer.h"
+#include "ble.h"
+#include "ble_hci.h"
+#include "adv_ble.h"
+#include "adv_power.h"
+#include "adv_shim.h"
+#include "adv_tools.h"
+#include "adv_trace.h"
+
+//-----------------------------------------------------------------------------
+// Constants
+//-----------------------------------------------------------------------------
+
+/** Scheduler queue, as sized by the application main module */
+#define BENCH_SCHED_QUEUE_SIZE (20U + ADV_BLE_SCHED_QUEUE_SIZE)
+
+/** Characteristic UUIDs, from ADV_CHAR_UUID_BASE and the attribute list */
+#define BENCH_UUID_ERROR       0x1001U
+#define BENCH_UUID_BULK        0x1002U
+#define BENCH_UUID_POWER       0x1004U
+#define BENCH_UUID_TRACE_CTRL  0x1005U
+
+/** Negotiated ATT MTU */
+#define BENCH_ATT_MTU          247U
+
+/** Simulated time to settle the application after start up, in ms */
+#define BENCH_SETTLE_MS        5000U
+
+/** Default count of iterations */
+#define BENCH_ITERATIONS       10000U
+/** Largest count of timed samples */
+#define BENCH_SAMPLES_MAX      100000U
+
+/** Burst sizes of the trace suite */
+static const unsigned int BENCH_BURSTS[] = { 8U, 32U, 128U, 512U };
+/**
+ * Messages emitted between two UARTE transfer completions: a 60-character
+ * message lasts about 600 us at 1 Mbps, while the CPU formats it in a few
+ * microseconds, so a burst always outpaces the UARTE
+ */
+static const unsigned int BENCH_DRAIN_RATES[] = { 0U, 1U, 4U, 16U };
+
+//-----------------------------------------------------------------------------
+// Type definitions
+//-----------------------------------------------------------------------------
+
+/** BLE event, with room for the variable length data */
+union bench_evt {
+   ble_evt_t be_evt;
+   uint8_t be_raw[BLE_EVT_LEN_MAX(BENCH_ATT_MTU)];
+};
+
+/** Timed samples, in nanoseconds */
+struct bench_samples {
+   uint64_t bs_values[BENCH_SAMPLES_MAX];
+   unsigned int bs_count;
+};
+
+/** Authorization reply probe */
+struct bench_reply {
+   uint64_t br_time;   /**< Time of the last reply */
+   uint16_t br_status; /**< GATT status of the last reply */
+   unsigned int br_count; /**< Count of replies */
+};
+
+//-----------------------------------------------------------------------------
+// Variables
+//-----------------------------------------------------------------------------
+
+static struct bench_samples _bench_samples;
+static struct bench_reply _bench_reply;
+static unsigned int _bench_iterations = BENCH_ITERATIONS;
+static uint32_t _bench_bulk_chunks;
+
+//-----------------------------------------------------------------------------
+// Helpers
+//-----------------------------------------------------------------------------
+
+static uint64_t
+_bench_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static int
+_bench_cmp_u64(const void * lhs, const void * rhs)
+{
+   uint64_t a = *(const uint64_t *)lhs;
+   uint64_t b = *(const uint64_t *)rhs;
+
+   return (a > b) - (a < b);
+}
+
+static void
+_bench_samples_reset(struct bench_samples * bs)
+{
+   bs->bs_count = 0U;
+}
+
+static void
+_bench_samples_add(struct bench_samples * bs, uint64_t value)
+{
+   if ( bs->bs_count < BENCH_SAMPLES_MAX ) {
+      bs->bs_values[bs->bs_count++] = value;
+   }
+}
+
+/**
+ * Print the distribution of timed samples.
+ *
+ * @param[in] name the measurement name
+ * @param[in,out] bs the samples, which are sorted
+ * @param[in] extra additional columns, may be empty
+ */
+static void
+_bench_samples_print(const char * name, struct bench_samples * bs,
+                     const char * extra)
+{
+   if ( ! bs->bs_count ) {
+      printf("  %-28s no sample\n", name);
+      return;
+   }
+
+   qsort(bs->bs_values, bs->bs_count, sizeof(bs->bs_values[0]),
+         &_bench_cmp_u64);
+   uint64_t sum = 0U;
+   for (unsigned int ix=0; ix<bs->bs_count; ix++) {
+      sum += bs->bs_values[ix];
+   }
+   printf("  %-28s %8u %8llu %8llu %8llu %8llu %s\n", name, bs->bs_count,
+          (unsigned long long)bs->bs_values[0],
+          (unsigned long long)bs->bs_values[bs->bs_count / 2U],
+          (unsigned long long)(sum / bs->bs_count),
+          (unsigned long long)bs->bs_values[(bs->bs_count * 99U) / 100U],
+          extra);
+}
+
+static void
+_bench_samples_header(const char * extra)
+{
+   printf("  %-28s %8s %8s %8s %8s %8s %s\n", "", "count", "min ns",
+          "med ns", "avg ns", "p99 ns", extra);
+}
+
+/**
+ * Complete all UARTE transfers, until the trace queue is empty.
+ */
+static void
+_bench_trace_drain(void)
+{
+   while ( adv_shim_uarte_complete() ) {
+   }
+}
+
+/**
+ * Run the main loop until there is nothing left to do, as the application
+ * would before waiting for the next event.
+ */
+static void
+_bench_idle(void)
+{
+   adv_shim_poll();
+   _bench_trace_drain();
+   adv_shim_poll();
+   if ( adv_shim_critical_depth() ) {
+      fprintf(stderr, "Critical region left open\n");
+      exit(EXIT_FAILURE);
+   }
+}
+
+static void
+_bench_evt_init(union bench_evt * be, uint16_t evt_id, uint16_t conn_handle)
+{
+   memset(be, 0, sizeof(*be));
+   be->be_evt.header.evt_id = evt_id;
+   be->be_evt.header.evt_len = sizeof(ble_evt_t);
+   // all event families start with the connection handle
+   be->be_evt.evt.gap_evt.conn_handle = conn_handle;
+}
+
+static void
+_bench_connect(uint16_t conn_handle)
+{
+   union bench_evt be;
+
+   _bench_evt_init(&be, BLE_GAP_EVT_CONNECTED, conn_handle);
+   be.be_evt.evt.gap_evt.params.connected.role = BLE_GAP_ROLE_PERIPH;
+   be.be_evt.evt.gap_evt.params.connected.peer_addr.addr[0] =
+      (uint8_t)conn_handle;
+   adv_shim_ble_evt(&be.be_evt);
+}
+
+static void
+_bench_disconnect(uint16_t conn_handle)
+{
+   union bench_evt be;
+
+   _bench_evt_init(&be, BLE_GAP_EVT_DISCONNECTED, conn_handle);
+   be.be_evt.evt.gap_evt.params.disconnected.reason =
+      BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION;
+   adv_shim_ble_evt(&be.be_evt);
+}
+
+static void
+_bench_exchange_mtu(uint16_t conn_handle)
+{
+   union bench_evt be;
+
+   _bench_evt_init(&be, BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST, conn_handle);
+   be.be_evt.evt.gatts_evt.params.exchange_mtu_request.client_rx_mtu =
+      BENCH_ATT_MTU;
+   adv_shim_ble_evt(&be.be_evt);
+}
+
+static void
+_bench_cccd_write(union bench_evt * be, uint16_t conn_handle, uint16_t uuid,
+                  bool enable)
+{
+   ble_gatts_char_handles_t handles;
+
+   if ( ! adv_shim_gatts_find(uuid, NULL, &handles) ) {
+      fprintf(stderr, "No characteristic 0x%04x\n", uuid);
+      exit(EXIT_FAILURE);
+   }
+
+   _bench_evt_init(be, BLE_GATTS_EVT_WRITE, conn_handle);
+   ble_gatts_evt_write_t * wr = &be->be_evt.evt.gatts_evt.params.write;
+   wr->handle = handles.cccd_handle;
+   wr->uuid.uuid = BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG;
+   wr->uuid.type = BLE_UUID_TYPE_BLE;
+   wr->op = BLE_GATTS_OP_WRITE_REQ;
+   wr->len = 2U;
+   wr->data[0] = enable ? BLE_GATT_HVX_NOTIFICATION : 0U;
+   wr->data[1] = 0U;
+   be->be_evt.header.evt_len = (uint16_t)(sizeof(ble_evt_t) + wr->len);
+}
+
+static void
+_bench_read_request(union bench_evt * be, uint16_t conn_handle,
+                    uint16_t uuid)
+{
+   ble_gatts_char_handles_t handles;
+   ble_uuid_t ble_uuid;
+
+   if ( ! adv_shim_gatts_find(uuid, &ble_uuid, &handles) ) {
+      fprintf(stderr, "No characteristic 0x%04x\n", uuid);
+      exit(EXIT_FAILURE);
+   }
+
+   _bench_evt_init(be, BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST, conn_handle);
+   ble_gatts_evt_rw_authorize_request_t * req =
+      &be->be_evt.evt.gatts_evt.params.authorize_request;
+   req->type = BLE_GATTS_AUTHORIZE_TYPE_READ;
+   req->request.read.handle = handles.value_handle;
+   req->request.read.uuid = ble_uuid;
+   req->request.read.offset = 0U;
+}
+
+static void
+_bench_write_request(union bench_evt * be, uint16_t conn_handle,
+                     uint16_t uuid, const uint8_t * data, uint16_t len)
+{
+   ble_gatts_char_handles_t handles;
+   ble_uuid_t ble_uuid;
+
+   if ( ! adv_shim_gatts_find(uuid, &ble_uuid, &handles) ) {
+      fprintf(stderr, "No characteristic 0x%04x\n", uuid);
+      exit(EXIT_FAILURE);
+   }
+
+   _bench_evt_init(be, BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST, conn_handle);
+   ble_gatts_evt_rw_authorize_request_t * req =
+      &be->be_evt.evt.gatts_evt.params.authorize_request;
+   req->type = BLE_GATTS_AUTHORIZE_TYPE_WRITE;
+   ble_gatts_evt_write_t * wr = &req->request.write;
+   wr->handle = handles.value_handle;
+   wr->uuid = ble_uuid;
+   wr->op = BLE_GATTS_OP_WRITE_REQ;
+   wr->offset = 0U;
+   wr->len = len;
+   memcpy(wr->data, data, len);
+   be->be_evt.header.evt_len = (uint16_t)(sizeof(ble_evt_t) + len);
+}
+
+static void
+_bench_reply_hook(uint16_t conn_handle,
+                  const ble_gatts_rw_authorize_reply_params_t * reply)
+{
+   (void)conn_handle;
+   _bench_reply.br_time = _bench_now();
+   _bench_reply.br_status =
+      (BLE_GATTS_AUTHORIZE_TYPE_WRITE == reply->type) ?
+      reply->params.write.gatt_status : reply->params.read.gatt_status;
+   _bench_reply.br_count++;
+}
+
+/**
+ * Bulk stream source, which never runs dry.
+ */
+static int
+_bench_bulk_source(uint8_t * buf, size_t size)
+{
+   memset(buf, (int)_bench_bulk_chunks++, size);
+   return (int)size;
+}
+
+//-----------------------------------------------------------------------------
+// Suites
+//-----------------------------------------------------------------------------
+
+/**
+ * Trace suite: pa_trace_printf() cost, then lost messages under bursts.
+ */
+static void
+_bench_trace(void)
+{
+   struct pa_trace_stats stats;
+   unsigned int count = _bench_iterations;
+
+   printf("\ntrace: pa_trace_printf\n");
+   _bench_samples_header("");
+
+   // formatting and enqueuing, the UARTE being drained out of the timed
+   // section whenever a transfer is on-going
+   _bench_trace_drain();
+   pa_trace_get_stats(&stats, true);
+   _bench_samples_reset(&_bench_samples);
+   for (unsigned int ix=0; ix<count; ix++) {
+      uint64_t start = _bench_now();
+      pa_trace_printf(PTL_INFO, "bench %u: %s 0x%08x" EOL, ix,
+                      "message", (unsigned int)(ix * 2654435761U));
+      _bench_samples_add(&_bench_samples, _bench_now() - start);
+      _bench_trace_drain();
+   }
+   _bench_samples_print("format and enqueue", &_bench_samples, "");
+
+   // filtered out messages only cost the level check, as MSGV() does
+   _bench_samples_reset(&_bench_samples);
+   for (unsigned int ix=0; ix<count; ix++) {
+      uint64_t start = _bench_now();
+      if ( _pa_trace_is_enabled(PTM_MAIN, PTL_CHATTY) ) {
+         pa_trace_printf(PTL_CHATTY, "bench %u" EOL, ix);
+      }
+      _bench_samples_add(&_bench_samples, _bench_now() - start);
+   }
+   _bench_samples_print("filtered out (CHATTY)", &_bench_samples, "");
+
+   // transfer completion, which releases the queue and starts the next batch
+   _bench_samples_reset(&_bench_samples);
+   for (unsigned int ix=0; ix<count; ix++) {
+      pa_trace_printf(PTL_INFO, "bench %u" EOL, ix);
+      uint64_t start = _bench_now();
+      bool done = adv_shim_uarte_complete();
+      uint64_t stop = _bench_now();
+      if ( done ) {
+         _bench_samples_add(&_bench_samples, stop - start);
+      }
+      _bench_trace_drain();
+   }
+   _bench_samples_print("UARTE TX done", &_bench_samples, "");
+
+   printf("\ntrace: bursts (drain: msgs between two UARTE completions, "
+          "0: none)\n");
+   printf("  %6s %6s %8s %8s %8s %7s %6s %6s\n", "burst", "drain", "msgs",
+          "sent", "lost", "lost %", "hwm", "bytes");
+   for (unsigned int bix=0; bix<ARRAY_SIZE(BENCH_BURSTS); bix++) {
+      for (unsigned int dix=0; dix<ARRAY_SIZE(BENCH_DRAIN_RATES); dix++) {
+         unsigned int burst = BENCH_BURSTS[bix];
+         unsigned int drain = BENCH_DRAIN_RATES[dix];
+         unsigned int rounds = MAX(count / burst, 1U);
+         unsigned int total = 0U;
+
+         _bench_trace_drain();
+         pa_trace_get_stats(&stats, true);
+         for (unsigned int rix=0; rix<rounds; rix++) {
+            for (unsigned int mix=0; mix<burst; mix++) {
+               pa_trace_printf(PTL_INFO,
+                               "burst %u msg %u: %s 0x%08x" EOL, rix, mix,
+                               "payload", (unsigned int)(mix * 40503U));
+               total++;
+               if ( drain && ! ((mix + 1U) % drain) ) {
+                  (void)adv_shim_uarte_complete();
+               }
+            }
+            _bench_trace_drain();
+         }
+         pa_trace_get_stats(&stats, true);
+
+         uint32_t lost = 0U;
+         for (unsigned int rix=0; rix<PTD_COUNT; rix++) {
+            lost += stats.st_drops[rix];
+         }
+         printf("  %6u %6u %8u %8u %8u %6.2f%% %6u %6u\n", burst, drain,
+                total, (unsigned int)stats.st_sent, (unsigned int)lost,
+                (100.0 * lost) / total, stats.st_hwm_count,
+                stats.st_hwm_bytes);
+      }
+   }
+}
+
+/**
+ * Time the dispatch of an event, to the end of its deferred processing.
+ *
+ * @param[in] be the event
+ * @param[in,out] sd_calls accumulated SoftDevice calls
+ */
+static void
+_bench_dispatch_one(const union bench_evt * be, uint64_t * sd_calls)
+{
+   struct adv_shim_stats stats;
+
+   adv_shim_get_stats(&stats, true);
+   uint64_t start = _bench_now();
+   adv_shim_ble_evt(&be->be_evt);
+   app_sched_execute();
+   _bench_samples_add(&_bench_samples, _bench_now() - start);
+   adv_shim_get_stats(&stats, true);
+   *sd_calls += stats.ss_sd_calls;
+   // trace transfers are not part of the measurement
+   _bench_idle();
+}
+
+static void
+_bench_dispatch_print(const char * name, uint64_t sd_calls)
+{
+   char extra[32];
+
+   snprintf(extra, sizeof(extra), "%6.2f",
+            _bench_samples.bs_count ?
+               (double)sd_calls / _bench_samples.bs_count : 0.0);
+   _bench_samples_print(name, &_bench_samples, extra);
+   _bench_samples_reset(&_bench_samples);
+}
+
+/**
+ * Dispatch suite: cost of SoftDevice events, per event type.
+ */
+static void
+_bench_dispatch(void)
+{
+   const uint16_t conn_handle = 0U;
+   unsigned int count = _bench_iterations;
+   union bench_evt be;
+   uint64_t sd_calls;
+
+   printf("\ndispatch: SoftDevice event, observer to deferred processing\n");
+   _bench_samples_header("sd/evt");
+   _bench_samples_reset(&_bench_samples);
+
+   // connection life cycle
+   uint64_t disc_calls = 0U;
+   struct bench_samples * disc = malloc(sizeof(*disc));
+   if ( ! disc ) {
+      exit(EXIT_FAILURE);
+   }
+   _bench_samples_reset(disc);
+   sd_calls = 0U;
+   for (unsigned int ix=0; ix<count; ix++) {
+      _bench_evt_init(&be, BLE_GAP_EVT_CONNECTED, conn_handle);
+      be.be_evt.evt.gap_evt.params.connected.role = BLE_GAP_ROLE_PERIPH;
+      _bench_dispatch_one(&be, &sd_calls);
+
+      uint64_t start = _bench_now();
+      _bench_disconnect(conn_handle);
+      app_sched_execute();
+      _bench_samples_add(disc, _bench_now() - start);
+      struct adv_shim_stats stats;
+      adv_shim_get_stats(&stats, true);
+      disc_calls += stats.ss_sd_calls;
+      _bench_idle();
+   }
+   _bench_dispatch_print("GAP CONNECTED", sd_calls);
+   {
+      char extra[32];
+      snprintf(extra, sizeof(extra), "%6.2f",
+               disc->bs_count ? (double)disc_calls / disc->bs_count : 0.0);
+      _bench_samples_print("GAP DISCONNECTED", disc, extra);
+   }
+   free(disc);
+
+   _bench_connect(conn_handle);
+   _bench_exchange_mtu(conn_handle);
+   _bench_idle();
+
+   sd_calls = 0U;
+   for (unsigned int ix=0; ix<count; ix++) {
+      _bench_evt_init(&be, BLE_GAP_EVT_PHY_UPDATE_REQUEST, conn_handle);
+      be.be_evt.evt.gap_evt.params.phy_update_request.peer_preferred_phys =
+         (ble_gap_phys_t){ BLE_GAP_PHY_2MBPS, BLE_GAP_PHY_2MBPS };
+      _bench_dispatch_one(&be, &sd_calls);
+   }
+   _bench_dispatch_print("GAP PHY_UPDATE_REQUEST", sd_calls);
+
+   sd_calls = 0U;
+   for (unsigned int ix=0; ix<count; ix++) {
+      _bench_evt_init(&be, BLE_GAP_EVT_CONN_PARAM_UPDATE, conn_handle);
+      be.be_evt.evt.gap_evt.params.conn_param_update.conn_params =
+         (ble_gap_conn_params_t){ 6U, 12U, 0U, 200U };
+      _bench_dispatch_one(&be, &sd_calls);
+   }
+   _bench_dispatch_print("GAP CONN_PARAM_UPDATE", sd_calls);
+
+   sd_calls = 0U;
+   for (unsigned int ix=0; ix<count; ix++) {
+      _bench_cccd_write(&be, conn_handle, BENCH_UUID_ERROR, ! (ix & 1U));
+      _bench_dispatch_one(&be, &sd_calls);
+      adv_shim_ble_hvn_complete(conn_handle);
+      _bench_idle();
+   }
+   _bench_dispatch_print("GATTS WRITE (CCCD)", sd_calls);
+
+   // notifications completed with no stream: nothing to refill
+   _bench_cccd_write(&be, conn_handle, BENCH_UUID_ERROR, false);
+   adv_shim_ble_evt(&be.be_evt);
+   _bench_idle();
+   sd_calls = 0U;
+   for (unsigned int ix=0; ix<count; ix++) {
+      _bench_evt_init(&be, BLE_GATTS_EVT_HVN_TX_COMPLETE, conn_handle);
+      be.be_evt.evt.gatts_evt.params.hvn_tx_complete.count = 1U;
+      _bench_dispatch_one(&be, &sd_calls);
+   }
+   _bench_dispatch_print("GATTS HVN_TX_COMPLETE idle", sd_calls);
+
+   // notifications completed while a bulk stream refills the TX queue
+   _bench_cccd_write(&be, conn_handle, BENCH_UUID_BULK, true);
+   adv_shim_ble_evt(&be.be_evt);
+   _bench_idle();
+   if ( adv_ble_bulk_start(&_bench_bulk_source) ) {
+      printf("  cannot start bulk stream\n");
+   } else {
+      _bench_idle();
+      sd_calls = 0U;
+      for (unsigned int ix=0; ix<count; ix++) {
+         struct adv_shim_stats stats;
+         adv_shim_get_stats(&stats, true);
+         uint64_t start = _bench_now();
+         adv_shim_ble_hvn_complete(conn_handle);
+         app_sched_execute();
+         _bench_samples_add(&_bench_samples, _bench_now() - start);
+         adv_shim_get_stats(&stats, true);
+         sd_calls += stats.ss_sd_calls;
+         _bench_idle();
+      }
+      _bench_dispatch_print("GATTS HVN_TX_COMPLETE bulk", sd_calls);
+      adv_ble_bulk_stop();
+      _bench_idle();
+   }
+
+   sd_calls = 0U;
+   for (unsigned int ix=0; ix<count; ix++) {
+      // events the application does not handle
+      _bench_evt_init(&be, BLE_GAP_EVT_SEC_PARAMS_REQUEST + 0x40U,
+                      conn_handle);
+      _bench_dispatch_one(&be, &sd_calls);
+   }
+   _bench_dispatch_print("unknown event", sd_calls);
+
+   _bench_disconnect(conn_handle);
+   _bench_idle();
+}
+
+/**
+ * Time authorization requests, from the request event to the reply.
+ *
+ * @param[in] name the measurement name
+ * @param[in] be the authorization request event
+ */
+static void
+_bench_authorize_one(const char * name, const union bench_evt * be)
+{
+   unsigned int count = _bench_iterations;
+   unsigned int failures = 0U;
+
+   _bench_samples_reset(&_bench_samples);
+   for (unsigned int ix=0; ix<count; ix++) {
+      unsigned int replies = _bench_reply.br_count;
+      uint64_t start = _bench_now();
+      adv_shim_ble_evt(&be->be_evt);
+      adv_shim_poll();
+      if ( _bench_reply.br_count == replies ) {
+         failures++;
+      } else {
+         _bench_samples_add(&_bench_samples, _bench_reply.br_time - start);
+         if ( BLE_GATT_STATUS_SUCCESS != _bench_reply.br_status ) {
+            failures++;
+         }
+      }
+      _bench_idle();
+   }
+
+   char extra[32];
+   snprintf(extra, sizeof(extra), "%u failed", failures);
+   _bench_samples_print(name, &_bench_samples, extra);
+}
+
+/**
+ * Authorize suite: read and write request latency.
+ */
+static void
+_bench_authorize(void)
+{
+   const uint16_t conn_handle = 0U;
+   union bench_evt be;
+
+   printf("\nauthorize: request to reply\n");
+   _bench_samples_header("");
+
+   adv_shim_set_reply_hook(&_bench_reply_hook);
+   _bench_connect(conn_handle);
+   _bench_exchange_mtu(conn_handle);
+   _bench_idle();
+
+   _bench_read_request(&be, conn_handle, BENCH_UUID_ERROR);
+   _bench_authorize_one("read error (no reader)", &be);
+   _bench_read_request(&be, conn_handle, BENCH_UUID_POWER);
+   _bench_authorize_one("read power (reader)", &be);
+
+   // re-apply the current level of the main source, so that the trace
+   // settings are left unchanged
+   const uint8_t level_cmd[] = {
+      PTC_LEVEL, PTM_MAIN, (uint8_t)pa_trace_get_source(PTM_MAIN),
+   };
+   _bench_write_request(&be, conn_handle, BENCH_UUID_TRACE_CTRL,
+                        level_cmd, (uint16_t)sizeof(level_cmd));
+   _bench_authorize_one("write tracectl (writer)", &be);
+
+   _bench_disconnect(conn_handle);
+   _bench_idle();
+   adv_shim_set_reply_hook(NULL);
+}
+
+//-----------------------------------------------------------------------------
+// Main
+//-----------------------------------------------------------------------------
+
+/**
+ * Initialize the application, in the same order as its main module.
+ */
+static void
+_bench_init(void)
+{
+   adv_power_boot_start();
+   pa_trace_init();
+   adv_power_boot_mark(APB_TRACE);
+
+   ret_code_t rc = app_timer_init();
+   APP_ERROR_CHECK(rc);
+   APP_SCHED_INIT(APP_TIMER_SCHED_EVENT_DATA_SIZE, BENCH_SCHED_QUEUE_SIZE);
+   adv_power_init();
+
+   adv_ble_init();
+   adv_power_start();
+   adv_ble_start();
+   _bench_idle();
+
+   // let the start up timers expire
+   adv_shim_advance(APP_TIMER_TICKS(BENCH_SETTLE_MS));
+   _bench_idle();
+}
+
+static void
+_bench_usage(const char * prog)
+{
+   fprintf(stderr, "Usage: %s [-n iterations] [-v]\n"
+                   "  -n  iterations per measurement (default: %u)\n"
+                   "  -v  copy the application traces to stdout\n",
+           prog, BENCH_ITERATIONS);
+}
+
+int
+main(int argc, char * argv[])
+{
+   int opt;
+
+   while ( (opt = getopt(argc, argv, "n:vh")) != -1 ) {
+      switch ( opt ) {
+         case 'n':
+            _bench_iterations = (unsigned int)strtoul(optarg, NULL, 0);
+            if ( ! _bench_iterations ||
+                 (_bench_iterations > BENCH_SAMPLES_MAX) ) {
+               fprintf(stderr, "Invalid iteration count\n");
+               return EXIT_FAILURE;
+            }
+            break;
+         case 'v':
+            adv_shim_uarte_echo(true);
+            break;
+         default:
+            _bench_usage(argv[0]);
+            return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+      }
+   }
+
+   _bench_init();
+
+   printf("Advertiser host benchmarks, %u iterations\n", _bench_iterations);
+   _bench_trace();
+   _bench_dispatch();
+   _bench_authorize();
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,338 @@
+/**
+ * Host simulation: Cortex-M core, peripherals and UARTE driver
+ *
+ * @file adv_shim_hw.c
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "app_error.h"
+#include "app_util_platform.h"
+#include "nrf.h"
+#include "nrfx_uarte.h"
+#include "adv_shim.h"
+#include "adv_shim_priv.h"
+
+//-----------------------------------------------------------------------------
+// Constants
+//-----------------------------------------------------------------------------
+
+/** Emulated core clock: 64 MHz */
+#define ADV_SHIM_CORE_FREQ  64000000U
+/** Frequency of the low frequency clock, RTC input */
+#define ADV_SHIM_LFCLK_FREQ 32768U
+
+//-----------------------------------------------------------------------------
+// Type definitions
+//-----------------------------------------------------------------------------
+
+/** UARTE driver instance */
+struct adv_shim_uarte {
+   nrfx_uarte_event_handler_t su_handler; /**< Driver event handler */
+   void * su_context;                     /**< Handler context */
+   const uint8_t * su_data;               /**< On-going transfer buffer */
+   size_t su_length;                      /**< On-going transfer length */
+   bool su_ready;                         /**< Driver is initialized */
+   bool su_echo;                          /**< Copy transfers to stdout */
+};
+
+//-----------------------------------------------------------------------------
+// Variables
+//-----------------------------------------------------------------------------
+
+volatile uint32_t adv_shim_ipsr;
+uint32_t SystemCoreClock = ADV_SHIM_CORE_FREQ;
+DWT_Type adv_shim_dwt;
+CoreDebug_Type adv_shim_core_debug;
+NRF_TIMER_Type adv_shim_timer2;
+NRF_RTC_Type adv_shim_rtc2;
+
+struct adv_shim_stats adv_shim_counters;
+
+/** Priority of the current execution context */
+static uint8_t _adv_shim_priority = APP_IRQ_PRIORITY_THREAD;
+/** Nesting depth of critical regions */
+static unsigned int _adv_shim_critical_depth;
+/** Free running RTC1 counter, which is 24-bit wide */
+static uint32_t _adv_shim_rtc1;
+/** RTC2 prescaler input ticks, since last clear */
+static uint64_t _adv_shim_rtc2_ticks;
+/** RTC2 has been started */
+static bool _adv_shim_rtc2_running;
+/** Debug trace UARTE */
+static struct adv_shim_uarte _adv_shim_uarte;
+
+//-----------------------------------------------------------------------------
+// Public API
+//-----------------------------------------------------------------------------
+
+/**
+ * Retrieve the simulation counters.
+ *
+ * @param[out] stats updated with the counters
+ * @param[in] reset whether to reset the counters once retrieved
+ */
+void
+adv_shim_get_stats(struct adv_shim_stats * stats, bool reset)
+{
+   *stats = adv_shim_counters;
+   if ( reset ) {
+      memset(&adv_shim_counters, 0, sizeof(adv_shim_counters));
+   }
+}
+
+/**
+ * Enter an emulated interrupt handler.
+ *
+ * @param[in] ipsr exception number of the interrupt
+ * @param[in] priority interrupt priority
+ * @param[out] saved updated with the interrupted context
+ */
+void
+adv_shim_irq_enter(uint32_t ipsr, uint8_t priority, uint32_t * saved)
+{
+   *saved = (adv_shim_ipsr << 8U) | _adv_shim_priority;
+   adv_shim_ipsr = ipsr;
+   _adv_shim_priority = priority;
+}
+
+/**
+ * Leave an emulated interrupt handler.
+ *
+ * @param[in] saved the interrupted context, from adv_shim_irq_enter()
+ */
+void
+adv_shim_irq_exit(uint32_t saved)
+{
+   adv_shim_ipsr = saved >> 8U;
+   _adv_shim_priority = (uint8_t)saved;
+}
+
+/**
+ * Report the nesting depth of critical regions, which should be nil
+ * whenever the application returns to the simulation.
+ *
+ * @return the nesting depth
+ */
+unsigned int
+adv_shim_critical_depth(void)
+{
+   return _adv_shim_critical_depth;
+}
+
+/**
+ * Complete the on-going UARTE transfer, from the UARTE interrupt handler.
+ *
+ * @return @c true if a transfer has been completed
+ */
+bool
+adv_shim_uarte_complete(void)
+{
+   struct adv_shim_uarte * uarte = &_adv_shim_uarte;
+
+   if ( ! uarte->su_data ) {
+      return false;
+   }
+
+   nrfx_uarte_event_t event = {
+      .type = NRFX_UARTE_EVT_TX_DONE,
+      .data.rxtx = {
+         .p_data = (uint8_t *)uarte->su_data,
+         .bytes = uarte->su_length,
+      },
+   };
+   uarte->su_data = NULL;
+   uarte->su_length = 0U;
+
+   uint32_t saved;
+   adv_shim_irq_enter(ADV_SHIM_IPSR_UARTE0, ADV_SHIM_PRIO_UARTE0, &saved);
+   uarte->su_handler(&event, uarte->su_context);
+   adv_shim_irq_exit(saved);
+
+   return true;
+}
+
+/**
+ * Report the length of the on-going UARTE transfer.
+ *
+ * @return the count of bytes, or 0 if the UARTE is idle
+ */
+size_t
+adv_shim_uarte_pending(void)
+{
+   return _adv_shim_uarte.su_length;
+}
+
+/**
+ * Copy UARTE transfers to the standard output.
+ *
+ * @param[in] enable whether to copy transfers
+ */
+void
+adv_shim_uarte_echo(bool enable)
+{
+   _adv_shim_uarte.su_echo = enable;
+}
+
+//-----------------------------------------------------------------------------
+// Shim internal API
+//-----------------------------------------------------------------------------
+
+/**
+ * Provide the RTC1 counter, which runs the application timers.
+ *
+ * @return the counter value
+ */
+uint32_t
+adv_shim_rtc1_counter(void)
+{
+   return _adv_shim_rtc1;
+}
+
+/**
+ * Move the free running counters forward.
+ *
+ * @param[in] ticks elapsed time, in 32768 Hz ticks
+ */
+void
+adv_shim_rtc_advance(uint32_t ticks)
+{
+   _adv_shim_rtc1 = (_adv_shim_rtc1 + ticks) & RTC_COUNTER_COUNTER_Msk;
+
+   NRF_RTC_Type * rtc = NRF_RTC2;
+   if ( rtc->TASKS_CLEAR ) {
+      rtc->TASKS_CLEAR = 0U;
+      _adv_shim_rtc2_ticks = 0U;
+   }
+   // tasks are triggers, consumed in the order the firmware issues them
+   if ( rtc->TASKS_STOP ) {
+      rtc->TASKS_STOP = 0U;
+      _adv_shim_rtc2_running = false;
+   }
+   if ( rtc->TASKS_START ) {
+      rtc->TASKS_START = 0U;
+      _adv_shim_rtc2_running = true;
+   }
+   if ( _adv_shim_rtc2_running ) {
+      _adv_shim_rtc2_ticks += ticks;
+   }
+   rtc->COUNTER = (uint32_t)(_adv_shim_rtc2_ticks / (rtc->PRESCALER + 1U)) &
+                  RTC_COUNTER_COUNTER_Msk;
+
+   if ( DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk ) {
+      DWT->CYCCNT += (uint32_t)(((uint64_t)ticks * SystemCoreClock) /
+                                ADV_SHIM_LFCLK_FREQ);
+   }
+}
+
+//-----------------------------------------------------------------------------
+// SDK platform
+//-----------------------------------------------------------------------------
+
+void
+app_util_critical_region_enter(uint8_t * nested)
+{
+   *nested = (uint8_t)(_adv_shim_critical_depth != 0U);
+   if ( ! _adv_shim_critical_depth++ ) {
+      adv_shim_counters.ss_crit_regions++;
+   }
+}
+
+void
+app_util_critical_region_exit(uint8_t nested)
+{
+   if ( ! _adv_shim_critical_depth ) {
+      fprintf(stderr, "Unbalanced critical region\n");
+      abort();
+   }
+   _adv_shim_critical_depth--;
+   (void)nested;
+}
+
+uint8_t
+current_int_priority_get(void)
+{
+   return _adv_shim_priority;
+}
+
+void
+app_error_handler(uint32_t error_code, uint32_t line_num,
+                  const uint8_t * p_file_name)
+{
+   fflush(stdout);
+   fprintf(stderr, "Fatal error 0x%x at %s:%u\n", (unsigned int)error_code,
+           p_file_name ? (const char *)p_file_name : "?",
+           (unsigned int)line_num);
+   abort();
+}
+
+//-----------------------------------------------------------------------------
+// UARTE driver
+//-----------------------------------------------------------------------------
+
+ret_code_t
+nrfx_uarte_init(nrfx_uarte_t const * p_instance,
+                nrfx_uarte_config_t const * p_config,
+                nrfx_uarte_event_handler_t event_handler)
+{
+   struct adv_shim_uarte * uarte = &_adv_shim_uarte;
+
+   (void)p_instance;
+   if ( uarte->su_ready ) {
+      return NRF_ERROR_INVALID_STATE;
+   }
+   uarte->su_handler = event_handler;
+   uarte->su_context = p_config->p_context;
+   uarte->su_data = NULL;
+   uarte->su_length = 0U;
+   uarte->su_ready = true;
+
+   return NRF_SUCCESS;
+}
+
+void
+nrfx_uarte_uninit(nrfx_uarte_t const * p_instance)
+{
+   (void)p_instance;
+   _adv_shim_uarte.su_ready = false;
+   _adv_shim_uarte.su_data = NULL;
+   _adv_shim_uarte.su_length = 0U;
+}
+
+ret_code_t
+nrfx_uarte_tx(nrfx_uarte_t const * p_instance, uint8_t const * p_data,
+              size_t length)
+{
+   struct adv_shim_uarte * uarte = &_adv_shim_uarte;
+
+   (void)p_instance;
+   if ( ! uarte->su_ready ) {
+      return NRF_ERROR_INVALID_STATE;
+   }
+   if ( uarte->su_data ) {
+      return NRF_ERROR_BUSY;
+   }
+   if ( ! length || (length >= (1U << UARTE0_EASYDMA_MAXCNT_SIZE)) ) {
+      return NRF_ERROR_INVALID_LENGTH;
+   }
+
+   uarte->su_data = p_data;
+   uarte->su_length = length;
+   adv_shim_counters.ss_uarte_tx++;
+   adv_shim_counters.ss_uarte_bytes += (uint32_t)length;
+   if ( uarte->su_echo ) {
+      fwrite(p_data, 1U, length, stdout);
+   }
+
+   return NRF_SUCCESS;
+}
+
+bool
+nrfx_uarte_tx_in_progress(nrfx_uarte_t const * p_instance)
+{
+   (void)p_instance;
+   return _adv_shim_uarte.su_data != NULL;
+}
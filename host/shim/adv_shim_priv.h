@@ -0,0 +1,31 @@
+/**
+ * Host simulation, definitions shared between the shim modules
+ *
+ * @file adv_shim_priv.h
+ */
+
+#ifndef _ADV_SHIM_PRIV_H_
+#define _ADV_SHIM_PRIV_H_
+
+#include <stdint.h>
+#include "adv_shim.h"
+
+/** Exception numbers of the emulated interrupts (IRQn + 16) */
+#define ADV_SHIM_IPSR_UARTE0 (16U + 2U)
+#define ADV_SHIM_IPSR_RTC1   (16U + 17U)
+#define ADV_SHIM_IPSR_SWI2   (16U + 22U)
+
+/** Priorities of the emulated interrupts, as configured on target */
+#define ADV_SHIM_PRIO_UARTE0 3U
+#define ADV_SHIM_PRIO_RTC1   6U
+#define ADV_SHIM_PRIO_SWI2   6U
+
+/** Simulation counters */
+extern struct adv_shim_stats adv_shim_counters;
+
+uint32_t adv_shim_rtc1_counter(void);
+void adv_shim_rtc_advance(uint32_t ticks);
+void adv_shim_conn_params_poll(void);
+void adv_shim_conn_params_release(uint16_t conn_handle);
+
+#endif // _ADV_SHIM_PRIV_H_
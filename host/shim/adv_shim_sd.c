@@ -0,0 +1,565 @@
+/**
+ * Host simulation: S132 SoftDevice and its handler library
+ *
+ * The simulated SoftDevice allocates attribute handles as the real one does,
+ * tracks connections and CCCD states from the events it delivers, and models
+ * the notification TX queue. Other calls are accepted and only accounted.
+ *
+ * @file adv_shim_sd.c
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "app_util_platform.h"
+#include "ble.h"
+#include "nrf_sdh.h"
+#include "nrf_sdh_ble.h"
+#include "nrf_soc.h"
+#include "sdk_config.h"
+#include "adv_shim.h"
+#include "adv_shim_priv.h"
+#include "adv_tools.h"
+
+//-----------------------------------------------------------------------------
+// Constants
+//-----------------------------------------------------------------------------
+
+/** First attribute handle after the GAP and GATT services */
+#define ADV_SHIM_FIRST_HANDLE   0x000CU
+/** Largest count of characteristics */
+#define ADV_SHIM_CHAR_MAX       32U
+/** Largest count of connections */
+#define ADV_SHIM_CONN_MAX       NRF_SDH_BLE_TOTAL_LINK_COUNT
+/** Start of the application RAM, as if the SoftDevice fit in 8 KiB */
+#define ADV_SHIM_APP_RAM_START  0x20002000U
+/** First vendor specific UUID type */
+#define ADV_SHIM_VS_UUID_FIRST  BLE_UUID_TYPE_VENDOR_BEGIN
+
+//-----------------------------------------------------------------------------
+// Type definitions
+//-----------------------------------------------------------------------------
+
+/** Characteristic record */
+struct adv_shim_char {
+   ble_uuid_t sc_uuid;                 /**< Characteristic UUID */
+   ble_gatts_char_handles_t sc_handles; /**< Allocated handles */
+};
+
+/** Connection record */
+struct adv_shim_conn {
+   uint16_t sn_conn_handle;   /**< Connection, or invalid if free */
+   uint16_t sn_hvn_queued;    /**< Queued notifications */
+   uint32_t sn_cccd_notify;   /**< Enabled notifications, per characteristic */
+};
+
+//-----------------------------------------------------------------------------
+// Variables
+//-----------------------------------------------------------------------------
+
+/** Observers, gathered by the linker from NRF_SDH_BLE_OBSERVER */
+extern const nrf_sdh_ble_evt_observer_t __start_sdh_ble_observers[];
+extern const nrf_sdh_ble_evt_observer_t __stop_sdh_ble_observers[];
+
+static struct adv_shim_char _adv_shim_chars[ADV_SHIM_CHAR_MAX];
+static unsigned int _adv_shim_char_count;
+static uint16_t _adv_shim_next_handle = ADV_SHIM_FIRST_HANDLE;
+static uint8_t _adv_shim_vs_uuid_type = ADV_SHIM_VS_UUID_FIRST;
+/** Notification TX queue size, per connection */
+static uint16_t _adv_shim_hvn_queue_size =
+   BLE_GATTS_HVN_TX_QUEUE_SIZE_DEFAULT;
+static struct adv_shim_conn _adv_shim_conns[ADV_SHIM_CONN_MAX] = {
+   [0 ... (ADV_SHIM_CONN_MAX - 1U)] = {
+      .sn_conn_handle = BLE_CONN_HANDLE_INVALID,
+   },
+};
+static adv_shim_reply_hook_t _adv_shim_reply_hook;
+
+//-----------------------------------------------------------------------------
+// Implementation
+//-----------------------------------------------------------------------------
+
+static struct adv_shim_conn *
+_adv_shim_conn_find(uint16_t conn_handle)
+{
+   for (unsigned int ix=0; ix<ADV_SHIM_CONN_MAX; ix++) {
+      if ( _adv_shim_conns[ix].sn_conn_handle == conn_handle ) {
+         return &_adv_shim_conns[ix];
+      }
+   }
+   return NULL;
+}
+
+static int
+_adv_shim_char_find(uint16_t handle, bool cccd)
+{
+   for (unsigned int ix=0; ix<_adv_shim_char_count; ix++) {
+      const ble_gatts_char_handles_t * h = &_adv_shim_chars[ix].sc_handles;
+      if ( (cccd ? h->cccd_handle : h->value_handle) == handle ) {
+         return (int)ix;
+      }
+   }
+   return -1;
+}
+
+/**
+ * Update the connection records before the application processes an event.
+ *
+ * @param[in] ble_evt the event
+ */
+static void
+_adv_shim_ble_evt_track(const ble_evt_t * ble_evt)
+{
+   uint16_t conn_handle = ble_evt->evt.gap_evt.conn_handle;
+   struct adv_shim_conn * conn;
+
+   switch ( ble_evt->header.evt_id ) {
+      case BLE_GAP_EVT_CONNECTED:
+         conn = _adv_shim_conn_find(BLE_CONN_HANDLE_INVALID);
+         if ( conn && ! _adv_shim_conn_find(conn_handle) ) {
+            conn->sn_conn_handle = conn_handle;
+            conn->sn_hvn_queued = 0U;
+            conn->sn_cccd_notify = 0U;
+         }
+         break;
+
+      case BLE_GATTS_EVT_WRITE: {
+         const ble_gatts_evt_write_t * wr =
+            &ble_evt->evt.gatts_evt.params.write;
+         int cix = _adv_shim_char_find(wr->handle, true);
+         conn = _adv_shim_conn_find(conn_handle);
+         if ( (cix < 0) || ! conn || (wr->len < 2U) ) {
+            break;
+         }
+         if ( wr->data[0] & BLE_GATT_HVX_NOTIFICATION ) {
+            conn->sn_cccd_notify |= 1U << cix;
+         } else {
+            conn->sn_cccd_notify &= ~(1U << cix);
+         }
+         break;
+      }
+
+      default:
+         break;
+   }
+}
+
+//-----------------------------------------------------------------------------
+// Public API
+//-----------------------------------------------------------------------------
+
+/**
+ * Deliver a SoftDevice event to all the BLE observers, from the SoftDevice
+ * event interrupt handler.
+ *
+ * @param[in] ble_evt the event
+ */
+void
+adv_shim_ble_evt(const ble_evt_t * ble_evt)
+{
+   _adv_shim_ble_evt_track(ble_evt);
+
+   uint32_t saved;
+   adv_shim_irq_enter(ADV_SHIM_IPSR_SWI2, ADV_SHIM_PRIO_SWI2, &saved);
+   for (const nrf_sdh_ble_evt_observer_t * obs=__start_sdh_ble_observers;
+        obs < __stop_sdh_ble_observers; obs++) {
+      obs->handler(ble_evt, obs->p_context);
+   }
+   adv_shim_irq_exit(saved);
+
+   if ( BLE_GAP_EVT_DISCONNECTED == ble_evt->header.evt_id ) {
+      uint16_t conn_handle = ble_evt->evt.gap_evt.conn_handle;
+      struct adv_shim_conn * conn = _adv_shim_conn_find(conn_handle);
+      if ( conn ) {
+         conn->sn_conn_handle = BLE_CONN_HANDLE_INVALID;
+      }
+      adv_shim_conn_params_release(conn_handle);
+   }
+}
+
+/**
+ * Complete the queued notifications of a connection, as at the end of a
+ * connection event.
+ *
+ * @param[in] conn_handle the connection
+ */
+void
+adv_shim_ble_hvn_complete(uint16_t conn_handle)
+{
+   struct adv_shim_conn * conn = _adv_shim_conn_find(conn_handle);
+
+   if ( ! conn || ! conn->sn_hvn_queued ) {
+      return;
+   }
+
+   ble_evt_t evt = {
+      .header = {
+         .evt_id = BLE_GATTS_EVT_HVN_TX_COMPLETE,
+         .evt_len = sizeof(ble_evt_t),
+      },
+      .evt.gatts_evt = {
+         .conn_handle = conn_handle,
+         .params.hvn_tx_complete.count = (uint8_t)conn->sn_hvn_queued,
+      },
+   };
+   conn->sn_hvn_queued = 0U;
+   adv_shim_ble_evt(&evt);
+}
+
+/**
+ * Install a hook to observe the authorization replies.
+ *
+ * @param[in] hook the hook, or @c NULL to remove it
+ */
+void
+adv_shim_set_reply_hook(adv_shim_reply_hook_t hook)
+{
+   _adv_shim_reply_hook = hook;
+}
+
+/**
+ * Retrieve an application characteristic.
+ *
+ * @param[in] uuid 16-bit UUID of the characteristic
+ * @param[out] ble_uuid updated with the full UUID, may be @c NULL
+ * @param[out] handles updated with the characteristic handles
+ * @return @c true if the characteristic exists
+ */
+bool
+adv_shim_gatts_find(uint16_t uuid, ble_uuid_t * ble_uuid,
+                    ble_gatts_char_handles_t * handles)
+{
+   for (unsigned int ix=0; ix<_adv_shim_char_count; ix++) {
+      const struct adv_shim_char * sc = &_adv_shim_chars[ix];
+      if ( (sc->sc_uuid.uuid == uuid) &&
+           (sc->sc_uuid.type >= BLE_UUID_TYPE_VENDOR_BEGIN) ) {
+         if ( ble_uuid ) {
+            *ble_uuid = sc->sc_uuid;
+         }
+         *handles = sc->sc_handles;
+         return true;
+      }
+   }
+   return false;
+}
+
+//-----------------------------------------------------------------------------
+// SoftDevice handler
+//-----------------------------------------------------------------------------
+
+ret_code_t
+nrf_sdh_enable_request(void)
+{
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+nrf_sdh_ble_app_ram_start_get(uint32_t * p_app_ram_start)
+{
+   *p_app_ram_start = ADV_SHIM_APP_RAM_START;
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+nrf_sdh_ble_enable(uint32_t * p_app_ram_start)
+{
+   // the configured RAM is always deemed large enough
+   *p_app_ram_start = ADV_SHIM_APP_RAM_START;
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+sd_app_evt_wait(void)
+{
+   adv_shim_counters.ss_sd_calls++;
+   return NRF_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Common API
+//-----------------------------------------------------------------------------
+
+ret_code_t
+sd_ble_cfg_set(uint32_t cfg_id, ble_cfg_t const * p_cfg,
+               uint32_t app_ram_base)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)app_ram_base;
+   if ( BLE_CONN_CFG_GATTS == cfg_id ) {
+      _adv_shim_hvn_queue_size =
+         MAX(p_cfg->conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size, 1U);
+   }
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+sd_ble_version_get(ble_version_t * p_version)
+{
+   adv_shim_counters.ss_sd_calls++;
+   // S132 v6.0.0
+   p_version->version_number = 0x09U;
+   p_version->company_id = 0x0059U;
+   p_version->subversion_number = 0x00A8U;
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+sd_ble_uuid_vs_add(ble_uuid128_t const * p_vs_uuid, uint8_t * p_uuid_type)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)p_vs_uuid;
+   *p_uuid_type = _adv_shim_vs_uuid_type++;
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+sd_ble_user_mem_reply(uint16_t conn_handle,
+                      ble_user_mem_block_t const * p_block)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)p_block;
+   return _adv_shim_conn_find(conn_handle) ? NRF_SUCCESS :
+                                             BLE_ERROR_INVALID_CONN_HANDLE;
+}
+
+//-----------------------------------------------------------------------------
+// GAP API
+//-----------------------------------------------------------------------------
+
+ret_code_t
+sd_ble_gap_addr_get(ble_gap_addr_t * p_addr)
+{
+   static const uint8_t addr[] = { 0x01U, 0x02U, 0x03U, 0x04U, 0x05U, 0xC6U };
+
+   adv_shim_counters.ss_sd_calls++;
+   memset(p_addr, 0, sizeof(*p_addr));
+   memcpy(p_addr->addr, addr, sizeof(addr));
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+sd_ble_gap_device_name_set(ble_gap_conn_sec_mode_t const * p_mode,
+                           uint8_t const * p_dev_name, uint16_t len)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)p_mode;
+   (void)p_dev_name;
+   return (len <= BLE_GAP_DEVNAME_DEFAULT_LEN) ? NRF_SUCCESS :
+                                                 NRF_ERROR_DATA_SIZE;
+}
+
+ret_code_t
+sd_ble_gap_appearance_set(uint16_t appearance)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)appearance;
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+sd_ble_gap_ppcp_set(ble_gap_conn_params_t const * p_params)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)p_params;
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+sd_ble_gap_tx_power_set(uint8_t role, uint16_t handle, int8_t tx_power)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)role;
+   (void)handle;
+   (void)tx_power;
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_code)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)hci_code;
+   return _adv_shim_conn_find(conn_handle) ? NRF_SUCCESS :
+                                             BLE_ERROR_INVALID_CONN_HANDLE;
+}
+
+ret_code_t
+sd_ble_gap_conn_param_update(uint16_t conn_handle,
+                             ble_gap_conn_params_t const * p)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)p;
+   return _adv_shim_conn_find(conn_handle) ? NRF_SUCCESS :
+                                             BLE_ERROR_INVALID_CONN_HANDLE;
+}
+
+ret_code_t
+sd_ble_gap_phy_update(uint16_t conn_handle, ble_gap_phys_t const * p_gap_phys)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)p_gap_phys;
+   return _adv_shim_conn_find(conn_handle) ? NRF_SUCCESS :
+                                             BLE_ERROR_INVALID_CONN_HANDLE;
+}
+
+ret_code_t
+sd_ble_gap_adv_set_configure(uint8_t * p_adv_handle,
+                             ble_gap_adv_data_t const * p_data,
+                             ble_gap_adv_params_t const * p_params)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)p_data;
+   (void)p_params;
+   if ( BLE_GAP_ADV_SET_HANDLE_NOT_SET == *p_adv_handle ) {
+      *p_adv_handle = 0U;
+   }
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+sd_ble_gap_adv_stop(uint8_t adv_handle)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)adv_handle;
+   return NRF_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// GATT server API
+//-----------------------------------------------------------------------------
+
+ret_code_t
+sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const * p_uuid,
+                         uint16_t * p_handle)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)type;
+   (void)p_uuid;
+   *p_handle = _adv_shim_next_handle++;
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+sd_ble_gatts_characteristic_add(uint16_t service_handle,
+                                ble_gatts_char_md_t const * p_md,
+                                ble_gatts_attr_t const * p_value,
+                                ble_gatts_char_handles_t * p_h)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)service_handle;
+   if ( _adv_shim_char_count >= ADV_SHIM_CHAR_MAX ) {
+      return NRF_ERROR_NO_MEM;
+   }
+
+   // declaration, value, then the descriptors in a fixed order
+   memset(p_h, 0, sizeof(*p_h));
+   _adv_shim_next_handle++;
+   p_h->value_handle = _adv_shim_next_handle++;
+   if ( p_md->char_props.notify || p_md->char_props.indicate ) {
+      p_h->cccd_handle = _adv_shim_next_handle++;
+   }
+   if ( p_md->p_char_user_desc ) {
+      p_h->user_desc_handle = _adv_shim_next_handle++;
+   }
+
+   struct adv_shim_char * sc = &_adv_shim_chars[_adv_shim_char_count++];
+   sc->sc_uuid = *p_value->p_uuid;
+   sc->sc_handles = *p_h;
+
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+sd_ble_gatts_rw_authorize_reply(
+   uint16_t conn_handle,
+   ble_gatts_rw_authorize_reply_params_t const * p_reply)
+{
+   adv_shim_counters.ss_sd_calls++;
+   if ( ! _adv_shim_conn_find(conn_handle) ) {
+      return BLE_ERROR_INVALID_CONN_HANDLE;
+   }
+   adv_shim_counters.ss_auth_replies++;
+   if ( _adv_shim_reply_hook ) {
+      _adv_shim_reply_hook(conn_handle, p_reply);
+   }
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+sd_ble_gatts_sys_attr_set(uint16_t conn_handle,
+                          uint8_t const * p_sys_attr_data, uint16_t len,
+                          uint32_t flags)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)p_sys_attr_data;
+   (void)len;
+   (void)flags;
+   return _adv_shim_conn_find(conn_handle) ? NRF_SUCCESS :
+                                             BLE_ERROR_INVALID_CONN_HANDLE;
+}
+
+ret_code_t
+sd_ble_gatts_hvx(uint16_t conn_handle,
+                 ble_gatts_hvx_params_t const * p_hvx_params)
+{
+   adv_shim_counters.ss_sd_calls++;
+
+   struct adv_shim_conn * conn = _adv_shim_conn_find(conn_handle);
+   if ( ! conn || (BLE_CONN_HANDLE_INVALID == conn_handle) ) {
+      return BLE_ERROR_INVALID_CONN_HANDLE;
+   }
+   int cix = _adv_shim_char_find(p_hvx_params->handle, false);
+   if ( cix < 0 ) {
+      return BLE_ERROR_INVALID_ATTR_HANDLE;
+   }
+   if ( ! (conn->sn_cccd_notify & (1U << cix)) ) {
+      return NRF_ERROR_INVALID_STATE;
+   }
+   if ( conn->sn_hvn_queued >= _adv_shim_hvn_queue_size ) {
+      adv_shim_counters.ss_hvx_busy++;
+      return NRF_ERROR_RESOURCES;
+   }
+
+   conn->sn_hvn_queued++;
+   adv_shim_counters.ss_hvx++;
+
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+sd_ble_gatts_value_set(uint16_t conn_handle, uint16_t handle,
+                       ble_gatts_value_t * p_value)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)conn_handle;
+   (void)p_value;
+   return (_adv_shim_char_find(handle, false) >= 0) ?
+      NRF_SUCCESS : BLE_ERROR_INVALID_ATTR_HANDLE;
+}
+
+ret_code_t
+sd_ble_gatts_attr_get(uint16_t handle, ble_uuid_t * p_uuid,
+                      ble_gatts_attr_md_t * p_md)
+{
+   adv_shim_counters.ss_sd_calls++;
+   (void)p_md;
+   if ( (BLE_GATT_HANDLE_INVALID == handle) ||
+        (handle >= _adv_shim_next_handle) ) {
+      return NRF_ERROR_NOT_FOUND;
+   }
+   if ( ! p_uuid ) {
+      return NRF_SUCCESS;
+   }
+   // only characteristic values and CCCDs are tracked
+   int cix = _adv_shim_char_find(handle, false);
+   if ( cix >= 0 ) {
+      *p_uuid = _adv_shim_chars[cix].sc_uuid;
+   } else if ( _adv_shim_char_find(handle, true) >= 0 ) {
+      p_uuid->uuid = BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG;
+      p_uuid->type = BLE_UUID_TYPE_BLE;
+   } else {
+      p_uuid->uuid = 0U;
+      p_uuid->type = BLE_UUID_TYPE_UNKNOWN;
+   }
+   return NRF_SUCCESS;
+}
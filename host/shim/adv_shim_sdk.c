@@ -0,0 +1,751 @@
+/**
+ * Host simulation: nRF5 SDK modules
+ *
+ * Application timers, scheduler, and the BLE helper modules the application
+ * relies on: advertising, connection parameters, GATT negotiation and device
+ * information service.
+ *
+ * @file adv_shim_sdk.c
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "app_error.h"
+#include "app_scheduler.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "ble.h"
+#include "ble_advdata.h"
+#include "ble_advertising.h"
+#include "ble_conn_params.h"
+#include "ble_dis.h"
+#include "nrf_ble_gatt.h"
+#include "sdk_config.h"
+#include "adv_shim.h"
+#include "adv_shim_priv.h"
+#include "adv_tools.h"
+
+//-----------------------------------------------------------------------------
+// Constants
+//-----------------------------------------------------------------------------
+
+/** Largest queue of the scheduler */
+#define ADV_SHIM_SCHED_QUEUE_MAX  64U
+/** Pending connection parameter negotiations */
+#define ADV_SHIM_CONN_PARAMS_MAX  NRF_SDH_BLE_PERIPHERAL_LINK_COUNT
+
+/** AD types */
+#define ADV_SHIM_AD_TYPE_FLAGS        0x01U
+#define ADV_SHIM_AD_TYPE_MANUF_DATA   0xFFU
+
+//-----------------------------------------------------------------------------
+// Type definitions
+//-----------------------------------------------------------------------------
+
+/** Scheduler event */
+struct adv_shim_sched_evt {
+   app_sched_event_handler_t se_handler;      /**< Event handler */
+   uint16_t se_size;                          /**< Event data size */
+   uint8_t se_data[APP_SCHED_SHIM_EVENT_SIZE_MAX]; /**< Event data */
+};
+
+/** Scheduler */
+struct adv_shim_sched {
+   struct adv_shim_sched_evt sc_queue[ADV_SHIM_SCHED_QUEUE_MAX];
+   uint16_t sc_size;      /**< Configured queue size */
+   uint16_t sc_evt_size;  /**< Configured largest event data */
+   uint16_t sc_read;      /**< Next event to run */
+   uint16_t sc_count;     /**< Queued events */
+   uint16_t sc_hwm;       /**< Highest count of queued events */
+};
+
+/** Application timer event, as handed over to the scheduler */
+struct adv_shim_timer_evt {
+   app_timer_timeout_handler_t te_handler; /**< Timeout handler */
+   void * te_context;                      /**< Handler context */
+};
+
+/** Connection parameter negotiation */
+struct adv_shim_conn_params {
+   uint16_t cp_conn_handle;  /**< Connection */
+   bool cp_pending;          /**< Outcome to report */
+   bool cp_refuse;           /**< The peer refuses new parameters */
+};
+
+//-----------------------------------------------------------------------------
+// Variables
+//-----------------------------------------------------------------------------
+
+static struct adv_shim_sched _adv_shim_sched;
+
+/** Active timers */
+static app_timer_t * _adv_shim_timers;
+/** Elapsed time, which never wraps, in ticks */
+static uint64_t _adv_shim_now;
+
+static ble_conn_params_init_t _adv_shim_conn_params_init;
+static struct adv_shim_conn_params
+   _adv_shim_conn_params[ADV_SHIM_CONN_PARAMS_MAX];
+
+//-----------------------------------------------------------------------------
+// Public API
+//-----------------------------------------------------------------------------
+
+/**
+ * Move simulation time forward. The application timers that expire on the
+ * way are handed over to the scheduler in expiry order; the scheduler is
+ * not run.
+ *
+ * @param[in] ticks elapsed time, in 32768 Hz ticks
+ */
+void
+adv_shim_advance(uint32_t ticks)
+{
+   uint64_t end = _adv_shim_now + ticks;
+
+   for (;;) {
+      app_timer_t * next = NULL;
+      for (app_timer_t * t=_adv_shim_timers; t; t=t->next) {
+         if ( (t->expire <= end) && (! next || (t->expire < next->expire)) ) {
+            next = t;
+         }
+      }
+      if ( ! next ) {
+         break;
+      }
+
+      adv_shim_rtc_advance((uint32_t)(next->expire - _adv_shim_now));
+      _adv_shim_now = next->expire;
+
+      app_timer_timeout_handler_t handler = next->handler;
+      void * context = next->p_context;
+      if ( APP_TIMER_MODE_REPEATED == next->mode ) {
+         next->expire += next->period;
+      } else {
+         (void)app_timer_stop(next);
+      }
+
+      const struct adv_shim_timer_evt evt = {
+         .te_handler = handler,
+         .te_context = context,
+      };
+      adv_shim_counters.ss_timer_fires++;
+      uint32_t saved;
+      adv_shim_irq_enter(ADV_SHIM_IPSR_RTC1, ADV_SHIM_PRIO_RTC1, &saved);
+      ret_code_t rc = app_sched_event_put(&evt, sizeof(evt), NULL);
+      adv_shim_irq_exit(saved);
+      APP_ERROR_CHECK(rc);
+   }
+
+   adv_shim_rtc_advance((uint32_t)(end - _adv_shim_now));
+   _adv_shim_now = end;
+}
+
+/**
+ * Run the main loop once: report the connection parameter negotiations,
+ * then run all scheduled events.
+ */
+void
+adv_shim_poll(void)
+{
+   adv_shim_conn_params_poll();
+   app_sched_execute();
+}
+
+/**
+ * Make the peer of a connection refuse or accept new connection parameters.
+ *
+ * @param[in] conn_handle the connection
+ * @param[in] refuse whether to refuse the next negotiations
+ */
+void
+adv_shim_conn_params_refuse(uint16_t conn_handle, bool refuse)
+{
+   for (unsigned int ix=0; ix<ADV_SHIM_CONN_PARAMS_MAX; ix++) {
+      struct adv_shim_conn_params * cp = &_adv_shim_conn_params[ix];
+      if ( cp->cp_conn_handle == conn_handle ) {
+         cp->cp_refuse = refuse;
+         return;
+      }
+   }
+   for (unsigned int ix=0; ix<ADV_SHIM_CONN_PARAMS_MAX; ix++) {
+      struct adv_shim_conn_params * cp = &_adv_shim_conn_params[ix];
+      if ( BLE_CONN_HANDLE_INVALID == cp->cp_conn_handle ) {
+         cp->cp_conn_handle = conn_handle;
+         cp->cp_refuse = refuse;
+         return;
+      }
+   }
+}
+
+//-----------------------------------------------------------------------------
+// Shim internal API
+//-----------------------------------------------------------------------------
+
+/**
+ * Report the outcome of the pending connection parameter negotiations, from
+ * the SoftDevice event handler.
+ */
+void
+adv_shim_conn_params_poll(void)
+{
+   ble_conn_params_evt_handler_t handler =
+      _adv_shim_conn_params_init.evt_handler;
+
+   for (unsigned int ix=0; ix<ADV_SHIM_CONN_PARAMS_MAX; ix++) {
+      struct adv_shim_conn_params * cp = &_adv_shim_conn_params[ix];
+      if ( ! cp->cp_pending ) {
+         continue;
+      }
+      cp->cp_pending = false;
+      if ( ! handler ) {
+         continue;
+      }
+      ble_conn_params_evt_t evt = {
+         .evt_type = cp->cp_refuse ? BLE_CONN_PARAMS_EVT_FAILED :
+                                     BLE_CONN_PARAMS_EVT_SUCCEEDED,
+         .conn_handle = cp->cp_conn_handle,
+      };
+      uint32_t saved;
+      adv_shim_irq_enter(ADV_SHIM_IPSR_SWI2, ADV_SHIM_PRIO_SWI2, &saved);
+      handler(&evt);
+      adv_shim_irq_exit(saved);
+   }
+}
+
+/**
+ * Forget any negotiation of a terminated connection.
+ *
+ * @param[in] conn_handle the connection
+ */
+void
+adv_shim_conn_params_release(uint16_t conn_handle)
+{
+   for (unsigned int ix=0; ix<ADV_SHIM_CONN_PARAMS_MAX; ix++) {
+      struct adv_shim_conn_params * cp = &_adv_shim_conn_params[ix];
+      if ( cp->cp_conn_handle == conn_handle ) {
+         cp->cp_conn_handle = BLE_CONN_HANDLE_INVALID;
+         cp->cp_pending = false;
+         cp->cp_refuse = false;
+      }
+   }
+}
+
+//-----------------------------------------------------------------------------
+// Scheduler
+//-----------------------------------------------------------------------------
+
+ret_code_t
+app_sched_init(uint16_t max_event_size, uint16_t queue_size,
+               void * p_evt_buffer)
+{
+   struct adv_shim_sched * sc = &_adv_shim_sched;
+
+   (void)p_evt_buffer;
+   if ( (max_event_size > APP_SCHED_SHIM_EVENT_SIZE_MAX) ||
+        (queue_size > ADV_SHIM_SCHED_QUEUE_MAX) ) {
+      return NRF_ERROR_INVALID_PARAM;
+   }
+   memset(sc, 0, sizeof(*sc));
+   sc->sc_size = queue_size;
+   sc->sc_evt_size = max_event_size;
+
+   return NRF_SUCCESS;
+}
+
+/**
+ * Run an expired application timer, from the scheduler.
+ */
+static void
+_adv_shim_timer_sched_handler(void * p_event_data, uint16_t event_size)
+{
+   const struct adv_shim_timer_evt * evt = p_event_data;
+
+   (void)event_size;
+   evt->te_handler(evt->te_context);
+}
+
+ret_code_t
+app_sched_event_put(void const * p_event_data, uint16_t event_size,
+                    app_sched_event_handler_t handler)
+{
+   struct adv_shim_sched * sc = &_adv_shim_sched;
+   ret_code_t rc = NRF_SUCCESS;
+
+   if ( event_size > sc->sc_evt_size ) {
+      return NRF_ERROR_INVALID_LENGTH;
+   }
+   if ( ! handler ) {
+      // only the timer module relies on the default handler
+      handler = &_adv_shim_timer_sched_handler;
+   }
+
+   CRITICAL_REGION_ENTER();
+   if ( sc->sc_count < sc->sc_size ) {
+      struct adv_shim_sched_evt * se =
+         &sc->sc_queue[(sc->sc_read + sc->sc_count) % sc->sc_size];
+      se->se_handler = handler;
+      se->se_size = event_size;
+      if ( p_event_data && event_size ) {
+         memcpy(se->se_data, p_event_data, event_size);
+      }
+      sc->sc_count++;
+      sc->sc_hwm = MAX(sc->sc_hwm, sc->sc_count);
+      adv_shim_counters.ss_sched_puts++;
+   } else {
+      adv_shim_counters.ss_sched_full++;
+      rc = NRF_ERROR_NO_MEM;
+   }
+   CRITICAL_REGION_EXIT();
+
+   return rc;
+}
+
+void
+app_sched_execute(void)
+{
+   struct adv_shim_sched * sc = &_adv_shim_sched;
+
+   while ( sc->sc_count ) {
+      struct adv_shim_sched_evt se = sc->sc_queue[sc->sc_read];
+      sc->sc_read = (uint16_t)((sc->sc_read + 1U) % sc->sc_size);
+      sc->sc_count--;
+      se.se_handler(se.se_size ? se.se_data : NULL, se.se_size);
+   }
+}
+
+uint16_t
+app_sched_queue_space_get(void)
+{
+   return (uint16_t)(_adv_shim_sched.sc_size - _adv_shim_sched.sc_count);
+}
+
+uint16_t
+app_sched_queue_utilization_get(void)
+{
+   return _adv_shim_sched.sc_hwm;
+}
+
+//-----------------------------------------------------------------------------
+// Application timers
+//-----------------------------------------------------------------------------
+
+ret_code_t
+app_timer_init(void)
+{
+   _adv_shim_timers = NULL;
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+app_timer_create(app_timer_id_t const * p_timer_id, app_timer_mode_t mode,
+                 app_timer_timeout_handler_t timeout_handler)
+{
+   if ( ! p_timer_id || ! *p_timer_id || ! timeout_handler ) {
+      return NRF_ERROR_INVALID_PARAM;
+   }
+
+   app_timer_t * timer = *p_timer_id;
+   memset(timer, 0, sizeof(*timer));
+   timer->handler = timeout_handler;
+   timer->mode = mode;
+
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks,
+                void * p_context)
+{
+   if ( ! timer_id->handler ) {
+      return NRF_ERROR_INVALID_STATE;
+   }
+   if ( timeout_ticks < APP_TIMER_MIN_TIMEOUT_TICKS ) {
+      return NRF_ERROR_INVALID_PARAM;
+   }
+
+   (void)app_timer_stop(timer_id);
+   timer_id->p_context = p_context;
+   timer_id->expire = _adv_shim_now + timeout_ticks;
+   timer_id->period = timeout_ticks;
+   timer_id->active = true;
+   timer_id->next = _adv_shim_timers;
+   _adv_shim_timers = timer_id;
+
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+app_timer_stop(app_timer_id_t timer_id)
+{
+   for (app_timer_t ** link=&_adv_shim_timers; *link; link=&(*link)->next) {
+      if ( *link == timer_id ) {
+         *link = timer_id->next;
+         break;
+      }
+   }
+   timer_id->next = NULL;
+   timer_id->active = false;
+
+   return NRF_SUCCESS;
+}
+
+uint32_t
+app_timer_cnt_get(void)
+{
+   return adv_shim_rtc1_counter();
+}
+
+uint32_t
+app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from)
+{
+   return (ticks_to - ticks_from) & APP_TIMER_MAX_CNT_VAL;
+}
+
+//-----------------------------------------------------------------------------
+// Advertising
+//-----------------------------------------------------------------------------
+
+ret_code_t
+ble_advdata_encode(ble_advdata_t const * p_advdata, uint8_t * p_encoded_data,
+                   uint16_t * p_len)
+{
+   // only the fields the application advertises are encoded
+   uint16_t max = *p_len;
+   uint16_t len = 0U;
+
+   if ( p_advdata->flags ) {
+      if ( len + 3U > max ) {
+         return NRF_ERROR_DATA_SIZE;
+      }
+      p_encoded_data[len++] = 2U;
+      p_encoded_data[len++] = ADV_SHIM_AD_TYPE_FLAGS;
+      p_encoded_data[len++] = p_advdata->flags;
+   }
+
+   const ble_advdata_manuf_data_t * manuf = p_advdata->p_manuf_specific_data;
+   if ( manuf ) {
+      uint16_t size = (uint16_t)(manuf->data.size + 4U);
+      if ( (len + size > max) || (size > UINT8_MAX) ) {
+         return NRF_ERROR_DATA_SIZE;
+      }
+      p_encoded_data[len++] = (uint8_t)(size - 1U);
+      p_encoded_data[len++] = ADV_SHIM_AD_TYPE_MANUF_DATA;
+      p_encoded_data[len++] = (uint8_t)manuf->company_identifier;
+      p_encoded_data[len++] = (uint8_t)(manuf->company_identifier >> 8U);
+      if ( manuf->data.size ) {
+         memcpy(&p_encoded_data[len], manuf->data.p_data, manuf->data.size);
+      }
+      len = (uint16_t)(len + manuf->data.size);
+   }
+
+   *p_len = len;
+
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+ble_advertising_init(ble_advertising_t * p_advertising,
+                     ble_advertising_init_t const * p_init)
+{
+   ret_code_t rc;
+
+   memset(p_advertising, 0, sizeof(*p_advertising));
+   p_advertising->adv_modes_config = p_init->config;
+   p_advertising->evt_handler = p_init->evt_handler;
+   p_advertising->error_handler = p_init->error_handler;
+   p_advertising->adv_handle = BLE_GAP_ADV_SET_HANDLE_NOT_SET;
+   p_advertising->adv_mode_current = BLE_ADV_MODE_IDLE;
+
+   p_advertising->adv_data.adv_data.p_data = p_advertising->enc_advdata;
+   p_advertising->adv_data.adv_data.len = BLE_GAP_ADV_SET_DATA_SIZE_MAX;
+   rc = ble_advdata_encode(&p_init->advdata,
+                           p_advertising->adv_data.adv_data.p_data,
+                           &p_advertising->adv_data.adv_data.len);
+   if ( rc ) {
+      return rc;
+   }
+
+   p_advertising->adv_data.scan_rsp_data.p_data =
+      p_advertising->enc_scan_rsp_data;
+   p_advertising->adv_data.scan_rsp_data.len = BLE_GAP_ADV_SET_DATA_SIZE_MAX;
+   rc = ble_advdata_encode(&p_init->srdata,
+                           p_advertising->adv_data.scan_rsp_data.p_data,
+                           &p_advertising->adv_data.scan_rsp_data.len);
+   if ( rc ) {
+      return rc;
+   }
+
+   p_advertising->adv_params.interval =
+      p_init->config.ble_adv_fast_interval;
+   p_advertising->adv_params.duration =
+      (uint16_t)p_init->config.ble_adv_fast_timeout;
+   rc = sd_ble_gap_adv_set_configure(&p_advertising->adv_handle,
+                                     &p_advertising->adv_data,
+                                     &p_advertising->adv_params);
+   if ( rc ) {
+      return rc;
+   }
+
+   p_advertising->initialized = true;
+
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+ble_advertising_start(ble_advertising_t * p_advertising,
+                      ble_adv_mode_t advertising_mode)
+{
+   const ble_adv_modes_config_t * config = &p_advertising->adv_modes_config;
+   ble_adv_evt_t evt;
+
+   if ( ! p_advertising->initialized ) {
+      return NRF_ERROR_INVALID_STATE;
+   }
+
+   switch ( advertising_mode ) {
+      case BLE_ADV_MODE_FAST:
+         p_advertising->adv_params.interval = config->ble_adv_fast_interval;
+         p_advertising->adv_params.duration =
+            (uint16_t)config->ble_adv_fast_timeout;
+         evt = BLE_ADV_EVT_FAST;
+         break;
+      case BLE_ADV_MODE_SLOW:
+         p_advertising->adv_params.interval = config->ble_adv_slow_interval;
+         p_advertising->adv_params.duration =
+            (uint16_t)config->ble_adv_slow_timeout;
+         evt = BLE_ADV_EVT_SLOW;
+         break;
+      case BLE_ADV_MODE_IDLE:
+         evt = BLE_ADV_EVT_IDLE;
+         break;
+      default:
+         return NRF_ERROR_NOT_SUPPORTED;
+   }
+
+   p_advertising->adv_mode_current = advertising_mode;
+   p_advertising->adv_evt = evt;
+   if ( p_advertising->evt_handler ) {
+      p_advertising->evt_handler(evt);
+   }
+
+   return NRF_SUCCESS;
+}
+
+void
+ble_advertising_conn_cfg_tag_set(ble_advertising_t * p_advertising,
+                                 uint8_t ble_cfg_tag)
+{
+   p_advertising->conn_cfg_tag = ble_cfg_tag;
+}
+
+//-----------------------------------------------------------------------------
+// Connection parameters
+//-----------------------------------------------------------------------------
+
+ret_code_t
+ble_conn_params_init(ble_conn_params_init_t const * p_init)
+{
+   _adv_shim_conn_params_init = *p_init;
+   memset(_adv_shim_conn_params, 0, sizeof(_adv_shim_conn_params));
+   for (unsigned int ix=0; ix<ADV_SHIM_CONN_PARAMS_MAX; ix++) {
+      _adv_shim_conn_params[ix].cp_conn_handle = BLE_CONN_HANDLE_INVALID;
+   }
+
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+ble_conn_params_change_conn_params(uint16_t conn_handle,
+                                   ble_gap_conn_params_t * p_new_params)
+{
+   struct adv_shim_conn_params * free_cp = NULL;
+   struct adv_shim_conn_params * cp = NULL;
+
+   if ( ! p_new_params ) {
+      return NRF_ERROR_NULL;
+   }
+
+   for (unsigned int ix=0; ix<ADV_SHIM_CONN_PARAMS_MAX; ix++) {
+      struct adv_shim_conn_params * it = &_adv_shim_conn_params[ix];
+      if ( it->cp_conn_handle == conn_handle ) {
+         cp = it;
+         break;
+      }
+      if ( (BLE_CONN_HANDLE_INVALID == it->cp_conn_handle) && ! free_cp ) {
+         free_cp = it;
+      }
+   }
+   if ( ! cp ) {
+      if ( ! free_cp ) {
+         return NRF_ERROR_NO_MEM;
+      }
+      cp = free_cp;
+      cp->cp_conn_handle = conn_handle;
+   }
+   if ( cp->cp_pending ) {
+      return NRF_ERROR_BUSY;
+   }
+
+   ret_code_t rc = sd_ble_gap_conn_param_update(conn_handle, p_new_params);
+   if ( rc ) {
+      return rc;
+   }
+
+   // the outcome is reported from the next poll, as the peer would answer
+   // in a later connection event
+   cp->cp_pending = true;
+   adv_shim_counters.ss_conn_updates++;
+
+   return NRF_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Device information service
+//-----------------------------------------------------------------------------
+
+ret_code_t
+ble_dis_init(ble_dis_init_t const * p_dis_init)
+{
+   const struct {
+      const ble_srv_utf8_str_t * str;
+      uint16_t uuid;
+   } strings[] = {
+      { &p_dis_init->manufact_name_str, 0x2A29U },
+      { &p_dis_init->model_num_str, 0x2A24U },
+      { &p_dis_init->serial_num_str, 0x2A25U },
+      { &p_dis_init->hw_rev_str, 0x2A27U },
+      { &p_dis_init->fw_rev_str, 0x2A26U },
+      { &p_dis_init->sw_rev_str, 0x2A28U },
+   };
+   const ble_uuid_t service_uuid = {
+      .uuid = BLE_UUID_DEVICE_INFORMATION_SERVICE,
+      .type = BLE_UUID_TYPE_BLE,
+   };
+   uint16_t service_handle;
+   ret_code_t rc;
+
+   rc = sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &service_uuid,
+                                 &service_handle);
+   if ( rc ) {
+      return rc;
+   }
+
+   for (unsigned int ix=0; ix<ARRAY_SIZE(strings); ix++) {
+      const ble_srv_utf8_str_t * str = strings[ix].str;
+      if ( ! str->length ) {
+         continue;
+      }
+      const ble_uuid_t char_uuid = {
+         .uuid = strings[ix].uuid,
+         .type = BLE_UUID_TYPE_BLE,
+      };
+      const ble_gatts_char_md_t char_md = {
+         .char_props = { .read = 1 },
+      };
+      const ble_gatts_attr_t attr = {
+         .p_uuid = &char_uuid,
+         .init_len = str->length,
+         .max_len = str->length,
+         .p_value = str->p_str,
+      };
+      ble_gatts_char_handles_t handles;
+      rc = sd_ble_gatts_characteristic_add(service_handle, &char_md, &attr,
+                                           &handles);
+      if ( rc ) {
+         return rc;
+      }
+   }
+
+   return NRF_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// GATT negotiation
+//-----------------------------------------------------------------------------
+
+ret_code_t
+nrf_ble_gatt_init(nrf_ble_gatt_t * p_gatt,
+                  nrf_ble_gatt_evt_handler_t evt_handler)
+{
+   memset(p_gatt, 0, sizeof(*p_gatt));
+   p_gatt->att_mtu_desired_periph = BLE_GATT_ATT_MTU_DEFAULT;
+   p_gatt->evt_handler = evt_handler;
+
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+nrf_ble_gatt_att_mtu_periph_set(nrf_ble_gatt_t * p_gatt, uint16_t desired_mtu)
+{
+   if ( desired_mtu < BLE_GATT_ATT_MTU_DEFAULT ) {
+      return NRF_ERROR_INVALID_PARAM;
+   }
+   p_gatt->att_mtu_desired_periph = desired_mtu;
+
+   return NRF_SUCCESS;
+}
+
+ret_code_t
+nrf_ble_gatt_data_length_set(nrf_ble_gatt_t * p_gatt, uint16_t conn_handle,
+                             uint8_t data_length)
+{
+   (void)conn_handle;
+   p_gatt->data_length = data_length;
+
+   return NRF_SUCCESS;
+}
+
+uint16_t
+nrf_ble_gatt_eff_mtu_get(nrf_ble_gatt_t const * p_gatt, uint16_t conn_handle)
+{
+   if ( conn_handle >= NRF_SDH_BLE_TOTAL_LINK_COUNT ) {
+      return 0U;
+   }
+
+   return p_gatt->links[conn_handle].att_mtu_effective;
+}
+
+void
+nrf_ble_gatt_on_ble_evt(ble_evt_t const * p_ble_evt, void * p_context)
+{
+   nrf_ble_gatt_t * gatt = p_context;
+   nrf_ble_gatt_evt_t evt;
+   uint16_t conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+
+   if ( conn_handle >= NRF_SDH_BLE_TOTAL_LINK_COUNT ) {
+      return;
+   }
+
+   switch ( p_ble_evt->header.evt_id ) {
+      case BLE_GAP_EVT_CONNECTED:
+         gatt->links[conn_handle].att_mtu_effective = BLE_GATT_ATT_MTU_DEFAULT;
+         return;
+      case BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST: {
+         uint16_t client_mtu = p_ble_evt->evt.gatts_evt.params.
+                                  exchange_mtu_request.client_rx_mtu;
+         evt.evt_id = NRF_BLE_GATT_EVT_ATT_MTU_UPDATED;
+         evt.conn_handle = p_ble_evt->evt.gatts_evt.conn_handle;
+         evt.params.att_mtu_effective =
+            MAX(MIN(client_mtu, gatt->att_mtu_desired_periph),
+                BLE_GATT_ATT_MTU_DEFAULT);
+         gatt->links[conn_handle].att_mtu_effective =
+            evt.params.att_mtu_effective;
+         break;
+      }
+      case BLE_GAP_EVT_DATA_LENGTH_UPDATE:
+         evt.evt_id = NRF_BLE_GATT_EVT_DATA_LENGTH_UPDATED;
+         evt.conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+         evt.params.data_length = (uint8_t)p_ble_evt->evt.gap_evt.params.
+                                    data_length_update.effective_params.
+                                    max_tx_octets;
+         break;
+      default:
+         return;
+   }
+
+   if ( gatt->evt_handler ) {
+      gatt->evt_handler(gatt, &evt);
+   }
+}
@@ -0,0 +1,71 @@
+/**
+ * Host simulation control API
+ *
+ * The simulation never runs on its own: time, SoftDevice events and UARTE
+ * transfer completions are all driven from the host program. Peripheral
+ * interrupts are emulated by running their handlers synchronously, with the
+ * interrupt program status and priority the target would use.
+ *
+ * @file adv_shim.h
+ */
+
+#ifndef _ADV_SHIM_H_
+#define _ADV_SHIM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ble.h"
+
+//-----------------------------------------------------------------------------
+// Type definitions
+//-----------------------------------------------------------------------------
+
+/** Simulation counters, see adv_shim_get_stats() */
+struct adv_shim_stats {
+   uint32_t ss_sd_calls;      /**< SoftDevice calls, sd_*() */
+   uint32_t ss_hvx;           /**< Accepted notifications */
+   uint32_t ss_hvx_busy;      /**< Notifications rejected, TX queue full */
+   uint32_t ss_auth_replies;  /**< Read/write authorization replies */
+   uint32_t ss_conn_updates;  /**< Connection parameter change requests */
+   uint32_t ss_uarte_tx;      /**< UARTE transfers */
+   uint32_t ss_uarte_bytes;   /**< UARTE transferred bytes */
+   uint32_t ss_sched_puts;    /**< Events queued into the scheduler */
+   uint32_t ss_sched_full;    /**< Events rejected, scheduler queue full */
+   uint32_t ss_timer_fires;   /**< Expired application timers */
+   uint32_t ss_crit_regions;  /**< Outermost critical regions */
+};
+
+/**
+ * Authorization reply hook, invoked from sd_ble_gatts_rw_authorize_reply()
+ *
+ * @param[in] conn_handle the connection the reply is sent to
+ * @param[in] reply the reply parameters
+ */
+typedef void (*adv_shim_reply_hook_t)(
+   uint16_t conn_handle,
+   const ble_gatts_rw_authorize_reply_params_t * reply);
+
+//-----------------------------------------------------------------------------
+// Public API
+//-----------------------------------------------------------------------------
+
+void adv_shim_get_stats(struct adv_shim_stats * stats, bool reset);
+void adv_shim_advance(uint32_t ticks);
+void adv_shim_poll(void);
+void adv_shim_ble_evt(const ble_evt_t * ble_evt);
+void adv_shim_ble_hvn_complete(uint16_t conn_handle);
+void adv_shim_set_reply_hook(adv_shim_reply_hook_t hook);
+void adv_shim_conn_params_refuse(uint16_t conn_handle, bool refuse);
+bool adv_shim_gatts_find(uint16_t uuid, ble_uuid_t * ble_uuid,
+                         ble_gatts_char_handles_t * handles);
+bool adv_shim_uarte_complete(void);
+size_t adv_shim_uarte_pending(void);
+void adv_shim_uarte_echo(bool enable);
+unsigned int adv_shim_critical_depth(void);
+
+// emulated interrupt context, for the shim modules
+void adv_shim_irq_enter(uint32_t ipsr, uint8_t priority, uint32_t * saved);
+void adv_shim_irq_exit(uint32_t saved);
+
+#endif // _ADV_SHIM_H_
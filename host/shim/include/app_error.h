@@ -0,0 +1,51 @@
+/**
+ * Host simulation shim: SDK error handling
+ *
+ * Errors are fatal, as on target: the shim reports the error and aborts the
+ * simulation.
+ *
+ * @file app_error.h
+ */
+
+#ifndef _SHIM_APP_ERROR_H_
+#define _SHIM_APP_ERROR_H_
+
+#include <stdint.h>
+#include "sdk_errors.h"
+
+#define NRF_FAULT_ID_SD_RANGE_START  0x00000000U
+#define NRF_FAULT_ID_APP_RANGE_START 0x00001000U
+#define NRF_FAULT_ID_SD_ASSERT       (NRF_FAULT_ID_SD_RANGE_START + 1U)
+#define NRF_FAULT_ID_APP_MEMACC      (NRF_FAULT_ID_APP_RANGE_START + 1U)
+#define NRF_FAULT_ID_SDK_RANGE_START 0x00004000U
+#define NRF_FAULT_ID_SDK_ERROR       (NRF_FAULT_ID_SDK_RANGE_START + 1U)
+#define NRF_FAULT_ID_SDK_ASSERT      (NRF_FAULT_ID_SDK_RANGE_START + 2U)
+
+/** Information of a NRF_FAULT_ID_SDK_ERROR fault */
+typedef struct {
+   uint32_t line_num;
+   uint8_t const * p_file_name;
+   uint32_t err_code;
+} error_info_t;
+
+/** Information of a NRF_FAULT_ID_SDK_ASSERT fault */
+typedef struct {
+   uint16_t line_num;
+   uint8_t const * p_file_name;
+} assert_info_t;
+
+void app_error_handler(uint32_t error_code, uint32_t line_num,
+                       const uint8_t * p_file_name);
+
+#define APP_ERROR_HANDLER(_err_) \
+   app_error_handler((_err_), __LINE__, (const uint8_t *)__FILE__)
+
+#define APP_ERROR_CHECK(_err_) \
+   do { \
+      const uint32_t __LOCAL_ERR_CODE = (_err_); \
+      if ( __LOCAL_ERR_CODE != NRF_SUCCESS ) { \
+         APP_ERROR_HANDLER(__LOCAL_ERR_CODE); \
+      } \
+   } while (0)
+
+#endif // _SHIM_APP_ERROR_H_
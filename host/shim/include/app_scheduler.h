@@ -0,0 +1,42 @@
+/**
+ * Host simulation shim: application scheduler
+ *
+ * Events are queued in a bounded FIFO, as with the SDK scheduler, and run
+ * by app_sched_execute().
+ *
+ * @file app_scheduler.h
+ */
+
+#ifndef _SHIM_APP_SCHEDULER_H_
+#define _SHIM_APP_SCHEDULER_H_
+
+#include <stdint.h>
+#include "app_error.h"
+#include "sdk_errors.h"
+
+/** Largest event data size the shim scheduler accepts */
+#define APP_SCHED_SHIM_EVENT_SIZE_MAX 64U
+
+typedef void (*app_sched_event_handler_t)(void * p_event_data,
+                                          uint16_t event_size);
+
+#define APP_SCHED_BUF_SIZE(_event_size_, _queue_size_) \
+   (((_event_size_) + 8U) * ((_queue_size_) + 1U))
+
+ret_code_t app_sched_init(uint16_t max_event_size, uint16_t queue_size,
+                          void * p_evt_buffer);
+
+#define APP_SCHED_INIT(_event_size_, _queue_size_) \
+   do { \
+      ret_code_t _rc_ = app_sched_init((_event_size_), (_queue_size_), \
+                                       NULL); \
+      APP_ERROR_CHECK(_rc_); \
+   } while (0)
+
+ret_code_t app_sched_event_put(void const * p_event_data, uint16_t event_size,
+                               app_sched_event_handler_t handler);
+void app_sched_execute(void);
+uint16_t app_sched_queue_space_get(void);
+uint16_t app_sched_queue_utilization_get(void);
+
+#endif // _SHIM_APP_SCHEDULER_H_
@@ -0,0 +1,66 @@
+/**
+ * Host simulation shim: application timers
+ *
+ * Timers run from the simulated RTC1 counter, which only moves forward with
+ * adv_shim_advance(). Expired timers are handed over to the application
+ * scheduler, as with APP_TIMER_CONFIG_USE_SCHEDULER. Starting a running
+ * timer re-arms it.
+ *
+ * @file app_timer.h
+ */
+
+#ifndef _SHIM_APP_TIMER_H_
+#define _SHIM_APP_TIMER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdk_errors.h"
+
+#define APP_TIMER_CLOCK_FREQ           32768U
+#define APP_TIMER_CONFIG_RTC_FREQUENCY 0U
+#define APP_TIMER_MIN_TIMEOUT_TICKS    5U
+#define APP_TIMER_MAX_CNT_VAL          0x00FFFFFFU
+
+/** Convert milliseconds into timer ticks */
+#define APP_TIMER_TICKS(_ms_) \
+   ((uint32_t)((((uint64_t)(_ms_)) * APP_TIMER_CLOCK_FREQ) / 1000U))
+
+typedef void (*app_timer_timeout_handler_t)(void * p_context);
+
+/** Size of the timeout events handed over to the scheduler */
+#define APP_TIMER_SCHED_EVENT_DATA_SIZE \
+   (sizeof(app_timer_timeout_handler_t) + sizeof(void *))
+
+typedef enum {
+   APP_TIMER_MODE_SINGLE_SHOT,
+   APP_TIMER_MODE_REPEATED,
+} app_timer_mode_t;
+
+/** Timer instance */
+typedef struct app_timer_s {
+   struct app_timer_s * next;           /**< Next active timer */
+   app_timer_timeout_handler_t handler; /**< Timeout handler */
+   app_timer_mode_t mode;               /**< Single shot or repeated */
+   void * p_context;                    /**< Handler context */
+   uint64_t expire;                     /**< Absolute expiry, in ticks */
+   uint32_t period;                     /**< Period of repeated timers */
+   bool active;                         /**< Timer is running */
+} app_timer_t;
+
+typedef app_timer_t * app_timer_id_t;
+
+#define APP_TIMER_DEF(_name_) \
+   static app_timer_t _name_##_data; \
+   static const app_timer_id_t _name_ = &_name_##_data
+
+ret_code_t app_timer_init(void);
+ret_code_t app_timer_create(app_timer_id_t const * p_timer_id,
+                            app_timer_mode_t mode,
+                            app_timer_timeout_handler_t timeout_handler);
+ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks,
+                           void * p_context);
+ret_code_t app_timer_stop(app_timer_id_t timer_id);
+uint32_t app_timer_cnt_get(void);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from);
+
+#endif // _SHIM_APP_TIMER_H_
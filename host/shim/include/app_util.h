@@ -0,0 +1,19 @@
+/**
+ * Host simulation shim: SDK utilities
+ *
+ * @file app_util.h
+ */
+
+#ifndef _SHIM_APP_UTIL_H_
+#define _SHIM_APP_UTIL_H_
+
+#include <stdint.h>
+
+#define UNIT_0_625_MS 625   /**< 0.625 ms unit, in microseconds */
+#define UNIT_1_25_MS  1250  /**< 1.25 ms unit, in microseconds */
+#define UNIT_10_MS    10000 /**< 10 ms unit, in microseconds */
+
+/** Convert a duration in milliseconds into a count of units */
+#define MSEC_TO_UNITS(_time_, _unit_) (((_time_) * 1000) / (_unit_))
+
+#endif // _SHIM_APP_UTIL_H_
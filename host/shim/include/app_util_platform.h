@@ -0,0 +1,38 @@
+/**
+ * Host simulation shim: platform utilities
+ *
+ * Critical regions only track their nesting depth, as the simulation runs in
+ * a single thread; see adv_shim_critical_depth().
+ *
+ * @file app_util_platform.h
+ */
+
+#ifndef _SHIM_APP_UTIL_PLATFORM_H_
+#define _SHIM_APP_UTIL_PLATFORM_H_
+
+#include <stdint.h>
+#include "nrf.h"
+#include "app_util.h"
+
+#define APP_IRQ_PRIORITY_HIGHEST 0
+#define APP_IRQ_PRIORITY_HIGH    2
+#define APP_IRQ_PRIORITY_MID     4
+#define APP_IRQ_PRIORITY_LOW     6
+#define APP_IRQ_PRIORITY_LOWEST  7
+#define APP_IRQ_PRIORITY_THREAD  15
+
+void app_util_critical_region_enter(uint8_t * nested);
+void app_util_critical_region_exit(uint8_t nested);
+
+#define CRITICAL_REGION_ENTER() \
+   { \
+      uint8_t __CR_NESTED = 0; \
+      app_util_critical_region_enter(&__CR_NESTED);
+
+#define CRITICAL_REGION_EXIT() \
+      app_util_critical_region_exit(__CR_NESTED); \
+   }
+
+uint8_t current_int_priority_get(void);
+
+#endif // _SHIM_APP_UTIL_PLATFORM_H_
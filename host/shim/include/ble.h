@@ -0,0 +1,508 @@
+/**
+ * Host simulation shim: SoftDevice BLE API (common, GAP, GATT, GATTS)
+ *
+ * Types follow the S132 v6 layout where the application relies on it: all
+ * event families start with the connection handle. SoftDevice calls are
+ * served by the simulated SoftDevice, see adv_shim.h.
+ *
+ * @file ble.h
+ */
+
+#ifndef _SHIM_BLE_H_
+#define _SHIM_BLE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdk_errors.h"
+
+//-----------------------------------------------------------------------------
+// Constants
+//-----------------------------------------------------------------------------
+
+#define BLE_CONN_HANDLE_INVALID   0xFFFFU
+#define BLE_GATT_HANDLE_INVALID   0x0000U
+#define BLE_GATT_HANDLE_START     0x0001U
+#define BLE_CONN_CFG_TAG_DEFAULT  0U
+
+#define BLE_UUID_TYPE_UNKNOWN      0x00U
+#define BLE_UUID_TYPE_BLE          0x01U
+#define BLE_UUID_TYPE_VENDOR_BEGIN 0x02U
+#define BLE_UUID_VS_COUNT_DEFAULT  10U
+
+#define BLE_UUID_DEVICE_INFORMATION_SERVICE    0x180AU
+#define BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG 0x2902U
+#define BLE_UUID_FIRMWARE_REVISION_STRING_CHAR 0x2A26U
+
+#define BLE_GATT_ATT_MTU_DEFAULT  23U
+#define BLE_GATT_HVX_NOTIFICATION 0x01U
+#define BLE_GATT_HVX_INDICATION   0x02U
+
+#define BLE_GATT_STATUS_SUCCESS                       0x0000U
+#define BLE_GATT_STATUS_ATTERR_READ_NOT_PERMITTED     0x0102U
+#define BLE_GATT_STATUS_ATTERR_WRITE_NOT_PERMITTED    0x0103U
+#define BLE_GATT_STATUS_ATTERR_INVALID_OFFSET         0x0107U
+#define BLE_GATT_STATUS_ATTERR_PREPARE_QUEUE_FULL     0x0109U
+#define BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_FOUND    0x010AU
+#define BLE_GATT_STATUS_ATTERR_INVALID_ATT_VAL_LENGTH 0x010DU
+#define BLE_GATT_STATUS_ATTERR_UNLIKELY_ERROR         0x010EU
+#define BLE_GATT_STATUS_ATTERR_INSUF_RESOURCES        0x0111U
+#define BLE_GATT_STATUS_ATTERR_APP_BEGIN              0x0180U
+
+#define BLE_GAP_ROLE_PERIPH        0x01U
+#define BLE_GAP_PHY_AUTO           0x00U
+#define BLE_GAP_PHY_1MBPS          0x01U
+#define BLE_GAP_PHY_2MBPS          0x02U
+#define BLE_GAP_PHY_CODED          0x04U
+#define BLE_GAP_DATA_LENGTH_AUTO   0U
+#define BLE_GAP_EVENT_LENGTH_DEFAULT 3U
+#define BLE_GAP_DEVNAME_DEFAULT_LEN  31U
+#define BLE_GAP_TX_POWER_ROLE_ADV  1U
+#define BLE_GAP_TX_POWER_ROLE_CONN 2U
+#define BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE 0x06U
+#define BLE_GAP_ADV_SET_DATA_SIZE_MAX                    31U
+#define BLE_GAP_ADV_SET_DATA_SIZE_EXTENDED_MAX_SUPPORTED 255U
+#define BLE_GAP_ADV_SET_HANDLE_NOT_SET                   0xFFU
+#define BLE_APPEARANCE_UNKNOWN     0U
+
+#define BLE_GATTS_SRVC_TYPE_PRIMARY 0x01U
+#define BLE_GATTS_VLOC_STACK        0x01U
+#define BLE_GATTS_VLOC_USER         0x02U
+#define BLE_GATTS_AUTHORIZE_TYPE_READ  0x01U
+#define BLE_GATTS_AUTHORIZE_TYPE_WRITE 0x02U
+#define BLE_GATTS_OP_WRITE_REQ             0x01U
+#define BLE_GATTS_OP_WRITE_CMD             0x02U
+#define BLE_GATTS_OP_SIGN_WRITE_CMD        0x03U
+#define BLE_GATTS_OP_PREP_WRITE_REQ        0x04U
+#define BLE_GATTS_OP_EXEC_WRITE_REQ_CANCEL 0x05U
+#define BLE_GATTS_OP_EXEC_WRITE_REQ_NOW    0x06U
+#define BLE_GATTS_ATTR_TAB_SIZE_MIN        248U
+#define BLE_GATTS_ATTR_TAB_SIZE_DEFAULT    1408U
+#define BLE_GATTS_HVN_TX_QUEUE_SIZE_DEFAULT 1U
+
+#define BLE_USER_MEM_TYPE_GATTS_QUEUED_WRITES 0x01U
+
+/** BLE event identifiers */
+enum {
+   BLE_EVT_USER_MEM_REQUEST = 0x01,
+   BLE_EVT_USER_MEM_RELEASE,
+   BLE_GAP_EVT_CONNECTED = 0x10,
+   BLE_GAP_EVT_DISCONNECTED,
+   BLE_GAP_EVT_CONN_PARAM_UPDATE,
+   BLE_GAP_EVT_SEC_PARAMS_REQUEST,
+   BLE_GAP_EVT_TIMEOUT = 0x1B,
+   BLE_GAP_EVT_CONN_PARAM_UPDATE_REQUEST = 0x1F,
+   BLE_GAP_EVT_PHY_UPDATE_REQUEST = 0x21,
+   BLE_GAP_EVT_PHY_UPDATE,
+   BLE_GAP_EVT_DATA_LENGTH_UPDATE_REQUEST,
+   BLE_GAP_EVT_DATA_LENGTH_UPDATE,
+   BLE_GAP_EVT_ADV_SET_TERMINATED = 0x26,
+   BLE_GATTC_EVT_TIMEOUT = 0x3C,
+   BLE_GATTS_EVT_WRITE = 0x50,
+   BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST,
+   BLE_GATTS_EVT_SYS_ATTR_MISSING,
+   BLE_GATTS_EVT_HVC,
+   BLE_GATTS_EVT_SC_CONFIRM,
+   BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST,
+   BLE_GATTS_EVT_TIMEOUT,
+   BLE_GATTS_EVT_HVN_TX_COMPLETE,
+};
+
+/** BLE configuration identifiers */
+enum {
+   BLE_CONN_CFG_GAP = 0x20,
+   BLE_CONN_CFG_GATTC,
+   BLE_CONN_CFG_GATTS,
+   BLE_CONN_CFG_GATT,
+   BLE_CONN_CFG_L2CAP,
+   BLE_COMMON_CFG_VS_UUID = 0x01,
+   BLE_GAP_CFG_ROLE_COUNT = 0x40,
+   BLE_GAP_CFG_DEVICE_NAME,
+   BLE_GATTS_CFG_SERVICE_CHANGED = 0xA0,
+   BLE_GATTS_CFG_ATTR_TAB_SIZE,
+};
+
+//-----------------------------------------------------------------------------
+// Common types
+//-----------------------------------------------------------------------------
+
+typedef struct {
+   uint16_t uuid;
+   uint8_t type;
+} ble_uuid_t;
+
+typedef struct {
+   uint8_t uuid128[16];
+} ble_uuid128_t;
+
+typedef struct {
+   uint8_t * p_data;
+   uint16_t len;
+} ble_data_t;
+
+typedef struct {
+   uint8_t * p_mem;
+   uint16_t len;
+} ble_user_mem_block_t;
+
+typedef struct {
+   uint8_t version_number;
+   uint16_t company_id;
+   uint16_t subversion_number;
+} ble_version_t;
+
+//-----------------------------------------------------------------------------
+// GAP types
+//-----------------------------------------------------------------------------
+
+typedef struct {
+   uint8_t addr_id_peer : 1;
+   uint8_t addr_type : 7;
+   uint8_t addr[6];
+} ble_gap_addr_t;
+
+typedef struct {
+   uint16_t min_conn_interval;
+   uint16_t max_conn_interval;
+   uint16_t slave_latency;
+   uint16_t conn_sup_timeout;
+} ble_gap_conn_params_t;
+
+typedef struct {
+   uint8_t sm : 4;
+   uint8_t lv : 4;
+} ble_gap_conn_sec_mode_t;
+
+#define BLE_GAP_CONN_SEC_MODE_SET_OPEN(_ptr_) \
+   do { (_ptr_)->sm = 1; (_ptr_)->lv = 1; } while (0)
+
+typedef struct {
+   uint8_t tx_phys;
+   uint8_t rx_phys;
+} ble_gap_phys_t;
+
+typedef struct {
+   uint16_t max_tx_octets;
+   uint16_t max_rx_octets;
+   uint16_t max_tx_time_us;
+   uint16_t max_rx_time_us;
+} ble_gap_data_length_params_t;
+
+typedef struct {
+   ble_data_t adv_data;
+   ble_data_t scan_rsp_data;
+} ble_gap_adv_data_t;
+
+typedef struct {
+   uint8_t type;
+} ble_gap_adv_properties_t;
+
+typedef struct {
+   ble_gap_adv_properties_t properties;
+   uint32_t interval;
+   uint16_t duration;
+   uint8_t primary_phy;
+   uint8_t secondary_phy;
+} ble_gap_adv_params_t;
+
+typedef struct {
+   ble_gap_addr_t peer_addr;
+   uint8_t role;
+   ble_gap_conn_params_t conn_params;
+   uint8_t adv_handle;
+} ble_gap_evt_connected_t;
+
+typedef struct {
+   uint8_t reason;
+} ble_gap_evt_disconnected_t;
+
+typedef struct {
+   ble_gap_conn_params_t conn_params;
+} ble_gap_evt_conn_param_update_t;
+
+typedef struct {
+   ble_gap_phys_t peer_preferred_phys;
+} ble_gap_evt_phy_update_request_t;
+
+typedef struct {
+   uint8_t status;
+   uint8_t tx_phy;
+   uint8_t rx_phy;
+} ble_gap_evt_phy_update_t;
+
+typedef struct {
+   ble_gap_data_length_params_t effective_params;
+} ble_gap_evt_data_length_update_t;
+
+typedef struct {
+   uint16_t conn_handle;
+   union {
+      ble_gap_evt_connected_t connected;
+      ble_gap_evt_disconnected_t disconnected;
+      ble_gap_evt_conn_param_update_t conn_param_update;
+      ble_gap_evt_conn_param_update_t conn_param_update_request;
+      ble_gap_evt_phy_update_request_t phy_update_request;
+      ble_gap_evt_phy_update_t phy_update;
+      ble_gap_evt_data_length_update_t data_length_update;
+   } params;
+} ble_gap_evt_t;
+
+//-----------------------------------------------------------------------------
+// GATT client and server types
+//-----------------------------------------------------------------------------
+
+typedef struct {
+   uint16_t conn_handle;
+   uint16_t gatt_status;
+} ble_gattc_evt_t;
+
+typedef struct {
+   uint8_t broadcast : 1;
+   uint8_t read : 1;
+   uint8_t write_wo_resp : 1;
+   uint8_t write : 1;
+   uint8_t notify : 1;
+   uint8_t indicate : 1;
+   uint8_t auth_signed_wr : 1;
+} ble_gatt_char_props_t;
+
+typedef struct {
+   ble_gap_conn_sec_mode_t read_perm;
+   ble_gap_conn_sec_mode_t write_perm;
+   uint8_t vlen : 1;
+   uint8_t vloc : 2;
+   uint8_t rd_auth : 1;
+   uint8_t wr_auth : 1;
+} ble_gatts_attr_md_t;
+
+typedef struct {
+   ble_uuid_t const * p_uuid;
+   ble_gatts_attr_md_t const * p_attr_md;
+   uint16_t init_len;
+   uint16_t init_offs;
+   uint16_t max_len;
+   uint8_t * p_value;
+} ble_gatts_attr_t;
+
+typedef struct {
+   ble_gatt_char_props_t char_props;
+   uint8_t const * p_char_user_desc;
+   uint16_t char_user_desc_max_size;
+   uint16_t char_user_desc_size;
+   void const * p_char_pf;
+   ble_gatts_attr_md_t const * p_user_desc_md;
+   ble_gatts_attr_md_t const * p_cccd_md;
+   ble_gatts_attr_md_t const * p_sccd_md;
+} ble_gatts_char_md_t;
+
+typedef struct {
+   uint16_t value_handle;
+   uint16_t user_desc_handle;
+   uint16_t cccd_handle;
+   uint16_t sccd_handle;
+} ble_gatts_char_handles_t;
+
+typedef struct {
+   uint16_t gatt_status;
+   uint8_t update : 1;
+   uint16_t offset;
+   uint16_t len;
+   uint8_t const * p_data;
+} ble_gatts_authorize_params_t;
+
+typedef struct {
+   uint8_t type;
+   union {
+      ble_gatts_authorize_params_t read;
+      ble_gatts_authorize_params_t write;
+   } params;
+} ble_gatts_rw_authorize_reply_params_t;
+
+typedef struct {
+   uint16_t handle;
+   uint8_t type;
+   uint16_t offset;
+   uint16_t * p_len;
+   uint8_t const * p_data;
+} ble_gatts_hvx_params_t;
+
+typedef struct {
+   uint16_t len;
+   uint16_t offset;
+   uint8_t * p_value;
+} ble_gatts_value_t;
+
+typedef struct {
+   uint16_t handle;
+   ble_uuid_t uuid;
+   uint8_t op;
+   uint8_t auth_required;
+   uint16_t offset;
+   uint16_t len;
+   uint8_t data[1]; /**< Variable length data */
+} ble_gatts_evt_write_t;
+
+typedef struct {
+   uint16_t handle;
+   ble_uuid_t uuid;
+   uint16_t offset;
+} ble_gatts_evt_read_t;
+
+typedef struct {
+   uint8_t type;
+   union {
+      ble_gatts_evt_read_t read;
+      ble_gatts_evt_write_t write;
+   } request;
+} ble_gatts_evt_rw_authorize_request_t;
+
+typedef struct {
+   uint16_t client_rx_mtu;
+} ble_gatts_evt_exchange_mtu_request_t;
+
+typedef struct {
+   uint8_t count;
+} ble_gatts_evt_hvn_tx_complete_t;
+
+typedef struct {
+   uint16_t conn_handle;
+   union {
+      ble_gatts_evt_write_t write;
+      ble_gatts_evt_rw_authorize_request_t authorize_request;
+      ble_gatts_evt_exchange_mtu_request_t exchange_mtu_request;
+      ble_gatts_evt_hvn_tx_complete_t hvn_tx_complete;
+   } params;
+} ble_gatts_evt_t;
+
+//-----------------------------------------------------------------------------
+// Events
+//-----------------------------------------------------------------------------
+
+typedef struct {
+   uint8_t type;
+} ble_evt_user_mem_request_t;
+
+typedef struct {
+   uint8_t type;
+   ble_user_mem_block_t mem_block;
+} ble_evt_user_mem_release_t;
+
+typedef struct {
+   uint16_t conn_handle;
+   union {
+      ble_evt_user_mem_request_t user_mem_request;
+      ble_evt_user_mem_release_t user_mem_release;
+   } params;
+} ble_common_evt_t;
+
+typedef struct {
+   uint16_t evt_id;
+   uint16_t evt_len;
+} ble_evt_hdr_t;
+
+/** BLE event */
+typedef struct {
+   ble_evt_hdr_t header;
+   union {
+      ble_common_evt_t common_evt;
+      ble_gap_evt_t gap_evt;
+      ble_gattc_evt_t gattc_evt;
+      ble_gatts_evt_t gatts_evt;
+   } evt;
+} __attribute__((aligned(4))) ble_evt_t;
+
+/** Largest event size, for a given ATT MTU */
+#define BLE_EVT_LEN_MAX(_att_mtu_) \
+   (sizeof(ble_evt_t) + (_att_mtu_))
+
+//-----------------------------------------------------------------------------
+// Configuration
+//-----------------------------------------------------------------------------
+
+typedef struct {
+   uint8_t conn_cfg_tag;
+   union {
+      struct {
+         uint8_t conn_count;
+         uint16_t event_length;
+      } gap_conn_cfg;
+      struct {
+         uint16_t att_mtu;
+      } gatt_conn_cfg;
+      struct {
+         uint8_t hvn_tx_queue_size;
+      } gatts_conn_cfg;
+   } params;
+} ble_conn_cfg_t;
+
+typedef union {
+   ble_conn_cfg_t conn_cfg;
+   struct {
+      struct {
+         uint8_t vs_uuid_count;
+      } vs_uuid_cfg;
+   } common_cfg;
+   struct {
+      struct {
+         uint8_t adv_set_count;
+         uint8_t periph_role_count;
+         uint8_t central_role_count;
+         uint8_t central_sec_count;
+      } role_count_cfg;
+   } gap_cfg;
+   struct {
+      struct {
+         uint32_t attr_tab_size;
+      } attr_tab_size;
+   } gatts_cfg;
+} ble_cfg_t;
+
+//-----------------------------------------------------------------------------
+// SoftDevice calls
+//-----------------------------------------------------------------------------
+
+ret_code_t sd_ble_cfg_set(uint32_t cfg_id, ble_cfg_t const * p_cfg,
+                          uint32_t app_ram_base);
+ret_code_t sd_ble_version_get(ble_version_t * p_version);
+ret_code_t sd_ble_uuid_vs_add(ble_uuid128_t const * p_vs_uuid,
+                              uint8_t * p_uuid_type);
+ret_code_t sd_ble_user_mem_reply(uint16_t conn_handle,
+                                 ble_user_mem_block_t const * p_block);
+
+ret_code_t sd_ble_gap_addr_get(ble_gap_addr_t * p_addr);
+ret_code_t sd_ble_gap_device_name_set(ble_gap_conn_sec_mode_t const * p_mode,
+                                      uint8_t const * p_dev_name,
+                                      uint16_t len);
+ret_code_t sd_ble_gap_appearance_set(uint16_t appearance);
+ret_code_t sd_ble_gap_ppcp_set(ble_gap_conn_params_t const * p_params);
+ret_code_t sd_ble_gap_tx_power_set(uint8_t role, uint16_t handle,
+                                   int8_t tx_power);
+ret_code_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_code);
+ret_code_t sd_ble_gap_conn_param_update(uint16_t conn_handle,
+                                        ble_gap_conn_params_t const * p);
+ret_code_t sd_ble_gap_phy_update(uint16_t conn_handle,
+                                 ble_gap_phys_t const * p_gap_phys);
+ret_code_t sd_ble_gap_adv_set_configure(uint8_t * p_adv_handle,
+                                        ble_gap_adv_data_t const * p_data,
+                                        ble_gap_adv_params_t const * p_params);
+ret_code_t sd_ble_gap_adv_stop(uint8_t adv_handle);
+
+ret_code_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const * p_uuid,
+                                    uint16_t * p_handle);
+ret_code_t sd_ble_gatts_characteristic_add(uint16_t service_handle,
+                                           ble_gatts_char_md_t const * p_md,
+                                           ble_gatts_attr_t const * p_value,
+                                           ble_gatts_char_handles_t * p_h);
+ret_code_t sd_ble_gatts_rw_authorize_reply(
+   uint16_t conn_handle,
+   ble_gatts_rw_authorize_reply_params_t const * p_reply);
+ret_code_t sd_ble_gatts_sys_attr_set(uint16_t conn_handle,
+                                     uint8_t const * p_sys_attr_data,
+                                     uint16_t len, uint32_t flags);
+ret_code_t sd_ble_gatts_hvx(uint16_t conn_handle,
+                            ble_gatts_hvx_params_t const * p_hvx_params);
+ret_code_t sd_ble_gatts_value_set(uint16_t conn_handle, uint16_t handle,
+                                  ble_gatts_value_t * p_value);
+ret_code_t sd_ble_gatts_attr_get(uint16_t handle, ble_uuid_t * p_uuid,
+                                 ble_gatts_attr_md_t * p_md);
+
+#endif // _SHIM_BLE_H_
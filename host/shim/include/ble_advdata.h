@@ -0,0 +1,56 @@
+/**
+ * Host simulation shim: advertising data encoder
+ *
+ * @file ble_advdata.h
+ */
+
+#ifndef _SHIM_BLE_ADVDATA_H_
+#define _SHIM_BLE_ADVDATA_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble.h"
+#include "sdk_errors.h"
+
+typedef enum {
+   BLE_ADVDATA_NO_NAME,
+   BLE_ADVDATA_SHORT_NAME,
+   BLE_ADVDATA_FULL_NAME,
+} ble_advdata_name_type_t;
+
+typedef struct {
+   uint16_t size;
+   uint8_t * p_data;
+} uint8_array_t;
+
+typedef struct {
+   uint16_t company_identifier;
+   uint8_array_t data;
+} ble_advdata_manuf_data_t;
+
+typedef struct {
+   uint16_t uuid_cnt;
+   ble_uuid_t * p_uuids;
+} ble_advdata_uuid_list_t;
+
+/** Advertising data content */
+typedef struct {
+   ble_advdata_name_type_t name_type;
+   uint8_t short_name_len;
+   bool include_appearance;
+   uint8_t flags;
+   int8_t * p_tx_power_level;
+   ble_advdata_uuid_list_t uuids_more_available;
+   ble_advdata_uuid_list_t uuids_complete;
+   ble_advdata_uuid_list_t uuids_solicited;
+   void * p_slave_conn_int;
+   ble_advdata_manuf_data_t * p_manuf_specific_data;
+   void * p_service_data_array;
+   uint8_t service_data_count;
+   bool include_ble_device_addr;
+} ble_advdata_t;
+
+ret_code_t ble_advdata_encode(ble_advdata_t const * p_advdata,
+                              uint8_t * p_encoded_data, uint16_t * p_len);
+
+#endif // _SHIM_BLE_ADVDATA_H_
@@ -0,0 +1,95 @@
+/**
+ * Host simulation shim: advertising module
+ *
+ * Starting a mode reports it to the event handler right away; the module
+ * does not observe BLE events, the bench drives connections explicitly.
+ *
+ * @file ble_advertising.h
+ */
+
+#ifndef _SHIM_BLE_ADVERTISING_H_
+#define _SHIM_BLE_ADVERTISING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble.h"
+#include "ble_advdata.h"
+#include "sdk_errors.h"
+
+typedef enum {
+   BLE_ADV_MODE_IDLE,
+   BLE_ADV_MODE_DIRECTED_HIGH_DUTY,
+   BLE_ADV_MODE_DIRECTED,
+   BLE_ADV_MODE_FAST,
+   BLE_ADV_MODE_SLOW,
+} ble_adv_mode_t;
+
+typedef enum {
+   BLE_ADV_EVT_IDLE,
+   BLE_ADV_EVT_DIRECTED_HIGH_DUTY,
+   BLE_ADV_EVT_DIRECTED,
+   BLE_ADV_EVT_FAST,
+   BLE_ADV_EVT_SLOW,
+   BLE_ADV_EVT_FAST_WHITELIST,
+   BLE_ADV_EVT_SLOW_WHITELIST,
+   BLE_ADV_EVT_WHITELIST_REQUEST,
+   BLE_ADV_EVT_PEER_ADDR_REQUEST,
+} ble_adv_evt_t;
+
+/** Advertising modes configuration */
+typedef struct {
+   bool ble_adv_on_disconnect_disabled;
+   bool ble_adv_whitelist_enabled;
+   bool ble_adv_directed_high_duty_enabled;
+   bool ble_adv_directed_enabled;
+   bool ble_adv_fast_enabled;
+   bool ble_adv_slow_enabled;
+   uint32_t ble_adv_directed_interval;
+   uint32_t ble_adv_directed_timeout;
+   uint32_t ble_adv_fast_interval;
+   uint32_t ble_adv_fast_timeout;
+   uint32_t ble_adv_slow_interval;
+   uint32_t ble_adv_slow_timeout;
+   bool ble_adv_extended_enabled;
+   uint32_t ble_adv_secondary_phy;
+   uint32_t ble_adv_primary_phy;
+} ble_adv_modes_config_t;
+
+typedef void (*ble_adv_evt_handler_t)(ble_adv_evt_t const adv_evt);
+typedef void (*ble_adv_error_handler_t)(uint32_t nrf_error);
+
+/** Advertising module initialization */
+typedef struct {
+   ble_advdata_t advdata;
+   ble_advdata_t srdata;
+   ble_adv_modes_config_t config;
+   ble_adv_evt_handler_t evt_handler;
+   ble_adv_error_handler_t error_handler;
+} ble_advertising_init_t;
+
+/** Advertising module instance */
+typedef struct {
+   bool initialized;
+   ble_adv_evt_t adv_evt;
+   ble_adv_mode_t adv_mode_current;
+   ble_adv_modes_config_t adv_modes_config;
+   uint8_t conn_cfg_tag;
+   ble_adv_evt_handler_t evt_handler;
+   ble_adv_error_handler_t error_handler;
+   ble_gap_adv_params_t adv_params;
+   uint8_t adv_handle;
+   uint8_t enc_advdata[BLE_GAP_ADV_SET_DATA_SIZE_EXTENDED_MAX_SUPPORTED];
+   uint8_t enc_scan_rsp_data[BLE_GAP_ADV_SET_DATA_SIZE_EXTENDED_MAX_SUPPORTED];
+   ble_gap_adv_data_t adv_data;
+} ble_advertising_t;
+
+#define BLE_ADVERTISING_DEF(_name_) static ble_advertising_t _name_
+
+ret_code_t ble_advertising_init(ble_advertising_t * p_advertising,
+                                ble_advertising_init_t const * p_init);
+ret_code_t ble_advertising_start(ble_advertising_t * p_advertising,
+                                 ble_adv_mode_t advertising_mode);
+void ble_advertising_conn_cfg_tag_set(ble_advertising_t * p_advertising,
+                                      uint8_t ble_cfg_tag);
+
+#endif // _SHIM_BLE_ADVERTISING_H_
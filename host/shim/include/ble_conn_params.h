@@ -0,0 +1,47 @@
+/**
+ * Host simulation shim: connection parameters negotiation
+ *
+ * A parameter change request is granted unless adv_shim_conn_params_refuse()
+ * has been called for the connection.
+ *
+ * @file ble_conn_params.h
+ */
+
+#ifndef _SHIM_BLE_CONN_PARAMS_H_
+#define _SHIM_BLE_CONN_PARAMS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble.h"
+#include "sdk_errors.h"
+
+typedef enum {
+   BLE_CONN_PARAMS_EVT_FAILED,
+   BLE_CONN_PARAMS_EVT_SUCCEEDED,
+} ble_conn_params_evt_type_t;
+
+typedef struct {
+   ble_conn_params_evt_type_t evt_type;
+   uint16_t conn_handle;
+} ble_conn_params_evt_t;
+
+typedef void (*ble_conn_params_evt_handler_t)(ble_conn_params_evt_t * p_evt);
+typedef void (*ble_srv_error_handler_t)(uint32_t nrf_error);
+
+/** Connection parameters module initialization */
+typedef struct {
+   ble_gap_conn_params_t * p_conn_params;
+   uint32_t first_conn_params_update_delay;
+   uint32_t next_conn_params_update_delay;
+   uint8_t max_conn_params_update_count;
+   uint16_t start_on_notify_cccd_handle;
+   bool disconnect_on_fail;
+   ble_conn_params_evt_handler_t evt_handler;
+   ble_srv_error_handler_t error_handler;
+} ble_conn_params_init_t;
+
+ret_code_t ble_conn_params_init(ble_conn_params_init_t const * p_init);
+ret_code_t ble_conn_params_change_conn_params(
+   uint16_t conn_handle, ble_gap_conn_params_t * p_new_params);
+
+#endif // _SHIM_BLE_CONN_PARAMS_H_
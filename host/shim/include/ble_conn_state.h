@@ -0,0 +1,10 @@
+/**
+ * Host simulation shim: connection state module, unused by the application
+ *
+ * @file ble_conn_state.h
+ */
+
+#ifndef _SHIM_BLE_CONN_STATE_H_
+#define _SHIM_BLE_CONN_STATE_H_
+
+#endif // _SHIM_BLE_CONN_STATE_H_
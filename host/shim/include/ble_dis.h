@@ -0,0 +1,26 @@
+/**
+ * Host simulation shim: device information service
+ *
+ * @file ble_dis.h
+ */
+
+#ifndef _SHIM_BLE_DIS_H_
+#define _SHIM_BLE_DIS_H_
+
+#include "ble_srv_common.h"
+#include "sdk_errors.h"
+
+/** Device information service initialization */
+typedef struct {
+   ble_srv_utf8_str_t manufact_name_str;
+   ble_srv_utf8_str_t model_num_str;
+   ble_srv_utf8_str_t serial_num_str;
+   ble_srv_utf8_str_t hw_rev_str;
+   ble_srv_utf8_str_t fw_rev_str;
+   ble_srv_utf8_str_t sw_rev_str;
+   security_req_t dis_char_rd_sec;
+} ble_dis_init_t;
+
+ret_code_t ble_dis_init(ble_dis_init_t const * p_dis_init);
+
+#endif // _SHIM_BLE_DIS_H_
@@ -0,0 +1,14 @@
+/**
+ * Host simulation shim: HCI error codes
+ *
+ * @file ble_hci.h
+ */
+
+#ifndef _SHIM_BLE_HCI_H_
+#define _SHIM_BLE_HCI_H_
+
+#define BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION 0x13U
+#define BLE_HCI_LOCAL_HOST_TERMINATED_CONNECTION  0x16U
+#define BLE_HCI_CONN_INTERVAL_UNACCEPTABLE        0x3BU
+
+#endif // _SHIM_BLE_HCI_H_
@@ -0,0 +1,26 @@
+/**
+ * Host simulation shim: common service definitions
+ *
+ * @file ble_srv_common.h
+ */
+
+#ifndef _SHIM_BLE_SRV_COMMON_H_
+#define _SHIM_BLE_SRV_COMMON_H_
+
+#include <stdint.h>
+
+#define BLE_CCCD_VALUE_LEN 2U
+
+/** Security requirement levels */
+typedef enum {
+   SEC_NO_ACCESS,
+   SEC_OPEN,
+} security_req_t;
+
+/** UTF-8 string */
+typedef struct {
+   uint16_t length;
+   uint8_t * p_str;
+} ble_srv_utf8_str_t;
+
+#endif // _SHIM_BLE_SRV_COMMON_H_
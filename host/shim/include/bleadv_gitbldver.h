@@ -0,0 +1,13 @@
+/**
+ * Host simulation shim: build version, generated by tag_application() in
+ * target builds
+ *
+ * @file bleadv_gitbldver.h
+ */
+
+#ifndef _SHIM_BLEADV_GITBLDVER_H_
+#define _SHIM_BLEADV_GITBLDVER_H_
+
+#define POWERADV_SVNVER "host"
+
+#endif // _SHIM_BLEADV_GITBLDVER_H_
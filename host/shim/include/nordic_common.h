@@ -0,0 +1,18 @@
+/**
+ * Host simulation shim: common SDK definitions
+ *
+ * MIN/MAX and friends are provided by adv_tools.h. The standard I/O and
+ * variadic headers are pulled in here, as the SDK headers do transitively.
+ *
+ * @file nordic_common.h
+ */
+
+#ifndef _SHIM_NORDIC_COMMON_H_
+#define _SHIM_NORDIC_COMMON_H_
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#define UNUSED_PARAMETER(_x_) ((void)(_x_))
+
+#endif // _SHIM_NORDIC_COMMON_H_
@@ -0,0 +1,126 @@
+/**
+ * Host simulation shim: nRF52832 device and Cortex-M4 core
+ *
+ * Core registers and peripherals are plain RAM structures, which the
+ * simulation updates, see adv_shim.h. Exclusive accesses always succeed, as
+ * the simulation runs in a single thread.
+ *
+ * @file nrf.h
+ */
+
+#ifndef _SHIM_NRF_H_
+#define _SHIM_NRF_H_
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+// Core
+//-----------------------------------------------------------------------------
+
+/** Interrupt program status, 0 from thread mode, see adv_shim_set_irq() */
+extern volatile uint32_t adv_shim_ipsr;
+
+#define __get_IPSR() (adv_shim_ipsr)
+#define __DMB() __sync_synchronize()
+#define __DSB() __sync_synchronize()
+#define __ISB() __sync_synchronize()
+#define __WFE() ((void)0)
+#define __SEV() ((void)0)
+#define __NOP() ((void)0)
+
+static inline uint32_t
+__LDREXW(volatile uint32_t * addr)
+{
+   return *addr;
+}
+
+static inline uint32_t
+__STREXW(uint32_t value, volatile uint32_t * addr)
+{
+   *addr = value;
+   return 0U;
+}
+
+static inline uint8_t
+__LDREXB(volatile uint8_t * addr)
+{
+   return *addr;
+}
+
+static inline uint32_t
+__STREXB(uint8_t value, volatile uint8_t * addr)
+{
+   *addr = value;
+   return 0U;
+}
+
+static inline void
+__CLREX(void)
+{
+}
+
+/** Core clock frequency */
+extern uint32_t SystemCoreClock;
+
+/** Data watchpoint and trace unit */
+typedef struct {
+   volatile uint32_t CTRL;
+   volatile uint32_t CYCCNT;
+} DWT_Type;
+
+/** Core debug registers */
+typedef struct {
+   volatile uint32_t DHCSR;
+   volatile uint32_t DCRSR;
+   volatile uint32_t DCRDR;
+   volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk        (1UL << 0)
+#define CoreDebug_DHCSR_C_DEBUGEN_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk    (1UL << 24)
+
+extern DWT_Type adv_shim_dwt;
+extern CoreDebug_Type adv_shim_core_debug;
+
+#define DWT       (&adv_shim_dwt)
+#define CoreDebug (&adv_shim_core_debug)
+
+//-----------------------------------------------------------------------------
+// Peripherals
+//-----------------------------------------------------------------------------
+
+/** Timer/counter */
+typedef struct {
+   volatile uint32_t TASKS_START;
+   volatile uint32_t TASKS_STOP;
+   volatile uint32_t TASKS_COUNT;
+   volatile uint32_t TASKS_CLEAR;
+   volatile uint32_t TASKS_CAPTURE[6];
+   volatile uint32_t MODE;
+   volatile uint32_t BITMODE;
+   volatile uint32_t PRESCALER;
+   volatile uint32_t CC[6];
+} NRF_TIMER_Type;
+
+#define TIMER_MODE_MODE_Timer       0UL
+#define TIMER_BITMODE_BITMODE_32Bit 3UL
+
+/** Real time counter */
+typedef struct {
+   volatile uint32_t TASKS_START;
+   volatile uint32_t TASKS_STOP;
+   volatile uint32_t TASKS_CLEAR;
+   volatile uint32_t PRESCALER;
+   volatile uint32_t COUNTER;
+} NRF_RTC_Type;
+
+#define RTC_COUNTER_COUNTER_Msk 0xFFFFFFUL
+
+extern NRF_TIMER_Type adv_shim_timer2;
+extern NRF_RTC_Type adv_shim_rtc2;
+
+#define NRF_TIMER2 (&adv_shim_timer2)
+#define NRF_RTC2   (&adv_shim_rtc2)
+
+#endif // _SHIM_NRF_H_
@@ -0,0 +1,60 @@
+/**
+ * Host simulation shim: GATT negotiation module
+ *
+ * @file nrf_ble_gatt.h
+ */
+
+#ifndef _SHIM_NRF_BLE_GATT_H_
+#define _SHIM_NRF_BLE_GATT_H_
+
+#include <stdint.h>
+#include "ble.h"
+#include "sdk_config.h"
+#include "sdk_errors.h"
+
+#define NRF_BLE_GATT_BLE_OBSERVER_PRIO 1U
+
+typedef enum {
+   NRF_BLE_GATT_EVT_ATT_MTU_UPDATED,
+   NRF_BLE_GATT_EVT_DATA_LENGTH_UPDATED,
+} nrf_ble_gatt_evt_id_t;
+
+typedef struct {
+   nrf_ble_gatt_evt_id_t evt_id;
+   uint16_t conn_handle;
+   union {
+      uint16_t att_mtu_effective;
+      uint8_t data_length;
+   } params;
+} nrf_ble_gatt_evt_t;
+
+typedef struct nrf_ble_gatt_s nrf_ble_gatt_t;
+
+typedef void (*nrf_ble_gatt_evt_handler_t)(nrf_ble_gatt_t * p_gatt,
+                                           nrf_ble_gatt_evt_t const * p_evt);
+
+/** GATT module link state */
+typedef struct {
+   uint16_t att_mtu_effective;
+} nrf_ble_gatt_link_t;
+
+/** GATT module instance */
+struct nrf_ble_gatt_s {
+   uint16_t att_mtu_desired_periph;
+   uint8_t data_length;
+   nrf_ble_gatt_link_t links[NRF_SDH_BLE_TOTAL_LINK_COUNT];
+   nrf_ble_gatt_evt_handler_t evt_handler;
+};
+
+ret_code_t nrf_ble_gatt_init(nrf_ble_gatt_t * p_gatt,
+                             nrf_ble_gatt_evt_handler_t evt_handler);
+ret_code_t nrf_ble_gatt_att_mtu_periph_set(nrf_ble_gatt_t * p_gatt,
+                                           uint16_t desired_mtu);
+ret_code_t nrf_ble_gatt_data_length_set(nrf_ble_gatt_t * p_gatt,
+                                        uint16_t conn_handle,
+                                        uint8_t data_length);
+uint16_t nrf_ble_gatt_eff_mtu_get(nrf_ble_gatt_t const * p_gatt,
+                                  uint16_t conn_handle);
+void nrf_ble_gatt_on_ble_evt(ble_evt_t const * p_ble_evt, void * p_context);
+
+#endif // _SHIM_NRF_BLE_GATT_H_
@@ -0,0 +1,16 @@
+/**
+ * Host simulation shim: SoftDevice handler
+ *
+ * @file nrf_sdh.h
+ */
+
+#ifndef _SHIM_NRF_SDH_H_
+#define _SHIM_NRF_SDH_H_
+
+#include <stdint.h>
+#include "sdk_errors.h"
+#include "sdk_config.h"
+
+ret_code_t nrf_sdh_enable_request(void);
+
+#endif // _SHIM_NRF_SDH_H_
@@ -0,0 +1,41 @@
+/**
+ * Host simulation shim: SoftDevice BLE event observers
+ *
+ * Observers are registered into a dedicated linker section, as with the SDK,
+ * and adv_shim_ble_evt() dispatches events to all of them.
+ *
+ * @file nrf_sdh_ble.h
+ */
+
+#ifndef _SHIM_NRF_SDH_BLE_H_
+#define _SHIM_NRF_SDH_BLE_H_
+
+#include <stdint.h>
+#include "ble.h"
+#include "sdk_config.h"
+
+typedef void (*nrf_sdh_ble_evt_handler_t)(ble_evt_t const * p_ble_evt,
+                                          void * p_context);
+
+/** BLE event observer */
+typedef struct {
+   nrf_sdh_ble_evt_handler_t handler;
+   void * p_context;
+} nrf_sdh_ble_evt_observer_t;
+
+/**
+ * Register a BLE event observer. Priorities are ignored: observers are
+ * invoked in link order.
+ */
+#define NRF_SDH_BLE_OBSERVER(_name_, _prio_, _handler_, _context_) \
+   static const nrf_sdh_ble_evt_observer_t _name_ \
+      __attribute__((section("sdh_ble_observers"), used, \
+                     aligned(sizeof(void *)))) = { \
+      .handler = (_handler_), \
+      .p_context = (_context_), \
+   }
+
+ret_code_t nrf_sdh_ble_app_ram_start_get(uint32_t * p_app_ram_start);
+ret_code_t nrf_sdh_ble_enable(uint32_t * p_app_ram_start);
+
+#endif // _SHIM_NRF_SDH_BLE_H_
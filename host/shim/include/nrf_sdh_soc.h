@@ -0,0 +1,28 @@
+/**
+ * Host simulation shim: SoftDevice SoC event observers
+ *
+ * SoC events are not simulated, observers are never invoked.
+ *
+ * @file nrf_sdh_soc.h
+ */
+
+#ifndef _SHIM_NRF_SDH_SOC_H_
+#define _SHIM_NRF_SDH_SOC_H_
+
+#include <stdint.h>
+
+typedef void (*nrf_sdh_soc_evt_handler_t)(uint32_t evt_id, void * p_context);
+
+/** SoC event observer */
+typedef struct {
+   nrf_sdh_soc_evt_handler_t handler;
+   void * p_context;
+} nrf_sdh_soc_evt_observer_t;
+
+#define NRF_SDH_SOC_OBSERVER(_name_, _prio_, _handler_, _context_) \
+   static const nrf_sdh_soc_evt_observer_t _name_ __attribute__((used)) = { \
+      .handler = (_handler_), \
+      .p_context = (_context_), \
+   }
+
+#endif // _SHIM_NRF_SDH_SOC_H_
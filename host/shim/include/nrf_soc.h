@@ -0,0 +1,15 @@
+/**
+ * Host simulation shim: SoftDevice SoC API
+ *
+ * @file nrf_soc.h
+ */
+
+#ifndef _SHIM_NRF_SOC_H_
+#define _SHIM_NRF_SOC_H_
+
+#include <stdint.h>
+#include "sdk_errors.h"
+
+ret_code_t sd_app_evt_wait(void);
+
+#endif // _SHIM_NRF_SOC_H_
@@ -0,0 +1,5 @@
+/**
+ * Host simulation shim: SDK header warning suppression, nothing to suppress
+ *
+ * @file nrf_warn_enter.h
+ */
@@ -0,0 +1,5 @@
+/**
+ * Host simulation shim: SDK header warning suppression, nothing to restore
+ *
+ * @file nrf_warn_leave.h
+ */
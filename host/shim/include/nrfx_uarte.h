@@ -0,0 +1,94 @@
+/**
+ * Host simulation shim: UARTE driver
+ *
+ * A transfer stays in progress until the simulation completes it, see
+ * adv_shim_uarte_complete(), which models the DMA transfer duration.
+ *
+ * @file nrfx_uarte.h
+ */
+
+#ifndef _SHIM_NRFX_UARTE_H_
+#define _SHIM_NRFX_UARTE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdk_errors.h"
+
+#define NRFX_UARTE_ENABLED          1
+/** UARTE0 EasyDMA MAXCNT register width, in bits */
+#define UARTE0_EASYDMA_MAXCNT_SIZE  8
+#define NRF_UARTE_PSEL_DISCONNECTED 0xFFFFFFFFU
+
+typedef enum {
+   NRF_UARTE_HWFC_DISABLED,
+   NRF_UARTE_HWFC_ENABLED,
+} nrf_uarte_hwfc_t;
+
+typedef enum {
+   NRF_UARTE_PARITY_EXCLUDED,
+   NRF_UARTE_PARITY_INCLUDED,
+} nrf_uarte_parity_t;
+
+typedef enum {
+   NRF_UARTE_BAUDRATE_115200,
+   NRF_UARTE_BAUDRATE_1000000,
+} nrf_uarte_baudrate_t;
+
+/** Driver instance */
+typedef struct {
+   void * p_reg;
+   uint8_t drv_inst_idx;
+} nrfx_uarte_t;
+
+#define NRFX_UARTE_INSTANCE(_id_) { .p_reg = NULL, .drv_inst_idx = (_id_) }
+
+/** Driver configuration */
+typedef struct {
+   uint32_t pseltxd;
+   uint32_t pselrxd;
+   uint32_t pselcts;
+   uint32_t pselrts;
+   void * p_context;
+   nrf_uarte_hwfc_t hwfc;
+   nrf_uarte_parity_t parity;
+   nrf_uarte_baudrate_t baudrate;
+   uint8_t interrupt_priority;
+} nrfx_uarte_config_t;
+
+typedef enum {
+   NRFX_UARTE_EVT_TX_DONE,
+   NRFX_UARTE_EVT_RX_DONE,
+   NRFX_UARTE_EVT_ERROR,
+} nrfx_uarte_evt_type_t;
+
+typedef struct {
+   uint8_t * p_data;
+   size_t bytes;
+} nrfx_uarte_xfer_evt_t;
+
+typedef struct {
+   nrfx_uarte_xfer_evt_t rxtx;
+   uint32_t error_mask;
+} nrfx_uarte_error_evt_t;
+
+typedef struct {
+   nrfx_uarte_evt_type_t type;
+   union {
+      nrfx_uarte_xfer_evt_t rxtx;
+      nrfx_uarte_error_evt_t error;
+   } data;
+} nrfx_uarte_event_t;
+
+typedef void (*nrfx_uarte_event_handler_t)(nrfx_uarte_event_t const * p_event,
+                                           void * p_context);
+
+ret_code_t nrfx_uarte_init(nrfx_uarte_t const * p_instance,
+                           nrfx_uarte_config_t const * p_config,
+                           nrfx_uarte_event_handler_t event_handler);
+void nrfx_uarte_uninit(nrfx_uarte_t const * p_instance);
+ret_code_t nrfx_uarte_tx(nrfx_uarte_t const * p_instance,
+                         uint8_t const * p_data, size_t length);
+bool nrfx_uarte_tx_in_progress(nrfx_uarte_t const * p_instance);
+
+#endif // _SHIM_NRFX_UARTE_H_
@@ -0,0 +1,15 @@
+/**
+ * Host simulation shim: SDK configuration
+ *
+ * Only the settings the application sources check are defined.
+ *
+ * @file sdk_config.h
+ */
+
+#ifndef _SHIM_SDK_CONFIG_H_
+#define _SHIM_SDK_CONFIG_H_
+
+#define NRF_SDH_BLE_PERIPHERAL_LINK_COUNT 2
+#define NRF_SDH_BLE_TOTAL_LINK_COUNT      2
+
+#endif // _SHIM_SDK_CONFIG_H_
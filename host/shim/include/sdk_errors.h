@@ -0,0 +1,43 @@
+/**
+ * Host simulation shim: SDK and SoftDevice error codes
+ *
+ * Values match the nRF5 SDK 15 / S132 v6 definitions.
+ *
+ * @file sdk_errors.h
+ */
+
+#ifndef _SHIM_SDK_ERRORS_H_
+#define _SHIM_SDK_ERRORS_H_
+
+#include <stdint.h>
+
+typedef uint32_t ret_code_t;
+
+#define NRF_SUCCESS                      0x0000U
+#define NRF_ERROR_SVC_HANDLER_MISSING    0x0001U
+#define NRF_ERROR_SOFTDEVICE_NOT_ENABLED 0x0002U
+#define NRF_ERROR_INTERNAL               0x0003U
+#define NRF_ERROR_NO_MEM                 0x0004U
+#define NRF_ERROR_NOT_FOUND              0x0005U
+#define NRF_ERROR_NOT_SUPPORTED          0x0006U
+#define NRF_ERROR_INVALID_PARAM          0x0007U
+#define NRF_ERROR_INVALID_STATE          0x0008U
+#define NRF_ERROR_INVALID_LENGTH         0x0009U
+#define NRF_ERROR_INVALID_FLAGS          0x000AU
+#define NRF_ERROR_INVALID_DATA           0x000BU
+#define NRF_ERROR_DATA_SIZE              0x000CU
+#define NRF_ERROR_TIMEOUT                0x000DU
+#define NRF_ERROR_NULL                   0x000EU
+#define NRF_ERROR_FORBIDDEN              0x000FU
+#define NRF_ERROR_INVALID_ADDR           0x0010U
+#define NRF_ERROR_BUSY                   0x0011U
+#define NRF_ERROR_CONN_COUNT             0x0012U
+#define NRF_ERROR_RESOURCES              0x0013U
+
+#define BLE_ERROR_NOT_ENABLED            0x3001U
+#define BLE_ERROR_INVALID_CONN_HANDLE    0x3002U
+#define BLE_ERROR_INVALID_ATTR_HANDLE    0x3003U
+#define BLE_ERROR_GATTS_INVALID_ATTR_TYPE 0x3400U
+#define BLE_ERROR_GATTS_SYS_ATTR_MISSING 0x3401U
+
+#endif // _SHIM_SDK_ERRORS_H_
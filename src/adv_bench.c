@@ -0,0 +1,453 @@
+/**
+ * PowerAdvertiser benchmark and soak test harness
+ *
+ * Replace the idle main loop of the application in the benchmark firmware:
+ * the harness emits trace bursts, loads the background worker engine and
+ * delays the completion of the bench characteristic reads, as configured by
+ * the host, and accounts where the CPU cycles go. The DWT cycle counter only
+ * runs while the CPU does, so it measures the time spent out of sleep.
+ *
+ * @file adv_bench.c
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "nrf_warn_enter.h"
+#include "app_error.h"
+#include "app_scheduler.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "nordic_common.h"
+#include "nrf.h"
+#include "nrf_warn_leave.h"
+#include "adv_bench.h"
+#include "adv_errors.h"
+#include "adv_power.h"
+#include "adv_tools.h"
+#include "adv_trace.h"
+
+//-----------------------------------------------------------------------------
+// Constants
+//-----------------------------------------------------------------------------
+
+/** Shortest trace burst period, in ms */
+#define ADV_BENCH_PERIOD_MIN_MS    10U
+/** Largest count of messages per source and burst */
+#define ADV_BENCH_BURST_MAX        64U
+/** Longest background worker load, in microseconds */
+#define ADV_BENCH_LOAD_MAX_US      100000U
+/** Longest bench read completion delay, in ms, within the ATT timeout */
+#define ADV_BENCH_REQ_DELAY_MAX_MS 10000U
+
+// record layouts are shared with tools/adv_bench.py
+ASSERT_COMPILE(sizeof(struct adv_bench_config) == 16U);
+ASSERT_COMPILE(sizeof(struct adv_bench_results) == 80U);
+// trace sources are selected with a 32-bit mask
+ASSERT_COMPILE(PTM_COUNT <= 32);
+
+//-----------------------------------------------------------------------------
+// Type definitions
+//-----------------------------------------------------------------------------
+
+/** Deferred bench read */
+struct adv_bench_read {
+   /** Record to fill in on completion, @c NULL if no read is pending */
+   struct adv_bench_results * rd_results;
+   adv_bench_complete_t rd_complete; /**< Completion callback */
+   unsigned int rd_req_id;           /**< Request identifier */
+   uint32_t rd_start;                /**< app_timer counter at read start */
+};
+
+/** Benchmark harness */
+struct adv_bench {
+   struct adv_bench_config bh_config;   /**< Current configuration */
+   struct adv_bench_results bh_results; /**< Accumulated results */
+   uint32_t bh_cyccnt;         /**< Cycle counter at last accounting */
+   uint32_t bh_start;          /**< Power time base at results reset */
+   uint32_t bh_wakeups;        /**< Count of wake ups at results reset */
+   struct adv_bench_read bh_read; /**< Deferred bench read */
+   app_timer_id_t bh_burst_timer_id; /**< Trace burst timer API */
+   app_timer_t bh_burst_timer;       /**< Trace burst timer instance */
+   app_timer_id_t bh_read_timer_id;  /**< Deferred read timer API */
+   app_timer_t bh_read_timer;        /**< Deferred read timer instance */
+};
+
+//-----------------------------------------------------------------------------
+// Forward declarations
+//-----------------------------------------------------------------------------
+
+static void _adv_bench_timer_create(struct adv_bench * bench);
+static void _adv_bench_reset(struct adv_bench * bench);
+static void _adv_bench_apply(struct adv_bench * bench);
+static void _adv_bench_account(struct adv_bench * bench);
+static void _adv_bench_fill(struct adv_bench * bench,
+                            struct adv_bench_results * results,
+                            uint32_t start);
+static void _adv_bench_burst_timer_cb(void * context);
+static void _adv_bench_read_timer_cb(void * context);
+
+//-----------------------------------------------------------------------------
+// Constants
+//-----------------------------------------------------------------------------
+
+/** Configuration at start up, so that a soak test runs without any host */
+static const struct adv_bench_config _ADV_BENCH_DEFAULT_CONFIG = {
+   .bc_sources = 1U << PTM_BENCH,
+   .bc_period = 1000U,
+   .bc_burst = 4U,
+   .bc_level = PTL_INFO,
+};
+
+//-----------------------------------------------------------------------------
+// Variables
+//-----------------------------------------------------------------------------
+
+/** Benchmark harness instance */
+static struct adv_bench _adv_bench;
+
+//-----------------------------------------------------------------------------
+// Public API
+//-----------------------------------------------------------------------------
+
+/**
+ * Run the benchmark harness in place of the application main loop.
+ */
+void __attribute__((noreturn))
+adv_bench_run(void)
+{
+   struct adv_bench * bench = &_adv_bench;
+
+   _adv_bench_timer_create(bench);
+   bench->bh_config = _ADV_BENCH_DEFAULT_CONFIG;
+   _adv_bench_reset(bench);
+   _adv_bench_apply(bench);
+
+   MSGV(PTL_INFO, "Bench: harness running");
+
+   for (;;) {
+      app_sched_execute();
+      // the cycle counter is stopped while the CPU sleeps
+      _adv_bench_account(bench);
+      adv_power_wait();
+   }
+}
+
+/**
+ * Update the benchmark configuration.
+ *
+ * @param[in] buf the configuration record, see adv_bench_config
+ * @param[in] length the record length
+ * @return @c PE_NO_ERROR or a negative error code
+ */
+int
+adv_bench_configure(const uint8_t * buf, size_t length)
+{
+   struct adv_bench * bench = &_adv_bench;
+   struct adv_bench_config config;
+
+   if ( length != sizeof(config) ) {
+      MSGV(PTL_ERROR, "Invalid config size %u", (unsigned int)length);
+      return -PE_INVALID_SIZE;
+   }
+   // the record comes from the request transient storage, which is not
+   // aligned for it
+   memcpy(&config, buf, sizeof(config));
+
+   if ( config.bc_rsv ) {
+      // keep the reserved byte available for a later extension
+      return -PE_INVALID_REQUEST;
+   }
+   if ( config.bc_period &&
+        (config.bc_period < ADV_BENCH_PERIOD_MIN_MS) ) {
+      return -PE_INVALID_DURATION;
+   }
+   if ( (config.bc_burst > ADV_BENCH_BURST_MAX) ||
+        (config.bc_level >= PTL_FATAL) ||
+        (config.bc_load >
+         ADV_BENCH_LOAD_MAX_US * (SystemCoreClock / 1000000U)) ) {
+      return -PE_OUT_OF_RANGE;
+   }
+   if ( config.bc_req_delay > ADV_BENCH_REQ_DELAY_MAX_MS ) {
+      return -PE_INVALID_DURATION;
+   }
+
+   MSGV(PTL_INFO, "Bench: src %08x period %u burst %u lvl %u load %u "
+        "delay %u%s", config.bc_sources, config.bc_period, config.bc_burst,
+        config.bc_level, config.bc_load, config.bc_req_delay,
+        config.bc_reset ? " reset" : "");
+
+   bench->bh_config = config;
+   if ( config.bc_reset ) {
+      _adv_bench_reset(bench);
+   }
+   _adv_bench_apply(bench);
+
+   return PE_NO_ERROR;
+}
+
+/**
+ * Read out the benchmark results, after the configured completion delay.
+ *
+ * @param[out] results updated with the results, possibly on completion
+ * @param[in] req_id the request identifier
+ * @param[in] complete completion callback of a deferred read
+ * @return @c PE_NO_ERROR, @c PE_DEFERRED if completion is invoked later on,
+ *         or a negative error code
+ */
+int
+adv_bench_read(struct adv_bench_results * results, unsigned int req_id,
+               adv_bench_complete_t complete)
+{
+   struct adv_bench * bench = &_adv_bench;
+   struct adv_bench_read * rd = &bench->bh_read;
+   uint32_t start = app_timer_cnt_get();
+
+   if ( ! bench->bh_config.bc_req_delay ) {
+      _adv_bench_fill(bench, results, start);
+      return PE_NO_ERROR;
+   }
+
+   if ( rd->rd_results ) {
+      // requests to an attribute are serialized, this should not occur
+      return -PE_BUSY;
+   }
+
+   ret_code_t rc = app_timer_start(bench->bh_read_timer_id,
+                                   MAX(APP_TIMER_TICKS(
+                                          bench->bh_config.bc_req_delay),
+                                       APP_TIMER_MIN_TIMEOUT_TICKS),
+                                   bench);
+   APP_ERROR_CHECK(rc);
+
+   rd->rd_results = results;
+   rd->rd_complete = complete;
+   rd->rd_req_id = req_id;
+   rd->rd_start = start;
+
+   return PE_DEFERRED;
+}
+
+/**
+ * Run the configured background worker load.
+ * Invoked from the background worker engine.
+ *
+ * @return @c PE_NO_ERROR
+ */
+int
+adv_bench_load(void)
+{
+   struct adv_bench * bench = &_adv_bench;
+   struct adv_bench_results * res = &bench->bh_results;
+   uint32_t load = bench->bh_config.bc_load;
+
+   if ( ! load ) {
+      return PE_NO_ERROR;
+   }
+
+   uint32_t start = DWT->CYCCNT;
+   while ( (DWT->CYCCNT - start) < load ) {
+      __NOP();
+   }
+   uint32_t cycles = DWT->CYCCNT - start;
+
+   res->br_loads++;
+   res->br_load_max = MAX(res->br_load_max, cycles);
+
+   return PE_NO_ERROR;
+}
+
+//-----------------------------------------------------------------------------
+// Private API
+//-----------------------------------------------------------------------------
+
+/**
+ * Create the harness timers.
+ *
+ * @param[in,out] bench benchmark harness
+ */
+static void
+_adv_bench_timer_create(struct adv_bench * bench)
+{
+   ret_code_t rc;
+
+   bench->bh_burst_timer_id = &bench->bh_burst_timer;
+   rc = app_timer_create(&bench->bh_burst_timer_id,
+                         APP_TIMER_MODE_REPEATED,
+                         &_adv_bench_burst_timer_cb);
+   APP_ERROR_CHECK(rc);
+
+   bench->bh_read_timer_id = &bench->bh_read_timer;
+   rc = app_timer_create(&bench->bh_read_timer_id,
+                         APP_TIMER_MODE_SINGLE_SHOT,
+                         &_adv_bench_read_timer_cb);
+   APP_ERROR_CHECK(rc);
+}
+
+/**
+ * Reset the results, including the trace statistics.
+ *
+ * @param[in,out] bench benchmark harness
+ */
+static void
+_adv_bench_reset(struct adv_bench * bench)
+{
+   struct adv_bench_results * res = &bench->bh_results;
+   struct adv_power_stats power;
+   struct pa_trace_stats trace;
+
+   memset(res, 0, sizeof(*res));
+   res->br_msg_min = UINT32_MAX;
+   res->br_core_freq = SystemCoreClock;
+   res->br_freq = adv_power_time_freq();
+
+   adv_power_get_stats(&power);
+   bench->bh_start = power.ps_time;
+   bench->bh_wakeups = power.ps_wakeups;
+   pa_trace_get_stats(&trace, true);
+   bench->bh_cyccnt = DWT->CYCCNT;
+}
+
+/**
+ * Apply the trace burst configuration.
+ *
+ * @param[in,out] bench benchmark harness
+ */
+static void
+_adv_bench_apply(struct adv_bench * bench)
+{
+   ret_code_t rc;
+
+   rc = app_timer_stop(bench->bh_burst_timer_id);
+   APP_ERROR_CHECK(rc);
+
+   if ( ! bench->bh_config.bc_period ||
+        ! bench->bh_config.bc_burst ||
+        ! bench->bh_config.bc_sources ) {
+      return;
+   }
+
+   rc = app_timer_start(bench->bh_burst_timer_id,
+                        APP_TIMER_TICKS(bench->bh_config.bc_period), bench);
+   APP_ERROR_CHECK(rc);
+}
+
+/**
+ * Account the CPU cycles elapsed since the last accounting.
+ * Accounting should occur more often than the 32-bit cycle counter wraps,
+ * which the main loop does.
+ *
+ * @param[in,out] bench benchmark harness
+ */
+static void
+_adv_bench_account(struct adv_bench * bench)
+{
+   uint32_t now = DWT->CYCCNT;
+
+   bench->bh_results.br_cycles += now - bench->bh_cyccnt;
+   bench->bh_cyccnt = now;
+}
+
+/**
+ * Complete a bench read: account it, then fill in the results.
+ *
+ * @param[in,out] bench benchmark harness
+ * @param[out] results updated with the results
+ * @param[in] start app_timer counter at read start
+ */
+static void
+_adv_bench_fill(struct adv_bench * bench, struct adv_bench_results * results,
+                uint32_t start)
+{
+   struct adv_bench_results * res = &bench->bh_results;
+   uint32_t duration = app_timer_cnt_diff_compute(app_timer_cnt_get(), start);
+
+   res->br_reqs++;
+   res->br_req_max = MAX(res->br_req_max, duration);
+   res->br_req_sum += duration;
+
+   _adv_bench_account(bench);
+
+   struct adv_power_stats power;
+   adv_power_get_stats(&power);
+   res->br_elapsed = power.ps_time - bench->bh_start;
+   res->br_wakeups = power.ps_wakeups - bench->bh_wakeups;
+
+   struct pa_trace_stats trace;
+   pa_trace_get_stats(&trace, false);
+   res->br_sent = trace.st_sent;
+   res->br_drops = 0U;
+   for (unsigned int dix=0; dix<PTD_COUNT; dix++) {
+      res->br_drops += trace.st_drops[dix];
+   }
+   res->br_hwm_count = trace.st_hwm_count;
+   res->br_hwm_bytes = trace.st_hwm_bytes;
+   res->br_lat_max = trace.st_lat_max;
+
+   *results = *res;
+   if ( ! results->br_msgs ) {
+      results->br_msg_min = 0U;
+   }
+}
+
+/**
+ * Emit a trace burst, from the application scheduler thread.
+ * Emission times include the interrupts that preempt the emitter, as
+ * production traces do.
+ *
+ * @param[in,out] context benchmark harness
+ */
+static void
+_adv_bench_burst_timer_cb(void * context)
+{
+   struct adv_bench * bench = (struct adv_bench *)context;
+   const struct adv_bench_config * config = &bench->bh_config;
+   struct adv_bench_results * res = &bench->bh_results;
+   enum pa_trace_level level = (enum pa_trace_level)config->bc_level;
+
+   adv_power_wakeup(APW_TIMER);
+
+   res->br_bursts++;
+   for (int six=0; six<PTM_COUNT; six++) {
+      if ( ! (config->bc_sources & (1U << six)) ) {
+         continue;
+      }
+      for (unsigned int mix=0; mix<config->bc_burst; mix++) {
+         uint32_t start = DWT->CYCCNT;
+         if ( pa_trace_is_traceable(six, level) ) {
+            pa_trace_printf_src(six, level,
+                                "bench %u: msg %u/%u src %d" EOL,
+                                res->br_bursts, mix, config->bc_burst, six);
+         }
+         uint32_t cycles = DWT->CYCCNT - start;
+         res->br_msgs++;
+         res->br_msg_min = MIN(res->br_msg_min, cycles);
+         res->br_msg_max = MAX(res->br_msg_max, cycles);
+         res->br_msg_cycles += cycles;
+      }
+   }
+}
+
+/**
+ * Complete a deferred bench read, from the application scheduler thread.
+ *
+ * @param[in,out] context benchmark harness
+ */
+static void
+_adv_bench_read_timer_cb(void * context)
+{
+   struct adv_bench * bench = (struct adv_bench *)context;
+   struct adv_bench_read * rd = &bench->bh_read;
+
+   adv_power_wakeup(APW_TIMER);
+
+   struct adv_bench_results * results = rd->rd_results;
+   if ( ! results ) {
+      MSGV(PTL_ERROR, "Spurious bench read completion");
+      return;
+   }
+   rd->rd_results = NULL;
+
+   _adv_bench_fill(bench, results, rd->rd_start);
+   rd->rd_complete(rd->rd_req_id, PE_NO_ERROR);
+}
@@ -0,0 +1,73 @@
+/**
+ * PowerAdvertiser benchmark and soak test harness
+ *
+ * Only built in the benchmark firmware (BENCH), see tools/adv_bench.py.
+ *
+ * @file adv_bench.h
+ */
+
+#ifndef _ADV_BENCH_H
+#define _ADV_BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Benchmark configuration, written through the bench characteristic.
+ * This record is exposed as is over BLE, beware of item alignment.
+ */
+struct adv_bench_config {
+   uint32_t bc_sources;   /**< Trace sources to burst, as a PTM_* bitmask */
+   uint16_t bc_period;    /**< Trace burst period in ms, 0 to disable */
+   uint8_t bc_burst;      /**< Count of messages per source and burst */
+   uint8_t bc_level;      /**< Trace level of burst messages */
+   uint32_t bc_load;      /**< Background worker load, in CPU cycles */
+   uint16_t bc_req_delay; /**< Completion delay of bench reads, in ms */
+   uint8_t bc_reset;      /**< Non-zero to reset the results */
+   uint8_t bc_rsv;        /**< Reserved, must be zero */
+};
+
+/**
+ * Benchmark results, read through the bench characteristic.
+ * All counters accumulate from the last results reset.
+ * This record is exposed as is over BLE, beware of item alignment.
+ */
+struct adv_bench_results {
+   uint64_t br_cycles;      /**< CPU cycles spent out of sleep */
+   uint32_t br_core_freq;   /**< CPU cycle frequency, in Hz */
+   uint32_t br_freq;        /**< Power time base frequency, in Hz */
+   uint32_t br_elapsed;     /**< Elapsed time, in power time base ticks */
+   uint32_t br_wakeups;     /**< Count of main loop wake ups */
+   uint32_t br_bursts;      /**< Count of trace bursts */
+   uint32_t br_msgs;        /**< Count of messages emitted by bursts */
+   uint32_t br_msg_min;     /**< Shortest message emission, in CPU cycles */
+   uint32_t br_msg_max;     /**< Longest message emission, in CPU cycles */
+   uint32_t br_msg_cycles;  /**< Accumulated message emission, in cycles */
+   uint32_t br_sent;        /**< Count of transmitted trace messages */
+   uint32_t br_drops;       /**< Count of lost trace messages */
+   uint16_t br_hwm_count;   /**< Trace queue high-water mark, messages */
+   uint16_t br_hwm_bytes;   /**< Trace queue high-water mark, bytes */
+   uint16_t br_lat_max;     /**< Longest trace latency, in RTC ticks */
+   uint16_t br_rsv;         /**< Reserved */
+   uint32_t br_loads;       /**< Count of background worker loads */
+   uint32_t br_load_max;    /**< Longest worker load, in CPU cycles */
+   uint32_t br_reqs;        /**< Count of bench reads */
+   uint32_t br_req_max;     /**< Longest bench read, in app_timer ticks */
+   uint32_t br_req_sum;     /**< Accumulated bench reads, app_timer ticks */
+};
+
+/**
+ * Completion of a deferred bench read.
+ *
+ * @param[in] req_id the request identifier
+ * @param[in] retcode the completion code
+ */
+typedef void (*adv_bench_complete_t)(unsigned int req_id, int retcode);
+
+void __attribute__((noreturn)) adv_bench_run(void);
+int adv_bench_configure(const uint8_t * buf, size_t length);
+int adv_bench_read(struct adv_bench_results * results, unsigned int req_id,
+                   adv_bench_complete_t complete);
+int adv_bench_load(void);
+
+#endif // _ADV_BENCH_H
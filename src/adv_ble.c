@@ -8,7 +8,9 @@
 #include <limits.h>
 #include "nrf_warn_enter.h"
 #include "app_error.h"
+#include "app_scheduler.h"
 #include "app_timer.h"
+#include "app_util_platform.h"
 #include "ble.h"
 #include "ble_advdata.h"
 #include "ble_advertising.h"
@@ -26,38 +28,206 @@
 #include "nrf_ble_gatt.h"
 #include "nrf_warn_leave.h"
 #include "adv_ble.h"
+#ifdef ADV_BENCH
+#include "adv_bench.h"
+#endif // ADV_BENCH
 #include "adv_errors.h"
+#include "adv_power.h"
 #include "adv_trace.h"
 #include "adv_tools.h"
 
 
+//-----------------------------------------------------------------------------
+// Configuration
+//-----------------------------------------------------------------------------
+
+// define to stream traces through the trace characteristic from boot up,
+// rather than once a client subscribes to it; usually defined from the build
+// system (TRACE_BLE)
+//#define ADV_TRACE_BLE
+// define to advertise with Bluetooth 5 extended advertising PDUs, which carry
+// the telemetry record in a larger payload on the secondary advertising
+// channel; usually defined from the build system (ADV_EXTENDED)
+//#define ADV_BLE_EXTENDED
+// define to process BLE events from the application scheduler, in thread
+// mode, rather than from the SoftDevice event interrupt handler
+#define ADV_BLE_EVT_SCHED
+
 //-----------------------------------------------------------------------------
 // Constants
 //-----------------------------------------------------------------------------
 
 /// @todo for production usage, these values need to be tailored
 
-/** BLE TX power */
+/** BLE TX power, while advertising at a fast pace */
 #define ADV_BLE_TX_POWER         4 // dBm
+/** BLE TX power, while advertising at a slow pace */
+#define ADV_BLE_TX_POWER_LOW     0 // dBm
 /** Delay after disconnection to enter sleep mode (& advertise @ slow pace) */
 #define ADV_BLE_SLEEP_DELAY_S    3600  // 1 hour
-/** Delay between each background work session in disconnected mode */
-#define ADV_BLE_WORKER_PACE_S    5  // seconds
+/**
+ * Longest worker engine timer delay, as app_timer timeouts cannot exceed
+ * half of its counter range (512 s); only used for farther deadlines
+ */
+#define ADV_BLE_WORKER_SLEEP_MAX_S 256U  // seconds
+/** Delay between two trace statistics reports */
+#define ADV_BLE_TRACE_STATS_PACE_S 3600U  // 1 hour
+#ifdef ADV_BLE_EXTENDED
+/** Delay between two telemetry record refreshes */
+#define ADV_BLE_TELEMETRY_PACE_S   30U  // seconds
+#endif // ADV_BLE_EXTENDED
+#ifdef ADV_BENCH
+/** Delay between two benchmark worker loads */
+#define ADV_BLE_BENCH_PACE_S       1U  // seconds
+#endif // ADV_BENCH
 /** Delay without real BLE activity, after which a connection is closed */
 #define ADV_BLE_STALL_DELAY_S    120  // seconds
+/**
+ * Delay without BLE activity, after which a link moves from the burst to the
+ * idle connection parameter profile
+ */
+#define ADV_BLE_CONN_IDLE_DELAY_S 10U  // seconds
 /** Maximum delay for a command to execute. BLE core specs is 30s max */
 #define PB_BLE_COMMAND_DELAY_S  10 // seconds
 /// @todo enforce this w/ the worker thread to reboot on too long a completion
 
 #define ADV_CHAR_UUID_BASE 0x1001
 
+/** Longest advertising run, as the SoftDevice duration is a 16-bit value */
+#define ADV_BLE_ADV_RUN_MAX_S    600U // seconds
+/** Highest connection demand level, see adv_ble_adv_policy */
+#define ADV_BLE_ADV_DEMAND_MAX   3U
+/** Ladder step used for on-demand advertising bursts */
+#define ADV_BLE_ADV_STEP_BURST   0U
+/** Ladder step used on start up and after disconnection */
+#define ADV_BLE_ADV_STEP_FIRST   1U
+
+#ifdef ADV_BLE_EXTENDED
+/**
+ * Secondary advertising channel PHY. 2M PHY halves the air time, but is
+ * not supported by all scanners; coded PHY is not available on nRF52832.
+ */
+#define ADV_BLE_EXT_SECONDARY_PHY BLE_GAP_PHY_1MBPS
+/** Advertising data size */
+#define ADV_BLE_ADV_DATA_SIZE \
+   BLE_GAP_ADV_SET_DATA_SIZE_EXTENDED_MAX_SUPPORTED
+#else // ADV_BLE_EXTENDED
+/** Advertising data size */
+#define ADV_BLE_ADV_DATA_SIZE    BLE_GAP_ADV_SET_DATA_SIZE_MAX
+#endif // !ADV_BLE_EXTENDED
+
+/** Maximum count of pending (deferred or queued) attribute requests */
+#define ADV_BLE_REQUEST_COUNT    4U
+/** Request identifier generation range, so that identifiers fit a byte */
+#define ADV_BLE_REQUEST_GEN_MAX  ((UINT8_MAX / ADV_BLE_REQUEST_COUNT) - 1U)
+/** ATT MTU, the largest one a single LL packet may carry w/ DLE */
+#define ADV_BLE_ATT_MTU          247U
+/** ATT notification header: opcode and handle */
+#define ADV_BLE_ATT_HVN_HEADER   3U
+/** LL data length, an ATT MTU PDU and its L2CAP header */
+#define ADV_BLE_DATA_LENGTH      (ADV_BLE_ATT_MTU + 4U)
+/** Bulk characteristic chunk size */
+#define ADV_BLE_BULK_SIZE        (ADV_BLE_ATT_MTU - ADV_BLE_ATT_HVN_HEADER)
+/** Connection event length, in 1.25 ms units, for several PDUs per event */
+#define ADV_BLE_GAP_EVENT_LENGTH 6U
+/** SoftDevice notification TX queue size, per connection */
+#define ADV_BLE_HVN_QUEUE_SIZE   8U
+/** Connection configuration tag for the above link settings */
+#define ADV_BLE_CONN_CFG_TAG     1U
+/**
+ * Count of concurrent peripheral links, so that a gateway and a
+ * technician's phone may be connected at once. Each link increases the RAM
+ * the SoftDevice requires.
+ */
+#define ADV_BLE_PERIPH_LINK_COUNT 2U
+/** Count of vendor specific base UUIDs: all attributes share the service's */
+#define ADV_BLE_VS_UUID_COUNT    1U
+
+/**
+ * Estimated SoftDevice attribute table cost of an attribute handle: UUID,
+ * permission and value location records, excluding values stored in the
+ * stack.
+ */
+#define ADV_BLE_ATTR_TAB_HANDLE_COST  20U
+/**
+ * Handles of the SoftDevice built-in services: GAP (device name,
+ * appearance, PPCP, central address resolution) and GATT (service changed)
+ */
+#define ADV_BLE_ATTR_TAB_SD_HANDLES   13U
+/** Values of the SoftDevice built-in services stored in the stack */
+#define ADV_BLE_ATTR_TAB_SD_VALUES    (BLE_GAP_DEVNAME_DEFAULT_LEN + 17U)
+/** Count of Device Information Service characteristics */
+#define ADV_BLE_DIS_CHAR_COUNT        5U
+/** Handles of the Device Information Service: declaration and value */
+#define ADV_BLE_ATTR_TAB_DIS_HANDLES  (1U + 2U * ADV_BLE_DIS_CHAR_COUNT)
+/** Values of the Device Information Service, all stored in the stack */
+#define ADV_BLE_ATTR_TAB_DIS_VALUES \
+   (ZARRAY_SIZE(MANUFACTURER_NAME) + ZARRAY_SIZE(MODEL_NUMBER) + \
+    ZARRAY_SIZE(HW_VERSION_TEMPLATE) + ZARRAY_SIZE(FW_VERSION_TEMPLATE) + \
+    ZARRAY_SIZE(ADV_SW_VERSION))
+/** Safety margin for the attribute table estimation */
+#define ADV_BLE_ATTR_TAB_MARGIN       128U
+/**
+ * Attribute table size, derived from the actual GATT table: built-in
+ * services, DIS and the PowerAdvertiser service, whose CCCD values are
+ * the only ones stored in the stack. It should be a multiple of 4 bytes.
+ */
+#define ADV_BLE_ATTR_TAB_SIZE \
+   ((MAX((uint32_t)BLE_GATTS_ATTR_TAB_SIZE_MIN, \
+         ((ADV_BLE_ATTR_TAB_SD_HANDLES + ADV_BLE_ATTR_TAB_DIS_HANDLES + \
+           ADV_HANDLE_COUNT) * ADV_BLE_ATTR_TAB_HANDLE_COST) + \
+         ADV_BLE_ATTR_TAB_SD_VALUES + ADV_BLE_ATTR_TAB_DIS_VALUES + \
+         (ADV_CCCD_COUNT * BLE_CCCD_VALUE_LEN) + \
+         ADV_BLE_ATTR_TAB_MARGIN) + 3U) & ~3U)
+
+#ifdef ADV_BLE_EVT_SCHED
+/**
+ * BLE event slot size, which fits any event but the ones that carry ATT
+ * data; those span several consecutive slots
+ */
+#define ADV_BLE_EVT_SLOT_SIZE    ((sizeof(ble_evt_t) + 3U) & ~3U)
+/** Count of slots a BLE event of the specified length spans */
+#define ADV_BLE_EVT_SLOT_SPAN(_len_) \
+   (((_len_) + ADV_BLE_EVT_SLOT_SIZE - 1U) / ADV_BLE_EVT_SLOT_SIZE)
+/** Count of slots the longest BLE event, with the largest ATT MTU, spans */
+#define ADV_BLE_EVT_SLOT_SPAN_MAX \
+   ADV_BLE_EVT_SLOT_SPAN(BLE_EVT_LEN_MAX(ADV_BLE_ATT_MTU))
+/**
+ * Events a link may raise before the scheduler runs, besides ATT requests
+ * and notification completions: connection, connection parameter update,
+ * PHY and data length update requests and updates, missing system
+ * attributes, queued write memory request and release, and disconnection
+ */
+#define ADV_BLE_EVT_LINK_PROCEDURES 10U
+/** Events that are not related to a link: advertising timeout and end */
+#define ADV_BLE_EVT_ADV_COUNT    2U
+/**
+ * Worst case count of slots in use.
+ * A client waits for the response to its ATT request before sending the
+ * next one, and no attribute accepts write commands, so a link has a single
+ * pending ATT request but for CCCD writes, which the SoftDevice answers on
+ * its own. Each queued notification is completed at most once.
+ */
+#define ADV_BLE_EVT_SLOT_BURST \
+   ((ADV_BLE_PERIPH_LINK_COUNT * \
+     (ADV_BLE_EVT_SLOT_SPAN_MAX + ADV_CCCD_COUNT + ADV_BLE_HVN_QUEUE_SIZE + \
+      ADV_BLE_EVT_LINK_PROCEDURES)) + ADV_BLE_EVT_ADV_COUNT)
+/** Count of BLE event slots, which should cover ADV_BLE_EVT_SLOT_BURST */
+#define ADV_BLE_EVT_SLOT_COUNT   64U
+#endif // ADV_BLE_EVT_SCHED
+/** Size of the user memory block for queued (long/reliable) writes */
+#define ADV_BLE_QWR_SIZE         512U
+/** Queued write header in user memory block: handle, offset, length */
+#define ADV_BLE_QWR_HEADER_SIZE  (3U * sizeof(uint16_t))
+
 /** Reply when unsupported features are requested. */
 #define APP_FEATURE_NOT_SUPPORTED (BLE_GATT_STATUS_ATTERR_APP_BEGIN + 2)
 
 /// @todo use proper values
 #define MANUFACTURER_NAME      "Iroazh"
 #define MANUFACTURER_ID        0x0006 // use M$ for now >:)
-#define INFO_VERSION           0x1 /** Format version 1 */
+#define INFO_VERSION           0x1 /** Format version 1, see adv_ble_adv_info */
+#define INFO_VERSION_EXT       0x2 /** Format version 2, telemetry record */
 #define MODEL_NUMBER           "Advertiser"
 #define DEVICE_NAME_STR        "Adv" // keep it *very* short
 #define HW_VERSION_TEMPLATE    "M.v.r-w" // only one decimal digit for v & r
@@ -70,17 +240,41 @@
 #define NORDIC_COMPANY_ID      0x0059U
 #define NORDIC_SD_OFFSET       100U
 
+#if defined(NRF_SDH_BLE_PERIPHERAL_LINK_COUNT) && \
+   (NRF_SDH_BLE_PERIPHERAL_LINK_COUNT < ADV_BLE_PERIPH_LINK_COUNT)
+// SDK modules (GATT, connection state) size their per-link tables from it
+#error "sdk_config NRF_SDH_BLE_PERIPHERAL_LINK_COUNT is too small"
+#endif
+
 //-----------------------------------------------------------------------------
 // Macros
 //-----------------------------------------------------------------------------
 
 #define BLE_MAKE_ATTR_DESC(_s_) { .ad_str = (_s_), .ad_size = ZARRAY_SIZE(_s_) }
 
-#define BLE_CHAR_RWN_PROP {.read = 1, .write = 1, .notify = 1}
-#define BLE_CHAR_RW_PROP  {.read = 1, .write = 1, .notify = 0}
-#define BLE_CHAR_RN_PROP  {.read = 1, .write = 0, .notify = 1}
-#define BLE_CHAR_R_PROP   {.read = 1, .write = 0, .notify = 0}
-#define BLE_CHAR_W_PROP   {.read = 0, .write = 1, .notify = 0}
+/** Characteristic property flags, as used in #ADV_BLE_ATTRIBUTES */
+#define BLE_CHAR_READ     (1U << 0)
+#define BLE_CHAR_WRITE    (1U << 1)
+#define BLE_CHAR_NOTIFY   (1U << 2)
+
+#define BLE_CHAR_RWN_PROP (BLE_CHAR_READ | BLE_CHAR_WRITE | BLE_CHAR_NOTIFY)
+#define BLE_CHAR_RW_PROP  (BLE_CHAR_READ | BLE_CHAR_WRITE)
+#define BLE_CHAR_RN_PROP  (BLE_CHAR_READ | BLE_CHAR_NOTIFY)
+#define BLE_CHAR_R_PROP   (BLE_CHAR_READ)
+#define BLE_CHAR_W_PROP   (BLE_CHAR_WRITE)
+#define BLE_CHAR_N_PROP   (BLE_CHAR_NOTIFY)
+
+/** Build a SoftDevice characteristic property record from property flags */
+#define BLE_MAKE_CHAR_PROPS(_p_) { \
+   .read = !!((_p_) & BLE_CHAR_READ), \
+   .write = !!((_p_) & BLE_CHAR_WRITE), \
+   .notify = !!((_p_) & BLE_CHAR_NOTIFY) }
+
+/**
+ * Count of attribute handles the SoftDevice allocates for a characteristic:
+ * declaration, value, CCCD if notifiable, and user description.
+ */
+#define BLE_CHAR_HANDLE_COUNT(_p_) (3U + !!((_p_) & BLE_CHAR_NOTIFY))
 
 /** syntactic sugar to access a BLE attribute storage location */
 #define ADV_BLE_VAR(_var_, _mbr_) \
@@ -102,24 +296,108 @@
 //-----------------------------------------------------------------------------
 
 /**
- * PowerAdvertiser BLE attributes for service ADV_SERVICE_UUID
+ * PowerAdvertiser BLE attributes for service ADV_SERVICE_UUID, in GATT table
+ * order. This list is the single definition of the service: the attribute
+ * enumeration, the attribute table and the handle map are generated from it.
+ *
+ * _X_(attribute, metadata, storage member, properties, reader, writer,
+ *     description, variable size)
  *
  * @note remember that UUID values have a +1 offset (e.g. ADV_ERROR is 0x1001)
  */
+#define ADV_BLE_ATTRIBUTES(_X_) \
+   /* 00: Last error code */ \
+   _X_(ADV_ERROR, _ADV_ROD_ATTR_MD, pv_error, BLE_CHAR_RN_PROP, \
+       NULL, NULL, "error", false) \
+   /* 01: Bulk data stream, notification only */ \
+   _X_(ADV_BULK, _ADV_STREAM_ATTR_MD, pv_bulk, BLE_CHAR_N_PROP, \
+       NULL, NULL, "bulk", true) \
+   /* 02: Trace stream, notification only */ \
+   _X_(ADV_TRACE, _ADV_STREAM_ATTR_MD, pv_trace, BLE_CHAR_N_PROP, \
+       NULL, NULL, "trace", true) \
+   /* 03: Power statistics */ \
+   _X_(ADV_POWER, _ADV_ROD_ATTR_MD, pv_power, BLE_CHAR_R_PROP, \
+       _adv_ble_power_reader, NULL, "power", false) \
+   /* 04: Trace control commands (write) and status (read); settings */ \
+   /*     survive a reset, but not a power cycle (.noinit RAM) */ \
+   _X_(ADV_TRACE_CTRL, _ADV_RWV_ATTR_MD, pv_trace_ctrl, BLE_CHAR_RW_PROP, \
+       _adv_ble_trace_ctrl_reader, _adv_ble_trace_ctrl_writer, "tracectl", \
+       true) \
+   ADV_BLE_BENCH_ATTRIBUTES(_X_)
+
+#ifdef ADV_BENCH
+/** Benchmark firmware attributes, appended to the service */
+#define ADV_BLE_BENCH_ATTRIBUTES(_X_) \
+   /* 05: Benchmark configuration (write) and results (read) */ \
+   _X_(ADV_DIAG, _ADV_RWV_ATTR_MD, pv_diag, BLE_CHAR_RW_PROP, \
+       _adv_ble_diag_reader, _adv_ble_diag_writer, "diag", true)
+#else // ADV_BENCH
+#define ADV_BLE_BENCH_ATTRIBUTES(_X_)
+#endif // !ADV_BENCH
+
 enum adv_ble_attr {
-   ADV_ERROR,       /**< 00: Last error code */
-   ADV_COUNT,       /**< 0f: (watermark) */
+   #define _ADV_BLE_ATTR_ENUM(_attr_, ...) _attr_,
+   ADV_BLE_ATTRIBUTES(_ADV_BLE_ATTR_ENUM)
+   #undef _ADV_BLE_ATTR_ENUM
+   ADV_COUNT,       /**< (watermark) */
+};
+
+/**
+ * Attribute handle offsets from the service declaration handle.
+ * The SoftDevice allocates the handles of a service sequentially, in the
+ * order the characteristics are added, so they are known at build time.
+ */
+enum adv_ble_attr_handle {
+   ADV_HANDLE_SERVICE,  /**< Service declaration */
+   #define _ADV_BLE_ATTR_HANDLE(_attr_, _md_, _var_, _props_, ...) \
+      _attr_##_HANDLE_DECL, \
+      _attr_##_HANDLE_VALUE, \
+      _attr_##_HANDLE_LAST = _attr_##_HANDLE_DECL + \
+                             BLE_CHAR_HANDLE_COUNT(_props_) - 1,
+   ADV_BLE_ATTRIBUTES(_ADV_BLE_ATTR_HANDLE)
+   #undef _ADV_BLE_ATTR_HANDLE
+   ADV_HANDLE_COUNT,    /**< Count of handles in service (watermark) */
 };
 
+/** Count of client characteristic configuration descriptors in service */
+enum {
+   ADV_CCCD_COUNT = 0
+   #define _ADV_BLE_ATTR_CCCD(_attr_, _md_, _var_, _props_, ...) \
+      + !!((_props_) & BLE_CHAR_NOTIFY)
+   ADV_BLE_ATTRIBUTES(_ADV_BLE_ATTR_CCCD)
+   #undef _ADV_BLE_ATTR_CCCD
+};
+
+// handle map entries are stored as uint8_t, with one spare value
+ASSERT_COMPILE(ADV_COUNT < UINT8_MAX);
+// per-link notification states are stored as attribute bitmasks
+ASSERT_COMPILE(ADV_COUNT <= 32U);
+// links with a full TX queue are tracked as a link bitmask while pumping
+ASSERT_COMPILE(ADV_BLE_PERIPH_LINK_COUNT <= 32U);
+
 #define ADV_FIRST   (0)
 #define ADV_LAST    (ADV_COUNT)
 
 /** Background worker */
 enum adv_ble_background_worker {
+   BW_TRACE_STATS, /**< Trace statistics report */
+#ifdef ADV_BLE_EXTENDED
+   BW_TELEMETRY,  /**< Telemetry record refresh */
+#endif // ADV_BLE_EXTENDED
+#ifdef ADV_BENCH
+   BW_BENCH,      /**< Benchmark load */
+#endif // ADV_BENCH
    BW_COUNT,      /**< Watermark */
 };
 
-/** ADV_ERROR format: Error reporting record */
+/**
+ * ADV_ERROR format: Error reporting record.
+ * A fault of the previous run is reported as #PE_FAULT, with no attribute
+ * (#ADV_COUNT), the low byte of the error code as the state, the fault
+ * identifier as the component (0x01: SoftDevice assert, 0x02: memory access,
+ * 0x41: SDK error, 0x42: SDK assert, 0xff: unknown fault), and the program
+ * counter as the payload.
+ */
 struct pa_error_desc {
    int8_t  pe_errno; /**< Errno code, see pa_errors.h */
    uint8_t pe_attr;  /**< Attribute as adv_ble_attr */
@@ -152,7 +430,8 @@ struct adv_ble_nordic_sd_version {
  * wisely so that all info (not limited to this record) fit into a single
  * BLE payload.
  * Be also very careful with item alignment, as this structure is mem copied
- * as is.
+ * as is. Any layout change should bump INFO_VERSION, as scanners rely on it
+ * to decode the record.
  */
 struct adv_ble_adv_info {
    uint8_t ai_version;  /** Version of record, for compatility purpose */
@@ -164,12 +443,72 @@ struct adv_ble_adv_info {
 
 ASSERT_COMPILE(sizeof(struct adv_ble_adv_info) == 3U);
 
+/**
+ * Telemetry record, broadcast in place of adv_ble_adv_info with extended
+ * advertising. The leading info record is kept as is, with INFO_VERSION_EXT
+ * as its version, so that legacy decoders may still use it.
+ * Same care as for adv_ble_adv_info applies regarding item alignment.
+ */
+struct adv_ble_adv_telemetry {
+   struct adv_ble_adv_info at_info; /**< Info record */
+   uint8_t at_adv_step;     /**< Current advertising ladder step */
+   uint32_t at_uptime;      /**< Worker engine time, in seconds */
+   uint16_t at_conn_count;  /**< Count of connections since start up */
+   uint8_t at_demand;       /**< Connection demand level */
+   uint8_t at_flags;        /**< Status bitfield, see adv_ble_telemetry_flag */
+};
+
+ASSERT_COMPILE(sizeof(struct adv_ble_adv_telemetry) == 12U);
+
+/** Telemetry status flags */
+enum adv_ble_telemetry_flag {
+   ADV_BLE_TELEMETRY_SLEEP = 1U << 0, /**< Entering sleep mode */
+   ADV_BLE_TELEMETRY_TRACE = 1U << 1, /**< Trace stream attached */
+};
+
 /** BLE attribute physical container */
 struct adv_ble_var {
    struct pa_error_desc pv_error;  /**< Last error description */
-   uint8_t pv_transient[16];   /**< Transcient storage for deferred events */
+   uint8_t pv_bulk[ADV_BLE_BULK_SIZE]; /**< Bulk stream chunk */
+   uint8_t pv_trace[ADV_BLE_BULK_SIZE]; /**< Trace stream chunk */
+   struct adv_power_stats pv_power; /**< Power statistics */
+   /** Trace control status, or commands once written */
+   struct pa_trace_control pv_trace_ctrl;
+#ifdef ADV_BENCH
+   /** Benchmark results, or configuration once written */
+   struct adv_bench_results pv_diag;
+#endif // ADV_BENCH
+   /** User memory block for queued writes, lent to the SoftDevice */
+   uint8_t pv_qwr[ADV_BLE_QWR_SIZE] ALIGN_UINT32;
+};
+
+/**
+ * Transient storage of a pending attribute request, which receives the
+ * written value: it fits the storage of any writable attribute.
+ */
+union adv_ble_transient {
+   #define _ADV_BLE_ATTR_TRANSIENT(_attr_, _md_, _var_, _props_, ...) \
+      uint8_t _attr_##_VALUE[((_props_) & BLE_CHAR_WRITE) ? \
+                             SIZEOF_MEMBER(struct adv_ble_var, _var_) : 1U];
+   ADV_BLE_ATTRIBUTES(_ADV_BLE_ATTR_TRANSIENT)
+   #undef _ADV_BLE_ATTR_TRANSIENT
+   uint8_t tr_bytes[1]; /**< Raw storage */
+   uint32_t tr_align; /**< Word alignment */
 };
 
+/** Transient storage size, for each pending attribute request */
+#define ADV_BLE_TRANSIENT_SIZE   sizeof(union adv_ble_transient)
+
+// a write request is copied as a whole into its transient storage
+#define _ADV_BLE_ATTR_TRANSIENT_CHECK(_attr_, _md_, _var_, _props_, ...) \
+   ASSERT_COMPILE(! ((_props_) & BLE_CHAR_WRITE) || \
+                  (SIZEOF_MEMBER(struct adv_ble_var, _var_) <= \
+                   ADV_BLE_TRANSIENT_SIZE));
+ADV_BLE_ATTRIBUTES(_ADV_BLE_ATTR_TRANSIENT_CHECK)
+#undef _ADV_BLE_ATTR_TRANSIENT_CHECK
+// the trace control commands are written in a single request
+ASSERT_COMPILE(ADV_BLE_TRANSIENT_SIZE >= sizeof(struct pa_trace_control));
+
 // forward declarations
 struct adv_ble;
 struct adv_ble_attribute;
@@ -179,22 +518,34 @@ struct adv_ble_attribute;
  * Whenever a PowerAdvertiser-specific BLE attribute is written from the
  * peer, such a method is run to check if the parameters are valid and if the
  * PowerAdvertiser may serve such a request, and eventually handle the change.
+ *
+ * A writer that returns @c PE_DEFERRED should later complete the request with
+ * its identifier, see #_adv_ble_complete_write_req.
  */
-typedef int (* adv_ble_attr_writer_t)(const uint8_t * buf, size_t length);
+typedef int (* adv_ble_attr_writer_t)(const uint8_t * buf, size_t length,
+                                      unsigned int req_id);
 
 /**
  * Attribute reader signature.
  * Whenever a PowerAdvertiser-specific BLE attribute is read from the
  * peer, such a method is run to validate and eventually compute the on-demand
  * value.
+ *
+ * A reader that returns @c PE_DEFERRED should later complete the request with
+ * its identifier, see #_adv_ble_complete_read_req.
  */
-typedef int (* adv_ble_attr_reader_t)(struct adv_ble_attribute * pa_attr);
+typedef int (* adv_ble_attr_reader_t)(struct adv_ble_attribute * pa_attr,
+                                      unsigned int req_id);
 
 /** Callback a worker should invoke on completion */
 typedef void (*adv_ble_worker_cb_t)(void);
 
-/** Worker routine signature */
-typedef int (*adv_ble_worker_func_t)(void);
+/**
+ * Worker routine signature.
+ * A worker that returns @c PE_DEFERRED should later invoke the completion
+ * callback, from the application scheduler thread, to chain the next worker
+ */
+typedef int (*adv_ble_worker_func_t)(adv_ble_worker_cb_t complete);
 
 /** BLE attribute user description */
 struct ble_attr_desc {
@@ -218,6 +569,8 @@ struct adv_ble_attribute {
    ble_gatts_char_handles_t          pa_handles;
    /** Attribute properties */
    const ble_gatt_char_props_t       pa_props;
+   /** Value handle offset from the service handle */
+   const uint8_t                     pa_offset;
    /** Reader method, if any, for on-demand readable attribute */
    const adv_ble_attr_reader_t        pa_reader;
    /** Writer method, if any, for writable attribute */
@@ -241,41 +594,220 @@ struct adv_ble_worker {
    adv_ble_worker_func_t bw_func; /**< Worker routine */
 };
 
+/** Background worker execution statistics, in app_timer ticks */
+struct adv_ble_worker_stats {
+   uint32_t ws_runs;               /**< Count of executions */
+   uint32_t ws_last;               /**< Duration of the last execution */
+   uint32_t ws_max;                /**< Longest execution */
+};
+
 /** Worker execution engine */
 struct adv_ble_worker_engine {
    bool we_enable;                 /**< @c false to prevent any execution */
    bool we_running;                /**< @c false when no worker is executing */
    unsigned int we_time;           /**< Current engine time, in seconds */
-   unsigned int we_last_time;      /**< Last active BLE communication time */
    unsigned int we_worker_ix;      /**< Current worker index */
+   uint32_t we_tick;               /**< Time base counter at last clock sync */
+   uint32_t we_subsec;             /**< Time base ticks not yet in we_time */
+   uint32_t we_run_start;          /**< app_timer counter at worker start */
+   unsigned int we_due[BW_COUNT];  /**< Next execution time of each worker */
+   /** Execution statistics of each worker */
+   struct adv_ble_worker_stats we_stats[BW_COUNT];
    app_timer_id_t we_timer_id;     /**< Timer API */
    app_timer_t we_timer;           /**< Timer instance */
    // local worker storage area
    uint8_t we_bat_soc;             /**< Transcient battery SoC */
 };
 
-/** Record for delayed attribute writer completion */
+#ifdef ADV_BLE_EVT_SCHED
+/**
+ * BLE events handed over to the application scheduler.
+ * Events are copied once into consecutive slots, and processed in order
+ * from a single scheduler event, which is only queued when the first
+ * pending event is captured. An event that starts in one of the last slots
+ * runs on into the trailing slots rather than wrapping around, so that it
+ * is always contiguous.
+ */
+struct adv_ble_evt_queue {
+   /** Event slots, and trailing slots for the end of the last events */
+   uint32_t eq_slots[ADV_BLE_EVT_SLOT_COUNT + ADV_BLE_EVT_SLOT_SPAN_MAX - 1U]
+                    [ADV_BLE_EVT_SLOT_SIZE / sizeof(uint32_t)];
+   volatile uint16_t eq_write; /**< Count of captured slots */
+   volatile uint16_t eq_read;  /**< Count of released slots */
+};
+
+// slot indices are free running counters
+ASSERT_COMPILE((ADV_BLE_EVT_SLOT_COUNT & (ADV_BLE_EVT_SLOT_COUNT - 1U)) == 0U);
+ASSERT_COMPILE(ADV_BLE_EVT_SLOT_BURST <= ADV_BLE_EVT_SLOT_COUNT);
+#endif // ADV_BLE_EVT_SCHED
+
+/** Advertising interval ladder step */
+struct adv_ble_adv_step {
+   uint16_t as_interval; /**< Advertising interval, in 0.625 ms units */
+   uint16_t as_period;   /**< Step duration in seconds, 0 for unlimited */
+   int8_t as_tx_power;   /**< BLE TX power, in dBm */
+   bool as_sleep;        /**< Enter sleep mode when the step starts */
+};
+
+/**
+ * Advertising policy.
+ * The ladder is walked down, toward slower advertising, each time a step
+ * elapses without any connection. Connection demand, which rises on each
+ * connection and decays each time the ladder bottom is reached, stretches
+ * the step periods, so that a device in use keeps advertising fast.
+ */
+struct adv_ble_adv_policy {
+   unsigned int ap_step;    /**< Current ladder step */
+   uint32_t ap_elapsed;     /**< Advertising time spent in step, in seconds */
+   uint32_t ap_run;         /**< Duration of the current run, in seconds */
+   unsigned int ap_demand;  /**< Connection demand level */
+};
+
+/** Advertising information fields, tracked for payload updates */
+enum adv_ble_adv_field {
+   ADV_BLE_ADV_ALERT = 1U << 0, /**< Alert bitfield */
+   ADV_BLE_ADV_SOC = 1U << 1,   /**< State of charge */
+   ADV_BLE_ADV_TELEMETRY = 1U << 2, /**< Telemetry counters */
+};
+
+/** Advertising payload updater */
+struct adv_ble_adv_updater {
+   /** Double-buffered encoded advertising data */
+   uint8_t au_adv[2][ADV_BLE_ADV_DATA_SIZE];
+   /** Double-buffered encoded scan response data */
+   uint8_t au_srsp[2][BLE_GAP_ADV_SET_DATA_SIZE_MAX];
+   unsigned int au_bank;       /**< Next buffer bank to encode into */
+   unsigned int au_dirty;      /**< Fields not yet pushed, adv_ble_adv_field */
+   bool au_holdoff;            /**< A payload has been pushed recently */
+   uint32_t au_updates;        /**< Count of pushed payloads */
+   app_timer_id_t au_timer_id; /**< Timer API */
+   app_timer_t au_timer;       /**< Timer instance */
+};
+
+/** Pending attribute request type */
+enum adv_ble_req_op {
+   ADV_BLE_REQ_WRITE = 1, /**< Write request */
+   ADV_BLE_REQ_READ,      /**< Read request */
+};
+
+/** Record for delayed attribute request completion */
 struct adv_ble_attr_event {
-   const uint8_t * ae_data; /**< Write event data buffer */
+   const uint8_t * ae_data; /**< Write event data, in transient storage */
    uint16_t ae_length;      /**< Write event data size */
    uint16_t ae_offset;      /**< Write event data offset */
-   struct adv_ble_attribute * ae_attr; /**< Write event destination attribute */
+   struct adv_ble_attribute * ae_attr; /**< Event destination attribute */
+   uint16_t ae_conn_handle; /**< Connection to reply to */
+   uint8_t ae_id;           /**< Request identifier, 0 if record is free */
+   uint8_t ae_op;           /**< Request type, as adv_ble_req_op */
+   bool ae_waiting;         /**< Waiting for a request on same attribute */
+   bool ae_queued;          /**< Executes queued writes (long write) */
+   uint32_t ae_seq;         /**< Arrival sequence, for per-attr ordering */
+};
+
+/** Notification streams, in decreasing priority order */
+enum adv_ble_stream_id {
+   ADV_BLE_STREAM_BULK,   /**< Bulk data stream */
+   ADV_BLE_STREAM_TRACE,  /**< Trace stream */
+   ADV_BLE_STREAM_COUNT,  /**< (watermark) */
+};
+
+/** Notification stream, through a notification only characteristic */
+struct adv_ble_stream {
+   enum adv_ble_attr bs_attr; /**< Stream characteristic */
+   adv_ble_bulk_source_t bs_source; /**< Stream source, if any */
+   uint16_t bs_length;   /**< Pending chunk size, not yet queued */
+   uint32_t bs_bytes;    /**< Count of bytes queued for the stream */
+   /** Link that has enabled notifications, if any */
+   uint16_t bs_conn_handle;
+};
+
+/**
+ * Connection parameter profiles, see _ADV_BLE_CONN_PROFILES.
+ * A link starts with the burst profile, which is the preferred one.
+ */
+enum adv_ble_conn_profile {
+   ADV_BLE_CONN_BURST,     /**< Short interval, while the link is in use */
+   ADV_BLE_CONN_IDLE,      /**< Long interval and latency, for idle links */
+   ADV_BLE_CONN_PROFILE_COUNT, /**< (watermark) */
+};
+
+/** Peripheral link context */
+struct adv_ble_link {
+   /** Connection handle, @c BLE_CONN_HANDLE_INVALID if the link is free */
+   uint16_t bl_conn_handle;
+   /** Effective ATT MTU */
+   uint16_t bl_mtu;
+   /** Last activity time, in worker engine time, for the stall watchdog */
+   unsigned int bl_last_time;
+   /** Attributes the peer has enabled notifications for, as a bitmask */
+   uint32_t bl_notify_enabled;
+   /** Attributes with a pending value notification, as a bitmask */
+   uint32_t bl_notify_pending;
+   /** Attributes notified during the current connection event */
+   uint32_t bl_notify_sent;
+   /** Last requested connection parameter profile */
+   uint8_t bl_profile;
+   /** Profiles the central has rejected, as a bitmask */
+   uint8_t bl_profile_refused;
+   /** Last activity time, in worker engine time, for the profile switch */
+   unsigned int bl_profile_time;
+};
+
+/** Trace queue chunk, owned by the BLE trace back-end */
+struct adv_ble_trace_chunk {
+   const uint8_t * tc_data; /**< Chunk bytes, @c NULL if no chunk */
+   size_t tc_length;        /**< Chunk size */
+   size_t tc_offset;        /**< Count of chunk bytes already streamed */
 };
 
 /** BLE PowerAdvertiser server engine */
 struct adv_ble {
    /** PowerAdvertiser service handle */
    uint16_t bp_service_handle;
+   /** Vendor specific UUID type of the PowerAdvertiser base UUID */
+   uint8_t bp_uuid_type;
    /** Marker to speed up client discovery */
    uint16_t bp_last_service_handle;
    /** GATT module instance */
    nrf_ble_gatt_t bp_gatt;
    /** PowerAdvertiser Attributes */
    struct adv_ble_attribute bp_attributes[ADV_COUNT];
-   /** Current client connexion, if any */
-   uint16_t bp_conn_handle;
-   /** Delayed attribute event completion */
-   struct adv_ble_attr_event bp_attr_event;
+   /** Peripheral links */
+   struct adv_ble_link bp_links[ADV_BLE_PERIPH_LINK_COUNT];
+   /** Count of connected links */
+   uint8_t bp_link_count;
+   /** Link of the BLE event being processed, if any */
+   struct adv_ble_link * bp_link;
+   /** Connection that owns the queued write memory block */
+   uint16_t bp_qwr_conn_handle;
+   /** Count of connections since start up */
+   uint16_t bp_conn_count;
+   /** Pending attribute requests */
+   struct adv_ble_attr_event bp_attr_events[ADV_BLE_REQUEST_COUNT];
+   /** Generation of the last allocated request identifier */
+   uint8_t bp_req_gen;
+   /** Arrival sequence of the next attribute request */
+   uint32_t bp_req_seq;
+   /** Queued write memory block, as lent to the SoftDevice */
+   ble_user_mem_block_t bp_qwr_block;
+   /** Whether the queued write memory block is lent to the SoftDevice */
+   bool bp_qwr_busy;
+   /** Value handle of the attribute targeted by current queued writes */
+   uint16_t bp_qwr_handle;
+   /** Notification streams */
+   struct adv_ble_stream bp_streams[ADV_BLE_STREAM_COUNT];
+   /** Application RAM start, as provided by the linker script */
+   uint32_t bp_app_ram_start;
+   /** Lowest application RAM start the SoftDevice accepts */
+   uint32_t bp_app_ram_min;
+   /** Notifications are being queued */
+   bool bp_pumping;
+   /** Queue notifications again once current pumping completes */
+   bool bp_pump_again;
+   /** Trace chunk being streamed */
+   struct adv_ble_trace_chunk bp_trace;
+   /** A pump of the trace stream is queued in the application scheduler */
+   bool bp_trace_scheduled;
    /** Timer to manage auto disconnection */
    struct adv_ble_timer bp_worker_timer;
    /** PowerAdvertiser is entering sleep and may accept no request */
@@ -291,19 +823,36 @@ struct adv_ble {
 //-----------------------------------------------------------------------------
 
 static void _adv_ble_stack_init(void);
+static void _adv_ble_version_init(void);
+#ifdef ADV_FAST_BOOT
+static void _adv_ble_late_init(void * data, uint16_t size);
+static void _adv_ble_dis_fw_version_update(void);
+#endif // ADV_FAST_BOOT
 static void _adv_ble_conn_init(void);
 static void _adv_ble_gap_init(void);
 static void _adv_ble_gatt_init(void);
+static void _adv_ble_gatt_evt_handler(nrf_ble_gatt_t * gatt,
+   nrf_ble_gatt_evt_t const * evt);
 static void _adv_ble_service_add(void);
 static void _adv_ble_dis_init(void);
 static void _adv_ble_advertising_init(void);
 static void _adv_ble_evt_handler(const ble_evt_t * ble_evt, void * context);
+static void _adv_ble_evt_process(const ble_evt_t * ble_evt,
+                                 struct adv_ble * blepn);
+#ifdef ADV_BLE_EVT_SCHED
+static void _adv_ble_evt_defer(const ble_evt_t * ble_evt);
+static void _adv_ble_evt_sched_handler(void * data, uint16_t size);
+#endif // ADV_BLE_EVT_SCHED
 static void _adv_ble_conn_evt(ble_conn_params_evt_t * ble_evt);
+static void _adv_ble_link_profile(struct adv_ble_link * link,
+                                  enum adv_ble_conn_profile profile);
+static bool _adv_ble_link_busy(const struct adv_ble * blepn,
+                               const struct adv_ble_link * link);
 static void _adv_ble_conn_error_handler(uint32_t nrf_error);
 static void _adv_ble_adv_event_handler(ble_adv_evt_t ble_adv_evt);
 static void _adv_ble_add_characteristics(struct adv_ble * blepn);
 static struct adv_ble_attribute * _adv_ble_retrieve_attribute(
-   enum adv_ble_attr * pa_char, struct adv_ble * blepn,
+   enum adv_ble_attr * pa_char, struct adv_ble * blepn, uint16_t handle,
    ble_uuid_t const * ble_uuid);
 static void _adv_ble_write_attr(struct adv_ble * blepn,
    const ble_gatts_evt_write_t * wr_evt);
@@ -312,27 +861,101 @@ static void _adv_ble_write_req(struct adv_ble * blepn,
 static void _adv_ble_read_req(struct adv_ble * blepn,
    const ble_gatts_evt_read_t * rd_evt);
 static int _adv_ble_write_attribute(struct adv_ble * blepn,
-   struct adv_ble_attribute * pa_attr, const ble_gatts_evt_write_t * wr_evt);
-static void _adv_ble_complete_write_req(int retcode);
-static void _adv_ble_complete_read_req(int retcode);
+   struct adv_ble_attr_event * event, const ble_gatts_evt_write_t * wr_evt);
+static void _adv_ble_prepare_write_req(struct adv_ble * blepn,
+   const ble_gatts_evt_write_t * wr_evt);
+static void _adv_ble_execute_write_req(struct adv_ble * blepn);
+static int _adv_ble_queued_write_attribute(struct adv_ble * blepn,
+   struct adv_ble_attr_event * event);
+static void _adv_ble_reply_write_status(struct adv_ble * blepn,
+   uint16_t gatt_status);
+static void _adv_ble_complete_write_req(unsigned int req_id, int retcode);
+static void _adv_ble_complete_read_req(unsigned int req_id, int retcode);
+static struct adv_ble_attr_event * _adv_ble_request_alloc(
+   struct adv_ble * blepn, enum adv_ble_req_op op,
+   struct adv_ble_attribute * pa_attr);
+static struct adv_ble_attr_event * _adv_ble_request_find(
+   struct adv_ble * blepn, unsigned int req_id, enum adv_ble_req_op op);
+static void _adv_ble_request_free(struct adv_ble_attr_event * event);
+static uint8_t * _adv_ble_request_transient(struct adv_ble * blepn,
+   const struct adv_ble_attr_event * event);
+static bool _adv_ble_request_is_blocked(struct adv_ble * blepn,
+   const struct adv_ble_attr_event * event);
+static void _adv_ble_request_next(struct adv_ble * blepn,
+   const struct adv_ble_attribute * pa_attr);
+static void _adv_ble_request_dispatch(struct adv_ble_attr_event * event);
+static void _adv_ble_reject_request(struct adv_ble * blepn, uint8_t type,
+   enum adv_ble_attr pa_char);
 static struct adv_ble_attribute * _adv_ble_set_error_on_attr(
    struct adv_ble * blepn, int errno, enum adv_ble_attr pa_char);
 static struct adv_ble_attribute * _adv_ble_get_attribute(
    struct adv_ble * blepn, enum adv_ble_attr pa_char);
-static void _adv_ble_handle_disconnect(struct adv_ble * blepn);
+static void _adv_ble_handle_disconnect(struct adv_ble * blepn,
+                                       struct adv_ble_link * link);
+static struct adv_ble_link * _adv_ble_link_find(struct adv_ble * blepn,
+                                                uint16_t conn_handle);
+static struct adv_ble_link * _adv_ble_link_open(struct adv_ble * blepn,
+                                                uint16_t conn_handle);
+static uint16_t _adv_ble_conn_handle(const struct adv_ble * blepn);
 
 static void _adv_ble_enter_sleep(struct adv_ble * blepn);
 static void _adv_ble_timer_create(void);
+static void _adv_ble_adv_policy_start(unsigned int step);
+static void _adv_ble_adv_policy_configure(struct adv_ble_adv_policy * ap);
+static void _adv_ble_adv_policy_idle(void);
+static void _adv_ble_adv_mark_dirty(unsigned int fields);
+#ifdef ADV_BLE_EXTENDED
+static void _adv_ble_adv_telemetry_refresh(void);
+#endif // ADV_BLE_EXTENDED
+static void _adv_ble_adv_push(struct adv_ble_adv_updater * au);
+static void _adv_ble_adv_holdoff_start(struct adv_ble_adv_updater * au);
+static void _adv_ble_adv_timer_cb(void * context);
 
 static void _adv_ble_worker_start(void);
 static void _adv_ble_worker_update_ble_status(bool active);
 static void _adv_ble_worker_timer_cb(void * context);
 static void _adv_ble_worker_feed(void);
 static void _adv_ble_worker_run_next(void);
+static void _adv_ble_worker_complete(void);
+static void _adv_ble_worker_clock(struct adv_ble_worker_engine * we);
+static void _adv_ble_worker_schedule(struct adv_ble_worker_engine * we);
+static void _adv_ble_worker_account(struct adv_ble_worker_engine * we,
+                                    unsigned int wix);
+static int _adv_ble_worker_trace_stats(adv_ble_worker_cb_t complete);
+#ifdef ADV_BLE_EXTENDED
+static int _adv_ble_worker_telemetry(adv_ble_worker_cb_t complete);
+#endif // ADV_BLE_EXTENDED
+static int _adv_ble_trace_ctrl_reader(struct adv_ble_attribute * pa_attr,
+                                      unsigned int req_id);
+static int _adv_ble_trace_ctrl_writer(const uint8_t * buf, size_t length,
+                                      unsigned int req_id);
+#ifdef ADV_BENCH
+static int _adv_ble_worker_bench(adv_ble_worker_cb_t complete);
+static int _adv_ble_diag_reader(struct adv_ble_attribute * pa_attr,
+                                 unsigned int req_id);
+static int _adv_ble_diag_writer(const uint8_t * buf, size_t length,
+                                 unsigned int req_id);
+#endif // ADV_BENCH
 
 static void _adv_ble_mac_addr_to_str(char * str, size_t length,
    const ble_gap_addr_t * addr);
-static void _adv_ble_disconnect(void);
+static void _adv_ble_disconnect(struct adv_ble_link * link);
+
+static int _adv_ble_publish(struct adv_ble * blepn, enum adv_ble_attr pa_char,
+                            const void * value, size_t length);
+static bool _adv_ble_notify_fill(struct adv_ble * blepn,
+                                 struct adv_ble_link * link);
+static void _adv_ble_stream_pump(struct adv_ble * blepn);
+static bool _adv_ble_stream_fill(struct adv_ble * blepn,
+   struct adv_ble_stream * stream);
+static void _adv_ble_stream_stop(struct adv_ble_stream * stream);
+static void _adv_ble_trace_attach(void);
+static int _adv_ble_trace_source(uint8_t * buf, size_t size);
+static int _adv_ble_power_reader(struct adv_ble_attribute * pa_attr,
+                                 unsigned int req_id);
+static int _adv_ble_trace_tx(const uint8_t * data, size_t length);
+static void _adv_ble_trace_sched_handler(void * data, uint16_t size);
+static void _adv_ble_trace_fatal(const uint8_t * data, size_t length);
 
 //-----------------------------------------------------------------------------
 // One-time initialized variables
@@ -400,6 +1023,18 @@ static const ble_uuid128_t ADV_UUID128 = {
    }
 };
 
+/**
+ * Attribute value handle map, indexed with the handle offset from the
+ * service handle. Entries are the attribute index plus one, zero stands for
+ * handles (declarations, descriptors) that are not PowerAdvertiser values.
+ */
+static const uint8_t _ADV_BLE_HANDLE_MAP[ADV_HANDLE_COUNT] = {
+   #define _ADV_BLE_ATTR_HMAP(_attr_, ...) \
+      [_attr_##_HANDLE_VALUE] = (uint8_t)((_attr_) + 1U),
+   ADV_BLE_ATTRIBUTES(_ADV_BLE_ATTR_HMAP)
+   #undef _ADV_BLE_ATTR_HMAP
+};
+
 // CCCD should always be writable by the client (SD fails otherwise)
 // "The Client Characteristic Configuration declaration is an optional
 //  characteristic descriptor that defines how the characteristic may
@@ -463,6 +1098,35 @@ static const ble_gatts_attr_md_t _ADV_ROD_ATTR_MD = {
    .rd_auth = 1,
 };
 
+/** BLE attribute metadata (notification only stream, variable length) */
+static const ble_gatts_attr_md_t _ADV_STREAM_ATTR_MD = {
+   .read_perm = { \
+      .sm = 0, .lv = 0, \
+      }, \
+   .write_perm = { \
+      .sm = 0, .lv = 0, \
+   }, \
+   .vlen = 1,
+   .vloc = BLE_GATTS_VLOC_USER,
+};
+
+/**
+ * BLE attribute metadata (readable with dynamic content/writable, variable
+ * length), whose written and read records differ
+ */
+static const ble_gatts_attr_md_t _ADV_RWV_ATTR_MD = {
+   .read_perm = { \
+      .sm = 1, .lv = 1, \
+      }, \
+   .write_perm = { \
+      .sm = 1, .lv = 1, \
+   }, \
+   .vlen = 1,
+   .vloc = BLE_GATTS_VLOC_USER,
+   .wr_auth = 1,
+   .rd_auth = 1,
+};
+
 #if 0
 /** BLE attribute metadata (readable with dynamic content/writable) */
 static const ble_gatts_attr_md_t _ADV_RWD_ATTR_MD = {
@@ -500,18 +1164,32 @@ static const ble_conn_params_init_t _CONN_PARAM_INIT = {
    .error_handler = &_adv_ble_conn_error_handler,
 };
 
-/** Connection parameters */
-static const ble_gap_conn_params_t _GAP_CONN_PARAMS = {
-   /** Minimum acceptable connection interval */
-   .min_conn_interval = (uint16_t)MSEC_TO_UNITS(7.5, UNIT_1_25_MS),
-   /** Maximum acceptable connection interval */
-   .max_conn_interval =  MSEC_TO_UNITS(15, UNIT_1_25_MS),
-   /** Slave latency. */
-   .slave_latency = 3,
-   /** Connection supervisory timeout. */
-   .conn_sup_timeout  = MSEC_TO_UNITS(2000, UNIT_10_MS),
+/**
+ * Connection parameter profiles.
+ * The supervision timeout should exceed twice the longest interval the slave
+ * latency allows the peripheral to skip: (1 + latency) * max interval * 2
+ */
+static const ble_gap_conn_params_t _ADV_BLE_CONN_PROFILES[] = {
+   [ADV_BLE_CONN_BURST] = {
+      // provisioning and bulk transfers: several exchanges per second
+      .min_conn_interval = (uint16_t)MSEC_TO_UNITS(7.5, UNIT_1_25_MS),
+      .max_conn_interval =  MSEC_TO_UNITS(15, UNIT_1_25_MS),
+      .slave_latency = 0,
+      .conn_sup_timeout  = MSEC_TO_UNITS(2000, UNIT_10_MS),
+   },
+   [ADV_BLE_CONN_IDLE] = {
+      // the peripheral wakes up every 2.5 seconds at most, it may still
+      // send notifications on any connection event
+      .min_conn_interval = MSEC_TO_UNITS(400, UNIT_1_25_MS),
+      .max_conn_interval = MSEC_TO_UNITS(500, UNIT_1_25_MS),
+      .slave_latency = 4,
+      .conn_sup_timeout  = MSEC_TO_UNITS(6000, UNIT_10_MS),
+   },
 };
 
+ASSERT_COMPILE(ARRAY_SIZE(_ADV_BLE_CONN_PROFILES) ==
+               ADV_BLE_CONN_PROFILE_COUNT);
+
 static const ble_dis_init_t _DIS_INIT = {
    .manufact_name_str = {
       .length = ZARRAY_SIZE(MANUFACTURER_NAME),
@@ -559,41 +1237,132 @@ static const ble_advertising_init_t _ADV_BLE_ADVERTISE_INIT =
          .uuid_cnt =  ARRAY_SIZE(_ADV_UUIDS),
          .p_uuids = (ble_uuid_t *)&_ADV_UUIDS[0],
       },
+#ifdef ADV_BLE_EXTENDED
+      // extended advertising PDUs are not scannable
+      .p_manuf_specific_data = &_adv_ble_manuf_data,
+   },
+#else // ADV_BLE_EXTENDED
    },
    .srdata = {
       .p_manuf_specific_data = &_adv_ble_manuf_data,
    },
+#endif // !ADV_BLE_EXTENDED
    .config = {
+      // intervals and durations are driven by the advertising ladder,
+      // with each step run in fast mode, see _adv_ble_adv_policy_start
       .ble_adv_fast_enabled  = true,
       .ble_adv_fast_interval = MSEC_TO_UNITS(200, UNIT_0_625_MS),
-      .ble_adv_fast_timeout  = ADV_BLE_SLEEP_DELAY_S,
-      .ble_adv_slow_enabled  = true,
-      .ble_adv_slow_interval = MSEC_TO_UNITS(1000, UNIT_0_625_MS),
-      .ble_adv_slow_timeout  = 3600, // 1 hour
+      .ble_adv_fast_timeout  = ADV_BLE_ADV_RUN_MAX_S * 100U, // 10 ms units
+      .ble_adv_slow_enabled  = false,
+      // advertising is resumed on disconnection by the BLE module, only
+      // when it was stopped because all the links were in use
+      .ble_adv_on_disconnect_disabled = true,
+#ifdef ADV_BLE_EXTENDED
+      .ble_adv_extended_enabled = true,
+      .ble_adv_primary_phy = BLE_GAP_PHY_1MBPS,
+      .ble_adv_secondary_phy = ADV_BLE_EXT_SECONDARY_PHY,
+#endif // ADV_BLE_EXTENDED
    },
    .evt_handler = _adv_ble_adv_event_handler,
    .error_handler = NULL,
 };
 
+/**
+ * Advertising interval ladder, from the fastest to the slowest step.
+ * Sleep mode is entered once fast steps have been used for about
+ * ADV_BLE_SLEEP_DELAY_S without any connection demand.
+ */
+static const struct adv_ble_adv_step _ADV_BLE_ADV_LADDER[] = {
+   [ADV_BLE_ADV_STEP_BURST] = {
+      .as_interval = MSEC_TO_UNITS(100, UNIT_0_625_MS),
+      .as_period = 30U,
+      .as_tx_power = ADV_BLE_TX_POWER,
+   },
+   [ADV_BLE_ADV_STEP_FIRST] = {
+      .as_interval = MSEC_TO_UNITS(200, UNIT_0_625_MS),
+      .as_period = 120U,
+      .as_tx_power = ADV_BLE_TX_POWER,
+   },
+   {
+      .as_interval = MSEC_TO_UNITS(500, UNIT_0_625_MS),
+      .as_period = 480U,
+      .as_tx_power = ADV_BLE_TX_POWER,
+   },
+   {
+      .as_interval = MSEC_TO_UNITS(1000, UNIT_0_625_MS),
+      .as_period = ADV_BLE_SLEEP_DELAY_S - 600U,
+      .as_tx_power = ADV_BLE_TX_POWER_LOW,
+   },
+   {
+      .as_interval = MSEC_TO_UNITS(2000, UNIT_0_625_MS),
+      .as_period = 0U,
+      .as_tx_power = ADV_BLE_TX_POWER_LOW,
+      .as_sleep = true,
+   },
+};
+
+/** Background workers, run in this order whenever they are due */
+static const struct adv_ble_worker _ADV_BLE_WORKERS[BW_COUNT] = {
+   [BW_TRACE_STATS] = {
+      .bw_pace = ADV_BLE_TRACE_STATS_PACE_S,
+      .bw_func = &_adv_ble_worker_trace_stats,
+   },
+#ifdef ADV_BLE_EXTENDED
+   [BW_TELEMETRY] = {
+      .bw_pace = ADV_BLE_TELEMETRY_PACE_S,
+      .bw_func = &_adv_ble_worker_telemetry,
+   },
+#endif // ADV_BLE_EXTENDED
+#ifdef ADV_BENCH
+   [BW_BENCH] = {
+      .bw_pace = ADV_BLE_BENCH_PACE_S,
+      .bw_func = &_adv_ble_worker_bench,
+   },
+#endif // ADV_BENCH
+};
+
+/** Trace back-end that streams the trace queue through notifications */
+static const struct pa_trace_sink _ADV_BLE_TRACE_SINK = {
+   .ts_init = NULL,
+   .ts_tx = &_adv_ble_trace_tx,
+   .ts_fatal = &_adv_ble_trace_fatal,
+   .ts_max_length = ADV_BLE_BULK_SIZE,
+};
+
 //-----------------------------------------------------------------------------
 // Variables
 //-----------------------------------------------------------------------------
 
 static struct adv_ble_var _adv_ble_var;
 
+/** Transient storage arena for pending requests, one slot per record */
+static union adv_ble_transient _adv_ble_transient[ADV_BLE_REQUEST_COUNT];
+
 /** BLE PowerAdvertiser server engine */
 static struct adv_ble _adv_ble = {
    .bp_attributes = {
-      [ADV_ERROR] = {
-         .pa_uuid = {
-            .uuid = ADV_CHAR_UUID_BASE + ADV_ERROR,
-         },
-         .pa_attr_md = &_ADV_ROD_ATTR_MD,
-         .pa_size = SIZEOF_MEMBER(struct adv_ble_var, pv_error),
-         .pa_var = &_adv_ble_var.pv_error,
-         .pa_props = BLE_CHAR_RN_PROP,
-         .pa_desc = BLE_MAKE_ATTR_DESC("error"),
+      #define _ADV_BLE_ATTR_INIT(_attr_, _md_, _var_, _props_, _rd_, _wr_, \
+                                 _desc_, _varsize_) \
+      [_attr_] = { \
+         .pa_uuid = { \
+            .uuid = ADV_CHAR_UUID_BASE + (_attr_), \
+         }, \
+         .pa_attr_md = &(_md_), \
+         .pa_size = SIZEOF_MEMBER(struct adv_ble_var, _var_), \
+         .pa_var = &_adv_ble_var._var_, \
+         .pa_props = BLE_MAKE_CHAR_PROPS(_props_), \
+         .pa_offset = _attr_##_HANDLE_VALUE, \
+         .pa_reader = (_rd_), \
+         .pa_writer = (_wr_), \
+         .pa_desc = BLE_MAKE_ATTR_DESC(_desc_), \
+         .pa_varsize = (_varsize_), \
       },
+      ADV_BLE_ATTRIBUTES(_ADV_BLE_ATTR_INIT)
+      #undef _ADV_BLE_ATTR_INIT
+   },
+   .bp_streams = {
+      [ADV_BLE_STREAM_BULK] = { .bs_attr = ADV_BULK },
+      [ADV_BLE_STREAM_TRACE] = { .bs_attr = ADV_TRACE },
    },
    .bp_sw_version = _adv_ble_sw_version,
 };
@@ -603,15 +1372,29 @@ static struct adv_ble_adv_info _adv_ble_adv_info = {
    .ai_version = INFO_VERSION,
 };
 
+#ifdef ADV_BLE_EXTENDED
+/** Telemetry, used to advertise PowerAdvertiser status w/ extended PDUs */
+static struct adv_ble_adv_telemetry _adv_ble_adv_telemetry = {
+   .at_info = {
+      .ai_version = INFO_VERSION_EXT,
+   },
+};
+#endif // ADV_BLE_EXTENDED
+
 /**
  * Manufacturer data, used to advertise PowerAdvertiser status in scan response
- * packets
+ * packets, or in the extended advertising payload (ADV_BLE_EXTENDED)
 */
 static ble_advdata_manuf_data_t _adv_ble_manuf_data = {
    .company_identifier = MANUFACTURER_ID,
    .data = {
+#ifdef ADV_BLE_EXTENDED
+      .size = sizeof(_adv_ble_adv_telemetry),
+      .p_data = (uint8_t *)&_adv_ble_adv_telemetry,
+#else // ADV_BLE_EXTENDED
       .size = sizeof(_adv_ble_adv_info),
       .p_data = (uint8_t *)&_adv_ble_adv_info,
+#endif // !ADV_BLE_EXTENDED
    },
 };
 
@@ -621,11 +1404,29 @@ static ble_advdata_manuf_data_t _adv_ble_manuf_data = {
 // now no other choices than this crap.
 NRF_SDH_BLE_OBSERVER(_adv_ble_observer, ADV_BLE_OBSERVER_PRIO,
                      &_adv_ble_evt_handler, &_adv_ble);
+#ifndef ADV_BLE_EVT_SCHED
+// GATT module negotiates ATT MTU and data length, as NRF_BLE_GATT_DEF would;
+// it is otherwise invoked along with the deferred events, as it reports to
+// the engine
+NRF_SDH_BLE_OBSERVER(_adv_ble_gatt_observer, NRF_BLE_GATT_BLE_OBSERVER_PRIO,
+                     &nrf_ble_gatt_on_ble_evt, &_adv_ble.bp_gatt);
+#endif // !ADV_BLE_EVT_SCHED
 BLE_ADVERTISING_DEF(_adv_ble_advertising);
 
 /** Background worker engine instance */
 static struct adv_ble_worker_engine _adv_ble_worker_engine;
 
+/** Advertising payload updater instance */
+static struct adv_ble_adv_updater _adv_ble_adv_updater;
+
+/** Advertising policy instance */
+static struct adv_ble_adv_policy _adv_ble_adv_policy;
+
+#ifdef ADV_BLE_EVT_SCHED
+/** BLE events handed over to the application scheduler */
+static struct adv_ble_evt_queue _adv_ble_evt_queue;
+#endif // ADV_BLE_EVT_SCHED
+
 //-----------------------------------------------------------------------------
 // Inline functions
 //-----------------------------------------------------------------------------
@@ -660,15 +1461,88 @@ void
 adv_ble_init(void)
 {
    _adv_ble_stack_init();
+   adv_power_boot_mark(APB_STACK);
    _adv_ble_gap_init();
    _adv_ble_gatt_init();
+#ifndef ADV_FAST_BOOT
+   _adv_ble_version_init();
+#endif // !ADV_FAST_BOOT
    _adv_ble_dis_init();
    _adv_ble_service_add();
+   adv_power_boot_mark(APB_SERVICES);
    _adv_ble_advertising_init();
    _adv_ble_timer_create();
    // if the next call is performed before GAP init, it fails miserabily
    // as the host receives a request with 0xffff values...
    _adv_ble_conn_init();
+#ifdef ADV_TRACE_BLE
+   // traces are kept in the trace queue until a client subscribes
+   _adv_ble_trace_attach();
+#endif // ADV_TRACE_BLE
+#ifndef ADV_FAST_BOOT
+   adv_power_boot_mark(APB_READY);
+#endif // !ADV_FAST_BOOT
+}
+
+/**
+ * Report the BLE module RAM usage, including the SoftDevice requirements.
+ *
+ * @param[out] usage updated with the RAM usage
+ */
+void
+adv_ble_get_ram_usage(struct adv_ble_ram_usage * usage)
+{
+   usage->ru_app_ram_start = _adv_ble.bp_app_ram_start;
+   usage->ru_app_ram_min = _adv_ble.bp_app_ram_min;
+   usage->ru_attr_tab_size = ADV_BLE_ATTR_TAB_SIZE;
+   usage->ru_engine = sizeof(_adv_ble) + sizeof(_adv_ble_var) +
+                      sizeof(_adv_ble_transient) +
+                      sizeof(_adv_ble_worker_engine) +
+                      sizeof(_adv_ble_adv_policy);
+   usage->ru_advertising = sizeof(_adv_ble_advertising) +
+                           sizeof(_adv_ble_adv_updater);
+#ifdef ADV_BLE_EVT_SCHED
+   usage->ru_events = sizeof(_adv_ble_evt_queue);
+#else // ADV_BLE_EVT_SCHED
+   usage->ru_events = 0U;
+#endif // !ADV_BLE_EVT_SCHED
+}
+
+/**
+ * Report a fault of the previous run through the ADV_ERROR attribute.
+ *
+ * @param[in] id fault identifier, see NRF_FAULT_ID_*
+ * @param[in] error error code
+ * @param[in] pc program counter of the fault
+ */
+void
+adv_ble_set_fault(uint32_t id, uint32_t error, uint32_t pc)
+{
+   struct pa_error_desc * bpe = &_adv_ble_var.pv_error;
+
+   bpe->pe_errno = (int8_t)-PE_FAULT;
+   bpe->pe_attr = (uint8_t)ADV_COUNT;
+   bpe->pe_state = (uint8_t)error;
+   switch ( id ) {
+      case NRF_FAULT_ID_SD_ASSERT:
+         bpe->pe_comp = 0x01U;
+         break;
+      case NRF_FAULT_ID_APP_MEMACC:
+         bpe->pe_comp = 0x02U;
+         break;
+      case NRF_FAULT_ID_SDK_ERROR:
+         bpe->pe_comp = 0x41U;
+         break;
+      case NRF_FAULT_ID_SDK_ASSERT:
+         bpe->pe_comp = 0x42U;
+         break;
+      default:
+         bpe->pe_comp = 0xffU;
+         break;
+   }
+   bpe->pe_payload = pc;
+
+   (void)_adv_ble_publish(&_adv_ble, ADV_ERROR, NULL, 0U);
 }
 
 /**
@@ -684,15 +1558,140 @@ adv_ble_start(void)
    } else
 #endif  // PEER_MANAGER_ENABLED
    {
-      ret_code_t rc = ble_advertising_start(&_adv_ble_advertising,
-                                            BLE_ADV_MODE_FAST);
-
-      APP_ERROR_CHECK(rc);
+      _adv_ble_adv_policy_start(ADV_BLE_ADV_STEP_FIRST);
    }
+   adv_power_boot_mark(APB_ADVERTISING);
+
+#ifdef ADV_FAST_BOOT
+   // complete the BLE initialization from the main loop, once the device
+   // advertises
+   ret_code_t rc = app_sched_event_put(NULL, 0U, &_adv_ble_late_init);
+   APP_ERROR_CHECK(rc);
+#endif // ADV_FAST_BOOT
 
    _adv_ble_worker_start();
 }
 
+/**
+ * Start streaming data through the bulk characteristic.
+ *
+ * Notifications are queued as long as the SoftDevice accepts them, and the
+ * queue is refilled from the source on each TX completion. The stream
+ * resumes on reconnection, once the client enables notifications.
+ *
+ * @param[in] source the stream source
+ * @return @c PE_NO_ERROR on success, or a negative error code
+ */
+int
+adv_ble_bulk_start(adv_ble_bulk_source_t source)
+{
+   struct adv_ble_stream * stream = &_adv_ble.bp_streams[ADV_BLE_STREAM_BULK];
+
+   if ( ! source ) {
+      return -PE_INVALID_REQUEST;
+   }
+   if ( stream->bs_source ) {
+      return -PE_BUSY;
+   }
+
+   stream->bs_length = 0U;
+   stream->bs_bytes = 0U;
+   stream->bs_source = source;
+
+   struct adv_ble_link * link =
+      _adv_ble_link_find(&_adv_ble, stream->bs_conn_handle);
+   if ( link ) {
+      _adv_ble_link_profile(link, ADV_BLE_CONN_BURST);
+   }
+
+   _adv_ble_stream_pump(&_adv_ble);
+
+   return PE_NO_ERROR;
+}
+
+/**
+ * Stop streaming data through the bulk characteristic.
+ * Chunks already queued in the SoftDevice are still sent.
+ */
+void
+adv_ble_bulk_stop(void)
+{
+   _adv_ble_stream_stop(&_adv_ble.bp_streams[ADV_BLE_STREAM_BULK]);
+}
+
+/**
+ * Resume the bulk stream, once a source that had no data to provide has
+ * some again.
+ */
+void
+adv_ble_bulk_kick(void)
+{
+   _adv_ble_stream_pump(&_adv_ble);
+}
+
+/**
+ * Update the alert bitfield broadcast in scan response packets, or in the
+ * extended advertising payload with ADV_BLE_EXTENDED, which then has no
+ * scan response.
+ * The payload is pushed without restarting advertising, at most once per
+ * advertising interval.
+ *
+ * @param[in] alert the new alert bitfield
+ */
+void
+adv_ble_adv_set_alert(uint8_t alert)
+{
+   struct pa_health * health = &_adv_ble_adv_info.ai_health;
+
+   if ( health->pa_alert != alert ) {
+      health->pa_alert = alert;
+      _adv_ble_adv_mark_dirty(ADV_BLE_ADV_ALERT);
+      // let nearby scanners catch up with the alert
+      adv_ble_adv_burst();
+   }
+}
+
+/**
+ * Advertise at the fastest pace for a short while, for example on a user
+ * action, then resume the advertising ladder from its first step.
+ * This is a no-op while all links are connected, as the device does not
+ * advertise then.
+ */
+void
+adv_ble_adv_burst(void)
+{
+   if ( _adv_ble.bp_link_count >= ADV_BLE_PERIPH_LINK_COUNT ) {
+      return;
+   }
+
+   // advertising parameters cannot be changed while advertising
+   ret_code_t rc = sd_ble_gap_adv_stop(_adv_ble_advertising.adv_handle);
+   if ( (NRF_SUCCESS != rc) && (NRF_ERROR_INVALID_STATE != rc) ) {
+      MSGV(PTL_WARN, "Cannot stop advertising: 0x%x", rc);
+      return;
+   }
+
+   _adv_ble_adv_policy_start(ADV_BLE_ADV_STEP_BURST);
+}
+
+/**
+ * Update the state of charge broadcast in scan response packets, or in the
+ * extended advertising payload with ADV_BLE_EXTENDED.
+ * See #adv_ble_adv_set_alert
+ *
+ * @param[in] soc the new state of charge, in %
+ */
+void
+adv_ble_adv_set_soc(uint8_t soc)
+{
+   struct pa_health * health = &_adv_ble_adv_info.ai_health;
+
+   if ( health->ph_soc != soc ) {
+      health->ph_soc = soc;
+      _adv_ble_adv_mark_dirty(ADV_BLE_ADV_SOC);
+   }
+}
+
 /**
  * Kludge for nRF52 v14 SDK ugly API
  *
@@ -726,7 +1725,7 @@ _adv_ble_stack_init(void)
    rc = nrf_sdh_ble_app_ram_start_get(&ram_start);
    APP_ERROR_CHECK(rc);
 
-   MSGV(PTL_INFO, "RAM start 0x%08x", ram_start);
+   _adv_ble.bp_app_ram_start = ram_start;
 
    // Overwrite some of the default configurations for the BLE stack.
    const ble_cfg_t common_cfg = {
@@ -735,7 +1734,7 @@ _adv_ble_stack_init(void)
          // failing to reserve proper space here lead to a NO_MEM error
          // on sd_ble_uuid_vs_add next call.
          .vs_uuid_cfg = {
-            .vs_uuid_count = 1,
+            .vs_uuid_count = ADV_BLE_VS_UUID_COUNT,
          },
       },
    };
@@ -749,7 +1748,7 @@ _adv_ble_stack_init(void)
          // on sd_ble_gatts_characteristic_add when too many attributes are
          // added
          .attr_tab_size = {
-            .attr_tab_size = 2U<<10U,
+            .attr_tab_size = ADV_BLE_ATTR_TAB_SIZE,
          },
       },
    };
@@ -760,7 +1759,7 @@ _adv_ble_stack_init(void)
    const ble_cfg_t role_cfg = {
       .gap_cfg = {
          .role_count_cfg = {
-            .periph_role_count = 1,
+            .periph_role_count = ADV_BLE_PERIPH_LINK_COUNT,
             .central_role_count = 0,
             .central_sec_count  = 0,
          },
@@ -769,25 +1768,88 @@ _adv_ble_stack_init(void)
    rc = sd_ble_cfg_set(BLE_GAP_CFG_ROLE_COUNT, &role_cfg, ram_start);
    APP_ERROR_CHECK(rc);
 
-   // Enable BLE stack.
-   rc = nrf_sdh_ble_enable(&ram_start);
+   // Connection settings for bulk transfers. Beware that each of them
+   // increases the RAM the SoftDevice requires.
+   const ble_cfg_t gap_conn_cfg = {
+      .conn_cfg = {
+         .conn_cfg_tag = ADV_BLE_CONN_CFG_TAG,
+         .params.gap_conn_cfg = {
+            .conn_count = ADV_BLE_PERIPH_LINK_COUNT,
+            // longer connection events allow several PDUs per event
+            .event_length = ADV_BLE_GAP_EVENT_LENGTH,
+         },
+      },
+   };
+   rc = sd_ble_cfg_set(BLE_CONN_CFG_GAP, &gap_conn_cfg, ram_start);
    APP_ERROR_CHECK(rc);
 
-   // Retrieve SoftDevice version
-   // should be called after nrf_sdh_ble_enable()
-   ble_version_t ble_sd_ver;
-   memset(&ble_sd_ver, 0, sizeof(ble_sd_ver));
-   rc = sd_ble_version_get(&ble_sd_ver);
+   const ble_cfg_t gatt_conn_cfg = {
+      .conn_cfg = {
+         .conn_cfg_tag = ADV_BLE_CONN_CFG_TAG,
+         .params.gatt_conn_cfg = {
+            .att_mtu = ADV_BLE_ATT_MTU,
+         },
+      },
+   };
+   rc = sd_ble_cfg_set(BLE_CONN_CFG_GATT, &gatt_conn_cfg, ram_start);
    APP_ERROR_CHECK(rc);
 
-   if ( NORDIC_COMPANY_ID == ble_sd_ver.company_id ) {
-      unsigned int ver_ix = BLE_LINK_VERSION_IDX(ble_sd_ver.version_number);
-      struct adv_ble_link_version ll_version;
-      if ( ver_ix < ARRAY_SIZE(BLE_LL_VERSIONS) ) {
-         ll_version = BLE_LL_VERSIONS[ver_ix];
-      } else {
-         ll_version.lv_major = 0U;
-         ll_version.lv_minor = 0U;
+   const ble_cfg_t gatts_conn_cfg = {
+      .conn_cfg = {
+         .conn_cfg_tag = ADV_BLE_CONN_CFG_TAG,
+         .params.gatts_conn_cfg = {
+            // keep the link busy while the application refills the queue
+            .hvn_tx_queue_size = ADV_BLE_HVN_QUEUE_SIZE,
+         },
+      },
+   };
+   rc = sd_ble_cfg_set(BLE_CONN_CFG_GATTS, &gatts_conn_cfg, ram_start);
+   APP_ERROR_CHECK(rc);
+
+   // Enable BLE stack. On return, ram_start is the lowest application RAM
+   // start address the SoftDevice accepts with the above configuration
+   rc = nrf_sdh_ble_enable(&ram_start);
+   _adv_ble.bp_app_ram_min = ram_start;
+   // the application RAM start is the RAM origin of ld/target.ld, which is
+   // not derived from the above configuration: never run with the
+   // SoftDevice overlapping the application RAM
+   if ( (NRF_SUCCESS == rc) && (ram_start > _adv_ble.bp_app_ram_start) ) {
+      rc = NRF_ERROR_NO_MEM;
+   }
+   if ( NRF_ERROR_NO_MEM == rc ) {
+      MSGV(PTL_FATAL, "SD RAM: app start 0x%08x, should be 0x%08x",
+           _adv_ble.bp_app_ram_start, ram_start);
+   }
+   APP_ERROR_CHECK(rc);
+
+   MSGV(PTL_INFO, "SD RAM: app start 0x%08x, required 0x%08x, %u spare, "
+        "attr tab %u", _adv_ble.bp_app_ram_start, ram_start,
+        _adv_ble.bp_app_ram_start - ram_start,
+        (unsigned int)ADV_BLE_ATTR_TAB_SIZE);
+}
+
+/**
+ * Retrieve the SoftDevice version, and build the DIS firmware version.
+ * Should be called after the BLE stack is enabled.
+ */
+static void
+_adv_ble_version_init(void)
+{
+   ret_code_t rc;
+
+   ble_version_t ble_sd_ver;
+   memset(&ble_sd_ver, 0, sizeof(ble_sd_ver));
+   rc = sd_ble_version_get(&ble_sd_ver);
+   APP_ERROR_CHECK(rc);
+
+   if ( NORDIC_COMPANY_ID == ble_sd_ver.company_id ) {
+      unsigned int ver_ix = BLE_LINK_VERSION_IDX(ble_sd_ver.version_number);
+      struct adv_ble_link_version ll_version;
+      if ( ver_ix < ARRAY_SIZE(BLE_LL_VERSIONS) ) {
+         ll_version = BLE_LL_VERSIONS[ver_ix];
+      } else {
+         ll_version.lv_major = 0U;
+         ll_version.lv_minor = 0U;
          MSGV(PTL_ERROR, "Unsupported BLE link layer code %d",
               ble_sd_ver.version_number);
       }
@@ -802,6 +1864,11 @@ _adv_ble_stack_init(void)
          MSGV(PTL_ERROR, "Unsupported SD code 0x%04x",
               ble_sd_ver.subversion_number)
       }
+#ifdef ADV_BLE_EXTENDED
+      if ( ((sd_version>>16U) & 0xFFU) < 6U ) {
+         MSGV(PTL_ERROR, "Extended advertising requires a v6+ SoftDevice");
+      }
+#endif // ADV_BLE_EXTENDED
 
       snprintf(_adv_ble_fw_version, sizeof(_adv_ble_fw_version),
                FW_VERSION_FORMAT,
@@ -821,10 +1888,16 @@ _adv_ble_stack_init(void)
 static void
 _adv_ble_conn_init(void)
 {
-   // @ start up, the connection handle is invalid
+   // @ start up, the connection handles are invalid
    // unfortunately, BLE_CONN_HANDLE_INVALID is not zero, so be sure to
-   // properly clear out the connection handle with invalid marker
-   _adv_ble.bp_conn_handle = BLE_CONN_HANDLE_INVALID;
+   // properly clear out the connection handles with invalid marker
+   for (unsigned int lix=0; lix<ADV_BLE_PERIPH_LINK_COUNT; lix++) {
+      _adv_ble.bp_links[lix].bl_conn_handle = BLE_CONN_HANDLE_INVALID;
+   }
+   for (unsigned int six=0; six<ADV_BLE_STREAM_COUNT; six++) {
+      _adv_ble.bp_streams[six].bs_conn_handle = BLE_CONN_HANDLE_INVALID;
+   }
+   _adv_ble.bp_qwr_conn_handle = BLE_CONN_HANDLE_INVALID;
 
    ret_code_t rc;
    rc = ble_conn_params_init(&_CONN_PARAM_INIT);
@@ -839,13 +1912,97 @@ _adv_ble_conn_init(void)
 static void
 _adv_ble_conn_evt(ble_conn_params_evt_t * ble_evt)
 {
-   ret_code_t rc;
+   struct adv_ble_link * link =
+      _adv_ble_link_find(&_adv_ble, ble_evt->conn_handle);
 
-   if (ble_evt->evt_type == BLE_CONN_PARAMS_EVT_FAILED) {
-      rc = sd_ble_gap_disconnect(_adv_ble.bp_conn_handle,
-                                 BLE_HCI_CONN_INTERVAL_UNACCEPTABLE);
-      APP_ERROR_CHECK(rc);
+   if ( ! link ) {
+      return;
+   }
+
+   switch ( ble_evt->evt_type ) {
+      case BLE_CONN_PARAMS_EVT_FAILED:
+         // the link is still usable with the parameters the central has
+         // chosen: keep it, but do not request this profile again
+         MSGV(PTL_WARN, "Profile %u rejected on C:%04x",
+              link->bl_profile, link->bl_conn_handle);
+         link->bl_profile_refused |= (uint8_t)(1U << link->bl_profile);
+         break;
+      case BLE_CONN_PARAMS_EVT_SUCCEEDED:
+         MSGV(PTL_INFO, "Profile %u on C:%04x",
+              link->bl_profile, link->bl_conn_handle);
+         break;
+      default:
+         break;
+   }
+}
+
+/**
+ * Request a connection parameter profile for a link.
+ * Profiles the central has already rejected on this link are not requested
+ * again.
+ *
+ * @param[in,out] link the link to update
+ * @param[in] profile the profile to switch to
+ */
+static void
+_adv_ble_link_profile(struct adv_ble_link * link,
+                      enum adv_ble_conn_profile profile)
+{
+   if ( (link->bl_profile == profile) ||
+        (link->bl_profile_refused & (1U << profile)) ) {
+      return;
+   }
+
+   // the module retries on its own, and reports the outcome through
+   // _adv_ble_conn_evt
+   ble_gap_conn_params_t params = _ADV_BLE_CONN_PROFILES[profile];
+   ret_code_t rc = ble_conn_params_change_conn_params(link->bl_conn_handle,
+                                                      &params);
+   if ( rc ) {
+      // a negotiation may be in progress, retry on the next switch
+      MSGV(PTL_DEBUG, "Cannot request profile %u: 0x%x", profile, rc);
+      return;
+   }
+
+   link->bl_profile = (uint8_t)profile;
+
+   if ( ADV_BLE_CONN_BURST == profile ) {
+      // the worker timer may only be armed for the stall deadline, which is
+      // far later than the switch back to the idle profile
+      struct adv_ble_worker_engine * we = &_adv_ble_worker_engine;
+      _adv_ble_worker_clock(we);
+      link->bl_profile_time = we->we_time;
+      if ( ! we->we_running ) {
+         _adv_ble_worker_schedule(we);
+      }
+   }
+}
+
+/**
+ * Tell whether a link has some activity that needs a short connection
+ * interval, besides incoming requests.
+ *
+ * @param[in] blepn BLE PowerAdvertiser engine
+ * @param[in] link the link to check
+ * @return @c true if some requests are pending or bulk data is streamed
+ */
+static bool
+_adv_ble_link_busy(const struct adv_ble * blepn,
+                   const struct adv_ble_link * link)
+{
+   for (unsigned int rix=0; rix<ADV_BLE_REQUEST_COUNT; rix++) {
+      const struct adv_ble_attr_event * event = &blepn->bp_attr_events[rix];
+      if ( event->ae_id && (event->ae_conn_handle == link->bl_conn_handle) ) {
+         return true;
+      }
    }
+
+   // the trace stream does not count: it stays attached while connected
+   const struct adv_ble_stream * stream =
+      &blepn->bp_streams[ADV_BLE_STREAM_BULK];
+
+   return stream->bs_source &&
+          (stream->bs_conn_handle == link->bl_conn_handle);
 }
 
 /**
@@ -883,7 +2040,8 @@ _adv_ble_gap_init(void)
    rc = sd_ble_gap_appearance_set(BLE_APPEARANCE_UNKNOWN);
    APP_ERROR_CHECK(rc);
 
-   rc = sd_ble_gap_ppcp_set(&_GAP_CONN_PARAMS);
+   // connections start with the burst profile, see _adv_ble_link_profile
+   rc = sd_ble_gap_ppcp_set(&_ADV_BLE_CONN_PROFILES[ADV_BLE_CONN_BURST]);
    APP_ERROR_CHECK(rc);
 
    ble_gap_addr_t mac_addr;
@@ -905,8 +2063,50 @@ _adv_ble_gap_init(void)
 static void
 _adv_ble_gatt_init(void)
 {
-   ret_code_t rc = nrf_ble_gatt_init(&_adv_ble.bp_gatt, NULL);
+   ret_code_t rc = nrf_ble_gatt_init(&_adv_ble.bp_gatt,
+                                     &_adv_ble_gatt_evt_handler);
+   APP_ERROR_CHECK(rc);
+
+   rc = nrf_ble_gatt_att_mtu_periph_set(&_adv_ble.bp_gatt, ADV_BLE_ATT_MTU);
    APP_ERROR_CHECK(rc);
+
+   rc = nrf_ble_gatt_data_length_set(&_adv_ble.bp_gatt,
+                                     BLE_CONN_HANDLE_INVALID,
+                                     ADV_BLE_DATA_LENGTH);
+   APP_ERROR_CHECK(rc);
+}
+
+/**
+ * GATT module event handler.
+ *
+ * @param[in] gatt GATT module instance
+ * @param[in] evt GATT module event
+ */
+static void
+_adv_ble_gatt_evt_handler(nrf_ble_gatt_t * gatt,
+                          nrf_ble_gatt_evt_t const * evt)
+{
+   (void)gatt;
+
+   switch ( evt->evt_id ) {
+      case NRF_BLE_GATT_EVT_ATT_MTU_UPDATED: {
+            MSGV(PTL_INFO, "ATT MTU %u on C:%04x",
+                 evt->params.att_mtu_effective, evt->conn_handle);
+            struct adv_ble_link * link =
+               _adv_ble_link_find(&_adv_ble, evt->conn_handle);
+            if ( link ) {
+               link->bl_mtu = evt->params.att_mtu_effective;
+            }
+            // larger chunks may now be sent
+            _adv_ble_stream_pump(&_adv_ble);
+         }
+         break;
+      case NRF_BLE_GATT_EVT_DATA_LENGTH_UPDATED:
+         MSGV(PTL_INFO, "Data length %u", evt->params.data_length);
+         break;
+      default:
+         break;
+   }
 }
 
 /**
@@ -924,8 +2124,10 @@ _adv_ble_service_add(void)
       .uuid = ADV_SERVICE_UUID,
    };
 
+   // the base UUID is registered once, all characteristics share its type
    rc = sd_ble_uuid_vs_add(&ADV_UUID128, &service_uuid.type);
    APP_ERROR_CHECK(rc);
+   _adv_ble.bp_uuid_type = service_uuid.type;
 
    rc = sd_ble_gatts_service_add(
       BLE_GATTS_SRVC_TYPE_PRIMARY, &service_uuid, &_adv_ble.bp_service_handle);
@@ -935,6 +2137,61 @@ _adv_ble_service_add(void)
    _adv_ble_add_characteristics(&_adv_ble);
 }
 
+#ifdef ADV_FAST_BOOT
+/**
+ * Complete the BLE initialization, from the application scheduler.
+ * The Device Information Service is registered before advertising starts,
+ * as it is advertised, but the firmware revision string is only built and
+ * published once the device advertises.
+ *
+ * @param[in] data unused
+ * @param[in] size unused
+ */
+static void
+_adv_ble_late_init(void * data, uint16_t size)
+{
+   (void)data;
+   (void)size;
+
+   _adv_ble_version_init();
+   _adv_ble_dis_fw_version_update();
+   adv_power_boot_mark(APB_READY);
+}
+
+/**
+ * Publish the firmware revision string of the Device Information Service.
+ * The DIS module does not expose its handles: the characteristic value is
+ * looked up in the attribute table, where DIS comes before the
+ * PowerAdvertiser service.
+ */
+static void
+_adv_ble_dis_fw_version_update(void)
+{
+   ble_gatts_value_t value = {
+      .len = ZARRAY_SIZE(_adv_ble_fw_version),
+      .offset = 0U,
+      .p_value = (uint8_t *)_adv_ble_fw_version,
+   };
+
+   for (uint16_t handle=BLE_GATT_HANDLE_START;
+        handle<_adv_ble.bp_service_handle; handle++) {
+      ble_uuid_t uuid;
+      if ( NRF_SUCCESS != sd_ble_gatts_attr_get(handle, &uuid, NULL) ) {
+         continue;
+      }
+      if ( (BLE_UUID_TYPE_BLE == uuid.type) &&
+           (BLE_UUID_FIRMWARE_REVISION_STRING_CHAR == uuid.uuid) ) {
+         ret_code_t rc;
+         rc = sd_ble_gatts_value_set(BLE_CONN_HANDLE_INVALID, handle, &value);
+         APP_ERROR_CHECK(rc);
+         return;
+      }
+   }
+
+   MSGV(PTL_ERROR, "DIS firmware revision not found");
+}
+#endif // ADV_FAST_BOOT
+
 /**
  * Device Information Service initialisation
  */
@@ -967,11 +2224,12 @@ _adv_ble_advertising_init(void)
    }
    APP_ERROR_CHECK(rc);
 
-   rc = sd_ble_gap_tx_power_set(BLE_GAP_TX_POWER_ROLE_ADV,
-                                _adv_ble_advertising.adv_handle,
-                                ADV_BLE_TX_POWER);
-   APP_ERROR_CHECK(rc);
-   MSGV(PTL_INFO, "BLE TX power %d dBm", ADV_BLE_TX_POWER);
+   // connections use the bulk transfer link settings
+   ble_advertising_conn_cfg_tag_set(&_adv_ble_advertising,
+                                    ADV_BLE_CONN_CFG_TAG);
+
+   _adv_ble_adv_policy.ap_step = ADV_BLE_ADV_STEP_FIRST;
+   _adv_ble_adv_policy_configure(&_adv_ble_adv_policy);
 }
 
 /**
@@ -984,8 +2242,10 @@ _adv_ble_adv_event_handler(ble_adv_evt_t ble_adv_evt)
 {
    switch (ble_adv_evt) {
       case BLE_ADV_EVT_IDLE:
-         MSGV(PTL_INFO, "Would have sleep");
-         ble_advertising_start(&_adv_ble_advertising, BLE_ADV_MODE_SLOW);
+         if ( ! _adv_ble.bp_link_count ) {
+            adv_power_set_state(APS_IDLE);
+         }
+         _adv_ble_adv_policy_idle();
          break;
       case BLE_ADV_MODE_DIRECTED_HIGH_DUTY:
          MSGV(PTL_INFO, "Directed adv");
@@ -995,6 +2255,12 @@ _adv_ble_adv_event_handler(ble_adv_evt_t ble_adv_evt)
          break;
       case BLE_ADV_EVT_FAST:
          MSGV(PTL_INFO, "Advertising (fast)");
+         // all ladder steps are run in fast mode
+         if ( ! _adv_ble.bp_link_count ) {
+            adv_power_set_state(
+               (_adv_ble_adv_policy.ap_step <= ADV_BLE_ADV_STEP_FIRST) ?
+               APS_ADV_FAST : APS_ADV_SLOW);
+         }
          break;
       case BLE_ADV_EVT_SLOW:
          MSGV(PTL_INFO, "Advertising (slow)");
@@ -1027,65 +2293,201 @@ _adv_ble_adv_event_handler(ble_adv_evt_t ble_adv_evt)
  * @param[in] ble_evt Bluetooth stack event.
  * @param[in,out] context struct adv_ble instance
  */
-void
+static void
 _adv_ble_evt_handler(const ble_evt_t * ble_evt, void * context)
 {
-   struct adv_ble * blepn = (struct adv_ble *)context;
+   adv_power_wakeup(APW_SOFTDEVICE);
+
+#ifdef ADV_BLE_EVT_SCHED
+   (void)context;
+
+   // processed from the main loop, see _adv_ble_evt_sched_handler
+   _adv_ble_evt_defer(ble_evt);
+#else // ADV_BLE_EVT_SCHED
+   _adv_ble_evt_process(ble_evt, (struct adv_ble *)context);
+#endif // !ADV_BLE_EVT_SCHED
+}
+
+#ifdef ADV_BLE_EVT_SCHED
+/**
+ * Capture a BLE stack event into free slots, and hand it over to the
+ * application scheduler.
+ * SoftDevice events are all delivered from the same interrupt handler, so
+ * there is a single producer. Events are never processed from the interrupt
+ * handler, so running out of slots is a fatal error: the slot count should
+ * be reconsidered, see ADV_BLE_EVT_SLOT_BURST.
+ *
+ * @param[in] ble_evt Bluetooth stack event.
+ */
+static void
+_adv_ble_evt_defer(const ble_evt_t * ble_evt)
+{
+   struct adv_ble_evt_queue * eq = &_adv_ble_evt_queue;
+   size_t length = ble_evt->header.evt_len;
+   uint16_t write = eq->eq_write;
+   uint16_t pending = (uint16_t)(write - eq->eq_read);
+   uint16_t span = (uint16_t)ADV_BLE_EVT_SLOT_SPAN(length);
+
+   if ( (span > ADV_BLE_EVT_SLOT_SPAN_MAX) ||
+        ((pending + span) > ADV_BLE_EVT_SLOT_COUNT) ) {
+      MSGV(PTL_FATAL, "No slot for BLE event 0x%02x, %u pending",
+           ble_evt->header.evt_id, pending);
+      APP_ERROR_CHECK(NRF_ERROR_NO_MEM);
+   }
+
+   ble_evt_t * slot =
+      (ble_evt_t *)&eq->eq_slots[write % ADV_BLE_EVT_SLOT_COUNT];
+   memcpy(slot, ble_evt, length);
+
+   eq->eq_write = (uint16_t)(write + span);
+
+   if ( ! pending ) {
+      // the handler processes all the events captured until it completes
+      ret_code_t rc = app_sched_event_put(NULL, 0U,
+                                          &_adv_ble_evt_sched_handler);
+      APP_ERROR_CHECK(rc);
+   }
+}
+
+/**
+ * Process the deferred BLE events, from the application scheduler thread.
+ *
+ * @param[in] data unused
+ * @param[in] size unused
+ */
+static void
+_adv_ble_evt_sched_handler(void * data, uint16_t size)
+{
+   struct adv_ble_evt_queue * eq = &_adv_ble_evt_queue;
+
+   (void)data;
+   (void)size;
+
+   // the slot is released before the empty queue check, so that an event
+   // captured meanwhile either is seen here, or queues another handler
+   for (uint16_t read = eq->eq_read; read != eq->eq_write; read = eq->eq_read) {
+      const ble_evt_t * ble_evt =
+         (const ble_evt_t *)&eq->eq_slots[read % ADV_BLE_EVT_SLOT_COUNT];
+
+      // the GATT module runs before the engine, as an observer would
+      nrf_ble_gatt_on_ble_evt(ble_evt, &_adv_ble.bp_gatt);
+      _adv_ble_evt_process(ble_evt, &_adv_ble);
+
+      // release the slots
+      eq->eq_read = (uint16_t)(read +
+                               ADV_BLE_EVT_SLOT_SPAN(ble_evt->header.evt_len));
+   }
+}
+#endif // ADV_BLE_EVT_SCHED
 
+/**
+ * Process a BLE stack event
+ *
+ * @param[in] ble_evt Bluetooth stack event.
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ */
+static void
+_adv_ble_evt_process(const ble_evt_t * ble_evt, struct adv_ble * blepn)
+{
    ret_code_t rc;
 
-   if ( BLE_CONN_HANDLE_INVALID == blepn->bp_conn_handle ) {
+   // all event families start with the connection handle
+   uint16_t conn_handle = ble_evt->evt.gattc_evt.conn_handle;
+   struct adv_ble_link * link = _adv_ble_link_find(blepn, conn_handle);
+
+   if ( ! link ) {
       switch ( ble_evt->header.evt_id ) {
          case BLE_GAP_EVT_CONNECTED: // new connection
-            break;
+            link = _adv_ble_link_open(blepn, conn_handle);
+            if ( link ) {
+               break;
+            }
+            // the SoftDevice should never accept more links
+            MSGV(PTL_ERROR, "No free link for C:%04x", conn_handle);
+            rc = sd_ble_gap_disconnect(conn_handle,
+                                    BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+            APP_ERROR_CHECK(rc);
+            return;
          case BLE_GAP_EVT_TIMEOUT: // may occur on advertising timeout
             return;
          case BLE_GAP_EVT_ADV_SET_TERMINATED: // adv buffer released
             return;
          case BLE_GAP_EVT_DISCONNECTED:
-            MSGV(PTL_ERROR, "Disconnect");
-            _adv_ble_handle_disconnect(blepn);
+            MSGV(PTL_ERROR, "Disconnect on unknown C:%04x", conn_handle);
             return;
          case BLE_GATTS_EVT_HVN_TX_COMPLETE:
             MSGV(PTL_ERROR, "HVN TX complete on closed conn");
             return;
+         case BLE_EVT_USER_MEM_RELEASE: // queued write memory reclaimed
+            blepn->bp_qwr_busy = false;
+            return;
          default:
             MSGV(PTL_ERROR, "EVT 0x%x on closed conn", ble_evt->header.evt_id);
             return;
       }
-   } else {
-      if ( ble_evt->evt.gattc_evt.conn_handle != blepn->bp_conn_handle ) {
-         MSGV(PTL_INFO, "Connection handle mismatch!");
-         if ( ble_evt->evt.gattc_evt.conn_handle != BLE_CONN_HANDLE_INVALID ) {
-            rc = sd_ble_gap_disconnect(ble_evt->evt.gattc_evt.conn_handle,
-                                    BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
-
-            APP_ERROR_CHECK(rc);
-         }
-      }
    }
 
+   blepn->bp_link = link;
+
    switch (ble_evt->header.evt_id) {
       case BLE_GAP_EVT_CONNECTED: {
             // be sure to disable the background worker whenever a client
             // is connected
             blepn->bp_reboot = false;
+            // the stall watchdog starts with the connection, and is armed
+            // along with the worker disablement
+            _adv_ble_worker_feed();
             _adv_ble_worker_update_ble_status(true);
             char addr[20];
             _adv_ble_mac_addr_to_str(addr, ARRAY_SIZE(addr),
                &ble_evt->evt.gap_evt.params.connected.peer_addr);
-            MSGV(PTL_INFO, "Connected from %s", addr);
-            blepn->bp_conn_handle = ble_evt->evt.gap_evt.conn_handle;
-            // restore advertisement configuration that may have been changed
-            _adv_ble_advertising.adv_modes_config.ble_adv_fast_timeout =
-               _ADV_BLE_ADVERTISE_INIT.config.ble_adv_fast_timeout;
+            MSGV(PTL_INFO, "Connected from %s on C:%04x, %u/%u links",
+                 addr, conn_handle, blepn->bp_link_count,
+                 ADV_BLE_PERIPH_LINK_COUNT);
+            blepn->bp_conn_count++;
+            adv_power_set_state(APS_CONNECTED);
+            // 2M PHY doubles the throughput and halves the radio on time;
+            // the peer may fall back to 1M
+            const ble_gap_phys_t phys = {
+               .tx_phys = BLE_GAP_PHY_2MBPS | BLE_GAP_PHY_1MBPS,
+               .rx_phys = BLE_GAP_PHY_2MBPS | BLE_GAP_PHY_1MBPS,
+            };
+            rc = sd_ble_gap_phy_update(conn_handle, &phys);
+            if ( rc ) {
+               MSGV(PTL_WARN, "Cannot request PHY update: 0x%x", rc);
+            }
+            // someone is using the device: advertising resumes from the
+            // first ladder step, with a higher demand
+            struct adv_ble_adv_policy * ap = &_adv_ble_adv_policy;
+            if ( ap->ap_demand < ADV_BLE_ADV_DEMAND_MAX ) {
+               ap->ap_demand++;
+            }
+            if ( blepn->bp_link_count < ADV_BLE_PERIPH_LINK_COUNT ) {
+               // connectable advertising stops on connection, resume it
+               // as long as links are free
+               _adv_ble_adv_policy_start(ADV_BLE_ADV_STEP_FIRST);
+            } else {
+               ap->ap_step = ADV_BLE_ADV_STEP_FIRST;
+               ap->ap_elapsed = 0U;
+               _adv_ble_adv_policy_configure(ap);
+            }
          }
          break;  // BLE_GAP_EVT_CONNECTED
 
-      case BLE_GAP_EVT_DISCONNECTED:
-         MSGV(PTL_INFO, "Disconnected");
-         blepn->bp_conn_handle = BLE_CONN_HANDLE_INVALID;
-         _adv_ble_handle_disconnect(blepn);
+      case BLE_GAP_EVT_DISCONNECTED: {
+            bool advertising =
+               blepn->bp_link_count < ADV_BLE_PERIPH_LINK_COUNT;
+            MSGV(PTL_INFO, "Disconnected C:%04x", conn_handle);
+            _adv_ble_handle_disconnect(blepn, link);
+            link = NULL;
+            if ( ! blepn->bp_link_count ) {
+               adv_power_set_state(APS_IDLE);
+            }
+            if ( ! advertising ) {
+               // a link is free again
+               _adv_ble_adv_policy_start(_adv_ble_adv_policy.ap_step);
+            }
+         }
          break;  // BLE_GAP_EVT_DISCONNECTED
 
       case BLE_GAP_EVT_TIMEOUT:
@@ -1104,12 +2506,51 @@ _adv_ble_evt_handler(const ble_evt_t * ble_evt, void * context)
          }
          break;
 
-      case BLE_EVT_USER_MEM_REQUEST:
-         MSGV(PTL_INFO, "User memory request");
-         rc = sd_ble_user_mem_reply(ble_evt->evt.gattc_evt.conn_handle, NULL);
-         APP_ERROR_CHECK(rc);
+      case BLE_GAP_EVT_PHY_UPDATE_REQUEST: {
+            const ble_gap_phys_t phys = {
+               .tx_phys = BLE_GAP_PHY_AUTO,
+               .rx_phys = BLE_GAP_PHY_AUTO,
+            };
+            rc = sd_ble_gap_phy_update(conn_handle, &phys);
+            APP_ERROR_CHECK(rc);
+         }
+         break;  // BLE_GAP_EVT_PHY_UPDATE_REQUEST
+
+      case BLE_GAP_EVT_PHY_UPDATE:
+         MSGV(PTL_INFO, "PHY rx:%u tx:%u status:%u",
+              ble_evt->evt.gap_evt.params.phy_update.rx_phy,
+              ble_evt->evt.gap_evt.params.phy_update.tx_phy,
+              ble_evt->evt.gap_evt.params.phy_update.status);
+         break;  // BLE_GAP_EVT_PHY_UPDATE
+
+      case BLE_EVT_USER_MEM_REQUEST: {
+            // lend the queued write memory block, so that long writes are
+            // handled by the application rather than being rejected
+            const ble_user_mem_block_t * block = NULL;
+            // the block is shared: a single link at once may use it
+            if ( ! blepn->bp_qwr_busy ) {
+               blepn->bp_qwr_block.p_mem = &_adv_ble_var.pv_qwr[0];
+               blepn->bp_qwr_block.len = (uint16_t)ADV_BLE_QWR_SIZE;
+               blepn->bp_qwr_busy = true;
+               blepn->bp_qwr_handle = BLE_GATT_HANDLE_INVALID;
+               blepn->bp_qwr_conn_handle = conn_handle;
+               block = &blepn->bp_qwr_block;
+            }
+            MSGV(PTL_INFO, "User memory request, %s",
+                 block ? "granted" : "busy");
+            rc = sd_ble_user_mem_reply(ble_evt->evt.common_evt.conn_handle,
+                                       block);
+            APP_ERROR_CHECK(rc);
+         }
          break;  // BLE_EVT_USER_MEM_REQUEST
 
+      case BLE_EVT_USER_MEM_RELEASE:
+         MSGV(PTL_DEBUG, "User memory release");
+         blepn->bp_qwr_busy = false;
+         blepn->bp_qwr_handle = BLE_GATT_HANDLE_INVALID;
+         blepn->bp_qwr_conn_handle = BLE_CONN_HANDLE_INVALID;
+         break;  // BLE_EVT_USER_MEM_RELEASE
+
       case BLE_GATTC_EVT_TIMEOUT:
          // Disconnect on GATT Client timeout event.
          MSGV(PTL_INFO, "GATT Client Timeout");
@@ -1152,6 +2593,11 @@ _adv_ble_evt_handler(const ble_evt_t * ble_evt, void * context)
          break;
 
       case BLE_GATTS_EVT_HVN_TX_COMPLETE:
+         // the SoftDevice reports completion at the end of the connection
+         // event: attributes may be notified again
+         link->bl_notify_sent = 0U;
+         // refill the SoftDevice TX queue
+         _adv_ble_stream_pump(blepn);
          break;
 
       default:
@@ -1159,6 +2605,8 @@ _adv_ble_evt_handler(const ble_evt_t * ble_evt, void * context)
               ble_evt->header.evt_id, ble_evt->evt.gattc_evt.conn_handle);
          break;
    }
+
+   blepn->bp_link = NULL;
 }
 
 /**
@@ -1171,7 +2619,6 @@ _adv_ble_add_characteristics(struct adv_ble * blepn)
 {
    ret_code_t rc;
 
-   ble_uuid128_t base_uuid = ADV_UUID128;
    for (unsigned int cix=0; cix<ADV_COUNT; cix++) {
       struct adv_ble_attribute * pa_attr = &blepn->bp_attributes[cix];
       #ifdef DEBUG
@@ -1180,8 +2627,7 @@ _adv_ble_add_characteristics(struct adv_ble * blepn)
          APP_ERROR_CHECK(NRF_ERROR_INTERNAL);
       }
       #endif // DEBUG
-      rc = sd_ble_uuid_vs_add(&base_uuid, &pa_attr->pa_uuid.type);
-      APP_ERROR_CHECK(rc);
+      pa_attr->pa_uuid.type = blepn->bp_uuid_type;
 
       ble_gatts_attr_t attr = {
          .p_uuid = &pa_attr->pa_uuid,
@@ -1204,42 +2650,65 @@ _adv_ble_add_characteristics(struct adv_ble * blepn)
 
       rc = sd_ble_gatts_characteristic_add(blepn->bp_service_handle, &char_md,
                                            &attr, &pa_attr->pa_handles);
+      if ( NRF_ERROR_NO_MEM == rc ) {
+         MSGV(PTL_FATAL, "Attribute table too small: %u",
+              (unsigned int)ADV_BLE_ATTR_TAB_SIZE);
+      }
       APP_ERROR_CHECK(rc);
+
+      // the handle map is built from the expected handle layout, which
+      // should never differ from the SoftDevice allocation
+      if ( pa_attr->pa_handles.value_handle !=
+           blepn->bp_service_handle + pa_attr->pa_offset ) {
+         MSGV(PTL_FATAL, "Unexpected handle %04x for %s",
+              pa_attr->pa_handles.value_handle, pa_attr->pa_desc.ad_str);
+         APP_ERROR_CHECK(NRF_ERROR_INTERNAL);
+      }
    }
 }
 
 /**
- * Retrieve a PowerAdvertiser BLE attribute from its UUID
+ * Retrieve a PowerAdvertiser BLE attribute from its value handle
+ *
+ * The lookup is a single access to the build time handle map; the UUID is
+ * only used as a sanity check.
  *
  * @param[out] pa_char optional output value, updated with PowerAdvertiser attribute
  *             index if the attribute is found
  * @param[in,out] blepn BLE PowerAdvertiser engine
- * @param[in] ble_uuid BLE PowerAdvertiser UUID to seek
+ * @param[in] handle attribute handle from the GATT event
+ * @param[in] ble_uuid attribute UUID from the GATT event, or @c NULL if the
+ *            event does not carry any
  * @return the PN attribute
  */
 static struct adv_ble_attribute *
 _adv_ble_retrieve_attribute(enum adv_ble_attr * pa_char,
-                           struct adv_ble * blepn, ble_uuid_t const * ble_uuid)
+                           struct adv_ble * blepn, uint16_t handle,
+                           ble_uuid_t const * ble_uuid)
 {
-   if ( (ble_uuid->uuid < ADV_CHAR_UUID_BASE) ||
-        (ble_uuid->type != BLE_UUID_TYPE_VENDOR_BEGIN) ) {
+   uint16_t offset = (uint16_t)(handle - blepn->bp_service_handle);
+   unsigned int attr_ix = (offset < ADV_HANDLE_COUNT) ?
+      _ADV_BLE_HANDLE_MAP[offset] : 0U;
+
+   if ( ! attr_ix ) {
       _adv_ble_set_error_on_attr(blepn, -PE_INVALID_UUID, ADV_ERROR);
-      // we may receive events for all UUID, such as one for notification
+      // we may receive events for all handles, such as one for notification
       // registering
-      MSGV(PTL_INFO, "Not a PN UUID: UUID:%04x Type:%02x",
-                   ble_uuid->uuid, ble_uuid->type);
+      MSGV(PTL_INFO, "Not a PN handle: H:%04x", handle);
       return NULL;
    }
 
-   uint16_t attr_ix =ble_uuid->uuid - ADV_CHAR_UUID_BASE;
-   if ( attr_ix >= ADV_COUNT ) {
+   attr_ix -= 1U;
+   struct adv_ble_attribute * pa_attr = &blepn->bp_attributes[attr_ix];
+
+   if ( ble_uuid && ((ble_uuid->uuid != pa_attr->pa_uuid.uuid) ||
+                     (ble_uuid->type != pa_attr->pa_uuid.type)) ) {
       _adv_ble_set_error_on_attr(blepn, -PE_INVALID_UUID, ADV_ERROR);
-      MSGV(PTL_ERROR, "Invalid UUID: Attr:%d", attr_ix);
+      MSGV(PTL_ERROR, "Invalid UUID: Attr:%u UUID:%04x",
+                      attr_ix, ble_uuid->uuid);
       return NULL;
    }
 
-   struct adv_ble_attribute * pa_attr = &blepn->bp_attributes[attr_ix];
-
    if ( pa_char ) {
       *pa_char = (enum adv_ble_attr)attr_ix;
    }
@@ -1264,10 +2733,55 @@ _adv_ble_write_attr(struct adv_ble * blepn,
 {
    if ( BLE_UUID_TYPE_BLE == wr_evt->uuid.type ) {
       switch (wr_evt->uuid.uuid) {
-         case BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG:
-            // client is registering notification/indication, let the BLE stack
-            // handle this case
+         case BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG: {
+            // client is registering notification/indication, let the BLE
+            // stack handle this case
+            bool enabled =
+               wr_evt->len && (wr_evt->data[0] & BLE_GATT_HVX_NOTIFICATION);
+            uint16_t conn_handle = _adv_ble_conn_handle(blepn);
+            struct adv_ble_link * link = blepn->bp_link;
+            for (unsigned int aix=ADV_FIRST; link && (aix<ADV_LAST); aix++) {
+               if ( wr_evt->handle !=
+                    blepn->bp_attributes[aix].pa_handles.cccd_handle ) {
+                  continue;
+               }
+               uint32_t mask = 1UL << aix;
+               CRITICAL_REGION_ENTER();
+               if ( enabled ) {
+                  // send the current value, so that the peer never needs
+                  // to read the attribute
+                  link->bl_notify_enabled |= mask;
+                  link->bl_notify_pending |= mask;
+               } else {
+                  link->bl_notify_enabled &= ~mask;
+                  link->bl_notify_pending &= ~mask;
+               }
+               CRITICAL_REGION_EXIT();
+            }
+            for (unsigned int six=0; six<ADV_BLE_STREAM_COUNT; six++) {
+               struct adv_ble_stream * stream = &blepn->bp_streams[six];
+               const struct adv_ble_attribute * attr =
+                  &blepn->bp_attributes[stream->bs_attr];
+               if ( wr_evt->handle != attr->pa_handles.cccd_handle ) {
+                  continue;
+               }
+               // a stream is sent to the last link that has subscribed
+               if ( enabled ) {
+                  stream->bs_conn_handle = conn_handle;
+               } else if ( stream->bs_conn_handle == conn_handle ) {
+                  stream->bs_conn_handle = BLE_CONN_HANDLE_INVALID;
+               }
+            }
+            if ( enabled && (wr_evt->handle ==
+                 blepn->bp_attributes[ADV_TRACE].pa_handles.cccd_handle) ) {
+               // traces are now streamed to the client, starting with
+               // the ones already in the trace queue
+               _adv_ble_trace_attach();
+            }
+            // a stream or an attribute notification may start
+            _adv_ble_stream_pump(blepn);
             return;
+         }
          default:
             MSGV(PTL_ERROR, "Write to std uuid 0x%04x", wr_evt->uuid.uuid);
             return;
@@ -1275,7 +2789,8 @@ _adv_ble_write_attr(struct adv_ble * blepn,
    }
 
    // only to get warnings for a unexpected write event
-   (void)_adv_ble_retrieve_attribute(NULL, blepn, &wr_evt->uuid);
+   (void)_adv_ble_retrieve_attribute(NULL, blepn, wr_evt->handle,
+                                     &wr_evt->uuid);
 }
 
 /**
@@ -1293,37 +2808,32 @@ static void
 _adv_ble_write_req(struct adv_ble * blepn,
                   const ble_gatts_evt_write_t * wr_evt)
 {
-   ret_code_t errcode;
-
    switch ( wr_evt->op ) {
       case BLE_GATTS_OP_PREP_WRITE_REQ:
+         _adv_ble_prepare_write_req(blepn, wr_evt);
+         return;
       case BLE_GATTS_OP_EXEC_WRITE_REQ_NOW:
-      case BLE_GATTS_OP_EXEC_WRITE_REQ_CANCEL: {
-            const ble_gatts_rw_authorize_reply_params_t auth_reply = {
-               .type = BLE_GATTS_AUTHORIZE_TYPE_WRITE,
-               .params.write = {
-                  .gatt_status = APP_FEATURE_NOT_SUPPORTED,
-                  .update = false,
-                  .offset = 0,
-                  .len = 0,
-                  .p_data = NULL,
-               },
-            };
-            MSGV(PTL_ERROR, "Unsupported write request: 0x%04x", wr_evt->op);
-            errcode = sd_ble_gatts_rw_authorize_reply(blepn->bp_conn_handle,
-                                                      &auth_reply);
-            APP_ERROR_CHECK(errcode);
-            return;
-         }
-      default:
+         _adv_ble_execute_write_req(blepn);
+         return;
+      case BLE_GATTS_OP_EXEC_WRITE_REQ_CANCEL:
+         MSGV(PTL_INFO, "Queued writes cancelled");
+         blepn->bp_qwr_handle = BLE_GATT_HANDLE_INVALID;
+         _adv_ble_reply_write_status(blepn, BLE_GATT_STATUS_SUCCESS);
+         return;
+      case BLE_GATTS_OP_WRITE_REQ:
          break;
+      default:
+         MSGV(PTL_ERROR, "Unsupported write request: 0x%04x", wr_evt->op);
+         _adv_ble_reply_write_status(blepn, APP_FEATURE_NOT_SUPPORTED);
+         return;
    }
 
    int rc = -PE_INVALID_UUID;
 
-   enum adv_ble_attr pa_char;
+   enum adv_ble_attr pa_char = ADV_COUNT;
    struct adv_ble_attribute * pa_attr =
-       _adv_ble_retrieve_attribute(&pa_char, blepn, &wr_evt->uuid);
+       _adv_ble_retrieve_attribute(&pa_char, blepn, wr_evt->handle,
+                                   &wr_evt->uuid);
    if ( ! pa_attr ) {
       MSGV(PTL_ERROR, "Write to unknown attribute rejected");
    }
@@ -1334,15 +2844,22 @@ _adv_ble_write_req(struct adv_ble * blepn,
       rc = -PE_ABORT; // special marker, see below
    }
 
+   struct adv_ble_attr_event * event =
+      _adv_ble_request_alloc(blepn, ADV_BLE_REQ_WRITE, pa_attr);
+   if ( ! event ) {
+      _adv_ble_reject_request(blepn, BLE_GATTS_AUTHORIZE_TYPE_WRITE, pa_char);
+      return;
+   }
+
    if ( pa_attr ) {
-      rc = _adv_ble_write_attribute(blepn, pa_attr, wr_evt);
+      rc = _adv_ble_write_attribute(blepn, event, wr_evt);
 
       if ( PE_DEFERRED == rc ) {
          // the completion callback should take care of calling
-         // sd_ble_gatts_rw_authorize_reply
+         // _adv_ble_complete_write_req
          // note that BLE core spec limits execution time to 30 seconds max.
-         MSGV(PTL_CHATTY, "Delayed completion for %s",
-              pa_attr->pa_desc.ad_str);
+         MSGV(PTL_CHATTY, "Delayed completion for %s, req %u",
+              pa_attr->pa_desc.ad_str, event->ae_id);
          return;
       }
       if ( rc < 0 ) {
@@ -1351,30 +2868,26 @@ _adv_ble_write_req(struct adv_ble * blepn,
       }
    }
 
-   _adv_ble_complete_write_req(rc);
-
-   if ( ! rc && blepn->bp_reboot ) {
-      // first trigger a disconnection
-      // as the reboot flag has been set, the disconnection event handler
-      // will resume with rebooting
-      _adv_ble_disconnect();
-   }
+   _adv_ble_complete_write_req(event->ae_id, rc);
 }
 
 /**
  * Execute a remote request to update a local attribute.
  *
  * @param[in,out] blepn BLE PowerAdvertiser engine
- * @param[in] pa_attr PowerAdvertiser attribute
+ * @param[in,out] event pending request record for the attribute
  * @param[in] wr_evt BLE write event
- * @return @c PE_NO_ERROR on success, a negative error code if value failed
- *         to pass the sanity check
+ * @return @c PE_NO_ERROR on success, @c PE_DEFERRED if the request completes
+ *         later, a negative error code if value failed to pass the sanity
+ *         check
  */
 static int
 _adv_ble_write_attribute(struct adv_ble * blepn,
-                        struct adv_ble_attribute * pa_attr,
+                        struct adv_ble_attr_event * event,
                         const ble_gatts_evt_write_t * wr_evt)
 {
+   struct adv_ble_attribute * pa_attr = event->ae_attr;
+
    if ( wr_evt->op != BLE_GATTS_OP_WRITE_REQ ) {
       MSGV(PTL_ERROR, "Not a write op");
       return -PE_INVALID_COMMAND;
@@ -1400,78 +2913,302 @@ _adv_ble_write_attribute(struct adv_ble * blepn,
       return -PE_READ_ONLY;
    }
 
-   struct adv_ble_attr_event * event = &blepn->bp_attr_event;
-   if ( event->ae_data || event->ae_attr ) {
-      MSGV(PTL_ERROR, "Previous request never completed");
-      // in case of deadlock, a disconnection should reset this
-      return -PE_BUSY;
+   if ( wr_evt->len > ADV_BLE_TRANSIENT_SIZE ) {
+      // The transient storage fits any writable attribute, which is checked
+      // at build time: only an unexpected/undocumented behaviour of the BLE
+      // stack could trigger this error.
+      MSGV(PTL_ERROR, "Transcient storage invalid definition");
+      return -PE_NOT_SUPPORTED;
    }
 
    // valid request, reset the sleep timer
    _adv_ble_worker_feed();
 
-   int rc;
-
-   event->ae_data = wr_evt->data;
+   // the write event is whipped out from memory (and its memory space
+   // re-used) as soon as this event has been handled, while the request may
+   // be deferred or wait for a previous request to complete. Copy the data
+   // into the transient storage of the request record.
    event->ae_length = wr_evt->len;
    event->ae_offset = wr_evt->offset;
-   event->ae_attr = pa_attr;
-
-   if ( event->ae_length > sizeof(_adv_ble_var.pv_transient) ) {
-      // There should be no reason for this error to occur, except if
-      // the attribute storage space would exceed the transcient storage
-      // container, which should not occur except if the size of the latter
-      // has not been updated when the definition of the former has changed.
-      // It is unfortunately difficult to detect at build time without
-      // relying on ugly macros, so perform sanity check at run time, which
-      // also protect against unexpected/undocumented behaviour of the BLE
-      // stack.
-      MSGV(PTL_ERROR, "Transcient storage invalid definition");
-      rc = -PE_NOT_SUPPORTED;
-      return rc;
+   if ( event->ae_length > 0 ) {
+      uint8_t * transient = _adv_ble_request_transient(blepn, event);
+      memcpy(transient, wr_evt->data, event->ae_length);
+      event->ae_data = transient;
    }
 
-   rc = pa_attr->pa_writer(&wr_evt->data[0], (size_t)wr_evt->len);
+   if ( _adv_ble_request_is_blocked(blepn, event) ) {
+      // keep per-attribute ordering: run once previous requests complete
+      MSGV(PTL_DEBUG, "Write to %s queued, req %u",
+                      pa_attr->pa_desc.ad_str, event->ae_id);
+      event->ae_waiting = true;
+      return PE_DEFERRED;
+   }
 
-   if ( PE_DEFERRED == rc ) {
-      // if completion is deferred, the write event is whipped out from
-      // memory (and its memory space re-used), so there should be no longer
-      // references to it. Copy the data that needs to be preserved into the
-      // special storage container.
-      if ( event->ae_length > 0 ) {
-         memcpy(_adv_ble_var.pv_transient, event->ae_data, event->ae_length);
-         event->ae_data = &_adv_ble_var.pv_transient[0];
-      } else {
-         event->ae_data = NULL;
-         event->ae_length = 0U;
-      }
+   return pa_attr->pa_writer(event->ae_data, (size_t)event->ae_length,
+                             event->ae_id);
+}
+
+/**
+ * Handle a prepare write request, i.e. a chunk of a long or reliable write.
+ * The SoftDevice stores the chunk into the queued write memory block; only
+ * check whether the chunk may be accepted.
+ *
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ * @param[in] wr_evt BLE write event
+ */
+static void
+_adv_ble_prepare_write_req(struct adv_ble * blepn,
+                           const ble_gatts_evt_write_t * wr_evt)
+{
+   uint16_t gatt_status = BLE_GATT_STATUS_SUCCESS;
+   int rc = PE_NO_ERROR;
+
+   enum adv_ble_attr pa_char = ADV_COUNT;
+   struct adv_ble_attribute * pa_attr =
+       _adv_ble_retrieve_attribute(&pa_char, blepn, wr_evt->handle,
+                                   &wr_evt->uuid);
+
+   if ( ! pa_attr || ! pa_attr->pa_writer ) {
+      MSGV(PTL_ERROR, "Prepare write to %04x rejected", wr_evt->handle);
+      rc = -PE_READ_ONLY;
+      gatt_status = BLE_GATT_STATUS_ATTERR_WRITE_NOT_PERMITTED;
+   } else if ( blepn->bp_entering_sleep ) {
+      MSGV(PTL_WARN, "PN is entering sleep, no request is accepted");
+      gatt_status = BLE_GATT_STATUS_ATTERR_UNLIKELY_ERROR;
+   } else if ( ! blepn->bp_qwr_busy ||
+               (blepn->bp_qwr_conn_handle != _adv_ble_conn_handle(blepn)) ) {
+      // the SoftDevice should never queue writes w/o user memory
+      MSGV(PTL_ERROR, "Prepare write w/o memory block");
+      rc = -PE_INTERNAL;
+      gatt_status = BLE_GATT_STATUS_ATTERR_PREPARE_QUEUE_FULL;
+   } else if ( (BLE_GATT_HANDLE_INVALID != blepn->bp_qwr_handle) &&
+               (wr_evt->handle != blepn->bp_qwr_handle) ) {
+      // writers expect a single contiguous buffer, which cannot be
+      // guaranteed when several attributes are updated at once
+      MSGV(PTL_ERROR, "Queued writes to several attributes");
+      rc = -PE_NOT_SUPPORTED;
+      gatt_status = APP_FEATURE_NOT_SUPPORTED;
+   } else if ( wr_evt->offset > pa_attr->pa_size ) {
+      MSGV(PTL_ERROR, "Invalid offset %u", wr_evt->offset);
+      rc = -PE_OVERFLOW;
+      gatt_status = BLE_GATT_STATUS_ATTERR_INVALID_OFFSET;
+   } else if ( (size_t)wr_evt->offset + wr_evt->len > pa_attr->pa_size ) {
+      MSGV(PTL_ERROR, "Size overflow");
+      rc = -PE_OVERFLOW;
+      gatt_status = BLE_GATT_STATUS_ATTERR_INVALID_ATT_VAL_LENGTH;
+   } else {
+      blepn->bp_qwr_handle = wr_evt->handle;
+      _adv_ble_worker_feed();
    }
 
-   return rc;
+   if ( rc < 0 ) {
+      _adv_ble_set_error_on_attr(blepn, rc, pa_char);
+   }
+
+   _adv_ble_reply_write_status(blepn, gatt_status);
 }
 
 /**
- * Complete a attribute request and reply to the peer
+ * Handle an execute write request, i.e. the completion of a long or
+ * reliable write.
  *
- * @param[in] retcode the completion code of the write request
+ * @param[in,out] blepn BLE PowerAdvertiser engine
  */
 static void
-_adv_ble_complete_write_req(int retcode)
+_adv_ble_execute_write_req(struct adv_ble * blepn)
 {
-   struct adv_ble * blepn = &_adv_ble;
-   struct adv_ble_attr_event * event = &blepn->bp_attr_event;
+   int rc = -PE_INVALID_REQUEST;
 
-   if ( (! event->ae_data) || (! event->ae_attr) ) {
-      // this may occur with a deferred completion that fails to update the
-      // event
-      MSGV(PTL_ERROR, "Nil event");
-      retcode = -PE_INTERNAL;
+   uint16_t handle = blepn->bp_qwr_handle;
+   blepn->bp_qwr_handle = BLE_GATT_HANDLE_INVALID;
+
+   enum adv_ble_attr pa_char = ADV_COUNT;
+   struct adv_ble_attribute * pa_attr = NULL;
+   if ( BLE_GATT_HANDLE_INVALID != handle ) {
+      pa_attr = _adv_ble_retrieve_attribute(&pa_char, blepn, handle, NULL);
+   } else {
+      MSGV(PTL_ERROR, "Execute write w/o prepared write");
    }
 
+   if ( blepn->bp_entering_sleep ) {
+      MSGV(PTL_WARN, "PN is entering sleep, no request is accepted");
+      pa_attr = NULL;
+      rc = -PE_ABORT; // special marker, see _adv_ble_complete_write_req
+   }
+
+   struct adv_ble_attr_event * event =
+      _adv_ble_request_alloc(blepn, ADV_BLE_REQ_WRITE, pa_attr);
+   if ( ! event ) {
+      _adv_ble_reject_request(blepn, BLE_GATTS_AUTHORIZE_TYPE_WRITE, pa_char);
+      return;
+   }
+   event->ae_queued = true;
+
+   if ( pa_attr ) {
+      rc = _adv_ble_queued_write_attribute(blepn, event);
+
+      if ( PE_DEFERRED == rc ) {
+         MSGV(PTL_CHATTY, "Delayed completion for %s, req %u",
+              pa_attr->pa_desc.ad_str, event->ae_id);
+         return;
+      }
+      if ( rc < 0 ) {
+         MSGV(PTL_ERROR, "Queued write to %s failed to execute: %d",
+                         pa_attr->pa_desc.ad_str, rc);
+      }
+   }
+
+   _adv_ble_complete_write_req(event->ae_id, rc);
+}
+
+/**
+ * Execute queued writes to a local attribute.
+ *
+ * The SoftDevice stores the queued writes into the user memory block as a
+ * sequence of { handle, offset, length, data } records, terminated with an
+ * invalid handle. Chunks are compacted in place at the beginning of the
+ * block, so that the writer receives the whole value as a single buffer,
+ * which lives in the block until the request completes.
+ *
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ * @param[in,out] event pending request record for the attribute
+ * @return @c PE_NO_ERROR on success, @c PE_DEFERRED if the request completes
+ *         later, a negative error code if value failed to pass the sanity
+ *         check
+ */
+static int
+_adv_ble_queued_write_attribute(struct adv_ble * blepn,
+                                struct adv_ble_attr_event * event)
+{
+   struct adv_ble_attribute * pa_attr = event->ae_attr;
+
+   if ( ! blepn->bp_qwr_busy ) {
+      MSGV(PTL_ERROR, "Execute write w/o memory block");
+      return -PE_INTERNAL;
+   }
+
+   uint8_t * data = blepn->bp_qwr_block.p_mem;
+   const uint8_t * pos = data;
+   const uint8_t * end = data + blepn->bp_qwr_block.len;
+   size_t length = 0;
+
+   while ( (size_t)(end - pos) >= ADV_BLE_QWR_HEADER_SIZE ) {
+      uint16_t qw_handle;
+      uint16_t qw_offset;
+      uint16_t qw_length;
+      get_uint16(&qw_handle, &pos[0]);
+      if ( BLE_GATT_HANDLE_INVALID == qw_handle ) {
+         break;
+      }
+      get_uint16(&qw_offset, &pos[sizeof(uint16_t)]);
+      get_uint16(&qw_length, &pos[2U*sizeof(uint16_t)]);
+      pos += ADV_BLE_QWR_HEADER_SIZE;
+
+      if ( qw_length > (size_t)(end - pos) ) {
+         MSGV(PTL_ERROR, "Truncated queued write");
+         return -PE_INVALID_REQUEST;
+      }
+      if ( qw_handle != pa_attr->pa_handles.value_handle ) {
+         MSGV(PTL_ERROR, "Queued write to unexpected handle %04x", qw_handle);
+         return -PE_NOT_SUPPORTED;
+      }
+      if ( qw_offset != length ) {
+         MSGV(PTL_ERROR, "Non-contiguous queued write @ %u", qw_offset);
+         return -PE_NOT_SUPPORTED;
+      }
+      if ( length + qw_length > pa_attr->pa_size ) {
+         MSGV(PTL_ERROR, "Size overflow");
+         return -PE_OVERFLOW;
+      }
+
+      // chunk data always lies after its final location, as at least one
+      // record header has been skipped
+      memmove(&data[length], pos, qw_length);
+      length += qw_length;
+      pos += qw_length;
+   }
+
+   if ( ! pa_attr->pa_varsize && (length != pa_attr->pa_size) ) {
+      MSGV(PTL_ERROR, "Size mismatch");
+      return -PE_INVALID_REQUEST;
+   }
+
+   if ( ! pa_attr->pa_writer ) {
+      MSGV(PTL_ERROR, "Write request w/ no executer");
+      return -PE_READ_ONLY;
+   }
+
+   // valid request, reset the sleep timer
+   _adv_ble_worker_feed();
+
+   event->ae_data = length ? data : NULL;
+   event->ae_length = (uint16_t)length;
+   event->ae_offset = 0U;
+
+   if ( _adv_ble_request_is_blocked(blepn, event) ) {
+      // keep per-attribute ordering: run once previous requests complete
+      MSGV(PTL_DEBUG, "Queued write to %s queued, req %u",
+                      pa_attr->pa_desc.ad_str, event->ae_id);
+      event->ae_waiting = true;
+      return PE_DEFERRED;
+   }
+
+   return pa_attr->pa_writer(event->ae_data, (size_t)event->ae_length,
+                             event->ae_id);
+}
+
+/**
+ * Reply to a write request with a status only, without any data update.
+ *
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ * @param[in] gatt_status GATT status to reply with
+ */
+static void
+_adv_ble_reply_write_status(struct adv_ble * blepn, uint16_t gatt_status)
+{
+   const ble_gatts_rw_authorize_reply_params_t auth_reply = {
+      .type = BLE_GATTS_AUTHORIZE_TYPE_WRITE,
+      .params.write = {
+         .gatt_status = gatt_status,
+         .update = false,
+         .offset = 0,
+         .len = 0,
+         .p_data = NULL,
+      },
+   };
+
+   ret_code_t errcode;
+   errcode = sd_ble_gatts_rw_authorize_reply(_adv_ble_conn_handle(blepn),
+                                             &auth_reply);
+   APP_ERROR_CHECK(errcode);
+}
+
+/**
+ * Complete a attribute request and reply to the peer
+ *
+ * @param[in] req_id the identifier of the request to complete
+ * @param[in] retcode the completion code of the write request
+ */
+static void
+_adv_ble_complete_write_req(unsigned int req_id, int retcode)
+{
+   struct adv_ble * blepn = &_adv_ble;
+   struct adv_ble_attr_event * event = _adv_ble_request_find(blepn, req_id,
+                                                            ADV_BLE_REQ_WRITE);
+
+   if ( ! event ) {
+      // this may occur with a deferred completion that outlived its
+      // connection, there is no longer any peer to reply to
+      MSGV(PTL_ERROR, "Unknown write request %u", req_id);
+      return;
+   }
+
+   struct adv_ble_attribute * pa_attr = event->ae_attr;
+
    uint16_t gatt_status;
    if ( retcode < 0 ) {
       if ( retcode != -PE_ABORT ) {
-         enum adv_ble_attr pa_char = _adv_ble_attribute_char(event->ae_attr);
+         enum adv_ble_attr pa_char = _adv_ble_attribute_char(pa_attr);
          _adv_ble_set_error_on_attr(blepn, retcode, pa_char);
          gatt_status = BLE_GATT_STATUS_ATTERR_WRITE_NOT_PERMITTED;
       } else {
@@ -1479,35 +3216,65 @@ _adv_ble_complete_write_req(int retcode)
          // valid (BT core spec V4.2 Vol 3 Part F, section 3.3)
          gatt_status = BLE_GATT_STATUS_ATTERR_UNLIKELY_ERROR;
       }
+   } else if ( ! pa_attr ) {
+      // this may occur with a deferred completion that fails to update the
+      // event
+      MSGV(PTL_ERROR, "Nil event");
+      retcode = -PE_INTERNAL;
+      _adv_ble_set_error_on_attr(blepn, retcode, ADV_ERROR);
+      gatt_status = BLE_GATT_STATUS_ATTERR_WRITE_NOT_PERMITTED;
    } else {
       gatt_status = BLE_GATT_STATUS_SUCCESS;
-      event->ae_attr->pa_length = event->ae_length + event->ae_offset;
+      pa_attr->pa_length = event->ae_length + event->ae_offset;
    };
 
+   // queued writes are not applied by the SoftDevice, which only expects
+   // a status for the execute request
+   const bool update = (PE_NO_ERROR == retcode) && ! event->ae_queued;
    const ble_gatts_rw_authorize_reply_params_t auth_reply = {
       .type = BLE_GATTS_AUTHORIZE_TYPE_WRITE,
       .params.write = {
          .gatt_status = gatt_status,
-         .update = PE_NO_ERROR == retcode,
-         .offset = event->ae_offset,
-         .len = event->ae_length,
-         .p_data = event->ae_data,
+         .update = update,
+         .offset = update ? event->ae_offset : 0U,
+         .len = update ? event->ae_length : 0U,
+         .p_data = update ? event->ae_data : NULL,
       },
    };
 
-   MSGV(PTL_DEBUG, "%s written, rc %d",
-        event->ae_attr ? event->ae_attr->pa_desc.ad_str : "?", retcode);
-
-   event->ae_data = NULL;
-   event->ae_length = 0U;
-   event->ae_offset = 0U;
-   event->ae_attr = NULL;
+   MSGV(PTL_DEBUG, "%s written, req %u rc %d",
+        pa_attr ? pa_attr->pa_desc.ad_str : "?", req_id, retcode);
 
    ret_code_t errcode;
 
-   errcode = sd_ble_gatts_rw_authorize_reply(blepn->bp_conn_handle,
+   if ( event->ae_queued && (PE_NO_ERROR == retcode) ) {
+      ble_gatts_value_t value = {
+         .len = event->ae_length,
+         .offset = 0U,
+         .p_value = (uint8_t *)event->ae_data,
+      };
+      errcode = sd_ble_gatts_value_set(event->ae_conn_handle,
+                                       pa_attr->pa_handles.value_handle,
+                                       &value);
+      APP_ERROR_CHECK(errcode);
+   }
+
+   // the reply data lives in the request transient storage, so the record
+   // should only be released once the SoftDevice has copied it out
+   errcode = sd_ble_gatts_rw_authorize_reply(event->ae_conn_handle,
                                              &auth_reply);
+   _adv_ble_request_free(event);
    APP_ERROR_CHECK(errcode);
+
+   if ( ! retcode && blepn->bp_reboot ) {
+      // first trigger a disconnection
+      // as the reboot flag has been set, the disconnection event handler
+      // will resume with rebooting
+      _adv_ble_disconnect(NULL);
+      return;
+   }
+
+   _adv_ble_request_next(blepn, pa_attr);
 }
 
 /**
@@ -1524,9 +3291,10 @@ _adv_ble_read_req(struct adv_ble * blepn,
 {
    int rc = -PE_INTERNAL;
 
-   enum adv_ble_attr pa_char;
+   enum adv_ble_attr pa_char = ADV_COUNT;
    struct adv_ble_attribute * pa_attr =
-       _adv_ble_retrieve_attribute(&pa_char, blepn, &rd_evt->uuid);
+       _adv_ble_retrieve_attribute(&pa_char, blepn, rd_evt->handle,
+                                   &rd_evt->uuid);
    if ( ! pa_attr ) {
       rc = -PE_INVALID_UUID;
       MSGV(PTL_ERROR, "Write to unknown attribute rejected");
@@ -1542,74 +3310,59 @@ _adv_ble_read_req(struct adv_ble * blepn,
       rc = -PE_ABORT; // special marker, see below
    }
 
-   struct adv_ble_attr_event * event = &blepn->bp_attr_event;
-   if ( event->ae_data || event->ae_attr ) {
-      MSGV(PTL_ERROR, "Previous request never completed");
-      // in case of deadlock, a disconnection should reset this
-      pa_attr = NULL;
-      rc = -PE_BUSY;
+   struct adv_ble_attr_event * event =
+      _adv_ble_request_alloc(blepn, ADV_BLE_REQ_READ, pa_attr);
+   if ( ! event ) {
+      _adv_ble_reject_request(blepn, BLE_GATTS_AUTHORIZE_TYPE_READ, pa_char);
+      return;
    }
 
-   if ( pa_attr ) {
-      _adv_ble_worker_feed();
-
-      event->ae_attr = pa_attr;
-
-      // clear out the attribute length if it has a variable size...
-      if ( pa_attr->pa_varsize ) {
-            pa_attr->pa_length = 0;
-      } else {
-         pa_attr->pa_length = pa_attr->pa_size;
-      }
-
-      if ( pa_attr->pa_reader ) {
-         event->ae_data = NULL;
-         event->ae_length = 0U;
-         event->ae_offset = 0U;
-
-         MSGV(PTL_DEBUG, "Read from %s", pa_attr->pa_desc.ad_str);
-
-         rc = pa_attr->pa_reader(pa_attr);
-
-         if ( PE_DEFERRED == rc ) {
-            // the completion callback should take care of calling
-            // _adv_ble_complete_read_req
-            // note that BLE core spec limits execution time to 30 seconds max.
-            return;
-         }
+   if ( ! pa_attr ) {
+      _adv_ble_complete_read_req(event->ae_id, rc);
+      return;
+   }
 
-         if ( rc < 0 ) {
-            MSGV(PTL_ERROR, "Read executer failed for %s",
-                            pa_attr->pa_desc.ad_str);
-         }
-      } else {
-         MSGV(PTL_CHATTY, "No read executer for %s", pa_attr->pa_desc.ad_str);
+   _adv_ble_worker_feed();
 
-         rc = PE_NO_ERROR;
-      }
+   if ( _adv_ble_request_is_blocked(blepn, event) ) {
+      // keep per-attribute ordering: run once previous requests complete
+      MSGV(PTL_DEBUG, "Read from %s queued, req %u",
+                      pa_attr->pa_desc.ad_str, event->ae_id);
+      event->ae_waiting = true;
+      return;
    }
 
-   _adv_ble_complete_read_req(rc);
+   _adv_ble_request_dispatch(event);
 }
 
 /**
  * Complete a attribute request and reply to the peer
  *
- * @param[in] retcode the completion code of the write request
+ * @param[in] req_id the identifier of the request to complete
+ * @param[in] retcode the completion code of the read request
  */
 static void
-_adv_ble_complete_read_req(int retcode)
+_adv_ble_complete_read_req(unsigned int req_id, int retcode)
 {
    struct adv_ble * blepn = &_adv_ble;
-   struct adv_ble_attr_event * event = &blepn->bp_attr_event;
+   struct adv_ble_attr_event * event = _adv_ble_request_find(blepn, req_id,
+                                                            ADV_BLE_REQ_READ);
 
-   if ( ! event->ae_attr ) {
-      MSGV(PTL_ERROR, "Invalid event record: 0x%08x",
-                      (uintptr_t)event->ae_attr);
-      retcode = -PE_INTERNAL;
+   if ( ! event ) {
+      // this may occur with a deferred completion that outlived its
+      // connection, there is no longer any peer to reply to
+      MSGV(PTL_ERROR, "Unknown read request %u", req_id);
+      return;
    }
+
+   struct adv_ble_attribute * pa_attr = event->ae_attr;
+
    if ( ! retcode ) {
-      if ( ! event->ae_attr->pa_length ) {
+      if ( ! pa_attr ) {
+         MSGV(PTL_ERROR, "Invalid event record: 0x%08x",
+              (unsigned int)(uintptr_t)pa_attr);
+         retcode = -PE_INTERNAL;
+      } else if ( ! pa_attr->pa_length ) {
          // this may occur with variable size attribute whose reader function
          // failed to update the attribute length
          MSGV(PTL_ERROR, "Nil event");
@@ -1625,20 +3378,20 @@ _adv_ble_complete_read_req(int retcode)
             .gatt_status = BLE_GATT_STATUS_SUCCESS,
             .update = true,
             .offset = 0U,
-            .len = (uint16_t)event->ae_attr->pa_length,
-            .p_data = event->ae_attr->pa_var,
+            .len = (uint16_t)pa_attr->pa_length,
+            .p_data = pa_attr->pa_var,
          },
       };
 
-      errcode = sd_ble_gatts_rw_authorize_reply(blepn->bp_conn_handle,
+      errcode = sd_ble_gatts_rw_authorize_reply(event->ae_conn_handle,
                                                 &reply_auth);
    } else {
-      MSGV(PTL_DEBUG, "Complete failed read: %d", retcode);
+      MSGV(PTL_DEBUG, "Complete failed read: req %u rc %d", req_id, retcode);
       uint16_t gatt_status;
 
       if ( retcode != -PE_ABORT ) {
          // _adv_ble_attribute_char accepts invalid pointers
-         enum adv_ble_attr pa_char = _adv_ble_attribute_char(event->ae_attr);
+         enum adv_ble_attr pa_char = _adv_ble_attribute_char(pa_attr);
          _adv_ble_set_error_on_attr(blepn, retcode, pa_char);
          gatt_status = BLE_GATT_STATUS_ATTERR_READ_NOT_PERMITTED;
       } else {
@@ -1654,192 +3407,1322 @@ _adv_ble_complete_read_req(int retcode)
          },
       };
 
-      errcode = sd_ble_gatts_rw_authorize_reply(blepn->bp_conn_handle,
+      errcode = sd_ble_gatts_rw_authorize_reply(event->ae_conn_handle,
                                                 &reply_auth);
    }
+   _adv_ble_request_free(event);
    APP_ERROR_CHECK(errcode);
 
-   event->ae_data = NULL;
-   event->ae_length = 0U;
-   event->ae_offset = 0U;
-   event->ae_attr = NULL;
+   _adv_ble_request_next(blepn, pa_attr);
 }
 
 /**
- * Update the ADV_ERROR BLE attribute, to store error information for the client
+ * Allocate a pending request record.
  *
  * @param[in,out] blepn BLE PowerAdvertiser engine
- * @param[in] errno error code to store
- * @param[in] pa_char attribute access that triggered the error
+ * @param[in] op request type
+ * @param[in] pa_attr target attribute, may be @c NULL for a request that is
+ *            to be rejected
+ * @return the request record, or @c NULL if all records are in use
  */
-static struct adv_ble_attribute *
-_adv_ble_set_error_on_attr(struct adv_ble * blepn,
-                          int errno,
-                          enum adv_ble_attr pa_char)
+static struct adv_ble_attr_event *
+_adv_ble_request_alloc(struct adv_ble * blepn, enum adv_ble_req_op op,
+                       struct adv_ble_attribute * pa_attr)
 {
-   const struct adv_ble_attribute * pa_attr;
-   if ( (pa_char < ADV_FIRST) || (pa_char >= ADV_LAST) ) {
-      // if the attribute is invalid, force the error attribute to flag the
-      // error
-      pa_char = ADV_ERROR;
+   for (unsigned int rix=0; rix<ADV_BLE_REQUEST_COUNT; rix++) {
+      struct adv_ble_attr_event * event = &blepn->bp_attr_events[rix];
+      if ( event->ae_id ) {
+         continue;
+      }
+      // identifiers encode the record slot, and a generation so that a late
+      // completion does not hit a record that has been re-allocated
+      blepn->bp_req_gen = (uint8_t)((blepn->bp_req_gen %
+                                     ADV_BLE_REQUEST_GEN_MAX) + 1U);
+      memset(event, 0, sizeof(*event));
+      event->ae_id = (uint8_t)(blepn->bp_req_gen * ADV_BLE_REQUEST_COUNT +
+                               rix);
+      event->ae_op = (uint8_t)op;
+      event->ae_attr = pa_attr;
+      event->ae_conn_handle = _adv_ble_conn_handle(blepn);
+      event->ae_seq = blepn->bp_req_seq++;
+      return event;
    }
-   pa_attr = _adv_ble_get_attribute(blepn, pa_char);
-   MSGV(PTL_INFO, "Store error %d for attribute %u %s",
-                  errno, pa_char, pa_attr ? pa_attr->pa_desc.ad_str : "?");
-   struct adv_ble_attribute * pa_error = _adv_ble_get_attribute(blepn, ADV_ERROR);
-   struct pa_error_desc * bpe = (struct pa_error_desc *)pa_error->pa_var;
-   bpe->pe_errno = (int8_t)errno;
-   bpe->pe_attr = (uint8_t)pa_char;
-   return pa_error;
+
+   MSGV(PTL_ERROR, "No free request record");
+   return NULL;
 }
 
 /**
- * Retrieve the BLE PowerAdvertiser attribute from its identifier
+ * Retrieve a pending request record from its identifier.
  *
  * @param[in,out] blepn BLE PowerAdvertiser engine
- * @param[in] pa_char attribute identifier
- * @return PowerAdvertiser attribute or @c NULL if not found
+ * @param[in] req_id request identifier
+ * @param[in] op expected request type
+ * @return the request record, or @c NULL if no such request is pending
  */
-static struct adv_ble_attribute *
-_adv_ble_get_attribute(struct adv_ble * blepn,
-                      enum adv_ble_attr pa_char)
+static struct adv_ble_attr_event *
+_adv_ble_request_find(struct adv_ble * blepn, unsigned int req_id,
+                      enum adv_ble_req_op op)
 {
-   if ( (pa_char >= ADV_FIRST) && (pa_char < ADV_LAST) ) {
-      return &blepn->bp_attributes[pa_char];
+   if ( (req_id < ADV_BLE_REQUEST_COUNT) || (req_id > UINT8_MAX) ) {
+      return NULL;
    }
 
-   MSGV(PTL_FATAL, "Invalid attribute %u", pa_char);
-   APP_ERROR_CHECK(NRF_FAULT_ID_SDK_ASSERT);
+   struct adv_ble_attr_event * event =
+      &blepn->bp_attr_events[req_id % ADV_BLE_REQUEST_COUNT];
+   if ( (event->ae_id != req_id) || (event->ae_op != op) ) {
+      return NULL;
+   }
 
-   return NULL;
+   return event;
 }
 
 /**
- * Handle disconnection
+ * Release a pending request record.
  *
- * @param[in,out] blepn BLE PowerAdvertiser engine
+ * @param[in,out] event request record to release
  */
 static void
-_adv_ble_handle_disconnect(struct adv_ble * blepn)
+_adv_ble_request_free(struct adv_ble_attr_event * event)
 {
-   // cleanup a potential deadlock case
-   memset(&blepn->bp_attr_event, 0, sizeof(struct adv_ble_attr_event));
+   memset(event, 0, sizeof(*event));
 }
 
 /**
- * Prepare the PN to enter sleep mode
+ * Retrieve the transient storage of a pending request record.
  *
  * @param[in,out] blepn BLE PowerAdvertiser engine
+ * @param[in] event request record
+ * @return the transient storage area, ADV_BLE_TRANSIENT_SIZE bytes long
  */
-static void
-_adv_ble_enter_sleep(struct adv_ble * blepn)
+static uint8_t *
+_adv_ble_request_transient(struct adv_ble * blepn,
+                           const struct adv_ble_attr_event * event)
 {
-   // restore advertisement configuration that may have been changed
-   _adv_ble_advertising.adv_modes_config.ble_adv_fast_timeout =
-      _ADV_BLE_ADVERTISE_INIT.config.ble_adv_fast_timeout;
-
-   blepn->bp_entering_sleep = true;
+   size_t rix = (size_t)(event - &blepn->bp_attr_events[0]);
+   return &_adv_ble_transient[rix].tr_bytes[0];
 }
 
-//-----------------------------------------------------------------------------
-// Helpers
-//-----------------------------------------------------------------------------
-
 /**
- * Build up a readable string with a BLE MAC address from a LE byte address
+ * Tell whether a request should wait for other requests on the same
+ * attribute to complete first.
  *
- * @param[out] str updated with the BLE MAC address string
- * @param[in] length length of output string in byte (should be 18 byte long
- *            or more)
- * @param[in] addr address to convert
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ * @param[in] event request record
+ * @return @c true if another request on the same attribute is pending
  */
-static void
-_adv_ble_mac_addr_to_str(char * str, size_t length, const ble_gap_addr_t * addr)
+static bool
+_adv_ble_request_is_blocked(struct adv_ble * blepn,
+                            const struct adv_ble_attr_event * event)
 {
-   ssize_t rem = (ssize_t)length;
-   for(unsigned int bix=0; bix<ARRAY_SIZE(addr->addr); bix++) {
-      int len = snprintf(str, (size_t)MAX(0, rem),
-                         (bix<(ARRAY_SIZE(addr->addr)-1)) ? "%02x:" : "%02x",
-                         addr->addr[ARRAY_SIZE(addr->addr)-1-bix]);
-      if ( len > rem ) {
-         MSGV(PTL_ERROR, "Invalid output string");
-         str[0] = '\0';
-         return;
+   for (unsigned int rix=0; rix<ADV_BLE_REQUEST_COUNT; rix++) {
+      const struct adv_ble_attr_event * other = &blepn->bp_attr_events[rix];
+      if ( (other != event) && other->ae_id &&
+           (other->ae_attr == event->ae_attr) ) {
+         return true;
       }
-      rem -= len;
-      str += len;
    }
+
+   return false;
 }
 
 /**
- * Close the current BLE connection, if any.
+ * Start the oldest request waiting on an attribute, if the attribute has no
+ * longer any running request.
+ *
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ * @param[in] pa_attr attribute whose request has just completed
  */
 static void
-_adv_ble_disconnect(void)
+_adv_ble_request_next(struct adv_ble * blepn,
+                      const struct adv_ble_attribute * pa_attr)
 {
-   if ( BLE_CONN_HANDLE_INVALID != _adv_ble.bp_conn_handle ) {
-      ret_code_t rc;
-      rc = sd_ble_gap_disconnect(_adv_ble.bp_conn_handle,
-                                 BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
-      if ( rc ) {
-         MSGV(PTL_WARN, "Cannot disconnect: 0x%04x", rc);
+   if ( ! pa_attr ) {
+      return;
+   }
+
+   struct adv_ble_attr_event * next = NULL;
+   for (unsigned int rix=0; rix<ADV_BLE_REQUEST_COUNT; rix++) {
+      struct adv_ble_attr_event * event = &blepn->bp_attr_events[rix];
+      if ( ! event->ae_id || (event->ae_attr != pa_attr) ) {
+         continue;
+      }
+      if ( ! event->ae_waiting ) {
+         // a request is still running on this attribute
+         return;
+      }
+      if ( ! next || ((int32_t)(event->ae_seq - next->ae_seq) < 0) ) {
+         next = event;
       }
    }
+
+   if ( next ) {
+      next->ae_waiting = false;
+      _adv_ble_request_dispatch(next);
+   }
 }
 
 /**
- * Create all timers
+ * Run the reader or writer method of a pending request, and complete the
+ * request unless the method defers its completion.
+ *
+ * @param[in,out] event request record
  */
 static void
-_adv_ble_timer_create(void)
+_adv_ble_request_dispatch(struct adv_ble_attr_event * event)
 {
-   ret_code_t rc;
+   struct adv_ble_attribute * pa_attr = event->ae_attr;
+   unsigned int req_id = event->ae_id;
+   int rc;
 
-   _adv_ble_worker_engine.we_timer_id = &_adv_ble_worker_engine.we_timer;
-   rc = app_timer_create(&_adv_ble_worker_engine.we_timer_id,
-                         APP_TIMER_MODE_REPEATED,
-                         &_adv_ble_worker_timer_cb);
-   APP_ERROR_CHECK(rc);
-}
+   if ( ADV_BLE_REQ_WRITE == event->ae_op ) {
+      rc = pa_attr->pa_writer(event->ae_data, (size_t)event->ae_length,
+                              req_id);
+      if ( PE_DEFERRED == rc ) {
+         MSGV(PTL_CHATTY, "Delayed completion for %s, req %u",
+              pa_attr->pa_desc.ad_str, req_id);
+         return;
+      }
+      if ( rc < 0 ) {
+         MSGV(PTL_ERROR, "Write to %s failed to execute: %d",
+                         pa_attr->pa_desc.ad_str, rc);
+      }
+      _adv_ble_complete_write_req(req_id, rc);
+      return;
+   }
 
-//-----------------------------------------------------------------------------
-// Background worker timer management
-//-----------------------------------------------------------------------------
+   // clear out the attribute length if it has a variable size...
+   if ( pa_attr->pa_varsize ) {
+         pa_attr->pa_length = 0;
+   } else {
+      pa_attr->pa_length = pa_attr->pa_size;
+   }
 
-/**
- * Kick off the background worker engine timer.
- */
-static void
-_adv_ble_worker_start(void)
-{
-   ret_code_t rc;
-   rc = app_timer_start(_adv_ble_worker_engine.we_timer_id,
-                        APP_TIMER_TICKS(ADV_BLE_WORKER_PACE_S*1000),
-                        &_adv_ble_worker_engine);
-   APP_ERROR_CHECK(rc);
+   if ( pa_attr->pa_reader ) {
+      MSGV(PTL_DEBUG, "Read from %s", pa_attr->pa_desc.ad_str);
 
-   // reset the relative timer clock
-   _adv_ble_worker_engine.we_time = 0U;
-   _adv_ble_worker_engine.we_last_time = 0U;
-}
+      rc = pa_attr->pa_reader(pa_attr, req_id);
 
-/**
- * Inform the worker engine about the BLE status.
- *
- * @param[in] active @c true to tell the engine a connection is active or may
- *                   be re-activated. Workers can only run when no connection
- *                   is active (and not forseen)
- */
-static void
+      if ( PE_DEFERRED == rc ) {
+         // the completion callback should take care of calling
+         // _adv_ble_complete_read_req
+         // note that BLE core spec limits execution time to 30 seconds max.
+         return;
+      }
+
+      if ( rc < 0 ) {
+         MSGV(PTL_ERROR, "Read executer failed for %s",
+                         pa_attr->pa_desc.ad_str);
+      }
+   } else {
+      MSGV(PTL_CHATTY, "No read executer for %s", pa_attr->pa_desc.ad_str);
+
+      rc = PE_NO_ERROR;
+   }
+
+   _adv_ble_complete_read_req(req_id, rc);
+}
+
+/**
+ * Reject a request that cannot be recorded, as all request records are in
+ * use.
+ *
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ * @param[in] type authorization type, read or write
+ * @param[in] pa_char target attribute, if known
+ */
+static void
+_adv_ble_reject_request(struct adv_ble * blepn, uint8_t type,
+                        enum adv_ble_attr pa_char)
+{
+   _adv_ble_set_error_on_attr(blepn, -PE_BUSY, pa_char);
+
+   ble_gatts_rw_authorize_reply_params_t auth_reply = {
+      .type = type,
+   };
+   if ( BLE_GATTS_AUTHORIZE_TYPE_WRITE == type ) {
+      auth_reply.params.write.gatt_status =
+         BLE_GATT_STATUS_ATTERR_WRITE_NOT_PERMITTED;
+   } else {
+      auth_reply.params.read.gatt_status =
+         BLE_GATT_STATUS_ATTERR_READ_NOT_PERMITTED;
+   }
+
+   ret_code_t errcode;
+   errcode = sd_ble_gatts_rw_authorize_reply(_adv_ble_conn_handle(blepn),
+                                             &auth_reply);
+   APP_ERROR_CHECK(errcode);
+}
+
+/**
+ * Update the ADV_ERROR BLE attribute, to store error information for the client
+ *
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ * @param[in] errno error code to store
+ * @param[in] pa_char attribute access that triggered the error
+ */
+static struct adv_ble_attribute *
+_adv_ble_set_error_on_attr(struct adv_ble * blepn,
+                          int errno,
+                          enum adv_ble_attr pa_char)
+{
+   const struct adv_ble_attribute * pa_attr;
+   if ( (pa_char < ADV_FIRST) || (pa_char >= ADV_LAST) ) {
+      // if the attribute is invalid, force the error attribute to flag the
+      // error
+      pa_char = ADV_ERROR;
+   }
+   pa_attr = _adv_ble_get_attribute(blepn, pa_char);
+   MSGV(PTL_INFO, "Store error %d for attribute %u %s",
+                  errno, pa_char, pa_attr ? pa_attr->pa_desc.ad_str : "?");
+   struct adv_ble_attribute * pa_error = _adv_ble_get_attribute(blepn, ADV_ERROR);
+   struct pa_error_desc * bpe = (struct pa_error_desc *)pa_error->pa_var;
+   bpe->pe_errno = (int8_t)errno;
+   bpe->pe_attr = (uint8_t)pa_char;
+   // subscribed clients learn about the error without polling
+   (void)_adv_ble_publish(blepn, ADV_ERROR, NULL, 0U);
+   return pa_error;
+}
+
+/**
+ * Update the value of an attribute, and notify it to the links that have
+ * enabled its notifications.
+ * Repeated updates are coalesced: an attribute is notified at most once per
+ * connection event, with its latest value. This function may be called from
+ * any context.
+ *
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ * @param[in] pa_char attribute to publish
+ * @param[in] value new value, or @c NULL if the attribute storage has
+ *                  already been updated
+ * @param[in] length size of the new value, ignored if @a value is @c NULL
+ * @return error code
+ */
+static int
+_adv_ble_publish(struct adv_ble * blepn, enum adv_ble_attr pa_char,
+                 const void * value, size_t length)
+{
+   struct adv_ble_attribute * pa_attr = _adv_ble_get_attribute(blepn, pa_char);
+
+   if ( ! pa_attr || ! pa_attr->pa_props.notify ) {
+      return -PE_INVALID_UUID;
+   }
+
+   for (unsigned int six=0; six<ADV_BLE_STREAM_COUNT; six++) {
+      if ( blepn->bp_streams[six].bs_attr == pa_char ) {
+         // stream storage is owned by the stream pump
+         return -PE_NOT_SUPPORTED;
+      }
+   }
+
+   if ( value ) {
+      if ( (length > pa_attr->pa_size) ||
+           (! pa_attr->pa_varsize && (length != pa_attr->pa_size)) ) {
+         return -PE_INVALID_SIZE;
+      }
+      memcpy(pa_attr->pa_var, value, length);
+      pa_attr->pa_length = length;
+   }
+
+   uint32_t mask = 1UL << pa_char;
+   bool pending = false;
+   CRITICAL_REGION_ENTER();
+   for (unsigned int lix=0; lix<ADV_BLE_PERIPH_LINK_COUNT; lix++) {
+      struct adv_ble_link * link = &blepn->bp_links[lix];
+      if ( link->bl_notify_enabled & mask ) {
+         link->bl_notify_pending |= mask;
+         pending = true;
+      }
+   }
+   CRITICAL_REGION_EXIT();
+
+   if ( pending ) {
+      _adv_ble_stream_pump(blepn);
+   }
+
+   return PE_NO_ERROR;
+}
+
+/**
+ * Retrieve the BLE PowerAdvertiser attribute from its identifier
+ *
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ * @param[in] pa_char attribute identifier
+ * @return PowerAdvertiser attribute or @c NULL if not found
+ */
+static struct adv_ble_attribute *
+_adv_ble_get_attribute(struct adv_ble * blepn,
+                      enum adv_ble_attr pa_char)
+{
+   if ( (pa_char >= ADV_FIRST) && (pa_char < ADV_LAST) ) {
+      return &blepn->bp_attributes[pa_char];
+   }
+
+   MSGV(PTL_FATAL, "Invalid attribute %u", pa_char);
+   APP_ERROR_CHECK(NRF_FAULT_ID_SDK_ASSERT);
+
+   return NULL;
+}
+
+/**
+ * Handle disconnection
+ *
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ * @param[in,out] link the closed link, which is released
+ */
+static void
+_adv_ble_handle_disconnect(struct adv_ble * blepn, struct adv_ble_link * link)
+{
+   uint16_t conn_handle = link->bl_conn_handle;
+
+   // notification streams, including the trace back-end, pause: pending
+   // chunks are kept until a client enables notifications again
+   for (unsigned int six=0; six<ADV_BLE_STREAM_COUNT; six++) {
+      struct adv_ble_stream * stream = &blepn->bp_streams[six];
+      if ( stream->bs_conn_handle == conn_handle ) {
+         MSGV(PTL_DEBUG, "Stream %u paused, %u bytes",
+              stream->bs_attr, stream->bs_bytes);
+         stream->bs_conn_handle = BLE_CONN_HANDLE_INVALID;
+      }
+   }
+
+   // queued writes are lost with the connection
+   if ( blepn->bp_qwr_conn_handle == conn_handle ) {
+      blepn->bp_qwr_handle = BLE_GATT_HANDLE_INVALID;
+   }
+
+   // there is no longer any peer to reply to: drop the pending requests of
+   // the link, late completions are ignored as their identifiers no longer
+   // match
+   for (unsigned int rix=0; rix<ADV_BLE_REQUEST_COUNT; rix++) {
+      struct adv_ble_attr_event * event = &blepn->bp_attr_events[rix];
+      if ( ! event->ae_id || (event->ae_conn_handle != conn_handle) ) {
+         continue;
+      }
+      MSGV(PTL_WARN, "Drop pending request %u", event->ae_id);
+      _adv_ble_request_free(event);
+   }
+
+   link->bl_conn_handle = BLE_CONN_HANDLE_INVALID;
+   if ( blepn->bp_link_count ) {
+      blepn->bp_link_count--;
+   }
+}
+
+/**
+ * Retrieve the context of a connected link.
+ *
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ * @param[in] conn_handle connection handle
+ * @return the link, or @c NULL if no link uses this connection
+ */
+static struct adv_ble_link *
+_adv_ble_link_find(struct adv_ble * blepn, uint16_t conn_handle)
+{
+   if ( BLE_CONN_HANDLE_INVALID == conn_handle ) {
+      return NULL;
+   }
+
+   for (unsigned int lix=0; lix<ADV_BLE_PERIPH_LINK_COUNT; lix++) {
+      if ( blepn->bp_links[lix].bl_conn_handle == conn_handle ) {
+         return &blepn->bp_links[lix];
+      }
+   }
+
+   return NULL;
+}
+
+/**
+ * Allocate the context of a new link.
+ *
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ * @param[in] conn_handle connection handle
+ * @return the link, or @c NULL if all links are in use
+ */
+static struct adv_ble_link *
+_adv_ble_link_open(struct adv_ble * blepn, uint16_t conn_handle)
+{
+   struct adv_ble_link * link = NULL;
+
+   for (unsigned int lix=0; lix<ADV_BLE_PERIPH_LINK_COUNT; lix++) {
+      if ( BLE_CONN_HANDLE_INVALID == blepn->bp_links[lix].bl_conn_handle ) {
+         link = &blepn->bp_links[lix];
+         break;
+      }
+   }
+   if ( ! link ) {
+      return NULL;
+   }
+
+   memset(link, 0, sizeof(*link));
+   link->bl_conn_handle = conn_handle;
+   // the GATT module may have completed the MTU exchange already
+   link->bl_mtu = nrf_ble_gatt_eff_mtu_get(&blepn->bp_gatt, conn_handle);
+   blepn->bp_link_count++;
+
+   return link;
+}
+
+/**
+ * Provide the connection handle of the BLE event being processed.
+ *
+ * @param[in] blepn BLE PowerAdvertiser engine
+ * @return the connection handle, or @c BLE_CONN_HANDLE_INVALID
+ */
+static uint16_t
+_adv_ble_conn_handle(const struct adv_ble * blepn)
+{
+   return blepn->bp_link ? blepn->bp_link->bl_conn_handle :
+                           BLE_CONN_HANDLE_INVALID;
+}
+
+/**
+ * Prepare the PN to enter sleep mode
+ *
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ */
+static void
+_adv_ble_enter_sleep(struct adv_ble * blepn)
+{
+   blepn->bp_entering_sleep = true;
+}
+
+/**
+ * Queue stream notifications, until the SoftDevice queue is full or the
+ * sources are exhausted.
+ * This function may be called from any context that is allowed to call the
+ * SoftDevice: whenever it is already running, the running instance loops
+ * once more.
+ *
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ */
+static void
+_adv_ble_stream_pump(struct adv_ble * blepn)
+{
+   bool run = false;
+
+   CRITICAL_REGION_ENTER();
+   if ( blepn->bp_pumping ) {
+      blepn->bp_pump_again = true;
+   } else {
+      blepn->bp_pumping = true;
+      run = true;
+   }
+   CRITICAL_REGION_EXIT();
+
+   while ( run ) {
+      blepn->bp_pump_again = false;
+      // attribute notifications are short and time sensitive, send them
+      // ahead of the streams; links whose TX queue is full are skipped, as
+      // each link has its own TX queue
+      uint32_t full = 0U;
+      for (unsigned int lix=0; lix<ADV_BLE_PERIPH_LINK_COUNT; lix++) {
+         if ( ! _adv_ble_notify_fill(blepn, &blepn->bp_links[lix]) ) {
+            full |= 1UL << lix;
+         }
+      }
+      for (unsigned int six=0; six<ADV_BLE_STREAM_COUNT; six++) {
+         struct adv_ble_stream * stream = &blepn->bp_streams[six];
+         const struct adv_ble_link * link =
+            _adv_ble_link_find(blepn, stream->bs_conn_handle);
+         uint32_t mask = link ? 1UL << (link - &blepn->bp_links[0]) : 0U;
+         if ( full & mask ) {
+            continue;
+         }
+         if ( ! _adv_ble_stream_fill(blepn, stream) ) {
+            // SoftDevice TX queue of the link is full
+            full |= mask;
+         }
+      }
+      CRITICAL_REGION_ENTER();
+      run = blepn->bp_pump_again;
+      blepn->bp_pumping = run;
+      CRITICAL_REGION_EXIT();
+   }
+}
+
+/**
+ * Queue the pending attribute notifications of a link, see
+ * #_adv_ble_stream_pump
+ *
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ * @param[in,out] link the link to queue notifications for
+ * @return @c false if the SoftDevice TX queue is full, @c true otherwise
+ */
+static bool
+_adv_ble_notify_fill(struct adv_ble * blepn, struct adv_ble_link * link)
+{
+   if ( BLE_CONN_HANDLE_INVALID == link->bl_conn_handle ) {
+      return true;
+   }
+
+   for (unsigned int aix=ADV_FIRST; aix<ADV_LAST; aix++) {
+      uint32_t mask = 1UL << aix;
+      bool send;
+      CRITICAL_REGION_ENTER();
+      // an attribute already notified in this connection event waits for
+      // the TX completion, further updates are merged meanwhile
+      send = (link->bl_notify_pending & ~link->bl_notify_sent & mask) != 0U;
+      link->bl_notify_pending &= ~(send ? mask : 0U);
+      CRITICAL_REGION_EXIT();
+      if ( ! send ) {
+         continue;
+      }
+
+      const struct adv_ble_attribute * pa_attr = &blepn->bp_attributes[aix];
+      uint16_t length = (uint16_t)(pa_attr->pa_varsize ? pa_attr->pa_length :
+                                                         pa_attr->pa_size);
+      length = MIN(length, (uint16_t)(link->bl_mtu - ADV_BLE_ATT_HVN_HEADER));
+      const ble_gatts_hvx_params_t hvx = {
+         .handle = pa_attr->pa_handles.value_handle,
+         .type = BLE_GATT_HVX_NOTIFICATION,
+         .offset = 0U,
+         .p_len = &length,
+         .p_data = pa_attr->pa_var,
+      };
+
+      ret_code_t rc = sd_ble_gatts_hvx(link->bl_conn_handle, &hvx);
+      switch ( rc ) {
+         case NRF_SUCCESS:
+            link->bl_notify_sent |= mask;
+            break;
+         case NRF_ERROR_RESOURCES:
+            // TX queue is full, resume on BLE_GATTS_EVT_HVN_TX_COMPLETE
+            CRITICAL_REGION_ENTER();
+            link->bl_notify_pending |= mask;
+            CRITICAL_REGION_EXIT();
+            return false;
+         case NRF_ERROR_INVALID_STATE:
+         case BLE_ERROR_GATTS_SYS_ATTR_MISSING:
+            // notifications are no longer enabled, drop the update
+            break;
+         default:
+            MSGV(PTL_WARN, "%s notification failed: 0x%x",
+                 pa_attr->pa_desc.ad_str, rc);
+            break;
+      }
+   }
+
+   return true;
+}
+
+/**
+ * Queue notifications of a stream, see #_adv_ble_stream_pump
+ *
+ * @param[in,out] blepn BLE PowerAdvertiser engine
+ * @param[in,out] stream the stream to queue notifications for
+ * @return @c false if the SoftDevice TX queue is full, @c true otherwise
+ */
+static bool
+_adv_ble_stream_fill(struct adv_ble * blepn, struct adv_ble_stream * stream)
+{
+   const struct adv_ble_attribute * pa_attr =
+      &blepn->bp_attributes[stream->bs_attr];
+   uint16_t conn_handle = stream->bs_conn_handle;
+   const struct adv_ble_link * link = _adv_ble_link_find(blepn, conn_handle);
+
+   if ( ! link ) {
+      // no subscriber, other streams may still be sent
+      return true;
+   }
+
+   size_t size = link->bl_mtu;
+   size = (size > ADV_BLE_ATT_HVN_HEADER) ? size - ADV_BLE_ATT_HVN_HEADER : 0U;
+   size = MIN(size, pa_attr->pa_size);
+
+   // the attribute storage is used as the chunk buffer: the SoftDevice
+   // copies the notification data into its own TX queue
+   uint8_t * chunk = (uint8_t *)pa_attr->pa_var;
+
+   while ( stream->bs_source ) {
+      if ( ! stream->bs_length ) {
+         int len = stream->bs_source(chunk, size);
+         if ( len < 0 ) {
+            MSGV(PTL_WARN, "%s source failed: %d",
+                 pa_attr->pa_desc.ad_str, len);
+            _adv_ble_stream_stop(stream);
+            break;
+         }
+         if ( ! len ) {
+            // source starved, see adv_ble_bulk_kick
+            break;
+         }
+         stream->bs_length = (uint16_t)MIN((size_t)len, size);
+      }
+
+      uint16_t length = stream->bs_length;
+      const ble_gatts_hvx_params_t hvx = {
+         .handle = pa_attr->pa_handles.value_handle,
+         .type = BLE_GATT_HVX_NOTIFICATION,
+         .offset = 0U,
+         .p_len = &length,
+         .p_data = chunk,
+      };
+
+      ret_code_t rc = sd_ble_gatts_hvx(conn_handle, &hvx);
+      switch ( rc ) {
+         case NRF_SUCCESS:
+            stream->bs_bytes += length;
+            stream->bs_length = 0U;
+            continue;
+         case NRF_ERROR_RESOURCES:
+            // TX queue is full, resume on BLE_GATTS_EVT_HVN_TX_COMPLETE
+            return false;
+         case NRF_ERROR_INVALID_STATE:
+         case BLE_ERROR_GATTS_SYS_ATTR_MISSING:
+            // notifications are not enabled (yet), keep the pending chunk
+            return true;
+         default:
+            MSGV(PTL_WARN, "%s notification failed: 0x%x",
+                 pa_attr->pa_desc.ad_str, rc);
+            return true;
+      }
+   }
+
+   return true;
+}
+
+/**
+ * Stop a notification stream.
+ * Chunks already queued in the SoftDevice are still sent.
+ *
+ * @param[in,out] stream the stream to stop
+ */
+static void
+_adv_ble_stream_stop(struct adv_ble_stream * stream)
+{
+   if ( stream->bs_source ) {
+      MSGV(PTL_INFO, "Stream %u stopped, %u bytes",
+           stream->bs_attr, stream->bs_bytes);
+   }
+   stream->bs_source = NULL;
+   stream->bs_length = 0U;
+}
+
+/**
+ * Replace the trace back-end with the trace stream, which then drains the
+ * trace queue.
+ */
+static void
+_adv_ble_trace_attach(void)
+{
+   struct adv_ble_stream * stream = &_adv_ble.bp_streams[ADV_BLE_STREAM_TRACE];
+
+   if ( stream->bs_source ) {
+      // already attached, the trace stream resumes
+      return;
+   }
+
+   MSGV(PTL_INFO, "Trace stream attached");
+
+   stream->bs_length = 0U;
+   stream->bs_bytes = 0U;
+   stream->bs_source = &_adv_ble_trace_source;
+
+   int rc = pa_trace_set_sink(&_ADV_BLE_TRACE_SINK);
+   if ( rc < 0 ) {
+      MSGV(PTL_ERROR, "Cannot attach trace stream: %d", rc);
+      stream->bs_source = NULL;
+   }
+}
+
+/**
+ * Trace stream source: pack the trace queue chunks into notifications.
+ *
+ * @param[out] buf buffer to fill with the next chunk of the stream
+ * @param[in] size maximum chunk size
+ * @return the chunk size, 0 if the trace queue is empty
+ */
+static int
+_adv_ble_trace_source(uint8_t * buf, size_t size)
+{
+   struct adv_ble_trace_chunk * trace = &_adv_ble.bp_trace;
+   size_t count = 0;
+
+   while ( (count < size) && trace->tc_data ) {
+      size_t length = MIN(size - count, trace->tc_length - trace->tc_offset);
+      memcpy(&buf[count], &trace->tc_data[trace->tc_offset], length);
+      count += length;
+      trace->tc_offset += length;
+      if ( trace->tc_offset == trace->tc_length ) {
+         // the whole chunk now sits in the notification buffer: release it
+         // from the trace queue, which may hand over the next chunk right
+         // away, see _adv_ble_trace_tx
+         trace->tc_data = NULL;
+         pa_trace_sink_done();
+      }
+   }
+
+   return (int)count;
+}
+
+/**
+ * Trace back-end transmission, see struct pa_trace_sink.
+ * The chunk is streamed once the SoftDevice TX queue can accept it, which
+ * provides back-pressure on the trace queue while no client is subscribed.
+ * May be invoked from any context, including interrupt handlers with a
+ * priority that forbids SoftDevice calls: the chunk is only recorded here,
+ * and the stream is pumped from the application scheduler.
+ *
+ * @param[in] data the bytes to transmit
+ * @param[in] length the count of bytes
+ * @return PE_DEFERRED, as pa_trace_sink_done() is called once the chunk
+ *         has been streamed
+ */
+static int
+_adv_ble_trace_tx(const uint8_t * data, size_t length)
+{
+   struct adv_ble_trace_chunk * trace = &_adv_ble.bp_trace;
+   bool schedule;
+
+   trace->tc_length = length;
+   trace->tc_offset = 0U;
+   trace->tc_data = data;
+
+   CRITICAL_REGION_ENTER();
+   schedule = ! _adv_ble.bp_trace_scheduled;
+   _adv_ble.bp_trace_scheduled = true;
+   CRITICAL_REGION_EXIT();
+
+   if ( schedule ) {
+      ret_code_t rc = app_sched_event_put(NULL, 0U,
+                                          &_adv_ble_trace_sched_handler);
+      APP_ERROR_CHECK(rc);
+   }
+
+   return PE_DEFERRED;
+}
+
+/**
+ * Pump the trace stream, from the application scheduler thread.
+ *
+ * @param[in] data unused
+ * @param[in] size unused
+ */
+static void
+_adv_ble_trace_sched_handler(void * data, uint16_t size)
+{
+   (void)data;
+   (void)size;
+
+   // cleared ahead of the pump, so that a chunk handed over meanwhile
+   // either is seen by this pump, or queues another handler
+   _adv_ble.bp_trace_scheduled = false;
+
+   _adv_ble_stream_pump(&_adv_ble);
+}
+
+/**
+ * Trace back-end fatal message, see struct pa_trace_sink.
+ * The SoftDevice is no longer serviced once a fatal error occurs, so the
+ * message cannot be streamed and is discarded.
+ *
+ * @param[in] data the bytes to transmit
+ * @param[in] length the count of bytes
+ */
+static void
+_adv_ble_trace_fatal(const uint8_t * data, size_t length)
+{
+   (void)data;
+   (void)length;
+}
+
+/**
+ * Read out the power statistics.
+ *
+ * @param[in,out] pa_attr the power attribute
+ * @param[in] req_id the request identifier, unused
+ * @return @c PE_NO_ERROR
+ */
+static int
+_adv_ble_power_reader(struct adv_ble_attribute * pa_attr, unsigned int req_id)
+{
+   (void)req_id;
+
+   adv_power_get_stats((struct adv_power_stats *)pa_attr->pa_var);
+
+   return PE_NO_ERROR;
+}
+
+/**
+ * Read out the trace control status.
+ *
+ * @param[in,out] pa_attr the trace control attribute
+ * @param[in] req_id the request identifier, unused
+ * @return @c PE_NO_ERROR
+ */
+static int
+_adv_ble_trace_ctrl_reader(struct adv_ble_attribute * pa_attr,
+                           unsigned int req_id)
+{
+   (void)req_id;
+
+   pa_attr->pa_length = sizeof(struct pa_trace_control);
+   pa_trace_get_control(ADV_BLE_ATTR_VAR(pa_attr, pv_trace_ctrl));
+
+   return PE_NO_ERROR;
+}
+
+/**
+ * Apply trace control commands.
+ *
+ * @param[in] buf the command sequence
+ * @param[in] length the sequence length
+ * @param[in] req_id the request identifier, unused
+ * @return @c PE_NO_ERROR or a negative error code
+ */
+static int
+_adv_ble_trace_ctrl_writer(const uint8_t * buf, size_t length,
+                           unsigned int req_id)
+{
+   (void)req_id;
+
+   int rc = pa_trace_control(buf, length);
+
+   MSGV(PTL_INFO, "Trace control: %u bytes, modes %02x, rc %d",
+        (unsigned int)length, pa_trace_get_modes(), rc);
+
+   return rc;
+}
+
+#ifdef ADV_BENCH
+/**
+ * Read out the benchmark results, possibly after a delay.
+ *
+ * @param[in,out] pa_attr the bench attribute
+ * @param[in] req_id the request identifier
+ * @return @c PE_NO_ERROR, @c PE_DEFERRED or a negative error code
+ */
+static int
+_adv_ble_diag_reader(struct adv_ble_attribute * pa_attr, unsigned int req_id)
+{
+   pa_attr->pa_length = sizeof(struct adv_bench_results);
+
+   return adv_bench_read(ADV_BLE_ATTR_VAR(pa_attr, pv_diag), req_id,
+                         &_adv_ble_complete_read_req);
+}
+
+/**
+ * Update the benchmark configuration.
+ *
+ * @param[in] buf the configuration record
+ * @param[in] length the record length
+ * @param[in] req_id the request identifier, unused
+ * @return @c PE_NO_ERROR or a negative error code
+ */
+static int
+_adv_ble_diag_writer(const uint8_t * buf, size_t length,
+                      unsigned int req_id)
+{
+   (void)req_id;
+
+   return adv_bench_configure(buf, length);
+}
+#endif // ADV_BENCH
+
+//-----------------------------------------------------------------------------
+// Helpers
+//-----------------------------------------------------------------------------
+
+/**
+ * Build up a readable string with a BLE MAC address from a LE byte address
+ *
+ * @param[out] str updated with the BLE MAC address string
+ * @param[in] length length of output string in byte (should be 18 byte long
+ *            or more)
+ * @param[in] addr address to convert
+ */
+static void
+_adv_ble_mac_addr_to_str(char * str, size_t length, const ble_gap_addr_t * addr)
+{
+   // two digits per byte, with a separator or the end-of-string marker
+   if ( length < 3U * ARRAY_SIZE(addr->addr) ) {
+      MSGV(PTL_ERROR, "Invalid output string");
+      if ( length ) {
+         str[0] = '\0';
+      }
+      return;
+   }
+   for(unsigned int bix=0; bix<ARRAY_SIZE(addr->addr); bix++) {
+      str = fmt_hex_uint8(str, addr->addr[ARRAY_SIZE(addr->addr)-1-bix]);
+      *str++ = ':';
+   }
+   str[-1] = '\0';
+}
+
+/**
+ * Close a BLE connection.
+ *
+ * @param[in] link the link to close, or @c NULL to close all links
+ */
+static void
+_adv_ble_disconnect(struct adv_ble_link * link)
+{
+   for (unsigned int lix=0; lix<ADV_BLE_PERIPH_LINK_COUNT; lix++) {
+      const struct adv_ble_link * bl = &_adv_ble.bp_links[lix];
+      if ( (link && (bl != link)) ||
+           (BLE_CONN_HANDLE_INVALID == bl->bl_conn_handle) ) {
+         continue;
+      }
+      ret_code_t rc;
+      rc = sd_ble_gap_disconnect(bl->bl_conn_handle,
+                                 BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+      if ( rc ) {
+         MSGV(PTL_WARN, "Cannot disconnect: 0x%04x", rc);
+      }
+   }
+}
+
+/**
+ * Create all timers
+ */
+static void
+_adv_ble_timer_create(void)
+{
+   ret_code_t rc;
+
+   _adv_ble_worker_engine.we_timer_id = &_adv_ble_worker_engine.we_timer;
+   rc = app_timer_create(&_adv_ble_worker_engine.we_timer_id,
+                         APP_TIMER_MODE_SINGLE_SHOT,
+                         &_adv_ble_worker_timer_cb);
+   APP_ERROR_CHECK(rc);
+
+   _adv_ble_adv_updater.au_timer_id = &_adv_ble_adv_updater.au_timer;
+   rc = app_timer_create(&_adv_ble_adv_updater.au_timer_id,
+                         APP_TIMER_MODE_SINGLE_SHOT,
+                         &_adv_ble_adv_timer_cb);
+   APP_ERROR_CHECK(rc);
+}
+
+//-----------------------------------------------------------------------------
+// Advertising policy
+//-----------------------------------------------------------------------------
+
+/**
+ * Start advertising from a ladder step.
+ *
+ * @param[in] step the ladder step to start from
+ */
+static void
+_adv_ble_adv_policy_start(unsigned int step)
+{
+   struct adv_ble_adv_policy * ap = &_adv_ble_adv_policy;
+
+   ap->ap_step = step;
+   ap->ap_elapsed = 0U;
+   _adv_ble_adv_policy_configure(ap);
+
+   ret_code_t rc = ble_advertising_start(&_adv_ble_advertising,
+                                         BLE_ADV_MODE_FAST);
+   APP_ERROR_CHECK(rc);
+}
+
+/**
+ * Configure the advertising module for the next run of the current ladder
+ * step. The advertising module also uses this configuration when it
+ * restarts advertising on its own, on disconnection.
+ *
+ * @param[in,out] ap advertising policy
+ */
+static void
+_adv_ble_adv_policy_configure(struct adv_ble_adv_policy * ap)
+{
+   const struct adv_ble_adv_step * as = &_ADV_BLE_ADV_LADDER[ap->ap_step];
+   ble_adv_modes_config_t * config = &_adv_ble_advertising.adv_modes_config;
+
+   uint32_t run = ADV_BLE_ADV_RUN_MAX_S;
+   if ( as->as_period ) {
+      uint32_t period = (uint32_t)as->as_period * (1U + ap->ap_demand);
+      run = MIN(run, period - ap->ap_elapsed);
+   }
+   ap->ap_run = run;
+
+   config->ble_adv_fast_interval = as->as_interval;
+   // advertising module durations are defined in 10 ms units
+   config->ble_adv_fast_timeout = run * 100U;
+
+   ret_code_t rc = sd_ble_gap_tx_power_set(BLE_GAP_TX_POWER_ROLE_ADV,
+                                           _adv_ble_advertising.adv_handle,
+                                           as->as_tx_power);
+   if ( rc ) {
+      MSGV(PTL_WARN, "Cannot set TX power: 0x%x", rc);
+   }
+
+   MSGV(PTL_INFO, "Adv step %u: %u ms, %u s, %d dBm, demand %u",
+        ap->ap_step, (as->as_interval * 5U) / 8U, run, as->as_tx_power,
+        ap->ap_demand);
+}
+
+/**
+ * Move down the advertising ladder once a step has elapsed without any
+ * connection, and restart advertising.
+ */
+static void
+_adv_ble_adv_policy_idle(void)
+{
+   struct adv_ble_adv_policy * ap = &_adv_ble_adv_policy;
+   const struct adv_ble_adv_step * as = &_ADV_BLE_ADV_LADDER[ap->ap_step];
+
+   ap->ap_elapsed += ap->ap_run;
+
+   if ( as->as_period &&
+        (ap->ap_elapsed >= (uint32_t)as->as_period * (1U + ap->ap_demand)) ) {
+      if ( ADV_BLE_ADV_STEP_BURST == ap->ap_step ) {
+         ap->ap_step = ADV_BLE_ADV_STEP_FIRST;
+      } else {
+         ap->ap_step++;
+      }
+      ap->ap_elapsed = 0U;
+      if ( ap->ap_step == (ARRAY_SIZE(_ADV_BLE_ADV_LADDER) - 1U) ) {
+         // nobody showed up for the whole ladder
+         if ( ap->ap_demand ) {
+            ap->ap_demand--;
+         }
+      }
+      if ( (ap->ap_step > ADV_BLE_ADV_STEP_FIRST) &&
+           ! _adv_ble.bp_link_count ) {
+         // the peer is not coming back for now
+         _adv_ble_worker_update_ble_status(false);
+      }
+      if ( _ADV_BLE_ADV_LADDER[ap->ap_step].as_sleep ) {
+         _adv_ble_enter_sleep(&_adv_ble);
+      }
+   }
+
+   _adv_ble_adv_policy_configure(ap);
+
+   ret_code_t rc = ble_advertising_start(&_adv_ble_advertising,
+                                         BLE_ADV_MODE_FAST);
+   if ( rc ) {
+      MSGV(PTL_ERROR, "Cannot restart advertising: 0x%x", rc);
+   }
+}
+
+//-----------------------------------------------------------------------------
+// Advertising payload updater
+//-----------------------------------------------------------------------------
+
+/**
+ * Schedule the advertising payload for update.
+ * The first update is pushed right away, the following ones are coalesced
+ * until the current advertising interval elapses.
+ * This function may be called from any context.
+ *
+ * @param[in] fields the updated fields, as a adv_ble_adv_field bitmask
+ */
+static void
+_adv_ble_adv_mark_dirty(unsigned int fields)
+{
+   struct adv_ble_adv_updater * au = &_adv_ble_adv_updater;
+   bool push = false;
+
+   CRITICAL_REGION_ENTER();
+   au->au_dirty |= fields;
+   if ( ! au->au_holdoff ) {
+      au->au_holdoff = true;
+      push = true;
+   }
+   CRITICAL_REGION_EXIT();
+
+   if ( push ) {
+      _adv_ble_adv_push(au);
+      _adv_ble_adv_holdoff_start(au);
+   }
+}
+
+/**
+ * Encode the advertising payload into the spare buffer bank, and hand it
+ * over to the SoftDevice.
+ * While advertising, the SoftDevice switches to the new buffers on the next
+ * advertising event, and releases the current ones, so the update neither
+ * stops advertising nor adds radio events. The advertising module uses the
+ * new buffers whenever it (re)starts advertising.
+ *
+ * @param[in,out] au advertising payload updater
+ */
+static void
+_adv_ble_adv_push(struct adv_ble_adv_updater * au)
+{
+   ble_gap_adv_data_t * cur = &_adv_ble_advertising.adv_data;
+   unsigned int bank = au->au_bank;
+   unsigned int dirty;
+
+   CRITICAL_REGION_ENTER();
+   dirty = au->au_dirty;
+   au->au_dirty = 0U;
+   CRITICAL_REGION_EXIT();
+
+#ifdef ADV_BLE_EXTENDED
+   _adv_ble_adv_telemetry_refresh();
+
+   // telemetry is part of the advertising data, there is no scan response
+   uint16_t adv_len = sizeof(au->au_adv[bank]);
+   uint16_t srsp_len = 0U;
+   ret_code_t rc = ble_advdata_encode(&_ADV_BLE_ADVERTISE_INIT.advdata,
+                                      au->au_adv[bank], &adv_len);
+#else // ADV_BLE_EXTENDED
+   // advertising data is left unchanged, but the SoftDevice only accepts
+   // new buffers while advertising
+   uint16_t adv_len = MIN(cur->adv_data.len, sizeof(au->au_adv[bank]));
+   memcpy(au->au_adv[bank], cur->adv_data.p_data, adv_len);
+
+   uint16_t srsp_len = sizeof(au->au_srsp[bank]);
+   ret_code_t rc = ble_advdata_encode(&_ADV_BLE_ADVERTISE_INIT.srdata,
+                                      au->au_srsp[bank], &srsp_len);
+#endif // !ADV_BLE_EXTENDED
+   if ( NRF_SUCCESS == rc ) {
+      const ble_gap_adv_data_t adv_data = {
+         .adv_data = {
+            .p_data = au->au_adv[bank],
+            .len = adv_len,
+         },
+         .scan_rsp_data = {
+            .p_data = srsp_len ? au->au_srsp[bank] : NULL,
+            .len = srsp_len,
+         },
+      };
+      // advertising parameters are left unchanged
+      rc = sd_ble_gap_adv_set_configure(&_adv_ble_advertising.adv_handle,
+                                        &adv_data, NULL);
+      if ( NRF_SUCCESS == rc ) {
+         *cur = adv_data;
+         au->au_bank = bank ^ 1U;
+         au->au_updates++;
+         MSGV(PTL_DEBUG, "Adv payload #%u: 0x%02x",
+              au->au_updates, dirty);
+         return;
+      }
+   }
+
+   MSGV(PTL_WARN, "Cannot update adv payload: 0x%x", rc);
+   // retry on next advertising interval
+   CRITICAL_REGION_ENTER();
+   au->au_dirty |= dirty;
+   CRITICAL_REGION_EXIT();
+}
+
+#ifdef ADV_BLE_EXTENDED
+/**
+ * Refresh the telemetry record from the current PowerAdvertiser status.
+ */
+static void
+_adv_ble_adv_telemetry_refresh(void)
+{
+   struct adv_ble_adv_telemetry * at = &_adv_ble_adv_telemetry;
+   uint8_t flags = 0U;
+
+   if ( _adv_ble.bp_entering_sleep ) {
+      flags |= ADV_BLE_TELEMETRY_SLEEP;
+   }
+   if ( _adv_ble.bp_streams[ADV_BLE_STREAM_TRACE].bs_source ) {
+      flags |= ADV_BLE_TELEMETRY_TRACE;
+   }
+
+   at->at_info.ai_health = _adv_ble_adv_info.ai_health;
+   at->at_adv_step = (uint8_t)_adv_ble_adv_policy.ap_step;
+   _adv_ble_worker_clock(&_adv_ble_worker_engine);
+   at->at_uptime = _adv_ble_worker_engine.we_time;
+   at->at_conn_count = _adv_ble.bp_conn_count;
+   at->at_demand = (uint8_t)_adv_ble_adv_policy.ap_demand;
+   at->at_flags = flags;
+}
+#endif // ADV_BLE_EXTENDED
+
+/**
+ * Start the advertising payload update hold-off period, for the current
+ * advertising interval.
+ *
+ * @param[in,out] au advertising payload updater
+ */
+static void
+_adv_ble_adv_holdoff_start(struct adv_ble_adv_updater * au)
+{
+   // advertising interval is defined in 0.625 ms units
+   uint32_t interval_ms = (_adv_ble_advertising.adv_params.interval * 5U) / 8U;
+   ret_code_t rc;
+
+   rc = app_timer_start(au->au_timer_id,
+                        APP_TIMER_TICKS(MAX(interval_ms, 1U)), au);
+   if ( rc ) {
+      MSGV(PTL_WARN, "Cannot start adv timer: 0x%x", rc);
+      au->au_holdoff = false;
+   }
+}
+
+/**
+ * Push the coalesced advertising payload updates, if any, once the
+ * hold-off period has elapsed.
+ *
+ * @param[in,out] context advertising payload updater
+ */
+static void
+_adv_ble_adv_timer_cb(void * context)
+{
+   struct adv_ble_adv_updater * au = (struct adv_ble_adv_updater *)context;
+   bool push;
+
+   adv_power_wakeup(APW_TIMER);
+
+   CRITICAL_REGION_ENTER();
+   push = !! au->au_dirty;
+   au->au_holdoff = push;
+   CRITICAL_REGION_EXIT();
+
+   if ( push ) {
+      _adv_ble_adv_push(au);
+      _adv_ble_adv_holdoff_start(au);
+   }
+}
+
+//-----------------------------------------------------------------------------
+// Background worker timer management
+//-----------------------------------------------------------------------------
+
+/**
+ * Kick off the background worker engine.
+ */
+static void
+_adv_ble_worker_start(void)
+{
+   struct adv_ble_worker_engine * we = &_adv_ble_worker_engine;
+
+   // reset the relative timer clock
+   we->we_tick = adv_power_time();
+   we->we_subsec = 0U;
+   we->we_time = 0U;
+
+   _adv_ble_worker_schedule(we);
+}
+
+/**
+ * Inform the worker engine about the BLE status.
+ *
+ * @param[in] active @c true to tell the engine a connection is active or may
+ *                   be re-activated. Workers can only run when no connection
+ *                   is active (and not forseen)
+ */
+static void
 _adv_ble_worker_update_ble_status(bool active)
 {
    struct adv_ble_worker_engine * we = &_adv_ble_worker_engine;
-   MSGV(PTL_INFO, "BLE status: %u", active);
-   if ( ! active ) {
-      we->we_enable = true;
-   } else  {
-      // be sure no worker can be run while BLE connection is active
-      we->we_enable = false;
+   if ( we->we_enable == ! active ) {
+      if ( ! active ) {
+         return;
+      }
+      // workers are already disabled, but a new link brings its own stall
+      // and idle profile deadlines
+   } else {
+      MSGV(PTL_INFO, "BLE status: %u", active);
+      if ( ! active ) {
+         we->we_enable = true;
+      } else  {
+         // be sure no worker can be run while BLE connection is active
+         we->we_enable = false;
+      }
+   }
+   _adv_ble_worker_clock(we);
+   if ( ! we->we_running ) {
+      _adv_ble_worker_schedule(we);
    }
 }
 
@@ -1853,25 +4736,43 @@ static void
 _adv_ble_worker_timer_cb(void * context)
 {
    struct adv_ble_worker_engine * we = (struct adv_ble_worker_engine *) context;
-   we->we_time += ADV_BLE_WORKER_PACE_S;
+   adv_power_wakeup(APW_TIMER);
+   _adv_ble_worker_clock(we);
    if ( ! we->we_enable ) {
-      // check if the BLE connection has not been used for a while
-      if ( (we->we_time - we->we_last_time) > ADV_BLE_STALL_DELAY_S ) {
-         if ( BLE_CONN_HANDLE_INVALID != _adv_ble.bp_conn_handle ) {
-            // the timeframe of connection and worker state differ
-            // * connection handle is invalidated as soon as the connection
-            //   is closed, while
-            // * worker enablement is deferred to the slow adverstisement
-            //   step
-            // meanwhile, the connection is closed but the PowerAdvertiser may
-            // expect a reconnection from the (same) peer
-            // therefore, the connection handle should be checked
-            MSGV(PTL_WARN, "Stalled connection detected, closing");
-
-            _adv_ble_disconnect();
+      // check if a BLE connection has not been used for a while
+      for (unsigned int lix=0; lix<ADV_BLE_PERIPH_LINK_COUNT; lix++) {
+         struct adv_ble_link * link = &_adv_ble.bp_links[lix];
+         // the timeframe of connection and worker state differ
+         // * connection handle is invalidated as soon as the connection
+         //   is closed, while
+         // * worker enablement is deferred to the slow adverstisement
+         //   step
+         // meanwhile, the connection is closed but the PowerAdvertiser may
+         // expect a reconnection from the (same) peer
+         // therefore, the connection handle should be checked
+         if ( (BLE_CONN_HANDLE_INVALID != link->bl_conn_handle) &&
+              ((we->we_time - link->bl_last_time) > ADV_BLE_STALL_DELAY_S) ) {
+            MSGV(PTL_WARN, "Stalled connection C:%04x detected, closing",
+                 link->bl_conn_handle);
+
+            _adv_ble_disconnect(link);
+            continue;
+         }
+         if ( (BLE_CONN_HANDLE_INVALID == link->bl_conn_handle) ||
+              (ADV_BLE_CONN_BURST != link->bl_profile) ||
+              ((we->we_time - link->bl_profile_time) <
+               ADV_BLE_CONN_IDLE_DELAY_S) ) {
+            continue;
          }
+         if ( _adv_ble_link_busy(&_adv_ble, link) ) {
+            // check again later
+            link->bl_profile_time = we->we_time;
+            continue;
+         }
+         _adv_ble_link_profile(link, ADV_BLE_CONN_IDLE);
       }
       // execution of workers is disabled for now
+      _adv_ble_worker_schedule(we);
       return;
    }
    if ( we->we_running ) {
@@ -1888,13 +4789,25 @@ _adv_ble_worker_timer_cb(void * context)
 
 /**
  * Tell the worker engine's connection watchdog that some BLE request has been
- * received, to let it know that the connection is still active
+ * received on the link of the event being processed, to let it know that the
+ * connection is still active
  */
 static void
 _adv_ble_worker_feed(void)
 {
    struct adv_ble_worker_engine * we = &_adv_ble_worker_engine;
-   we->we_last_time = we->we_time;
+   struct adv_ble_link * link = _adv_ble.bp_link;
+   if ( ! link ) {
+      return;
+   }
+   // the watchdog timer is not re-armed: on expiry, it checks the latest
+   // activity time and sleeps again for the remaining delay
+   _adv_ble_worker_clock(we);
+   link->bl_last_time = we->we_time;
+   link->bl_profile_time = we->we_time;
+   // activity switches to the burst profile at once, while the idle profile
+   // is only resumed after ADV_BLE_CONN_IDLE_DELAY_S without activity
+   _adv_ble_link_profile(link, ADV_BLE_CONN_BURST);
 }
 
 /**
@@ -1907,6 +4820,205 @@ _adv_ble_worker_run_next(void)
 {
    struct adv_ble_worker_engine * we = &_adv_ble_worker_engine;
 
+   while ( we->we_worker_ix < BW_COUNT ) {
+      if ( ! we->we_enable ) {
+         // a connection has been established, end the session early
+         break;
+      }
+      unsigned int wix = we->we_worker_ix;
+      if ( (int)(we->we_due[wix] - we->we_time) > 0 ) {
+         // not due yet
+         we->we_worker_ix++;
+         continue;
+      }
+      const struct adv_ble_worker * bw = &_ADV_BLE_WORKERS[wix];
+      we->we_due[wix] = we->we_time + bw->bw_pace;
+      we->we_run_start = app_timer_cnt_get();
+      int rc = bw->bw_func(&_adv_ble_worker_complete);
+      if ( PE_DEFERRED == rc ) {
+         // resume from _adv_ble_worker_complete
+         return;
+      }
+      if ( rc < 0 ) {
+         MSGV(PTL_WARN, "Worker %u failed: %d", wix, rc);
+      }
+      _adv_ble_worker_account(we, wix);
+      we->we_worker_ix++;
+   }
+
    // all workers have been tested or run, get ready for the next session
    we->we_running = false;
+   _adv_ble_worker_clock(we);
+   _adv_ble_worker_schedule(we);
+}
+
+/**
+ * Completion callback of deferred background workers, which chains the
+ * execution of the next worker.
+ */
+static void
+_adv_ble_worker_complete(void)
+{
+   struct adv_ble_worker_engine * we = &_adv_ble_worker_engine;
+
+   if ( ! we->we_running || (we->we_worker_ix >= BW_COUNT) ) {
+      MSGV(PTL_ERROR, "Spurious worker completion");
+      return;
+   }
+
+   _adv_ble_worker_account(we, we->we_worker_ix);
+   we->we_worker_ix++;
+   _adv_ble_worker_run_next();
+}
+
+/**
+ * Update the engine time from the power instrumentation time base, which is
+ * read on demand and never interrupts the CPU.
+ * May be invoked from any context.
+ *
+ * @param[in,out] we worker engine
+ */
+static void
+_adv_ble_worker_clock(struct adv_ble_worker_engine * we)
+{
+   uint32_t freq = adv_power_time_freq();
+
+   CRITICAL_REGION_ENTER();
+   uint32_t now = adv_power_time();
+   uint32_t ticks = (now - we->we_tick) + we->we_subsec;
+   we->we_tick = now;
+   we->we_time += ticks / freq;
+   we->we_subsec = ticks % freq;
+   CRITICAL_REGION_EXIT();
+}
+
+/**
+ * Arm the worker engine timer for the next deadline: the earliest due worker
+ * if workers are enabled, or the connection stall deadline otherwise.
+ * When there is no deadline, the timer is left disarmed, so that the CPU is
+ * not woken up between radio events.
+ *
+ * @param[in,out] we worker engine
+ */
+static void
+_adv_ble_worker_schedule(struct adv_ble_worker_engine * we)
+{
+   unsigned int delay = UINT_MAX;
+
+   if ( we->we_enable ) {
+      for (unsigned int wix=0; wix<BW_COUNT; wix++) {
+         int due = (int)(we->we_due[wix] - we->we_time);
+         delay = MIN(delay, (unsigned int)MAX(due, 0));
+      }
+   } else {
+      for (unsigned int lix=0; lix<ADV_BLE_PERIPH_LINK_COUNT; lix++) {
+         const struct adv_ble_link * link = &_adv_ble.bp_links[lix];
+         if ( BLE_CONN_HANDLE_INVALID == link->bl_conn_handle ) {
+            continue;
+         }
+         int due = (int)(link->bl_last_time + ADV_BLE_STALL_DELAY_S + 1U -
+                         we->we_time);
+         delay = MIN(delay, (unsigned int)MAX(due, 0));
+         if ( ADV_BLE_CONN_BURST == link->bl_profile ) {
+            due = (int)(link->bl_profile_time + ADV_BLE_CONN_IDLE_DELAY_S -
+                        we->we_time);
+            delay = MIN(delay, (unsigned int)MAX(due, 0));
+         }
+      }
+   }
+
+   ret_code_t rc;
+   rc = app_timer_stop(we->we_timer_id);
+   APP_ERROR_CHECK(rc);
+
+   if ( UINT_MAX == delay ) {
+      // nothing to wait for
+      return;
+   }
+
+   // the engine clock has a one second resolution
+   delay = MIN(MAX(delay, 1U), ADV_BLE_WORKER_SLEEP_MAX_S);
+
+   // align the wake up on the engine clock second boundary
+   uint32_t ms = (delay * 1000U) -
+                 ((we->we_subsec * 1000U) / adv_power_time_freq());
+
+   rc = app_timer_start(we->we_timer_id,
+                        MAX(APP_TIMER_TICKS(ms), APP_TIMER_MIN_TIMEOUT_TICKS),
+                        we);
+   APP_ERROR_CHECK(rc);
+}
+
+/**
+ * Record the execution time of a worker.
+ *
+ * @param[in,out] we worker engine
+ * @param[in] wix the index of the worker that has completed
+ */
+static void
+_adv_ble_worker_account(struct adv_ble_worker_engine * we, unsigned int wix)
+{
+   struct adv_ble_worker_stats * ws = &we->we_stats[wix];
+   uint32_t duration = app_timer_cnt_diff_compute(app_timer_cnt_get(),
+                                                  we->we_run_start);
+   ws->ws_runs++;
+   ws->ws_last = duration;
+   ws->ws_max = MAX(ws->ws_max, duration);
+   MSGV(PTL_DEBUG, "Worker %u: %u ticks", wix, duration);
+}
+
+//-----------------------------------------------------------------------------
+// Background workers
+//-----------------------------------------------------------------------------
+
+/**
+ * Report trace statistics.
+ *
+ * @param[in] complete completion callback, unused
+ * @return @c PE_NO_ERROR
+ */
+static int
+_adv_ble_worker_trace_stats(adv_ble_worker_cb_t complete)
+{
+   (void)complete;
+
+   pa_trace_print_stats();
+
+   return PE_NO_ERROR;
+}
+
+#ifdef ADV_BLE_EXTENDED
+/**
+ * Refresh the telemetry record broadcast with extended advertising.
+ *
+ * @param[in] complete completion callback, unused
+ * @return @c PE_NO_ERROR
+ */
+static int
+_adv_ble_worker_telemetry(adv_ble_worker_cb_t complete)
+{
+   (void)complete;
+
+   // the payload updater encodes the up-to-date record
+   _adv_ble_adv_mark_dirty(ADV_BLE_ADV_TELEMETRY);
+
+   return PE_NO_ERROR;
+}
+#endif // ADV_BLE_EXTENDED
+
+#ifdef ADV_BENCH
+/**
+ * Run the benchmark load. Like any other worker, it only runs while no
+ * link is connected.
+ *
+ * @param[in] complete completion callback, unused
+ * @return @c PE_NO_ERROR
+ */
+static int
+_adv_ble_worker_bench(adv_ble_worker_cb_t complete)
+{
+   (void)complete;
+
+   return adv_bench_load();
 }
+#endif // ADV_BENCH
@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "nrf_warn_enter.h"
 #include "ble.h"
 #include "ble_advertising.h"
@@ -28,10 +29,47 @@
 /** Proprietary BLE UUID for advertiser services */
 #define ADV_SERVICE_UUID      0x0071U
 
+/** BLE module RAM usage */
+struct adv_ble_ram_usage {
+   /** Application RAM start address, as provided by the linker script */
+   uint32_t ru_app_ram_start;
+   /** Lowest application RAM start address the SoftDevice accepts */
+   uint32_t ru_app_ram_min;
+   /** SoftDevice attribute table size, in bytes */
+   uint32_t ru_attr_tab_size;
+   /** BLE engine, worker engine and advertising policy, in bytes */
+   uint32_t ru_engine;
+   /** Advertising module and advertising payload buffers, in bytes */
+   uint32_t ru_advertising;
+   /** BLE event slots, in bytes */
+   uint32_t ru_events;
+};
+
+/** Count of application scheduler events the BLE module may queue */
+#define ADV_BLE_SCHED_QUEUE_SIZE 5U
+
+/**
+ * Bulk data stream source, invoked whenever a notification may be queued.
+ *
+ * @param[out] buf buffer to fill with the next chunk of the stream
+ * @param[in] size maximum chunk size, from the negotiated ATT MTU
+ * @return the chunk size, 0 if the source has no data for now, or a
+ *         negative error code to end the stream
+ */
+typedef int (* adv_ble_bulk_source_t)(uint8_t * buf, size_t size);
+
 void adv_ble_init(void);
+void adv_ble_get_ram_usage(struct adv_ble_ram_usage * usage);
+void adv_ble_set_fault(uint32_t id, uint32_t error, uint32_t pc);
 void adv_ble_start(void);
 void adv_ble_evt_dispatch(ble_evt_t * ble_evt);
 void adv_ble_debug_evt(bool enable);
 void adv_ble_get_advertising(ble_advertising_t ** adv);
+void adv_ble_adv_burst(void);
+void adv_ble_adv_set_alert(uint8_t alert);
+void adv_ble_adv_set_soc(uint8_t soc);
+int adv_ble_bulk_start(adv_ble_bulk_source_t source);
+void adv_ble_bulk_stop(void);
+void adv_ble_bulk_kick(void);
 
 #endif // _ADV_BLE_H
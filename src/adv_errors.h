@@ -47,7 +47,8 @@ enum pa_error {
    PE_NO_SLAVE_DEVICE,     /**< 21: 1-wire slave device is not known */
    PE_PROTECTED,           /**< 22: Safety/energy condition not met */
    PE_UNKNOWN,             /**< 23: Unknown error */
-   PE_COUNT,               /**< 24: Watermark */
+   PE_FAULT,               /**< 24: Fatal fault, before the last reset */
+   PE_COUNT,               /**< 25: Watermark */
 };
 
 /** @} */
@@ -3,6 +3,7 @@
  **/
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include "nrf_warn_enter.h"
@@ -21,6 +22,10 @@
 #include "nrf_sdh_ble.h"
 #include "nrf_warn_leave.h"
 #include "adv_ble.h"
+#ifdef ADV_BENCH
+#include "adv_bench.h"
+#endif // ADV_BENCH
+#include "adv_power.h"
 #include "adv_tools.h"
 #include "adv_trace.h"
 
@@ -30,17 +35,51 @@
 // Constants
 //-----------------------------------------------------------------------------
 
-#define SCHED_QUEUE_SIZE       20
+#define SCHED_QUEUE_SIZE       (20 + ADV_BLE_SCHED_QUEUE_SIZE)
 #define SCHED_MAX_EVENT_DATA_SIZE APP_TIMER_SCHED_EVENT_DATA_SIZE
 
 #define ADV_MAIN_OBSERVER_PRIO 1U
 
+/** Data RAM base address, where the SoftDevice RAM starts */
+#define ADV_MAIN_RAM_BASE      0x20000000U
+
 /**
  * Value used as error code on stack dump, can be used to identify stack
  *location on stack unwind.
  */
 #define DEAD_BEEF 0xDEADBEEFU
 
+/** Postmortem record marker */
+#define ADV_MAIN_PM_MAGIC      0x504D5254U // "PMRT"
+
+/** FNV-1a 32-bit hash offset basis */
+#define ADV_MAIN_FNV_BASIS     0x811C9DC5U
+/** FNV-1a 32-bit hash prime */
+#define ADV_MAIN_FNV_PRIME     0x01000193U
+
+//-----------------------------------------------------------------------------
+// Type definitions
+//-----------------------------------------------------------------------------
+
+/**
+ * Postmortem record, kept in RAM that is neither loaded nor cleared at start
+ * up, so that it survives the reset that follows a fault.
+ */
+struct pa_main_postmortem {
+   uint32_t pm_magic;  /**< Record marker, see #ADV_MAIN_PM_MAGIC */
+   uint32_t pm_id;     /**< Fault identifier, see NRF_FAULT_ID_* */
+   uint32_t pm_pc;     /**< Program counter of the fault */
+   uint32_t pm_file;   /**< FNV-1a hash of the source file base name */
+   uint32_t pm_line;   /**< Source file line */
+   uint32_t pm_error;  /**< Error code */
+   /** Most recent trace identifiers, most recent first */
+   uint32_t pm_traces[ADV_TRACE_RECENT_COUNT];
+   uint32_t pm_check;  /**< FNV-1a hash of the above fields */
+};
+
+// the postmortem report emits four trace identifiers
+ASSERT_COMPILE(ADV_TRACE_RECENT_COUNT == 4U);
+
 //-----------------------------------------------------------------------------
 // Forward declarations
 //-----------------------------------------------------------------------------
@@ -49,11 +88,35 @@ static void _pa_main_evt_handler(uint32_t sys_evt, void * context);
 static void _pa_main_timers_init(void);
 static void _sys_evt_dispatch(uint32_t sys_evt);
 static void _pa_main_power_manage(void);
+static void _pa_main_boot_report(void);
+static void _pa_main_ram_report(void);
+static void _pa_main_postmortem_report(void);
+static uint32_t _pa_main_hash(uint32_t hash, const void * data, size_t length);
+#ifdef ADV_FAST_BOOT
+static void _pa_main_late_init(void * data, uint16_t size);
+#endif // ADV_FAST_BOOT
 
 //-----------------------------------------------------------------------------
 // Variables
 //-----------------------------------------------------------------------------
 
+/** Postmortem record of the last fault, retained across resets */
+static struct pa_main_postmortem _pa_main_postmortem
+   __attribute__((section(".noinit")));
+
+/** Reset reason, as read out at start up */
+static uint32_t _pa_main_reset_reason;
+
+// RAM layout, from the linker script (nrf_common.ld)
+extern uint8_t __data_start__[];
+extern uint8_t __data_end__[];
+extern uint8_t __bss_start__[];
+extern uint8_t __bss_end__[];
+extern uint8_t __HeapBase[];
+extern uint8_t __HeapLimit[];
+extern uint8_t __StackLimit[];
+extern uint8_t __StackTop[];
+
 // nRF52 SDK14 has found that messing around with linker (ordered) sections is
 // a handy trick to register observers at build time. While this may sound
 // clever, this is a recipe for disaster when public SDKs. Anyway, there are
@@ -71,22 +134,47 @@ NRF_SDH_SOC_OBSERVER(_pa_main_observer, ADV_MAIN_OBSERVER_PRIO,
 int
 main(void)
 {
+   adv_power_boot_start();
+
+   // the reset reason register is cumulative, and can only be accessed
+   // directly before the SoftDevice is enabled
+   _pa_main_reset_reason = NRF_POWER->RESETREAS;
+   NRF_POWER->RESETREAS = _pa_main_reset_reason;
+
    pa_trace_init();
+   adv_power_boot_mark(APB_TRACE);
 
    _pa_main_timers_init();
    APP_SCHED_INIT(SCHED_MAX_EVENT_DATA_SIZE, SCHED_QUEUE_SIZE);
+   adv_power_init();
 
    adv_ble_init();
+   // the SoftDevice is now enabled, and has started the LF clock
+   adv_power_start();
 
    // Start execution.
+#ifdef ADV_FAST_BOOT
+   adv_ble_start();
+   // let the BLE module complete its initialization first
+   ret_code_t rc = app_sched_event_put(NULL, 0U, &_pa_main_late_init);
+   APP_ERROR_CHECK(rc);
+#else // ADV_FAST_BOOT
    MSGV(PTL_INFO, "Advertiser " ADV_SW_VERSION " starting");
+   _pa_main_postmortem_report();
    adv_ble_start();
+   _pa_main_boot_report();
+#endif // !ADV_FAST_BOOT
 
    // Enter main loop.
+#ifdef ADV_BENCH
+   // the benchmark harness drives the load and accounts for the CPU time
+   adv_bench_run();
+#else // ADV_BENCH
    for (;;) {
       app_sched_execute();
       _pa_main_power_manage();
    }
+#endif // !ADV_BENCH
 }
 
 /**
@@ -108,25 +196,70 @@ assert_nrf_callback(uint16_t line_num, const uint8_t * file_name)
    app_error_handler(DEAD_BEEF, line_num, file_name);
 }
 
+/**
+ * Record a fault into the postmortem record, and reset the device.
+ * The record is reported once the device restarts, so the RELEASE build
+ * resets right away, without waiting for any trace to be sent out.
+ *
+ * @param[in] id fault identifier, see NRF_FAULT_ID_*
+ * @param[in] pc program counter of the fault, if known
+ * @param[in] info fault information, which depends on the fault identifier
+ */
 void __attribute__((noreturn))
 app_error_fault_handler(uint32_t id, uint32_t pc, uint32_t info)
 {
-   const error_info_t * const error = (const error_info_t * const)info;
+   struct pa_main_postmortem * pm = &_pa_main_postmortem;
+   const char * filename = NULL;
 
-   const char * filename = strrchr((const char *)error->p_file_name, '/');
-   if ( (uintptr_t)filename > (uintptr_t)error->p_file_name ) {
-      filename += 1;
+   memset(pm, 0, sizeof(*pm));
+   pm->pm_id = id;
+   pm->pm_pc = pc;
+   switch ( id ) {
+      case NRF_FAULT_ID_SDK_ERROR: {
+         const error_info_t * error = (const error_info_t *)info;
+         filename = (const char *)error->p_file_name;
+         pm->pm_line = error->line_num;
+         pm->pm_error = error->err_code;
+         break;
+      }
+      case NRF_FAULT_ID_SDK_ASSERT: {
+         const assert_info_t * assertion = (const assert_info_t *)info;
+         filename = (const char *)assertion->p_file_name;
+         pm->pm_line = assertion->line_num;
+         break;
+      }
+      default:
+         // SoftDevice assertion or memory access: info is an address
+         pm->pm_error = info;
+         break;
    }
 
+   if ( filename ) {
+      const char * basename = strrchr(filename, '/');
+      if ( basename ) {
+         filename = basename + 1;
+      }
+      pm->pm_file = _pa_main_hash(ADV_MAIN_FNV_BASIS, filename,
+                                  strlen(filename));
+   }
+   pa_trace_get_recent(&pm->pm_traces[0], ARRAY_SIZE(pm->pm_traces));
+   pm->pm_magic = ADV_MAIN_PM_MAGIC;
+   pm->pm_check = _pa_main_hash(ADV_MAIN_FNV_BASIS, pm,
+                                offsetof(struct pa_main_postmortem,
+                                         pm_check));
+   __DSB();
+
+   #ifndef DEBUG
+   NVIC_SystemReset();
+   #else // DEBUG
    char fatal_msg[120];
    size_t fatal_len;
    fatal_len = (size_t)snprintf(fatal_msg, sizeof(fatal_msg),
-                                "FAULT:%08x PC:%08x @ %s:%d error 0x%04x\n",
-                                id, pc, filename, error->line_num,
-                                error->err_code);
+                                "FAULT:%08x PC:%08x @ %s:%u error 0x%04x\n",
+                                id, pc, filename ? filename : "?",
+                                (unsigned int)pm->pm_line,
+                                (unsigned int)pm->pm_error);
    pa_trace_fatal_error(fatal_msg, fatal_len);
-   #ifndef DEBUG
-   NVIC_SystemReset();
    #endif // !DEBUG
    // never reached in RELEASE build, but as Nordic fails to declare the
    // reset API as non-returning, the compiler would complain about a
@@ -163,6 +296,8 @@ _pa_main_timers_init(void)
 static void
 _pa_main_evt_handler(uint32_t sys_evt, void * context _unused)
 {
+   adv_power_wakeup(APW_SOFTDEVICE);
+
 #if FSTORAGE_ENABLED
    // Dispatch the system event to the fstorage module, where it will be
    // dispatched to the Flash Data Storage (FDS) module.
@@ -177,12 +312,131 @@ _pa_main_evt_handler(uint32_t sys_evt, void * context _unused)
    ble_advertising_on_sys_evt(sys_evt, adv);
 }
 
+/**
+ * Report the fault of the previous run, if any, and the reset reason.
+ * The postmortem record is consumed, so that a fault is only reported once.
+ */
+static void
+_pa_main_postmortem_report(void)
+{
+   struct pa_main_postmortem * pm = &_pa_main_postmortem;
+
+   MSGV(PTL_INFO, "Reset reason 0x%08x", _pa_main_reset_reason);
+
+   if ( ADV_MAIN_PM_MAGIC != pm->pm_magic ) {
+      // cold boot or clean reset: RAM content is random
+      return;
+   }
+   uint32_t check = _pa_main_hash(ADV_MAIN_FNV_BASIS, pm,
+                                  offsetof(struct pa_main_postmortem,
+                                           pm_check));
+   pm->pm_magic = 0U;
+   if ( check != pm->pm_check ) {
+      MSGV(PTL_WARN, "Corrupted postmortem record");
+      return;
+   }
+
+   MSGV(PTL_ERROR, "Previous fault %04x PC:%08x @ %08x:%u error 0x%04x",
+        pm->pm_id, pm->pm_pc, pm->pm_file, pm->pm_line, pm->pm_error);
+   MSGV(PTL_ERROR, "Previous traces %08x %08x %08x %08x",
+        pm->pm_traces[0], pm->pm_traces[1], pm->pm_traces[2],
+        pm->pm_traces[3]);
+
+   adv_ble_set_fault(pm->pm_id, pm->pm_error, pm->pm_pc);
+}
+
+/**
+ * Compute a FNV-1a 32-bit hash.
+ * May be invoked from the fault handler.
+ *
+ * @param[in] hash the initial hash value, usually #ADV_MAIN_FNV_BASIS
+ * @param[in] data the data to hash
+ * @param[in] length the count of bytes to hash
+ * @return the updated hash value
+ */
+static uint32_t
+_pa_main_hash(uint32_t hash, const void * data, size_t length)
+{
+   const uint8_t * bytes = (const uint8_t *)data;
+
+   while ( length-- ) {
+      hash ^= *bytes++;
+      hash *= ADV_MAIN_FNV_PRIME;
+   }
+
+   return hash;
+}
+
+/**
+ * Report the boot milestones
+ */
+static void
+_pa_main_boot_report(void)
+{
+   MSGV(PTL_INFO, "Boot: trace %u, stack %u, services %u, adv %u, "
+        "ready %u us",
+        adv_power_boot_time(APB_TRACE), adv_power_boot_time(APB_STACK),
+        adv_power_boot_time(APB_SERVICES),
+        adv_power_boot_time(APB_ADVERTISING),
+        adv_power_boot_time(APB_READY));
+
+   _pa_main_ram_report();
+}
+
+/**
+ * Report the RAM layout, the SoftDevice requirements, and the static RAM
+ * used by the main modules
+ */
+static void
+_pa_main_ram_report(void)
+{
+   struct adv_ble_ram_usage ble;
+   adv_ble_get_ram_usage(&ble);
+
+   MSGV(PTL_INFO, "RAM: SD %u (%u spare), data %u, bss %u, heap %u, "
+        "stack %u",
+        ble.ru_app_ram_min - ADV_MAIN_RAM_BASE,
+        ble.ru_app_ram_start - ble.ru_app_ram_min,
+        (unsigned int)(__data_end__ - __data_start__),
+        (unsigned int)(__bss_end__ - __bss_start__),
+        (unsigned int)(__HeapLimit - __HeapBase),
+        (unsigned int)(__StackTop - __StackLimit));
+   MSGV(PTL_INFO, "RAM: trace %u, sched %u, ble %u, adv %u, events %u, "
+        "attr tab %u",
+        (unsigned int)pa_trace_ram_size(),
+        (unsigned int)APP_SCHED_BUF_SIZE(SCHED_MAX_EVENT_DATA_SIZE,
+                                         SCHED_QUEUE_SIZE),
+        ble.ru_engine, ble.ru_advertising, ble.ru_events,
+        ble.ru_attr_tab_size);
+}
+
+#ifdef ADV_FAST_BOOT
+/**
+ * Complete the application start up from the main loop, once the device
+ * advertises.
+ *
+ * @param[in] data unused
+ * @param[in] size unused
+ */
+static void
+_pa_main_late_init(void * data, uint16_t size)
+{
+   (void)data;
+   (void)size;
+
+   pa_trace_banner();
+   MSGV(PTL_INFO, "Advertiser " ADV_SW_VERSION " starting");
+   _pa_main_postmortem_report();
+   _pa_main_boot_report();
+}
+#endif // ADV_FAST_BOOT
+
 /**
  * Wait for an event
  */
 static void
 _pa_main_power_manage(void)
 {
-   ret_code_t rc = sd_app_evt_wait();
-   APP_ERROR_CHECK(rc);
+   // wake ups are accounted by cause
+   adv_power_wait();
 }
@@ -0,0 +1,305 @@
+/**
+ * PowerAdvertiser power instrumentation
+ *
+ * Track where the time goes, and what wakes the CPU up, to tune the
+ * advertising policy and to predict battery life.
+ *
+ * @file adv_power.c
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "nrf_warn_enter.h"
+#include "app_error.h"
+#include "app_scheduler.h"
+#include "app_util_platform.h"
+#include "nordic_common.h"
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "nrf_warn_leave.h"
+#include "adv_power.h"
+#include "adv_tools.h"
+#include "adv_trace.h"
+
+//-----------------------------------------------------------------------------
+// Constants
+//-----------------------------------------------------------------------------
+
+/**
+ * Time base. The SoftDevice uses RTC0 and app_timer RTC1, so RTC2 runs from
+ * the LF clock with the largest prescaler. It is only read on demand, and
+ * never interrupts the CPU; its 24-bit counter wraps after about 24 days.
+ */
+#define ADV_POWER_RTC            NRF_RTC2
+/** Time base prescaler */
+#define ADV_POWER_RTC_PRESCALER  4095U
+/** Time base frequency */
+#define ADV_POWER_RTC_FREQ       (32768U / (ADV_POWER_RTC_PRESCALER + 1U))
+
+/**
+ * Boot milestones are timed with the DWT cycle counter, as the LF clock is
+ * not running before the SoftDevice is enabled. The counter only runs while
+ * the CPU does, which is the case along the boot path up to the main loop.
+ */
+#define ADV_POWER_BOOT_CYCLES_PER_US (SystemCoreClock / 1000000U)
+
+//-----------------------------------------------------------------------------
+// Type definitions
+//-----------------------------------------------------------------------------
+
+/** Power instrumentation engine */
+struct adv_power {
+   uint32_t pw_counter;     /**< Time base counter at last time read out */
+   uint32_t pw_time;        /**< Extended time base */
+   enum adv_power_state pw_state; /**< Current power state */
+   uint32_t pw_since;       /**< Time of the last state transition */
+   uint32_t pw_pending;     /**< Wake up causes since last wait, bitfield */
+   struct adv_power_stats pw_stats; /**< Accumulated statistics */
+};
+
+//-----------------------------------------------------------------------------
+// Variables
+//-----------------------------------------------------------------------------
+
+/** Power instrumentation engine instance */
+static struct adv_power _adv_power;
+
+/**
+ * Boot milestones, in CPU cycles. Kept apart from the engine, as they are
+ * recorded before the power instrumentation is initialized.
+ */
+static uint32_t _adv_power_boot_cycles[APB_COUNT];
+
+/** Cycle counter value at application entry */
+static uint32_t _adv_power_boot_origin;
+
+//-----------------------------------------------------------------------------
+// Public API
+//-----------------------------------------------------------------------------
+
+/**
+ * Start timing the boot sequence.
+ * This function should be called first from the application entry point.
+ */
+void
+adv_power_boot_start(void)
+{
+   CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+   DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+   _adv_power_boot_origin = DWT->CYCCNT;
+}
+
+/**
+ * Record a boot milestone, if it has not been reached yet.
+ * May be invoked from any context.
+ *
+ * @param[in] milestone the boot milestone
+ */
+void
+adv_power_boot_mark(enum adv_power_boot milestone)
+{
+   if ( milestone >= APB_COUNT ) {
+      return;
+   }
+
+   uint32_t cycles = DWT->CYCCNT - _adv_power_boot_origin;
+
+   CRITICAL_REGION_ENTER();
+   if ( ! _adv_power_boot_cycles[milestone] ) {
+      // zero marks an unreached milestone
+      _adv_power_boot_cycles[milestone] = MAX(cycles, 1U);
+   }
+   CRITICAL_REGION_EXIT();
+}
+
+/**
+ * Provide the time a boot milestone has been reached at.
+ *
+ * @param[in] milestone the boot milestone
+ * @return the time since the application entry, in microseconds, or 0 if
+ *         the milestone has not been reached yet
+ */
+uint32_t
+adv_power_boot_time(enum adv_power_boot milestone)
+{
+   if ( milestone >= APB_COUNT ) {
+      return 0U;
+   }
+
+   uint32_t cycles = _adv_power_boot_cycles[milestone];
+   if ( ! cycles ) {
+      return 0U;
+   }
+
+   return MAX(cycles / ADV_POWER_BOOT_CYCLES_PER_US, 1U);
+}
+
+/**
+ * Initialize the power instrumentation. Its time base stays stopped, and
+ * reads as zero, until adv_power_start() is called.
+ */
+void
+adv_power_init(void)
+{
+   NRF_RTC_Type * rtc = ADV_POWER_RTC;
+
+   rtc->TASKS_STOP = 1U;
+   rtc->PRESCALER = ADV_POWER_RTC_PRESCALER;
+   rtc->TASKS_CLEAR = 1U;
+
+   memset(&_adv_power, 0, sizeof(_adv_power));
+   _adv_power.pw_state = APS_IDLE;
+   _adv_power.pw_stats.ps_freq = ADV_POWER_RTC_FREQ;
+}
+
+/**
+ * Start the time base of the power instrumentation.
+ * The RTC only counts once the LF clock runs, so this function should be
+ * called once the SoftDevice is enabled, as the SoftDevice starts the LF
+ * clock.
+ */
+void
+adv_power_start(void)
+{
+   ADV_POWER_RTC->TASKS_START = 1U;
+}
+
+/**
+ * Provide the current time.
+ * This function should be called at least once per time base counter wrap.
+ * May be invoked from any context.
+ *
+ * @return the time, in time base ticks, see adv_power_time_freq()
+ */
+uint32_t
+adv_power_time(void)
+{
+   struct adv_power * pw = &_adv_power;
+   uint32_t time;
+
+   CRITICAL_REGION_ENTER();
+   uint32_t counter = ADV_POWER_RTC->COUNTER;
+   pw->pw_time += (counter - pw->pw_counter) & RTC_COUNTER_COUNTER_Msk;
+   pw->pw_counter = counter;
+   time = pw->pw_time;
+   CRITICAL_REGION_EXIT();
+
+   return time;
+}
+
+/**
+ * Provide the time base frequency.
+ *
+ * @return the time base frequency, in Hz
+ */
+uint32_t
+adv_power_time_freq(void)
+{
+   return ADV_POWER_RTC_FREQ;
+}
+
+/**
+ * Account for a power state transition.
+ * May be invoked from any context.
+ *
+ * @param[in] state the new power state
+ */
+void
+adv_power_set_state(enum adv_power_state state)
+{
+   struct adv_power * pw = &_adv_power;
+
+   if ( state >= APS_COUNT ) {
+      return;
+   }
+
+   uint32_t now = adv_power_time();
+   enum adv_power_state prev;
+
+   CRITICAL_REGION_ENTER();
+   prev = pw->pw_state;
+   pw->pw_stats.ps_ticks[prev] += now - pw->pw_since;
+   pw->pw_since = now;
+   pw->pw_state = state;
+   CRITICAL_REGION_EXIT();
+
+   if ( prev != state ) {
+      MSGV(PTL_DEBUG, "Power state %u -> %u", prev, state);
+   }
+}
+
+/**
+ * Record a wake up cause, to be accounted once the main loop resumes.
+ * May be invoked from any context, usually from interrupt handlers.
+ *
+ * @param[in] cause the wake up cause
+ */
+void
+adv_power_wakeup(enum adv_power_wakeup cause)
+{
+   CRITICAL_REGION_ENTER();
+   _adv_power.pw_pending |= 1U << cause;
+   CRITICAL_REGION_EXIT();
+}
+
+/**
+ * Wait for an event, and account for the wake up.
+ * This function should only be called from the main loop.
+ */
+void
+adv_power_wait(void)
+{
+   struct adv_power * pw = &_adv_power;
+
+   uint16_t sched_space = app_sched_queue_space_get();
+
+   ret_code_t rc = sd_app_evt_wait();
+   APP_ERROR_CHECK(rc);
+
+   uint32_t pending;
+
+   CRITICAL_REGION_ENTER();
+   pending = pw->pw_pending;
+   pw->pw_pending = 0U;
+   CRITICAL_REGION_EXIT();
+
+   if ( app_sched_queue_space_get() < sched_space ) {
+      // some event has been queued for the main loop
+      pending |= 1U << APW_SCHEDULER;
+   }
+
+   struct adv_power_stats * stats = &pw->pw_stats;
+   stats->ps_wakeups++;
+   if ( ! pending ) {
+      pending = 1U << APW_OTHER;
+   }
+   for (unsigned int cix=0; cix<APW_COUNT; cix++) {
+      if ( pending & (1U << cix) ) {
+         stats->ps_causes[cix]++;
+      }
+   }
+}
+
+/**
+ * Provide the power statistics, including the ongoing state period.
+ *
+ * @param[out] stats the statistics
+ */
+void
+adv_power_get_stats(struct adv_power_stats * stats)
+{
+   struct adv_power * pw = &_adv_power;
+   uint32_t now = adv_power_time();
+
+   CRITICAL_REGION_ENTER();
+   *stats = pw->pw_stats;
+   stats->ps_ticks[pw->pw_state] += now - pw->pw_since;
+   CRITICAL_REGION_EXIT();
+
+   stats->ps_time = now;
+
+   for (unsigned int bix=0; bix<APB_COUNT; bix++) {
+      stats->ps_boot[bix] = adv_power_boot_time((enum adv_power_boot)bix);
+   }
+}
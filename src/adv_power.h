@@ -0,0 +1,69 @@
+/**
+ * PowerAdvertiser power instrumentation
+ *
+ * @file adv_power.h
+ */
+
+#ifndef _ADV_POWER_H
+#define _ADV_POWER_H
+
+#include <stdint.h>
+
+/** Device power states, as seen from the BLE activity */
+enum adv_power_state {
+   APS_IDLE,       /**< Neither advertising nor connected */
+   APS_ADV_FAST,   /**< Advertising, first steps of the advertising ladder */
+   APS_ADV_SLOW,   /**< Advertising, slower steps of the advertising ladder */
+   APS_CONNECTED,  /**< A client is connected */
+   APS_COUNT,      /**< (watermark) */
+};
+
+/** Main loop wake up causes */
+enum adv_power_wakeup {
+   APW_SOFTDEVICE, /**< SoftDevice BLE or SoC event */
+   APW_SCHEDULER,  /**< Application scheduler event */
+   APW_TRACE,      /**< Trace back-end interrupt */
+   APW_TIMER,      /**< Application timer */
+   APW_OTHER,      /**< Any other, or unidentified, cause */
+   APW_COUNT,      /**< (watermark) */
+};
+
+/**
+ * Boot milestones, from the application entry point.
+ * Each milestone is only recorded once.
+ */
+enum adv_power_boot {
+   APB_TRACE,       /**< Trace subsystem is up */
+   APB_STACK,       /**< SoftDevice is enabled */
+   APB_SERVICES,    /**< Advertised GATT service is registered */
+   APB_ADVERTISING, /**< First advertising set is started */
+   APB_READY,       /**< All BLE services are up, including deferred ones */
+   APB_COUNT,       /**< (watermark) */
+};
+
+/**
+ * Power statistics.
+ * This record is exposed as is over BLE, beware of item alignment.
+ */
+struct adv_power_stats {
+   uint32_t ps_freq;               /**< Time base frequency, in Hz */
+   uint32_t ps_time;               /**< Time base ticks since start up */
+   uint32_t ps_ticks[APS_COUNT];   /**< Time base ticks spent in each state */
+   uint32_t ps_wakeups;            /**< Count of main loop wake ups */
+   uint32_t ps_causes[APW_COUNT];  /**< Count of wake ups, per cause */
+   uint32_t ps_boot[APB_COUNT];    /**< Boot milestones, in microseconds */
+};
+
+void adv_power_boot_start(void);
+void adv_power_boot_mark(enum adv_power_boot milestone);
+uint32_t adv_power_boot_time(enum adv_power_boot milestone);
+void adv_power_init(void);
+void adv_power_start(void);
+uint32_t adv_power_time(void);
+uint32_t adv_power_time_freq(void);
+void adv_power_set_state(enum adv_power_state state);
+void adv_power_wakeup(enum adv_power_wakeup cause);
+void adv_power_wait(void);
+void adv_power_get_stats(struct adv_power_stats * stats);
+
+#endif // _ADV_POWER_H
@@ -7,7 +7,12 @@
 #ifndef _ADV_TOOLS_H_
 #define _ADV_TOOLS_H_
 
+#include <limits.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 //-----------------------------------------------------------------------------
 // Macros
@@ -215,6 +220,238 @@ set_uint64(uint8_t * buf, uint64_t value)
    set_uint32(buf+sizeof(uint32_t), (uint32_t)(value >> 32U));
 }
 
+//-----------------------------------------------------------------------------
+// Formatting inline function helpers
+//
+// Allocation-free replacements for the printf family on hot paths. Emitters
+// write their digits at the destination pointer, which should be large
+// enough, never add an end-of-string marker and return the pointer past the
+// last written character.
+//-----------------------------------------------------------------------------
+
+/** Largest count of digits of a 32-bit integer, in hexadecimal */
+#define FMT_UINT32_HEX_LEN 8U
+/** Largest count of digits of a 32-bit integer, in decimal */
+#define FMT_UINT32_DEC_LEN 10U
+/** Largest field width supported by #fmt_vformat */
+#define FMT_WIDTH_MAX 32U
+
+/**
+ * Emit a byte as two lower case hexadecimal digits
+ *
+ * @param[out] dst the destination, at least 2 characters long
+ * @param[in] value the byte to emit
+ * @return the pointer past the last emitted digit
+ */
+static inline char *
+fmt_hex_uint8(char * dst, uint8_t value)
+{
+   static const char hex[16] = "0123456789abcdef";
+
+   dst[0] = hex[value >> 4U];
+   dst[1] = hex[value & 0xfU];
+   return &dst[2];
+}
+
+/**
+ * Emit a 32-bit integer as lower case hexadecimal digits
+ *
+ * @param[out] dst the destination, at least #FMT_UINT32_HEX_LEN characters
+ *                 long
+ * @param[in] value the integer to emit
+ * @param[in] width the minimum count of digits, zero padded, up to
+ *                  #FMT_UINT32_HEX_LEN
+ * @return the pointer past the last emitted digit
+ */
+static inline char *
+fmt_hex_uint32(char * dst, uint32_t value, unsigned int width)
+{
+   static const char hex[16] = "0123456789abcdef";
+
+   unsigned int count = value ? (35U - (unsigned int)__builtin_clz(value))/4U
+                              : 1U;
+   count = MIN(MAX(count, width), FMT_UINT32_HEX_LEN);
+
+   for (unsigned int ix=count; ix>0; ix--) {
+      dst[ix-1U] = hex[value & 0xfU];
+      value >>= 4U;
+   }
+   return &dst[count];
+}
+
+/**
+ * Emit a 32-bit integer as decimal digits
+ *
+ * Digits are emitted by pairs, from a lookup table.
+ *
+ * @param[out] dst the destination, at least #FMT_UINT32_DEC_LEN characters
+ *                 long
+ * @param[in] value the integer to emit
+ * @return the pointer past the last emitted digit
+ */
+static inline char *
+fmt_dec_uint32(char * dst, uint32_t value)
+{
+   static const char pairs[200] =
+      "00010203040506070809" "10111213141516171819"
+      "20212223242526272829" "30313233343536373839"
+      "40414243444546474849" "50515253545556575859"
+      "60616263646566676869" "70717273747576777879"
+      "80818283848586878889" "90919293949596979899";
+
+   char tmp[FMT_UINT32_DEC_LEN];
+   char * ptr = &tmp[FMT_UINT32_DEC_LEN];
+
+   while ( value >= 100U ) {
+      unsigned int pix = (value % 100U) * 2U;
+      value /= 100U;
+      *--ptr = pairs[pix+1U];
+      *--ptr = pairs[pix];
+   }
+   if ( value >= 10U ) {
+      *--ptr = pairs[value*2U+1U];
+      *--ptr = pairs[value*2U];
+   } else {
+      *--ptr = (char)('0' + value);
+   }
+
+   size_t len = (size_t)(&tmp[FMT_UINT32_DEC_LEN] - ptr);
+   memcpy(dst, ptr, len);
+   return &dst[len];
+}
+
+/**
+ * Append a string to a bounded destination, keeping track of the length it
+ * would have if the destination were large enough
+ *
+ * @param[out] dst the destination string
+ * @param[in] dlen the size of the destination, including the end-of-string
+ *                 marker
+ * @param[in,out] pos the current length of the formatted string
+ * @param[in] str the string to append, or @c NULL to append @p len times the
+ *                @p fill character
+ * @param[in] fill the filler character
+ * @param[in] len the count of characters to append
+ */
+static inline void
+_fmt_append(char * dst, size_t dlen, size_t * pos, const char * str,
+            char fill, size_t len)
+{
+   if ( *pos < dlen ) {
+      size_t count = MIN(len, dlen - *pos - 1U);
+      if ( str ) {
+         memcpy(&dst[*pos], str, count);
+      } else {
+         memset(&dst[*pos], fill, count);
+      }
+   }
+   *pos += len;
+}
+
+/**
+ * Format a string from a restricted format specification.
+ *
+ * Only supports the @c %%u, @c %%d, @c %%x and @c %%s conversions, with an
+ * optional zero-padding flag and field width, and @c %%%%. Any other
+ * specification is rejected, so that the caller may fall back to the
+ * printf family with a copy of the argument list.
+ *
+ * @param[out] dst the destination string, always terminated if @p dlen is
+ *                 not null
+ * @param[in] dlen the size of the destination
+ * @param[in] fmt the format string
+ * @param[in] ap the argument list, consumed up to the first unsupported
+ *               specification
+ * @return the count of characters the formatted string would contain if the
+ *         destination were large enough, as vsnprintf, or -1 on unsupported
+ *         specification
+ */
+static inline int
+fmt_vformat(char * dst, size_t dlen, const char * fmt, va_list ap)
+{
+   size_t pos = 0;
+
+   while ( *fmt ) {
+      if ( *fmt != '%' ) {
+         const char * lit = fmt;
+         while ( *fmt && (*fmt != '%') ) {
+            fmt++;
+         }
+         _fmt_append(dst, dlen, &pos, lit, 0, (size_t)(fmt - lit));
+         continue;
+      }
+      fmt++;
+      if ( *fmt == '%' ) {
+         _fmt_append(dst, dlen, &pos, fmt++, 0, 1U);
+         continue;
+      }
+
+      char fill = ' ';
+      if ( *fmt == '0' ) {
+         fill = '0';
+         fmt++;
+      }
+      unsigned int width = 0;
+      while ( (*fmt >= '0') && (*fmt <= '9') ) {
+         width = width*10U + (unsigned int)(*fmt++ - '0');
+         if ( width > FMT_WIDTH_MAX ) {
+            return -1;
+         }
+      }
+
+      char num[1U+FMT_UINT32_DEC_LEN];
+      const char * str = &num[0];
+      size_t len;
+      bool neg = false;
+
+      switch ( *fmt++ ) {
+         case 'u':
+            len = (size_t)(fmt_dec_uint32(num, va_arg(ap, unsigned int)) -
+                           num);
+            break;
+         case 'd':
+            {
+               int value = va_arg(ap, int);
+               neg = value < 0;
+               uint32_t mag = neg ? 0U-(uint32_t)value : (uint32_t)value;
+               len = (size_t)(fmt_dec_uint32(num, mag) - num);
+            }
+            break;
+         case 'x':
+            len = (size_t)(fmt_hex_uint32(num, va_arg(ap, unsigned int), 0) -
+                           num);
+            break;
+         case 's':
+            str = va_arg(ap, const char *);
+            if ( ! str ) {
+               str = "(null)";
+            }
+            len = strlen(str);
+            // zero padding is undefined with strings
+            fill = ' ';
+            break;
+         default:
+            return -1;
+      }
+
+      size_t pad = (width > len + neg) ? width - len - neg : 0;
+      if ( neg && (fill == '0') ) {
+         _fmt_append(dst, dlen, &pos, "-", 0, 1U);
+      }
+      _fmt_append(dst, dlen, &pos, NULL, fill, pad);
+      if ( neg && (fill != '0') ) {
+         _fmt_append(dst, dlen, &pos, "-", 0, 1U);
+      }
+      _fmt_append(dst, dlen, &pos, str, 0, len);
+   }
+
+   if ( dlen ) {
+      dst[MIN(pos, dlen - 1U)] = '\0';
+   }
+
+   return (pos <= INT_MAX) ? (int)pos : -1;
+}
+
 #pragma clang diagnostic pop
 
 /** @} */
@@ -14,7 +14,12 @@
 #include "nordic_common.h"
 #include "nrfx_uarte.h"
 #include "app_timer.h"
+#ifdef ADV_TRACE_RTT
+#include "SEGGER_RTT.h"
+#endif // ADV_TRACE_RTT
 #include "nrf_warn_leave.h"
+#include "adv_errors.h"
+#include "adv_power.h"
 #include "adv_trace.h"
 #include "adv_tools.h"
 #include "adv_tracesrcs.h"
@@ -30,8 +35,20 @@
 #define ADV_TRACE_SHOW_TIME
 // define to emit a trace with a trace counter
 #define ADV_TRACE_SHOW_COUNT
-// define to emit a trace with an IRQ context
-#undef ADV_TRACE_SHOW_CTX
+// define to emit a trace with an IRQ context, traces emitted from an IRQ
+// handler are discarded otherwise
+#define ADV_TRACE_SHOW_CTX
+// define to coalesce contiguous queued messages into a single transfer by
+// default, see #PTF_BATCH
+#define ADV_TRACE_BATCH_FLUSH
+// define to timestamp traces with a high resolution counter rather than with
+// the RTC: DWT cycle counter if a debugger is attached, a TIMER otherwise
+#undef ADV_TRACE_HIRES_TIME
+// define to periodically emit a summary line of the trace statistics
+#undef ADV_TRACE_STATS_SUMMARY
+// define to emit traces into a SEGGER RTT buffer rather than to the UARTE
+// debug port; usually defined from the build system (TRACE_RTT)
+//#define ADV_TRACE_RTT
 
 //-----------------------------------------------------------------------------
 // Constants
@@ -41,19 +58,87 @@
 #define ADV_TRACE_MSG_LENGTH       127
 /** Maximum count of a debug traces in transmit queue. */
 #define ADV_TRACE_MSG_COUNT_LOG2   7U // 128
+/** Size of the byte ring that stores the trace messages. */
+#define ADV_TRACE_BUF_SIZE_LOG2    12U // 4 KiB
 
 #define MSG_QUEUE_SIZE            (1U << ADV_TRACE_MSG_COUNT_LOG2)
 #define MSG_QUEUE_MASK            (MSG_QUEUE_SIZE - 1U)
+#define BUF_QUEUE_SIZE            (1U << ADV_TRACE_BUF_SIZE_LOG2)
+#define BUF_QUEUE_MASK            (BUF_QUEUE_SIZE - 1U)
 
-#define DISABLE_ALL_TRACES_MASK   ((1ULL << 32U) - 1U)
-#define PTS_BITS                  (CHAR_BIT * sizeof(uint32_t))  // 32 bits
-#define PTS_MASK                  (PTS_BITS - 1)
-#define PTS_SHIFT                 5  // 32 bits = 2^5
-#define PTL_LVLBITS               3  // 8 level (3 bits)
-#define PTL_BITS                  4  // 8 level (3 bits) + 1 bit extra per src
-#define PTL_MASK                  ((1U << (PTL_LVLBITS)) -1)
-#define PTM_BITS                  (PTL_BITS * PTM_COUNT)
-#define PTN_WORDS                 ((PTM_BITS + (PTS_BITS - 1)) / PTS_BITS)
+/**
+ * Maximum count of bytes of a single UARTE transfer, when batching is enabled
+ * UARTE EasyDMA MAXCNT is 8-bit wide on nRF52832.
+ */
+#define ADV_TRACE_TX_BATCH_LENGTH  255U
+/** RTC frequency, in Hz */
+#define ADV_TRACE_RTC_FREQ \
+   (APP_TIMER_CLOCK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1U))
+
+/**
+ * TIMER instance for high resolution timestamps, when no debugger is attached.
+ * TIMER0 is reserved for the SoftDevice. Note that a running TIMER keeps
+ * the HFCLK requested.
+ */
+#define ADV_TRACE_HIRES_TIMER      NRF_TIMER2
+/** Capture channel of the high resolution TIMER */
+#define ADV_TRACE_HIRES_TIMER_CC   0U
+/** High resolution TIMER frequency, in Hz: 16 MHz, no prescaler */
+#define ADV_TRACE_HIRES_TIMER_FREQ 16000000U
+
+/** Minimum period between two time correlation records, in seconds */
+#define ADV_TRACE_SYNC_PERIOD_S    10U
+/** Minimum period between two time correlation records, in RTC ticks */
+#define ADV_TRACE_SYNC_PERIOD \
+   (ADV_TRACE_SYNC_PERIOD_S * ADV_TRACE_RTC_FREQ)
+
+/** Minimum period between two trace statistics summary lines, in seconds */
+#define ADV_TRACE_STATS_PERIOD_S   10U
+/** Minimum period between two trace statistics summary lines, in RTC ticks */
+#define ADV_TRACE_STATS_PERIOD \
+   (ADV_TRACE_STATS_PERIOD_S * ADV_TRACE_RTC_FREQ)
+
+/** RTT up buffer used for traces */
+#define ADV_TRACE_RTT_CHANNEL      0U
+/**
+ * Maximum count of bytes of a single RTT write, which should fit in the RTT up
+ * buffer for the write to ever succeed.
+ */
+#define ADV_TRACE_RTT_BATCH_LENGTH 512U
+
+#ifdef ADV_TRACE_BATCH_FLUSH
+#define ADV_TRACE_BATCH_MODE       PTF_BATCH
+#else // ADV_TRACE_BATCH_FLUSH
+#define ADV_TRACE_BATCH_MODE       0U
+#endif // !ADV_TRACE_BATCH_FLUSH
+#ifdef ADV_TRACE_BINARY
+#define ADV_TRACE_BINARY_MODE      PTF_BINARY
+#else // ADV_TRACE_BINARY
+#define ADV_TRACE_BINARY_MODE      0U
+#endif // !ADV_TRACE_BINARY
+/** Trace modes at start up, unless restored from the persisted settings */
+#define ADV_TRACE_DEFAULT_MODES \
+   (ADV_TRACE_BATCH_MODE | ADV_TRACE_BINARY_MODE)
+/** Trace modes that may be changed at runtime */
+#define ADV_TRACE_RUNTIME_MODES    (PTF_BATCH | PTF_PAUSE)
+
+/** Persisted trace settings marker */
+#define ADV_TRACE_PERSIST_MAGIC    0x54524331U // "TRC1"
+
+/** Message header value for a claimed, not yet committed, message */
+#define MSG_HEADER_PENDING        0x00U
+/** Message header flag for ring padding, which is never transmitted */
+#define MSG_HEADER_SKIP           0x80U
+/** Message header mask to retrieve the byte count */
+#define MSG_HEADER_LENGTH_MASK    (MSG_HEADER_SKIP - 1U)
+
+/** Build a queue position from a header counter and a byte counter */
+#define TQ_POS(_hdrs_, _bytes_) \
+   ((((uint32_t)(uint16_t)(_hdrs_)) << 16U) | ((uint32_t)(uint16_t)(_bytes_)))
+/** Free-running header counter of a queue position */
+#define TQ_POS_HDRS(_pos_)        ((uint16_t)((_pos_) >> 16U))
+/** Free-running byte counter of a queue position */
+#define TQ_POS_BYTES(_pos_)       ((uint16_t)(_pos_))
 
 #define _BPLS                     4U  // Byte per line
 #define _BPL                      (1U << _BPLS)
@@ -79,63 +164,168 @@
 #define ADV_TRACE_FMT_HEADER \
    ADV_TRACE_FMT_TIME ADV_TRACE_FMT_COUNT ADV_TRACE_FMT_CTX
 
-ASSERT_COMPILE((1U << PTS_SHIFT) == PTS_BITS);
+/**
+ * Binary trace record marker, ORed with the argument count.
+ * As text traces are plain ASCII, the MSB tells binary records apart.
+ */
+#define ADV_TRACE_BIN_MARKER       0x80U
+/** Binary trace record header size: marker, id, time, source/level, count */
+#define ADV_TRACE_BIN_HEADER_SIZE  (1U + 2U + 4U + 1U + 1U)
+/** Largest binary trace record */
+#define ADV_TRACE_BIN_RECORD_SIZE  \
+   (ADV_TRACE_BIN_HEADER_SIZE + ADV_TRACE_BIN_ARGS_MAX * sizeof(uint32_t))
+
+ASSERT_COMPILE((1U << PTS_SHIFT) == (CHAR_BIT * sizeof(uint32_t)));
 ASSERT_COMPILE(PTL_COUNT <= 8);
 // PTM_COUNT can be augmented, nevertheless for now we want to control
 // the enumeration count
 ASSERT_COMPILE(PTM_COUNT == 32);
+// message length and padding length should fit into a message header
+ASSERT_COMPILE(ADV_TRACE_MSG_LENGTH <= MSG_HEADER_LENGTH_MASK);
+// the ring should at least store as many messages as there are headers
+ASSERT_COMPILE(BUF_QUEUE_SIZE >= (MSG_QUEUE_SIZE * 8U));
+// free-running 16-bit counters should wrap on a ring boundary
+ASSERT_COMPILE(BUF_QUEUE_SIZE <= (1U << 15U));
+// a transfer should at least contain the longest message
+ASSERT_COMPILE(ADV_TRACE_TX_BATCH_LENGTH >= ADV_TRACE_MSG_LENGTH);
+ASSERT_COMPILE(ADV_TRACE_RTT_BATCH_LENGTH >= ADV_TRACE_MSG_LENGTH);
+#ifdef BUFFER_SIZE_UP
+ASSERT_COMPILE(ADV_TRACE_RTT_BATCH_LENGTH <= BUFFER_SIZE_UP);
+#endif // BUFFER_SIZE_UP
+ASSERT_COMPILE(ADV_TRACE_BIN_RECORD_SIZE <= ADV_TRACE_MSG_LENGTH);
+ASSERT_COMPILE(ADV_TRACE_BIN_ARGS_MAX < ADV_TRACE_BIN_MARKER);
+#ifdef UARTE0_EASYDMA_MAXCNT_SIZE
+ASSERT_COMPILE(ADV_TRACE_TX_BATCH_LENGTH < (1U << UARTE0_EASYDMA_MAXCNT_SIZE));
+#endif // UARTE0_EASYDMA_MAXCNT_SIZE
 
 //-----------------------------------------------------------------------------
 // Type definitions
 //-----------------------------------------------------------------------------
 
-/** A trace message */
-struct pa_trace_msg {
-   char tm_msg[ADV_TRACE_MSG_LENGTH]; /** Message buffer */
-   uint8_t tm_length;                /** Message length */
-};
-
-ASSERT_COMPILE(sizeof(struct pa_trace_msg) == 128);
-
-/** Trace queue */
+/**
+ * Trace queue.
+ * Messages are packed back to back in a byte ring, each of them only using
+ * its actual length. Message lengths are stored in a companion ring of
+ * one-byte headers, so that message payloads stay contiguous in the byte
+ * ring. A message never wraps around the end of the byte ring: the unused
+ * tail is consumed with a padding header (#MSG_HEADER_SKIP) instead.
+ *
+ * Producers may run from any context: they first claim room for a message
+ * by atomically advancing the write position (LDREX/STREX), copy the
+ * message, then commit it by writing its header. The consumer never goes
+ * past a message whose header is still #MSG_HEADER_PENDING.
+ * Each position packs a free-running header counter and a free-running byte
+ * counter into a single word, so that both are updated at once.
+ */
 struct pa_trace_queue {
-   /** Current index where the next message to be transmitted resides. */
-   off_t tq_read_p;
-   /** Current index where the next message should be inserted. */
-   off_t tq_write_p;
+   /** Position of the next message to be transmitted. */
+   volatile uint32_t tq_read_p;
+   /** Position where the next message should be inserted. */
+   volatile uint32_t tq_write_p;
+   /** Count of messages covered by the on-going transfer. */
+   unsigned int tq_tx_count;
+   /** Highest count of stored messages */
+   volatile uint32_t tq_hwm_count;
+   /** Highest count of stored bytes */
+   volatile uint32_t tq_hwm_bytes;
+   /** Message headers, i.e. payload length and padding flag */
+   volatile uint8_t tq_headers[MSG_QUEUE_SIZE];
+   /** Enqueue time of each message, 16 LSBs of the RTC counter */
+   uint16_t tq_stamps[MSG_QUEUE_SIZE];
    /** Transmit buffer for messages to be transmitted to the central. */
-   struct pa_trace_msg tq_msgs[MSG_QUEUE_SIZE];
+   char tq_buffer[BUF_QUEUE_SIZE];
 };
 
 struct pa_trace {
-   uint32_t pt_masks[PTN_WORDS]; /** Levels for each trace source  */
    bool pt_initialized; /** Trace subsystem has been initialised */
-   uint8_t pt_count;    /** Overflowing counter to track lost messages */
-   bool pt_que_active;  /** FIFO queue is being sent */
+   volatile uint8_t pt_count; /** Overflowing counter to track lost messages */
+   volatile uint32_t pt_que_active; /** FIFO queue is being sent */
    struct pa_trace_queue * pt_que; /** Message queue */
-   nrfx_uarte_t pt_uart; /** UART instance */
+   const struct pa_trace_sink * pt_sink; /** Trace back-end */
+   /** Trace back-end to switch to, once the on-going transfer completes */
+   const struct pa_trace_sink * volatile pt_next_sink;
+   struct pa_trace_stats pt_stats; /** Trace statistics */
+   uint32_t pt_stats_time; /** RTC time of the last statistics summary */
+   uint32_t pt_sync_time; /** RTC time of the last correlation record */
+   uint32_t pt_time_freq; /** Frequency of the timestamps, in Hz */
+   bool pt_cyccnt; /** DWT cycle counter is used for timestamps */
+   /**
+    * Recent trace identifiers: format string offset for binary traces,
+    * call site address for text traces
+    */
+   uint32_t pt_recent[ADV_TRACE_RECENT_COUNT];
+   volatile uint8_t pt_recent_pos; /** Next slot in recent identifiers */
+   volatile uint8_t pt_modes; /** Active modes, see #pa_trace_mode */
+   bool pt_restored; /** Settings have been restored at start up */
+};
+
+/**
+ * Trace settings changed through pa_trace_control(), kept in RAM that is
+ * neither loaded nor cleared at start up, so that they survive a reset.
+ */
+struct pa_trace_persist {
+   uint32_t tp_magic; /**< Record marker, see #ADV_TRACE_PERSIST_MAGIC */
+   uint32_t tp_masks[PTN_WORDS]; /**< Levels for each trace source */
+   uint32_t tp_modes; /**< Runtime modes, see #pa_trace_mode */
+   uint32_t tp_check; /**< Complement of the XOR of the above fields */
 };
 
+ASSERT_COMPILE((ADV_TRACE_RECENT_COUNT & (ADV_TRACE_RECENT_COUNT - 1U)) == 0U);
+
 //-----------------------------------------------------------------------------
 // Forward declarations
 //-----------------------------------------------------------------------------
 
 static struct pa_trace _pa_trace;
 
+#ifdef ADV_TRACE_RTT
+static int _pa_trace_rtt_init(void);
+static int _pa_trace_rtt_tx(const uint8_t * data, size_t length);
+static void _pa_trace_rtt_fatal(const uint8_t * data, size_t length);
+#else // ADV_TRACE_RTT
+static int _pa_trace_uart_init(void);
+static int _pa_trace_uart_tx(const uint8_t * data, size_t length);
+static void _pa_trace_uart_fatal(const uint8_t * data, size_t length);
 static void _nd_trace_uart_event_handler(const nrfx_uarte_event_t * event,
    void * context);
-static void _pa_trace_pop_queue(struct pa_trace * trace);
+#endif // !ADV_TRACE_RTT
+static void _pa_trace_time_init(struct pa_trace * trace);
+#ifdef ADV_TRACE_HIRES_TIME
+static void _pa_trace_sync(struct pa_trace * trace);
+#endif // ADV_TRACE_HIRES_TIME
+static void _pa_trace_stats_sent(struct pa_trace * trace);
+static void _pa_trace_periodic(struct pa_trace * trace);
+static int _pa_trace_pop_queue(struct pa_trace * trace);
+static void _pa_trace_kick_queue(struct pa_trace * trace);
 static void _pa_trace_start_queue(struct pa_trace * trace);
+static void _pa_trace_defaults(void);
+static void _pa_trace_persist_save(const struct pa_trace * trace);
+static bool _pa_trace_persist_restore(struct pa_trace * trace);
+static uint32_t _pa_trace_persist_check(const struct pa_trace_persist * tp);
 
 //-----------------------------------------------------------------------------
 // Static constants
 //-----------------------------------------------------------------------------
 
+#ifdef ADV_TRACE_RTT
+/** SEGGER RTT trace back-end, drained by the debugger */
+static const struct pa_trace_sink _pa_trace_rtt_sink = {
+   .ts_init = &_pa_trace_rtt_init,
+   .ts_tx = &_pa_trace_rtt_tx,
+   .ts_fatal = &_pa_trace_rtt_fatal,
+   .ts_max_length = ADV_TRACE_RTT_BATCH_LENGTH,
+};
+
+#define ADV_TRACE_DEFAULT_SINK     _pa_trace_rtt_sink
+#else // ADV_TRACE_RTT
 #if ! defined(NRFX_UARTE_ENABLED)
 // Yes, nRF5 SDK UART definition is a mess...
 #error Invalid UART configuration
 #endif
 
+/** UART debug port instance */
+static const nrfx_uarte_t _pa_trace_uart = NRFX_UARTE_INSTANCE(0);
+
 /** UART debug port configuration */
 static const nrfx_uarte_config_t _pa_trace_uart_config = {
    .pseltxd = 18U,  // SWO
@@ -150,6 +340,17 @@ static const nrfx_uarte_config_t _pa_trace_uart_config = {
    //.use_easy_dma = true,
 };
 
+/** UARTE trace back-end */
+static const struct pa_trace_sink _pa_trace_uart_sink = {
+   .ts_init = &_pa_trace_uart_init,
+   .ts_tx = &_pa_trace_uart_tx,
+   .ts_fatal = &_pa_trace_uart_fatal,
+   .ts_max_length = ADV_TRACE_TX_BATCH_LENGTH,
+};
+
+#define ADV_TRACE_DEFAULT_SINK     _pa_trace_uart_sink
+#endif // !ADV_TRACE_RTT
+
 /** Log level code */
 static const char ADV_TRACE_LOGLEVELS[] = "CDIWEF.";
 
@@ -158,6 +359,8 @@ static const uint8_t ADV_TRACE_DEFAULT_LEVELS[] = {
    [PTM_MAIN] = PTL_DEBUG,
    [PTM_SYS] = PTL_DEBUG,
    [PTM_BLE] = PTL_CHATTY,
+   [PTM_POWER] = PTL_INFO,
+   [PTM_BENCH] = PTL_INFO,
 };
 
 //-----------------------------------------------------------------------------
@@ -166,25 +369,60 @@ static const uint8_t ADV_TRACE_DEFAULT_LEVELS[] = {
 
 struct pa_trace_queue _pa_trace_queue;
 
+/** Levels for each trace source, all traces are disabled until initialized */
+uint32_t pa_trace_masks[PTN_WORDS] = {
+   [0 ... (PTN_WORDS - 1U)] = DISABLE_ALL_TRACES_MASK,
+};
+
+/** Trace settings changed at runtime, retained across resets */
+static struct pa_trace_persist _pa_trace_persist
+   __attribute__((section(".noinit")));
+
 /** Trace configuration */
 static struct pa_trace _pa_trace = {
-   .pt_uart = NRFX_UARTE_INSTANCE(0),
    .pt_que = &_pa_trace_queue,
+   .pt_modes = ADV_TRACE_DEFAULT_MODES,
+   .pt_sink = &ADV_TRACE_DEFAULT_SINK,
+   .pt_stats = {
+      .st_lat_min = UINT16_MAX,
+   },
+   .pt_time_freq = ADV_TRACE_RTC_FREQ,
 };
 
 //-----------------------------------------------------------------------------
 // Inline function
 //-----------------------------------------------------------------------------
 
+/**
+ * Provide current RTC time
+ *
+ * @return RTC counter value
+ */
+static inline uint32_t
+_pa_trace_rtc_time(void)
+{
+   return app_timer_cnt_get();
+}
+
 /**
  * Provide current timestamp
  *
- * @return timestamp
+ * @return timestamp, at #pa_trace.pt_time_freq
  */
 static inline uint32_t
 _pa_trace_time(void)
 {
-   return app_timer_cnt_get();
+   #ifdef ADV_TRACE_HIRES_TIME
+   if ( _pa_trace.pt_cyccnt ) {
+      return DWT->CYCCNT;
+   }
+   // a capture from a preempting context may overwrite the capture register:
+   // this only delays the timestamp of the preempted context
+   ADV_TRACE_HIRES_TIMER->TASKS_CAPTURE[ADV_TRACE_HIRES_TIMER_CC] = 1U;
+   return ADV_TRACE_HIRES_TIMER->CC[ADV_TRACE_HIRES_TIMER_CC];
+   #else // ADV_TRACE_HIRES_TIME
+   return _pa_trace_rtc_time();
+   #endif // !ADV_TRACE_HIRES_TIME
 }
 
 /**
@@ -198,14 +436,206 @@ _pa_trace_context(void)
    return __get_IPSR() & 0xFFU;
 }
 
+/**
+ * Take a ticket from the trace counter.
+ *
+ * @return the current trace counter value
+ */
+static inline uint8_t
+_pa_trace_count(void)
+{
+   uint8_t count;
+
+   do {
+      count = __LDREXB(&_pa_trace.pt_count);
+   } while ( __STREXB((uint8_t)(count + 1U), &_pa_trace.pt_count) );
+
+   return count;
+}
+
+/**
+ * Keep track of a trace identifier, for postmortem analysis.
+ * A preempting context may overwrite a slot: identifiers are a best effort
+ * hint of what the application was doing.
+ *
+ * @param[in,out] trace the trace engine
+ * @param[in] id the trace identifier
+ */
+static inline void
+_pa_trace_recent(struct pa_trace * trace, uint32_t id)
+{
+   uint8_t pos = trace->pt_recent_pos;
+   trace->pt_recent[pos & (ADV_TRACE_RECENT_COUNT - 1U)] = id;
+   trace->pt_recent_pos = (uint8_t)(pos + 1U);
+}
+
+/**
+ * Emit the fixed-layout header of a text trace message, as laid out by
+ * #ADV_TRACE_FMT_HEADER, without going through the printf family.
+ *
+ * @param[out] buf the destination, large enough for the whole header
+ * @param[in] count the trace ticket
+ * @return the count of emitted characters
+ */
+static inline size_t
+_pa_trace_header(char * buf, uint8_t count)
+{
+   char * ptr = buf;
+
+   #ifdef ADV_TRACE_SHOW_TIME
+   *ptr++ = '^';
+   ptr = fmt_hex_uint32(ptr, _pa_trace_time(), FMT_UINT32_HEX_LEN);
+   *ptr++ = ' ';
+   #endif // ADV_TRACE_SHOW_TIME
+   #ifdef ADV_TRACE_SHOW_COUNT
+   *ptr++ = ':';
+   ptr = fmt_hex_uint8(ptr, count);
+   *ptr++ = ' ';
+   #else // ADV_TRACE_SHOW_COUNT
+   (void)count;
+   #endif // !ADV_TRACE_SHOW_COUNT
+   #ifdef ADV_TRACE_SHOW_CTX
+   *ptr++ = '{';
+   ptr = fmt_hex_uint8(ptr, (uint8_t)_pa_trace_context());
+   *ptr++ = '}';
+   *ptr++ = ' ';
+   #endif // ADV_TRACE_SHOW_CTX
+
+   return (size_t)(ptr - buf);
+}
+
+/**
+ * Format a trace message body, using the restricted formatter and falling
+ * back to the printf family on unusual conversion specifications.
+ *
+ * @param[out] dst the destination string
+ * @param[in] dlen the size of the destination
+ * @param[in] fmt the format string
+ * @param[in] ap the argument list
+ * @return the count of characters the message would contain if the
+ *         destination were large enough
+ */
+static inline int
+_pa_trace_vformat(char * dst, size_t dlen, const char * fmt, va_list ap)
+{
+   va_list aq;
+
+   va_copy(aq, ap);
+   int ret = fmt_vformat(dst, dlen, fmt, aq);
+   va_end(aq);
+
+   if ( ret < 0 ) {
+      ret = vsnprintf(dst, dlen, fmt, ap);
+   }
+
+   return ret;
+}
+
+/**
+ * Acquire the ownership of the trace queue consumer side.
+ *
+ * @param[in,out] trace the trace engine
+ * @return @c true if the caller has become the owner
+ */
+static inline bool
+_pa_trace_acquire(struct pa_trace * trace)
+{
+   do {
+      if ( __LDREXW(&trace->pt_que_active) ) {
+         __CLREX();
+         return false;
+      }
+   } while ( __STREXW(1U, &trace->pt_que_active) );
+   __DMB();
+
+   return true;
+}
+
+/**
+ * Release the ownership of the trace queue consumer side.
+ *
+ * @param[in,out] trace the trace engine
+ */
+static inline void
+_pa_trace_release(struct pa_trace * trace)
+{
+   __DMB();
+   trace->pt_que_active = 0U;
+   __DMB();
+}
+
+/**
+ * Atomically increment a counter.
+ *
+ * @param[in,out] counter the counter to increment
+ * @param[in] value the increment
+ */
+static inline void
+_pa_trace_atomic_add(uint32_t * counter, uint32_t value)
+{
+   volatile uint32_t * vcounter = (volatile uint32_t *)counter;
+   uint32_t count;
+
+   do {
+      count = __LDREXW(vcounter);
+   } while ( __STREXW(count + value, vcounter) );
+}
+
+/**
+ * Atomically raise a high-water mark.
+ *
+ * @param[in,out] mark the high-water mark
+ * @param[in] value the new value
+ */
+static inline void
+_pa_trace_atomic_max(volatile uint32_t * mark, uint32_t value)
+{
+   do {
+      if ( __LDREXW(mark) >= value ) {
+         __CLREX();
+         return;
+      }
+   } while ( __STREXW(value, mark) );
+}
+
+/**
+ * Account for a message that cannot be queued.
+ * A full queue may be caused by a stalled back-end, which is given a chance
+ * to resume.
+ *
+ * @param[in] reason why the message is lost
+ * @param[in] source the source of the message, or -1 if not known
+ * @return 0, as no character has been printed out
+ */
+static inline int
+_pa_trace_drop(enum pa_trace_drop reason, int source)
+{
+   struct pa_trace_stats * stats = &_pa_trace.pt_stats;
+
+   _pa_trace_atomic_add(&stats->st_drops[reason], 1U);
+   if ( (source >= 0) && (source < PTM_COUNT) ) {
+      _pa_trace_atomic_add(&stats->st_src_drops[source], 1U);
+   }
+
+   if ( PTD_FULL == reason ) {
+      _pa_trace_start_queue(&_pa_trace);
+   }
+
+   return 0;
+}
+
 /**
  * Discards any stored data in the trace messsage queue.
  *
+ * @pre no other context should be using the queue
  * @param[in] que the trace messsage queue instance
  */
 static inline void
 _pa_trace_queue_flush(struct pa_trace_queue * que)
 {
+   memset((void *)que->tq_headers, MSG_HEADER_PENDING,
+          sizeof(que->tq_headers));
+   que->tq_tx_count = 0;
    que->tq_read_p = que->tq_write_p;
 }
 
@@ -213,38 +643,43 @@ _pa_trace_queue_flush(struct pa_trace_queue * que)
  * Count how many free slots are available in the trace messsage queue.
  *
  * @param[in] que the trace messsage queue instance
- * @return the number of free bytes in the trace messsage queue
+ * @return the number of free message headers in the trace messsage queue
  */
 static inline ssize_t
 _pa_trace_queue_count_free(const struct pa_trace_queue * que)
 {
-   ssize_t bytes;
-
-   bytes = que->tq_read_p - que->tq_write_p;
-   if ( bytes <= 0 ) {
-       bytes += MSG_QUEUE_SIZE;
-   }
+   uint16_t used = (uint16_t)(TQ_POS_HDRS(que->tq_write_p) -
+                              TQ_POS_HDRS(que->tq_read_p));
 
-   return bytes-1;
+   return (ssize_t)MSG_QUEUE_SIZE - (ssize_t)used;
 }
 
 /**
  * Count how many busy slots are available from the trace messsage queue.
  *
  * @param[in] que the trace messsage queue instance
- * @return the number of readable bytes in the trace messsage queue
+ * @return the number of readable messages in the trace messsage queue
  */
 static inline ssize_t
 _pa_trace_queue_count_avail(const struct pa_trace_queue * que)
 {
-   ssize_t bytes;
+   return (uint16_t)(TQ_POS_HDRS(que->tq_write_p) -
+                     TQ_POS_HDRS(que->tq_read_p));
+}
 
-   bytes = que->tq_write_p - que->tq_read_p;
-   if ( bytes < 0 ) {
-       bytes += MSG_QUEUE_SIZE;
-   }
+/**
+ * Count how many free bytes are available in the trace messsage queue.
+ *
+ * @param[in] que the trace messsage queue instance
+ * @return the number of free bytes in the trace messsage queue
+ */
+static inline ssize_t
+_pa_trace_queue_bytes_free(const struct pa_trace_queue * que)
+{
+   uint16_t used = (uint16_t)(TQ_POS_BYTES(que->tq_write_p) -
+                              TQ_POS_BYTES(que->tq_read_p));
 
-   return bytes;
+   return (ssize_t)BUF_QUEUE_SIZE - (ssize_t)used;
 }
 
 /**
@@ -272,25 +707,224 @@ _pa_trace_queue_is_full(const struct pa_trace_queue * que)
 }
 
 /**
- * Advance the read pointer.
+ * Reports whether the oldest message of the trace messsage queue has been
+ * committed, i.e. whether it can be transmitted.
+ *
+ * @param[in] que the trace messsage queue instance
+ * @return @c true if the oldest message is ready
+ */
+static inline bool
+_pa_trace_queue_is_ready(const struct pa_trace_queue * que)
+{
+   uint32_t read = que->tq_read_p;
+
+   if ( read == que->tq_write_p ) {
+      return false;
+   }
+
+   return MSG_HEADER_PENDING !=
+      que->tq_headers[TQ_POS_HDRS(read) & MSG_QUEUE_MASK];
+}
+
+/**
+ * Advance the read pointer past the oldest messages.
  *
+ * @note only the owner of the consumer side may call this function
  * @param[in] que the trace messsage queue instance
+ * @param[in] count the count of messages to discard
  */
 static inline void
-_pa_trace_queue_r_next(struct pa_trace_queue * que)
+_pa_trace_queue_r_next(struct pa_trace_queue * que, unsigned int count)
+{
+   uint32_t read = que->tq_read_p;
+   uint16_t hdrs = TQ_POS_HDRS(read);
+   uint16_t bytes = TQ_POS_BYTES(read);
+
+   for (unsigned int mix=0; mix<count; mix++) {
+      unsigned int hix = hdrs & MSG_QUEUE_MASK;
+      unsigned int length = que->tq_headers[hix] & MSG_HEADER_LENGTH_MASK;
+      bytes = (uint16_t)(bytes + length);
+      // the slot may now be claimed again by a producer
+      que->tq_headers[hix] = MSG_HEADER_PENDING;
+      hdrs++;
+   }
+
+   // headers should be cleared out before producers may see the free space
+   __DMB();
+   que->tq_read_p = TQ_POS(hdrs, bytes);
+}
+
+/**
+ * Advance the read pointer past all the messages of the on-going transfer.
+ *
+ * @param[in] que the trace messsage queue instance
+ */
+static inline void
+_pa_trace_queue_r_release(struct pa_trace_queue * que)
+{
+   _pa_trace_queue_r_next(que, que->tq_tx_count);
+   que->tq_tx_count = 0;
+}
+
+/**
+ * Claim room for a new message, advancing the write pointer.
+ * The message tail is padded if it would wrap around the byte ring.
+ *
+ * @param[in] que the trace messsage queue instance
+ * @param[in] length the count of bytes of the message
+ * @param[out] position updated with the claimed position
+ * @param[out] padding updated with the count of padding bytes to insert
+ *             before the message
+ * @return @c false if the queue cannot receive the message
+ */
+static inline bool
+_pa_trace_queue_w_claim(struct pa_trace_queue * que, size_t length,
+                        uint32_t * position, size_t * padding)
 {
-   que->tq_read_p = ((que->tq_read_p + 1) & (off_t)MSG_QUEUE_MASK);
+   uint32_t write;
+   uint32_t next;
+
+   do {
+      write = __LDREXW(&que->tq_write_p);
+      uint32_t read = que->tq_read_p;
+
+      uint16_t hdrs = TQ_POS_HDRS(write);
+      uint16_t bytes = TQ_POS_BYTES(write);
+      size_t tail = BUF_QUEUE_SIZE - (bytes & BUF_QUEUE_MASK);
+      size_t pad = (tail < length) ? tail : 0U;
+      unsigned int count = pad ? 2U : 1U;
+
+      size_t used_hdrs = (uint16_t)(hdrs - TQ_POS_HDRS(read));
+      size_t used_bytes = (uint16_t)(bytes - TQ_POS_BYTES(read));
+
+      if ( ((used_hdrs + count) > MSG_QUEUE_SIZE) ||
+           ((used_bytes + pad + length) > BUF_QUEUE_SIZE) ) {
+         __CLREX();
+         return false;
+      }
+
+      next = TQ_POS(hdrs + count, bytes + pad + length);
+      *padding = pad;
+   } while ( __STREXW(next, &que->tq_write_p) );
+   __DMB();
+
+   *position = write;
+
+   return true;
 }
 
 /**
- * Advance the write pointer.
+ * Commit a claimed message, so that it can be transmitted.
  *
  * @param[in] que the trace messsage queue instance
+ * @param[in] position the claimed position of the message
+ * @param[in] header the header of the message
  */
 static inline void
-_pa_trace_queue_w_next(struct pa_trace_queue * que)
+_pa_trace_queue_w_next(struct pa_trace_queue * que, uint32_t position,
+                       uint8_t header)
+{
+   // the message content should be written before it is declared as ready
+   __DMB();
+   que->tq_headers[TQ_POS_HDRS(position) & MSG_QUEUE_MASK] = header;
+}
+
+/**
+ * Compute how many of the oldest messages may be sent with a single
+ * transfer, i.e. the committed messages that are stored contiguously in the
+ * byte ring.
+ *
+ * @param[in] que the trace messsage queue instance
+ * @param[in] max_count the maximum count of messages of a single transfer
+ * @param[in] max_length the maximum count of bytes of a single transfer
+ * @param[out] length updated with the count of bytes to transmit
+ * @return the number of messages covered by the transfer
+ */
+static inline unsigned int
+_pa_trace_queue_batch(const struct pa_trace_queue * que,
+                      unsigned int max_count, size_t max_length,
+                      size_t * length)
+{
+   uint32_t read = que->tq_read_p;
+   uint32_t write = que->tq_write_p;
+   uint16_t hdr = TQ_POS_HDRS(read);
+   size_t offset = TQ_POS_BYTES(read) & BUF_QUEUE_MASK;
+   unsigned int count = 0;
+   size_t bytes = 0;
+
+   while ( (hdr != TQ_POS_HDRS(write)) && (count < max_count) ) {
+      uint8_t header = que->tq_headers[hdr & MSG_QUEUE_MASK];
+      if ( MSG_HEADER_PENDING == header ) {
+         // message is being written
+         break;
+      }
+      if ( header & MSG_HEADER_SKIP ) {
+         // next message resides at the beginning of the ring
+         break;
+      }
+      if ( (bytes + header) > max_length ) {
+         break;
+      }
+      bytes += header;
+      count++;
+      if ( (offset + bytes) >= BUF_QUEUE_SIZE ) {
+         // end of the ring
+         break;
+      }
+      hdr++;
+   }
+
+   *length = bytes;
+   return count;
+}
+
+/**
+ * Insert a new message into the trace message queue.
+ * This function may be called from any context.
+ *
+ * @param[in] que the trace messsage queue instance
+ * @param[in] message the message to copy into the queue
+ * @param[in] length the count of bytes of the message, which should not
+ *            exceed ADV_TRACE_MSG_LENGTH
+ * @return @c false if the queue cannot receive the message
+ */
+static bool
+_pa_trace_queue_push(struct pa_trace_queue * que, const char * message,
+                     size_t length)
 {
-   que->tq_write_p = (que->tq_write_p + 1) & (off_t)MSG_QUEUE_MASK;
+   if ( ! length ) {
+      return true;
+   }
+
+   uint32_t write;
+   size_t padding;
+
+   if ( ! _pa_trace_queue_w_claim(que, length, &write, &padding) ) {
+      return false;
+   }
+
+   if ( padding ) {
+      // the message would wrap around, pad the end of the ring so that the
+      // message starts at the beginning of the ring
+      _pa_trace_queue_w_next(que, write, (uint8_t)(MSG_HEADER_SKIP | padding));
+      write = TQ_POS(TQ_POS_HDRS(write) + 1U, TQ_POS_BYTES(write) + padding);
+   }
+
+   memcpy(&que->tq_buffer[TQ_POS_BYTES(write) & BUF_QUEUE_MASK], message,
+          length);
+   que->tq_stamps[TQ_POS_HDRS(write) & MSG_QUEUE_MASK] =
+      (uint16_t)_pa_trace_rtc_time();
+
+   _pa_trace_atomic_max(&que->tq_hwm_count,
+                        (uint32_t)_pa_trace_queue_count_avail(que));
+   _pa_trace_atomic_max(&que->tq_hwm_bytes,
+                        (uint32_t)(BUF_QUEUE_SIZE -
+                                   _pa_trace_queue_bytes_free(que)));
+
+   // commit this new message to the queue
+   _pa_trace_queue_w_next(que, write, (uint8_t)length);
+
+   return true;
 }
 
 //-----------------------------------------------------------------------------
@@ -307,19 +941,38 @@ void
 pa_trace_init(void)
 {
    // disable all traces
-   for (unsigned int pos = 0; pos < ARRAY_SIZE(_pa_trace.pt_masks); ++pos) {
-      _pa_trace.pt_masks[pos] = DISABLE_ALL_TRACES_MASK;
+   for (unsigned int pos = 0; pos < ARRAY_SIZE(pa_trace_masks); ++pos) {
+      pa_trace_masks[pos] = DISABLE_ALL_TRACES_MASK;
    }
 
-   nrfx_uarte_uninit(&_pa_trace.pt_uart);
-
-   ret_code_t rc;
-   rc = nrfx_uarte_init(&_pa_trace.pt_uart, &_pa_trace_uart_config,
-                          &_nd_trace_uart_event_handler);
+   int rc;
+   rc = _pa_trace.pt_sink->ts_init();
    (void)rc;
 
-   // emit the initialization trace message to inform the host about
-   // the target startup and the actual tick value
+   _pa_trace_time_init(&_pa_trace);
+   _pa_trace.pt_initialized = true;
+
+   #ifndef ADV_FAST_BOOT
+   pa_trace_banner();
+   #endif // !ADV_FAST_BOOT
+
+   // settings changed at runtime override the default ones until the next
+   // power cycle, or until the defaults are explicitly restored
+   _pa_trace.pt_restored = _pa_trace_persist_restore(&_pa_trace);
+   if ( ! _pa_trace.pt_restored ) {
+      _pa_trace_defaults();
+   }
+}
+
+/**
+ * Emit the initialization trace message, to inform the host about the
+ * target startup and the actual tick value.
+ * With a fast boot, this is deferred until the device advertises, as
+ * formatting and sending the message out delays the BLE start up.
+ */
+void
+pa_trace_banner(void)
+{
    char buffer[80];
    int len;
    len = snprintf(buffer,
@@ -335,14 +988,12 @@ pa_trace_init(void)
                   _pa_trace_context(),
                   #endif // ADV_TRACE_SHOW_CTX
                   __func__,
-                  (unsigned int)(APP_TIMER_CLOCK_FREQ/
-                                 (APP_TIMER_CONFIG_RTC_FREQUENCY+1)));
-   _pa_trace.pt_initialized = true;
+                  (unsigned int)_pa_trace.pt_time_freq);
    pa_print(&buffer[0], (size_t)len);
 
-   for (unsigned int six=0; six<ARRAY_SIZE(ADV_TRACE_DEFAULT_LEVELS); six++) {
-      pa_trace_set_source((int)six, ADV_TRACE_DEFAULT_LEVELS[six]);
-   }
+   #ifdef ADV_TRACE_HIRES_TIME
+   _pa_trace_sync(&_pa_trace);
+   #endif // ADV_TRACE_HIRES_TIME
 }
 
 /**
@@ -362,13 +1013,7 @@ pa_trace_is_traceable(int source, enum pa_trace_level level)
       return false;
    }
 
-   // index in the trace mask array
-   unsigned int pos = (PTL_BITS * (unsigned int)source) >> PTS_SHIFT;
-   // bits in the trace mask word
-   unsigned int src = (PTL_BITS * (unsigned int)source) & PTS_MASK;
-
-   return level >=
-      ((_pa_trace.pt_masks[pos] >> src) & PTL_MASK);
+   return _pa_trace_is_enabled(source, level);
 }
 
 /**
@@ -418,9 +1063,9 @@ pa_trace_set_source(int source, enum pa_trace_level level)
    unsigned int src = (PTL_BITS * (unsigned int)source) & PTS_MASK;
 
    // reset previous trace mask for the source
-   _pa_trace.pt_masks[pos] &= ~(PTL_MASK << src);
+   pa_trace_masks[pos] &= ~(PTL_MASK << src);
    // set the new trace mask for the source
-   _pa_trace.pt_masks[pos] |= (uint32_t)(level << src);
+   pa_trace_masks[pos] |= (uint32_t)(level << src);
 }
 
 /**
@@ -437,109 +1082,226 @@ pa_trace_get_source(int source)
    // bits in the trace mask word
    unsigned int src = (PTL_BITS * (unsigned int)source) & PTS_MASK;
 
-   return (enum pa_trace_level)((_pa_trace.pt_masks[pos] >> src) & PTL_MASK);
+   return (enum pa_trace_level)((pa_trace_masks[pos] >> src) & PTL_MASK);
 }
 
 /**
- * Prints out the content of a 8-bit descriptor to the debug port
+ * Apply a sequence of trace control commands, see #pa_trace_command.
+ * Commands take effect immediately, and the resulting settings are
+ * retained across resets, but not across power cycles.
+ * The whole sequence is validated before any command is applied.
  *
- * @pre should not be invoked from an ISR
- * @param[in] message the ASCII character string to be printed out
- * @param[in] len the count of meaningful characters in the string
+ * @param[in] buf the command sequence
+ * @param[in] length the length of the command sequence
+ * @return 0 on success, or a negative error code
  */
 int
-pa_print(const char * message, size_t len)
+pa_trace_control(const uint8_t * buf, size_t length)
 {
-   struct pa_trace_queue * que = _pa_trace.pt_que;
-
-   if ( ! _pa_trace.pt_initialized ) {
-      return 0;
+   if ( ! length ) {
+      return -PE_INVALID_SIZE;
    }
 
-   #ifndef ADV_TRACE_SHOW_CTX
-   if ( _pa_trace_context() ) {
-      // it is not possible to emit from an IRQ, as either the message FIFO
-      // would be corrupted, or the whole printf() calls should be encapsulated
-      // in critical sections. Therefore, only count the lost trace
-      _pa_trace.pt_count++;
-      return 0;
+   for (size_t pos = 0; pos < length; ) {
+      size_t cmdlen;
+      switch ( buf[pos] ) {
+         case PTC_LEVEL:
+            cmdlen = 3U;
+            if ( (pos + cmdlen) > length ) {
+               return -PE_INVALID_SIZE;
+            }
+            if ( (buf[pos+1U] >= PTM_COUNT) &&
+                 (buf[pos+1U] != PTC_ALL_SOURCES) ) {
+               return -PE_OUT_OF_RANGE;
+            }
+            if ( buf[pos+2U] >= PTL_COUNT ) {
+               return -PE_OUT_OF_RANGE;
+            }
+            break;
+         case PTC_MODES:
+            cmdlen = 3U;
+            if ( (pos + cmdlen) > length ) {
+               return -PE_INVALID_SIZE;
+            }
+            // binary traces are selected at build time
+            if ( buf[pos+1U] & ~ADV_TRACE_RUNTIME_MODES ) {
+               return -PE_NOT_SUPPORTED;
+            }
+            break;
+         case PTC_DEFAULTS:
+            cmdlen = 1U;
+            break;
+         default:
+            return -PE_INVALID_COMMAND;
+      }
+      pos += cmdlen;
    }
-   #endif // ADV_TRACE_SHOW_CTX
 
-   if ( _pa_trace_queue_is_full(que) ) {
-      // nothing can be done for now
-      _pa_trace.pt_count++;
-      return 0;
+   for (size_t pos = 0; pos < length; ) {
+      switch ( buf[pos] ) {
+         case PTC_LEVEL:
+            if ( buf[pos+1U] == PTC_ALL_SOURCES ) {
+               for (int six=0; six<PTM_COUNT; six++) {
+                  pa_trace_set_source(six, (enum pa_trace_level)buf[pos+2U]);
+               }
+            } else {
+               pa_trace_set_source((int)buf[pos+1U],
+                                   (enum pa_trace_level)buf[pos+2U]);
+            }
+            pos += 3U;
+            break;
+         case PTC_MODES:
+            (void)pa_trace_set_modes(buf[pos+1U], buf[pos+2U]);
+            pos += 3U;
+            break;
+         default: // PTC_DEFAULTS
+            _pa_trace_defaults();
+            pos += 1U;
+            break;
+      }
    }
 
-   struct pa_trace_msg * msg = &que->tq_msgs[que->tq_write_p];
-   char * const msg_buf = &msg->tm_msg[0];
-   msg->tm_length = (uint8_t)MIN(len, ADV_TRACE_MSG_LENGTH);
-   memcpy(msg_buf, message, msg->tm_length);
-   _pa_trace.pt_count++;
-
-   // commit this new message to the queue
-   _pa_trace_queue_w_next(que);
-   _pa_trace_start_queue(&_pa_trace);
+   _pa_trace_persist_save(&_pa_trace);
 
-   return (int)len;
+   return 0;
 }
 
+/**
+ * Retrieve the trace control status.
+ *
+ * @param[out] control updated with the trace control status
+ */
+void
+pa_trace_get_control(struct pa_trace_control * control)
+{
+   memcpy(control->tc_masks, pa_trace_masks, sizeof(control->tc_masks));
+   control->tc_modes = _pa_trace.pt_modes;
+   control->tc_restored = _pa_trace.pt_restored;
+   control->tc_rsv = 0;
+}
 
 /**
- * Prints a debug trace message to the debug port
+ * Change the trace modes, which take effect immediately.
+ * May be invoked from any context.
  *
- * @pre should not be invoked from an ISR
- * @param[in] level the level of the trace message
- * @param[in] fmt a format string
- * @return the number of printed character
- * @note truncate oversized lines, and append a '...' marker to signal
- *       the truncature
+ * @param[in] mask the modes to change, see #pa_trace_mode
+ * @param[in] modes the new value of the modes to change
+ * @return 0 on success, or -PE_NOT_SUPPORTED if a mode cannot be changed at
+ *         runtime
  */
 int
-pa_trace_printf(enum pa_trace_level level, const char * fmt, ...)
+pa_trace_set_modes(unsigned int mask, unsigned int modes)
 {
-   if ( ! _pa_trace.pt_initialized ) {
-      return 0;
+   if ( mask & ~ADV_TRACE_RUNTIME_MODES ) {
+      return -PE_NOT_SUPPORTED;
    }
 
+   uint8_t previous;
+   do {
+      previous = __LDREXB(&_pa_trace.pt_modes);
+   } while ( __STREXB((uint8_t)((previous & ~mask) | (modes & mask)),
+                      &_pa_trace.pt_modes) );
+
+   if ( (previous & PTF_PAUSE) && ! (modes & mask & PTF_PAUSE) ) {
+      // flush the messages held back while paused
+      _pa_trace_start_queue(&_pa_trace);
+   }
+
+   return 0;
+}
+
+/**
+ * Get the active trace modes.
+ *
+ * @return the active modes, see #pa_trace_mode
+ */
+unsigned int
+pa_trace_get_modes(void)
+{
+   return _pa_trace.pt_modes;
+}
+
+/**
+ * Prints out the content of a 8-bit descriptor to the debug port
+ *
+ * May be invoked from any context, including IRQ handlers.
+ *
+ * @param[in] message the ASCII character string to be printed out
+ * @param[in] len the count of meaningful characters in the string
+ */
+int
+pa_print(const char * message, size_t len)
+{
+   struct pa_trace_queue * que = _pa_trace.pt_que;
+
+   if ( ! _pa_trace.pt_initialized ) {
+      return _pa_trace_drop(PTD_UNINIT, -1);
+   }
+
+   (void)_pa_trace_count();
+
+   #ifndef ADV_TRACE_SHOW_CTX
+   if ( _pa_trace_context() ) {
+      // IRQ traces have not been selected, only count the lost trace
+      return _pa_trace_drop(PTD_IRQ, -1);
+   }
+   #endif // ADV_TRACE_SHOW_CTX
+
+   if ( ! _pa_trace_queue_push(que, message,
+                               MIN(len, ADV_TRACE_MSG_LENGTH)) ) {
+      return _pa_trace_drop(PTD_FULL, -1);
+   }
+
+   _pa_trace_start_queue(&_pa_trace);
+
+   return (int)len;
+}
+
+
+/**
+ * Formats and queues a debug trace message
+ *
+ * @param[in] caller the address of the trace call site
+ * @param[in] source the source of the trace message
+ * @param[in] level the level of the trace message
+ * @param[in] fmt a format string
+ * @param[in] ap the format arguments
+ * @return the number of printed character
+ * @note truncate oversized lines, and append a '...' marker to signal
+ *       the truncature
+ */
+static int
+_pa_trace_vprintf(uint32_t caller, int source, enum pa_trace_level level,
+                  const char * fmt, va_list ap)
+{
+   _pa_trace_recent(&_pa_trace, caller);
+
+   if ( ! _pa_trace.pt_initialized ) {
+      return _pa_trace_drop(PTD_UNINIT, source);
+   }
+
+   // each trace attempt takes a ticket, so that the host can detect
+   // lost messages from the gaps in the sequence
+   uint8_t count = _pa_trace_count();
+
    #ifndef ADV_TRACE_SHOW_CTX
    if ( _pa_trace_context() ) {
       // see note in #pa_print
-      _pa_trace.pt_count++;
-      return 0;
+      return _pa_trace_drop(PTD_IRQ, source);
    }
    #endif // ADV_TRACE_SHOW_CTX
 
    struct pa_trace_queue * que = _pa_trace.pt_que;
 
    if ( _pa_trace_queue_is_full(que) ) {
-      // nothing can be done for now
-      _pa_trace.pt_count++;
-      return 0;
+      return _pa_trace_drop(PTD_FULL, source);
    }
 
-   struct pa_trace_msg * msg = &que->tq_msgs[que->tq_write_p];
-   char * const msg_buf = &msg->tm_msg[0];
+   // format the message on the stack, so that it only uses its actual length
+   // once inserted into the queue
+   char msg_buf[ADV_TRACE_MSG_LENGTH];
 
-   #ifdef ADV_TRACE_SHOW_TIME
-   uint32_t rt = _pa_trace.pt_initialized ? _pa_trace_time() : 0UL;
-   #endif // ADV_TRACE_SHOW_TIME
-
-   int ret;
-
-   ret = snprintf(&msg_buf[0], ADV_TRACE_MSG_LENGTH,
-                  ADV_TRACE_FMT_HEADER
-                  #ifdef ADV_TRACE_SHOW_TIME
-                  , rt
-                  #endif // ADV_TRACE_SHOW_TIME
-                  #ifdef ADV_TRACE_SHOW_COUNT
-                  , _pa_trace.pt_count
-                  #endif // ADV_TRACE_SHOW_COUNT
-                  #ifdef ADV_TRACE_SHOW_CTX
-                  , _pa_trace_context()
-                  #endif // ADV_TRACE_SHOW_CTX
-   );
+   int ret = (int)_pa_trace_header(&msg_buf[0], count);
 
    // if log level tracing is enabled, emit a marker
    if ( (level < PTL_COUNT) && ret < (ADV_TRACE_MSG_LENGTH - 2) ) {
@@ -547,13 +1309,9 @@ pa_trace_printf(enum pa_trace_level level, const char * fmt, ...)
       msg_buf[ret++] = ' ';
    }
 
-   va_list ap;
-
-   va_start(ap, fmt);
    ret +=
-      vsnprintf(&msg_buf[ret],
-                ADV_TRACE_MSG_LENGTH - (unsigned int)ret - 1U, fmt, ap);
-   va_end(ap);
+      _pa_trace_vformat(&msg_buf[ret],
+                        ADV_TRACE_MSG_LENGTH - (unsigned int)ret - 1U, fmt, ap);
 
    if (ret >= ADV_TRACE_MSG_LENGTH) {
       msg_buf[ADV_TRACE_MSG_LENGTH - 5] = '.';
@@ -564,16 +1322,64 @@ pa_trace_printf(enum pa_trace_level level, const char * fmt, ...)
       ret = ADV_TRACE_MSG_LENGTH;
    }
 
-   _pa_trace.pt_count++;
-
    // commit this new message to the queue
-   msg->tm_length = (uint8_t)ret;
-   _pa_trace_queue_w_next(que);
+   if ( ! _pa_trace_queue_push(que, msg_buf, (size_t)ret) ) {
+      return _pa_trace_drop(PTD_FULL, source);
+   }
+
    _pa_trace_start_queue(&_pa_trace);
 
    return ret;
 }
 
+/**
+ * Prints a debug trace message of the main source to the debug port
+ *
+ * May be invoked from any context, including IRQ handlers.
+ *
+ * @param[in] level the level of the trace message
+ * @param[in] fmt a format string
+ * @return the number of printed character
+ */
+int
+pa_trace_printf(enum pa_trace_level level, const char * fmt, ...)
+{
+   va_list ap;
+
+   va_start(ap, fmt);
+   int ret =
+      _pa_trace_vprintf((uint32_t)(uintptr_t)__builtin_return_address(0),
+                        PTM_MAIN, level, fmt, ap);
+   va_end(ap);
+
+   return ret;
+}
+
+/**
+ * Prints a debug trace message to the debug port
+ *
+ * May be invoked from any context, including IRQ handlers.
+ *
+ * @param[in] source the source of the trace message
+ * @param[in] level the level of the trace message
+ * @param[in] fmt a format string
+ * @return the number of printed character
+ */
+int
+pa_trace_printf_src(int source, enum pa_trace_level level,
+                    const char * fmt, ...)
+{
+   va_list ap;
+
+   va_start(ap, fmt);
+   int ret =
+      _pa_trace_vprintf((uint32_t)(uintptr_t)__builtin_return_address(0),
+                        source, level, fmt, ap);
+   va_end(ap);
+
+   return ret;
+}
+
 /**
   * Define an alias for pa_printf that may be defined and called from an
   * external component, typically a cross-call from eCos
@@ -584,7 +1390,8 @@ int pa_printf_ext(const char * fmt, ...)
 /**
  * Prints a message to the debug port
  *
- * @pre should not be invoked from an ISR
+ * May be invoked from any context, including IRQ handlers.
+ *
  * @param[in] fmt a format string
  * @return the number of printed character
  */
@@ -594,40 +1401,353 @@ pa_printf(const char * fmt, ...)
    struct pa_trace_queue * que = _pa_trace.pt_que;
 
    if ( ! _pa_trace.pt_initialized ) {
-      return 0;
+      return _pa_trace_drop(PTD_UNINIT, -1);
    }
 
    if ( _pa_trace_queue_is_full(que) ) {
-      // nothing can be done for now
-      _pa_trace.pt_count++;
-      return 0;
+      (void)_pa_trace_count();
+      return _pa_trace_drop(PTD_FULL, -1);
    }
 
-   struct pa_trace_msg * msg = &que->tq_msgs[que->tq_write_p];
-   char * const msg_buf = &msg->tm_msg[0];
+   char msg_buf[ADV_TRACE_MSG_LENGTH];
 
    va_list ap;
    int ret;
 
    va_start(ap, fmt);
-   ret = vsnprintf(msg_buf, ADV_TRACE_MSG_LENGTH, fmt, ap);
+   ret = _pa_trace_vformat(msg_buf, ADV_TRACE_MSG_LENGTH, fmt, ap);
    va_end(ap);
 
-   msg->tm_length = (uint8_t)MIN(ADV_TRACE_MSG_LENGTH, ret);
-
    // commit this new message to the queue
-   _pa_trace_queue_w_next(que);
+   if ( ret > 0 ) {
+      if ( ! _pa_trace_queue_push(que, msg_buf,
+                                  (size_t)MIN(ADV_TRACE_MSG_LENGTH, ret)) ) {
+         (void)_pa_trace_count();
+         return _pa_trace_drop(PTD_FULL, -1);
+      }
+   }
    _pa_trace_start_queue(&_pa_trace);
 
    return ret;
 }
 
+/**
+ * Emit a binary trace message, whose format string is not stored on the
+ * target. Use the MSGV macros with ADV_TRACE_BINARY rather than calling this
+ * function directly.
+ *
+ * Record layout, all integers being little endian:
+ *  * 1 byte: ADV_TRACE_BIN_MARKER | argument count
+ *  * 2 bytes: format string identifier, i.e. its offset in .trace_fmt section
+ *  * 4 bytes: timestamp
+ *  * 1 byte: trace source (5 MSBs) and trace level (3 LSBs)
+ *  * 1 byte: trace counter
+ *  * 4 bytes per argument
+ *
+ * @param[in] fmt the address of the format string in .trace_fmt section
+ * @param[in] srclvl the trace source and level, see _PA_SRCLVL
+ * @param[in] argc the count of 32-bit arguments
+ * @return the number of bytes of the record
+ */
+int
+pa_trace_binary(uintptr_t fmt, unsigned int srclvl, unsigned int argc, ...)
+{
+   // trace source
+   int source = (int)(srclvl >> 3U);
+
+   _pa_trace_recent(&_pa_trace, (uint32_t)fmt);
+
+   if ( ! _pa_trace.pt_initialized ) {
+      return _pa_trace_drop(PTD_UNINIT, source);
+   }
+
+   uint8_t count = _pa_trace_count();
+
+   #ifndef ADV_TRACE_SHOW_CTX
+   if ( _pa_trace_context() ) {
+      // see note in #pa_print
+      return _pa_trace_drop(PTD_IRQ, source);
+   }
+   #endif // ADV_TRACE_SHOW_CTX
+
+   uint8_t record[ADV_TRACE_BIN_RECORD_SIZE];
+
+   argc = MIN(argc, ADV_TRACE_BIN_ARGS_MAX);
+
+   set_uint8(&record[0], (uint8_t)(ADV_TRACE_BIN_MARKER | argc));
+   set_uint16(&record[1], (uint16_t)fmt);
+   set_uint32(&record[3], _pa_trace_time());
+   set_uint8(&record[7], (uint8_t)srclvl);
+   set_uint8(&record[8], count);
+
+   va_list ap;
+
+   va_start(ap, argc);
+   for (unsigned int aix=0; aix<argc; aix++) {
+      set_uint32(&record[ADV_TRACE_BIN_HEADER_SIZE + aix * sizeof(uint32_t)],
+                 va_arg(ap, uint32_t));
+   }
+   va_end(ap);
+
+   size_t length = ADV_TRACE_BIN_HEADER_SIZE + argc * sizeof(uint32_t);
+
+   if ( ! _pa_trace_queue_push(_pa_trace.pt_que, (const char *)record,
+                               length) ) {
+      return _pa_trace_drop(PTD_FULL, source);
+   }
+
+   _pa_trace_start_queue(&_pa_trace);
+
+   return (int)length;
+}
+
 void
 pa_trace_fatal_error(const char * message, size_t length) {
-   _pa_trace.pt_que_active = true;
+   // prevent any other context from using the trace back-end
+   _pa_trace.pt_que_active = 1U;
+   __DMB();
+
+   _pa_trace.pt_sink->ts_fatal((const uint8_t *)message, length);
+}
+
+/**
+ * Provide the most recent trace identifiers, most recent first.
+ * Identifiers are format string offsets in binary trace mode, and call site
+ * addresses otherwise. Unused entries are zeroed.
+ * May be invoked from any context, including fault handlers.
+ *
+ * @param[out] ids updated with the trace identifiers
+ * @param[in] count the count of identifiers to retrieve
+ */
+void
+pa_trace_get_recent(uint32_t * ids, unsigned int count)
+{
+   uint8_t pos = _pa_trace.pt_recent_pos;
+
+   for (unsigned int rix=0; rix<count; rix++) {
+      if ( rix < ADV_TRACE_RECENT_COUNT ) {
+         pos = (uint8_t)(pos - 1U);
+         ids[rix] = _pa_trace.pt_recent[pos & (ADV_TRACE_RECENT_COUNT - 1U)];
+      } else {
+         ids[rix] = 0U;
+      }
+   }
+}
+
+/**
+ * Replace the trace back-end.
+ * Pending messages are transmitted through the new back-end, which should
+ * have been initialized by the caller. If a transfer is on-going, the
+ * back-end is replaced once it completes.
+ * May be invoked from any context.
+ *
+ * @param[in] sink the new trace back-end
+ * @return 0 on success, or a negative error code
+ */
+int
+pa_trace_set_sink(const struct pa_trace_sink * sink)
+{
+   if ( ! sink ) {
+      return -PE_INVALID_REQUEST;
+   }
+
+   _pa_trace.pt_next_sink = sink;
+
+   _pa_trace_start_queue(&_pa_trace);
+
+   return 0;
+}
+
+/**
+ * Notify the completion of a deferred transfer of the trace back-end.
+ * May be invoked from any context.
+ */
+void
+pa_trace_sink_done(void)
+{
+   // the back-end owns the consumer side until the queue is idle
+   _pa_trace_stats_sent(&_pa_trace);
+   _pa_trace_queue_r_release(_pa_trace.pt_que);
+
+   _pa_trace_kick_queue(&_pa_trace);
+}
+
+/**
+ * Notify that the trace back-end can accept data again, after it has
+ * rejected a transfer with -PE_BUSY.
+ * May be invoked from any context.
+ */
+void
+pa_trace_sink_resume(void)
+{
+   _pa_trace_start_queue(&_pa_trace);
+}
+
+/**
+ * Retrieve the trace statistics.
+ * Counters are updated from any context, so they may be slightly out of
+ * sync with each other.
+ *
+ * @param[out] stats updated with the trace statistics
+ * @param[in] reset whether to restart the statistics from scratch
+ */
+void
+pa_trace_get_stats(struct pa_trace_stats * stats, bool reset)
+{
+   struct pa_trace_queue * que = _pa_trace.pt_que;
+
+   *stats = _pa_trace.pt_stats;
+   stats->st_hwm_count = (uint16_t)que->tq_hwm_count;
+   stats->st_hwm_bytes = (uint16_t)que->tq_hwm_bytes;
+
+   if ( reset ) {
+      memset(&_pa_trace.pt_stats, 0, sizeof(_pa_trace.pt_stats));
+      _pa_trace.pt_stats.st_lat_min = UINT16_MAX;
+      que->tq_hwm_count = (uint32_t)_pa_trace_queue_count_avail(que);
+      que->tq_hwm_bytes =
+         (uint32_t)(BUF_QUEUE_SIZE - _pa_trace_queue_bytes_free(que));
+   }
+}
+
+/**
+ * Provide the size of the static RAM used by the trace subsystem: message
+ * queue, engine, trace masks and persisted settings.
+ *
+ * @return the RAM size, in bytes
+ */
+size_t
+pa_trace_ram_size(void)
+{
+   return sizeof(_pa_trace_queue) + sizeof(_pa_trace) +
+      sizeof(pa_trace_masks) + sizeof(_pa_trace_persist);
+}
+
+/**
+ * Emit a summary line of the trace statistics:
+ *  * count of transmitted messages
+ *  * count of lost messages: full queue, IRQ, not initialized, back-end
+ *  * trace source with the most lost messages and its count
+ *  * high-water marks: messages and bytes, with the queue capacities
+ *  * latency from enqueue to transmission: min/avg/max, in RTC ticks
+ */
+void
+pa_trace_print_stats(void)
+{
+   struct pa_trace_stats stats;
+
+   pa_trace_get_stats(&stats, false);
+
+   int worst = 0;
+   for (int six=1; six<PTM_COUNT; six++) {
+      if ( stats.st_src_drops[six] > stats.st_src_drops[worst] ) {
+         worst = six;
+      }
+   }
+
+   unsigned int avg = stats.st_sent ?
+      (unsigned int)(stats.st_lat_sum / stats.st_sent) : 0U;
+
+   char buffer[ADV_TRACE_MSG_LENGTH];
+   int len;
+   len = snprintf(buffer, sizeof(buffer),
+                  "stats: tx %u drop %u/%u/%u/%u src %d:%u "
+                  "hwm %u/%u %u/%u lat %u/%u/%u" CRLF,
+                  (unsigned int)stats.st_sent,
+                  (unsigned int)stats.st_drops[PTD_FULL],
+                  (unsigned int)stats.st_drops[PTD_IRQ],
+                  (unsigned int)stats.st_drops[PTD_UNINIT],
+                  (unsigned int)stats.st_drops[PTD_SINK],
+                  worst, (unsigned int)stats.st_src_drops[worst],
+                  stats.st_hwm_count, MSG_QUEUE_SIZE,
+                  stats.st_hwm_bytes, BUF_QUEUE_SIZE,
+                  stats.st_sent ? stats.st_lat_min : 0U, avg,
+                  stats.st_lat_max);
+   if ( len > 0 ) {
+      pa_print(buffer, MIN((size_t)len, sizeof(buffer) - 1U));
+   }
+}
+
+/**
+ * Provide the current trace timestamp.
+ * May be invoked from any context.
+ *
+ * @return the timestamp, see pa_trace_timestamp_freq()
+ */
+uint32_t
+pa_trace_timestamp(void)
+{
+   return _pa_trace_time();
+}
+
+/**
+ * Provide the frequency of the trace timestamps.
+ *
+ * @return the frequency in Hz
+ */
+uint32_t
+pa_trace_timestamp_freq(void)
+{
+   return _pa_trace.pt_time_freq;
+}
 
-   nrfx_uarte_tx(&_pa_trace.pt_uart, (const uint8_t *)message,
-                 (uint8_t)length);
+/**
+ * Start a measurement.
+ *
+ * @param[in,out] prof the probe
+ */
+void
+adv_prof_begin(struct adv_prof * prof)
+{
+   prof->ap_start = _pa_trace_time();
+}
+
+/**
+ * Complete a measurement started with adv_prof_begin().
+ *
+ * @param[in,out] prof the probe
+ */
+void
+adv_prof_end(struct adv_prof * prof)
+{
+   uint32_t elapsed = _pa_trace_time() - prof->ap_start;
+
+   prof->ap_count++;
+   prof->ap_sum += elapsed;
+   prof->ap_min = MIN(prof->ap_min, elapsed);
+   prof->ap_max = MAX(prof->ap_max, elapsed);
+}
+
+/**
+ * Emit the results of a probe, in timestamp ticks.
+ *
+ * @param[in,out] prof the probe
+ * @param[in] reset whether to restart the measurements from scratch
+ */
+void
+adv_prof_print(struct adv_prof * prof, bool reset)
+{
+   unsigned int avg = prof->ap_count ?
+      (unsigned int)(prof->ap_sum / prof->ap_count) : 0U;
+
+   char buffer[ADV_TRACE_MSG_LENGTH];
+   int len;
+   len = snprintf(buffer, sizeof(buffer),
+                  "prof: %s n %u min %u avg %u max %u freq %u" CRLF,
+                  prof->ap_name ? prof->ap_name : "?",
+                  (unsigned int)prof->ap_count,
+                  prof->ap_count ? (unsigned int)prof->ap_min : 0U, avg,
+                  (unsigned int)prof->ap_max,
+                  (unsigned int)_pa_trace.pt_time_freq);
+   if ( len > 0 ) {
+      pa_print(buffer, MIN((size_t)len, sizeof(buffer) - 1U));
+   }
+
+   if ( reset ) {
+      prof->ap_count = 0;
+      prof->ap_sum = 0;
+      prof->ap_min = UINT32_MAX;
+      prof->ap_max = 0;
+   }
 }
 
 #ifdef HAVE_DUMP_HEX
@@ -690,15 +1810,12 @@ size_t
 pa_trace_build_hex(char * dst, size_t dlen, const void * buffer, size_t blen)
 {
    char * hexp = &dst[0];
-   ssize_t rem = (ssize_t)dlen;
-   for (unsigned int ix=0; ix<blen; ++ix) {
-      int count = snprintf(hexp, (size_t)MAX(0, rem),
-                           "%02x ", ((const uint8_t*)buffer)[ix]);
-      if ( count >= rem ) {
-         break;
-      }
-      rem -= count;
-      hexp += count;
+   // each byte takes up two digits and a separator, and the last one the
+   // end-of-string marker
+   size_t count = MIN(blen, dlen ? (dlen - 1U) / 3U : 0U);
+   for (unsigned int ix=0; ix<count; ++ix) {
+      hexp = fmt_hex_uint8(hexp, ((const uint8_t*)buffer)[ix]);
+      *hexp++ = ' ';
    }
    if ( hexp > dst ) {
       hexp--;
@@ -712,6 +1829,70 @@ pa_trace_build_hex(char * dst, size_t dlen, const void * buffer, size_t blen)
 // Private implementation
 //-----------------------------------------------------------------------------
 
+#ifdef ADV_TRACE_RTT
+static int
+_pa_trace_rtt_init(void)
+{
+   SEGGER_RTT_Init();
+
+   // never stall the application: a write that does not fit is rejected and
+   // retried later on
+   int rc;
+   rc = SEGGER_RTT_SetFlagsUpBuffer(ADV_TRACE_RTT_CHANNEL,
+                                    SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+
+   return (rc < 0) ? -PE_IO_ERROR : 0;
+}
+
+static int
+_pa_trace_rtt_tx(const uint8_t * data, size_t length)
+{
+   unsigned int count;
+
+   // the trace queue is only ever drained by its owner, there is no need
+   // for the RTT lock
+   count = SEGGER_RTT_WriteSkipNoLock(ADV_TRACE_RTT_CHANNEL, data,
+                                      (unsigned int)length);
+
+   // the debugger has not drained the RTT buffer yet
+   return count ? 0 : -PE_BUSY;
+}
+
+static void
+_pa_trace_rtt_fatal(const uint8_t * data, size_t length)
+{
+   (void)SEGGER_RTT_WriteNoLock(ADV_TRACE_RTT_CHANNEL, data,
+                                (unsigned int)length);
+}
+#else // ADV_TRACE_RTT
+static int
+_pa_trace_uart_init(void)
+{
+   nrfx_uarte_uninit(&_pa_trace_uart);
+
+   ret_code_t rc;
+   rc = nrfx_uarte_init(&_pa_trace_uart, &_pa_trace_uart_config,
+                        &_nd_trace_uart_event_handler);
+
+   return (NRF_SUCCESS == rc) ? 0 : -PE_IO_ERROR;
+}
+
+static int
+_pa_trace_uart_tx(const uint8_t * data, size_t length)
+{
+   ret_code_t rc;
+
+   rc = nrfx_uarte_tx(&_pa_trace_uart, data, length);
+
+   return (NRF_SUCCESS == rc) ? PE_DEFERRED : -PE_IO_ERROR;
+}
+
+static void
+_pa_trace_uart_fatal(const uint8_t * data, size_t length)
+{
+   nrfx_uarte_tx(&_pa_trace_uart, data, (uint8_t)length);
+}
+
 static void
 _nd_trace_uart_event_handler(const nrfx_uarte_event_t * event, void * context)
 {
@@ -723,58 +1904,332 @@ _nd_trace_uart_event_handler(const nrfx_uarte_event_t * event, void * context)
          break;
    }
 
-   struct pa_trace * trace = (struct pa_trace *)context;
+   (void)context;
+
+   adv_power_wakeup(APW_TRACE);
+
+   // the messages have been consumed by UART DMA, discard them
+   pa_trace_sink_done();
+}
+#endif // !ADV_TRACE_RTT
+
+/**
+ * Account for the messages of a completed transfer.
+ *
+ * @param[in,out] trace the trace engine
+ */
+static void
+_pa_trace_stats_sent(struct pa_trace * trace)
+{
    struct pa_trace_queue * que = trace->pt_que;
+   struct pa_trace_stats * stats = &trace->pt_stats;
+   uint16_t now = (uint16_t)_pa_trace_rtc_time();
+   uint16_t hdr = TQ_POS_HDRS(que->tq_read_p);
+
+   for (unsigned int mix=0; mix<que->tq_tx_count; mix++, hdr++) {
+      // RTC counter wraps every other second at 32 kHz, which is far beyond
+      // any meaningful trace latency
+      uint16_t stamp = que->tq_stamps[hdr & MSG_QUEUE_MASK];
+      uint16_t latency = (uint16_t)(now - stamp);
+      stats->st_lat_min = MIN(stats->st_lat_min, latency);
+      stats->st_lat_max = MAX(stats->st_lat_max, latency);
+      stats->st_lat_sum += latency;
+   }
+   stats->st_sent += que->tq_tx_count;
+
+   _pa_trace_periodic(trace);
+}
+
+/**
+ * Emit the periodic trace records, if any is due.
+ * Records are only emitted while traces are flowing.
+ *
+ * @param[in,out] trace the trace engine
+ */
+static void
+_pa_trace_periodic(struct pa_trace * trace)
+{
+   uint32_t time = _pa_trace_rtc_time();
+
+   (void)trace;
+   (void)time;
+
+   #ifdef ADV_TRACE_HIRES_TIME
+   if ( app_timer_cnt_diff_compute(time, trace->pt_sync_time) >=
+        ADV_TRACE_SYNC_PERIOD ) {
+      _pa_trace_sync(trace);
+   }
+   #endif // ADV_TRACE_HIRES_TIME
+
+   #ifdef ADV_TRACE_STATS_SUMMARY
+   if ( app_timer_cnt_diff_compute(time, trace->pt_stats_time) >=
+        ADV_TRACE_STATS_PERIOD ) {
+      trace->pt_stats_time = time;
+      pa_trace_print_stats();
+   }
+   #endif // ADV_TRACE_STATS_SUMMARY
+}
+
+/**
+ * Select and start the timestamp counter.
+ *
+ * @param[in,out] trace the trace engine
+ */
+static void
+_pa_trace_time_init(struct pa_trace * trace)
+{
+   #ifdef ADV_TRACE_HIRES_TIME
+   if ( CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk ) {
+      // a debugger is attached, which keeps the CPU clock running anyway
+      CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+      if ( ! (DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) ) {
+         // the counter may already run to time the boot sequence
+         DWT->CYCCNT = 0U;
+         DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+      }
+      trace->pt_cyccnt = true;
+      trace->pt_time_freq = SystemCoreClock;
+      return;
+   }
+
+   NRF_TIMER_Type * timer = ADV_TRACE_HIRES_TIMER;
+
+   timer->TASKS_STOP = 1U;
+   timer->MODE = TIMER_MODE_MODE_Timer;
+   timer->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+   timer->PRESCALER = 0U;
+   timer->TASKS_CLEAR = 1U;
+   timer->TASKS_START = 1U;
+   trace->pt_cyccnt = false;
+   trace->pt_time_freq = ADV_TRACE_HIRES_TIMER_FREQ;
+   #else // ADV_TRACE_HIRES_TIME
+   trace->pt_time_freq = ADV_TRACE_RTC_FREQ;
+   #endif // !ADV_TRACE_HIRES_TIME
+}
+
+#ifdef ADV_TRACE_HIRES_TIME
+/**
+ * Emit a time correlation record, so that the host can rebuild the wall
+ * clock time from the timestamps.
+ *
+ * @param[in,out] trace the trace engine
+ */
+static void
+_pa_trace_sync(struct pa_trace * trace)
+{
+   uint32_t rtc;
+   uint32_t time;
 
-   // the message has been consumed by UART DMA, discard it
-   CRITICAL_REGION_ENTER();
-   _pa_trace_queue_r_next(que);
-   CRITICAL_REGION_EXIT();
+   // sample both counters within the same RTC tick
+   do {
+      rtc = _pa_trace_rtc_time();
+      time = _pa_trace_time();
+   } while ( rtc != _pa_trace_rtc_time() );
 
-   _pa_trace_pop_queue(trace);
+   trace->pt_sync_time = rtc;
+
+   char buffer[64];
+   int len;
+   len = snprintf(buffer, sizeof(buffer),
+                  "sync: time %08x rtc %06x freq %u" CRLF,
+                  (unsigned int)time, (unsigned int)rtc,
+                  (unsigned int)trace->pt_time_freq);
+   if ( len > 0 ) {
+      pa_print(buffer, MIN((size_t)len, sizeof(buffer) - 1U));
+   }
 }
+#endif // ADV_TRACE_HIRES_TIME
 
+/**
+ * Start the transmission of the trace queue if no transfer is on-going.
+ * May be invoked from any context.
+ *
+ * @param[in,out] trace the trace engine
+ */
 static void
 _pa_trace_start_queue(struct pa_trace * trace)
 {
-   if ( ! trace->pt_que_active ) {
-      _pa_trace_pop_queue(&_pa_trace);
+   if ( _pa_trace_acquire(trace) ) {
+      _pa_trace_kick_queue(trace);
    }
 }
 
+/**
+ * Transmit the pending messages as the owner of the consumer side, and
+ * give up the ownership once the queue is idle.
+ *
+ * @param[in,out] trace the trace engine
+ */
 static void
+_pa_trace_kick_queue(struct pa_trace * trace)
+{
+   for (;;) {
+      int rc = _pa_trace_pop_queue(trace);
+      if ( PE_DEFERRED == rc ) {
+         // the back-end now owns the consumer side
+         return;
+      }
+      _pa_trace_release(trace);
+      if ( rc < 0 ) {
+         // the back-end is stalled, wait for the next message or for the
+         // back-end to resume
+         return;
+      }
+      // a producer may have committed a message after the queue has been
+      // found idle, but before the ownership has been released: it has
+      // failed to acquire the ownership, so the message should be handled
+      // from here
+      if ( ! _pa_trace_queue_is_ready(trace->pt_que) ) {
+         return;
+      }
+      if ( ! _pa_trace_acquire(trace) ) {
+         return;
+      }
+   }
+}
+
+/**
+ * Transmit the oldest committed messages through the trace back-end.
+ *
+ * @param[in,out] trace the trace engine
+ * @return PE_DEFERRED if a transfer is on-going, 0 if the queue is idle,
+ *         -PE_BUSY if the back-end cannot accept data for now, or
+ *         -PE_NOT_READY if the traces are paused
+ */
+static int
 _pa_trace_pop_queue(struct pa_trace * trace)
 {
    struct pa_trace_queue * que = trace->pt_que;
 
-   for(;;) {
-      bool empty;
-      struct pa_trace_msg * msg;
-      CRITICAL_REGION_ENTER();
-      empty = _pa_trace_queue_is_empty(que);
-      msg = &que->tq_msgs[que->tq_read_p];
-      CRITICAL_REGION_EXIT();
+   while ( _pa_trace_queue_is_ready(que) ) {
+      if ( trace->pt_modes & PTF_PAUSE ) {
+         // keep the messages until the traces are resumed
+         return -PE_NOT_READY;
+      }
+      // the back-end may only be replaced while no transfer is on-going
+      if ( trace->pt_next_sink ) {
+         trace->pt_sink = trace->pt_next_sink;
+         trace->pt_next_sink = NULL;
+      }
 
-      if ( empty ) {
-         break;
+      const struct pa_trace_sink * sink = trace->pt_sink;
+      uint32_t read = que->tq_read_p;
+      uint8_t header = que->tq_headers[TQ_POS_HDRS(read) & MSG_QUEUE_MASK];
+
+      if ( header & MSG_HEADER_SKIP ) {
+         // ring padding, nothing to transmit
+         _pa_trace_queue_r_next(que, 1U);
+         continue;
       }
 
-      _pa_trace.pt_que_active = true;
+      const char * msg = &que->tq_buffer[TQ_POS_BYTES(read) & BUF_QUEUE_MASK];
+      size_t length;
 
-      ret_code_t rc;
+      que->tq_tx_count =
+         _pa_trace_queue_batch(que,
+                               (trace->pt_modes & PTF_BATCH) ?
+                                  MSG_QUEUE_SIZE : 1U,
+                               sink->ts_max_length, &length);
 
-      rc = nrfx_uarte_tx(&trace->pt_uart, (uint8_t *)msg->tm_msg,
-                         msg->tm_length);
+      int rc;
 
+      rc = sink->ts_tx((const uint8_t *)msg, length);
 
-      if ( NRF_SUCCESS == rc ) {
-         return;
+      if ( PE_DEFERRED == rc ) {
+         return rc;
       }
 
-      CRITICAL_REGION_ENTER();
-      _pa_trace_queue_r_next(que);
-      CRITICAL_REGION_EXIT();
+      if ( -PE_BUSY == rc ) {
+         // keep the messages for the next attempt
+         que->tq_tx_count = 0;
+         return rc;
+      }
+
+      if ( rc < 0 ) {
+         _pa_trace_atomic_add(&trace->pt_stats.st_drops[PTD_SINK],
+                              que->tq_tx_count);
+      } else {
+         _pa_trace_stats_sent(trace);
+      }
+
+      // the messages have been consumed, or cannot be sent: discard them
+      _pa_trace_queue_r_release(que);
+   }
+
+   return 0;
+}
+
+/**
+ * Apply the default trace levels and modes.
+ */
+static void
+_pa_trace_defaults(void)
+{
+   for (unsigned int pos = 0; pos < ARRAY_SIZE(pa_trace_masks); ++pos) {
+      pa_trace_masks[pos] = DISABLE_ALL_TRACES_MASK;
+   }
+   for (unsigned int six=0; six<ARRAY_SIZE(ADV_TRACE_DEFAULT_LEVELS); six++) {
+      pa_trace_set_source((int)six, ADV_TRACE_DEFAULT_LEVELS[six]);
+   }
+
+   (void)pa_trace_set_modes(ADV_TRACE_RUNTIME_MODES,
+                            ADV_TRACE_DEFAULT_MODES);
+}
+
+/**
+ * Retain the current trace settings across resets.
+ *
+ * @param[in] trace the trace engine
+ */
+static void
+_pa_trace_persist_save(const struct pa_trace * trace)
+{
+   struct pa_trace_persist * tp = &_pa_trace_persist;
+
+   tp->tp_magic = ADV_TRACE_PERSIST_MAGIC;
+   memcpy(tp->tp_masks, pa_trace_masks, sizeof(tp->tp_masks));
+   tp->tp_modes = trace->pt_modes & ADV_TRACE_RUNTIME_MODES;
+   tp->tp_check = _pa_trace_persist_check(tp);
+}
+
+/**
+ * Restore the trace settings retained from before the last reset, if any.
+ * The RAM content is random after a power cycle, hence the check word.
+ *
+ * @param[in,out] trace the trace engine
+ * @return @c true if the settings have been restored
+ */
+static bool
+_pa_trace_persist_restore(struct pa_trace * trace)
+{
+   const struct pa_trace_persist * tp = &_pa_trace_persist;
+
+   if ( (tp->tp_magic != ADV_TRACE_PERSIST_MAGIC) ||
+        (tp->tp_check != _pa_trace_persist_check(tp)) ||
+        (tp->tp_modes & ~ADV_TRACE_RUNTIME_MODES) ) {
+      return false;
+   }
+
+   memcpy(pa_trace_masks, tp->tp_masks, sizeof(pa_trace_masks));
+   trace->pt_modes = (uint8_t)(ADV_TRACE_BINARY_MODE | tp->tp_modes);
+
+   return true;
+}
+
+/**
+ * Compute the check word of the persisted trace settings.
+ *
+ * @param[in] tp the persisted settings
+ * @return the check word
+ */
+static uint32_t
+_pa_trace_persist_check(const struct pa_trace_persist * tp)
+{
+   uint32_t check = tp->tp_magic ^ tp->tp_modes;
+
+   for (unsigned int pos = 0; pos < ARRAY_SIZE(tp->tp_masks); ++pos) {
+      check ^= tp->tp_masks[pos];
    }
 
-   _pa_trace.pt_que_active = false;
+   return ~check;
 }
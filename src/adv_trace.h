@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <limits.h>
 #include <sys/types.h>
 #include "adv_tools.h"
 
@@ -19,10 +20,20 @@
  * Optional definitions
  *    @c DUMP_METHODS if defined, method 'enter' and 'leave' trace are
  *       produced
+ *    @c PTM_MIN_LEVEL the lowest trace level of the source that is built in,
+ *       trace messages below this level are stripped out at compile time.
+ *       Defaults to PTL_CHATTY, i.e. all traces are built in.
+ *    @c ADV_TRACE_RTT if defined, traces are emitted into a SEGGER RTT
+ *       buffer rather than to the UARTE debug port.
+ *    @c ADV_TRACE_BINARY if defined, trace messages are not formatted on the
+ *       target: format strings are stored in a non-loaded ELF section and
+ *       only their identifier and raw arguments are emitted. See
+ *       tools/adv_tracedec.py to rebuild the messages on the host.
  *
  * Notes
  *    Macros with the underscore character prefix are not to be used in
  *    external code.
+ *    Trace macros may be used from any context, including IRQ handlers.
  */
 
 
@@ -45,6 +56,42 @@ enum pa_trace_level {
 };
 
 
+/**
+ * Trace back-end, which transmits the content of the trace queue.
+ */
+struct pa_trace_sink {
+   /**
+    * Initialize the back-end.
+    *
+    * @return 0 on success, or a negative error code
+    */
+   int (*ts_init)(void);
+   /**
+    * Transmit a chunk of the trace queue.
+    * The chunk should be left untouched until the transfer completes.
+    *
+    * @param[in] data the bytes to transmit
+    * @param[in] length the count of bytes, never more than ts_max_length
+    * @return 0 if the chunk has been consumed,
+    *         PE_DEFERRED if the back-end calls pa_trace_sink_done() once the
+    *         chunk has been consumed,
+    *         -PE_BUSY if the back-end cannot accept data for now, in which
+    *         case the chunk is kept and retried with the next trace message
+    *         or with pa_trace_sink_resume(),
+    *         or any other negative error code to discard the chunk
+    */
+   int (*ts_tx)(const uint8_t * data, size_t length);
+   /**
+    * Emit a message right away, bypassing the trace queue.
+    *
+    * @param[in] data the bytes to transmit
+    * @param[in] length the count of bytes
+    */
+   void (*ts_fatal)(const uint8_t * data, size_t length);
+   /** Maximum count of bytes of a single transfer */
+   size_t ts_max_length;
+};
+
 //------------------------------------------------------------------------------
 // default definitions
 //------------------------------------------------------------------------------
@@ -80,21 +127,31 @@ enum pa_trace_level {
 //------------------------------------------------------------------------------
 
 void pa_trace_init(void);
+void pa_trace_banner(void);
 int pa_printf(const char* fmt, ...) __attribute__((format(printf,1,2)));
 int pa_print(const char * message, size_t len);
 int pa_trace_printf(enum pa_trace_level level, const char * fmt, ...)
     __attribute__((format(printf,2,3)));
+int pa_trace_printf_src(int source, enum pa_trace_level level,
+                        const char * fmt, ...)
+    __attribute__((format(printf,3,4)));
 bool pa_trace_is_traceable(int source, enum pa_trace_level level);
 bool pa_trace_is_funcable(int source);
 bool pa_trace_is_irq(void);
 void pa_trace_set_source(int source, enum pa_trace_level level);
 enum pa_trace_level pa_trace_get_source(int source);
 void pa_trace_fatal_error(const char * message, size_t length);
+void pa_trace_get_recent(uint32_t * ids, unsigned int count);
 #ifdef HAVE_DUMP_HEX
 void pa_trace_dump_hex(const void * buf, size_t len);
 #endif // HAVE_DUMP_HEX
 size_t pa_trace_build_hex(char * dst, size_t dlen, const void * buffer,
                           size_t blen);
+int pa_trace_binary(uintptr_t fmt, unsigned int srclvl, unsigned int argc,
+                    ...);
+int pa_trace_set_sink(const struct pa_trace_sink * sink);
+void pa_trace_sink_done(void);
+void pa_trace_sink_resume(void);
 
 extern void app_error_handler(uint32_t c, uint32_t l, const uint8_t * f);
 
@@ -104,7 +161,8 @@ extern void app_error_handler(uint32_t c, uint32_t l, const uint8_t * f);
 // also enable it for pa_trace itself if (and only if) another component uses
 // this -dangerous- feature.
 #if defined(DEBUG) || defined(FORCE_RELEASE_TRACES)
-#  define TPRINTF pa_trace_printf
+#  define TPRINTF(_lvl_, _fmt_, ...) \
+    pa_trace_printf_src(PTM_SOURCE, _lvl_, _fmt_, ##__VA_ARGS__)
 #else // DEBUG || FORCE_RELEASE_TRACES
 #  undef TPRINTF
 #endif // ! (DEBUG || FORCE_RELEASE_TRACES)
@@ -130,6 +188,42 @@ extern void app_error_handler(uint32_t c, uint32_t l, const uint8_t * f);
 #define _OUTMSG   "< "
 #define _NOMSG    ""
 
+/** ELF section for binary trace format strings, never loaded on target */
+#define _ADV_TRACE_FMT_SECTION ".trace_fmt"
+
+/**
+ * Count of recent trace identifiers kept for postmortem analysis, should be
+ * a power of 2
+ */
+#define ADV_TRACE_RECENT_COUNT 4U
+
+/** Maximum count of arguments of a binary trace message */
+#define ADV_TRACE_BIN_ARGS_MAX 8
+
+/**
+ * Count the arguments of a binary trace message, up to
+ * ADV_TRACE_BIN_ARGS_MAX. From 9 up to 16 arguments, the count expands to
+ * _PA_NARGS_OVERFLOW, which fails the build rather than miscounting.
+ */
+#define _PA_NARGS(...) \
+    _PA_NARGS_(0, ##__VA_ARGS__, \
+               _PA_NARGS_OVERFLOW, _PA_NARGS_OVERFLOW, _PA_NARGS_OVERFLOW, \
+               _PA_NARGS_OVERFLOW, _PA_NARGS_OVERFLOW, _PA_NARGS_OVERFLOW, \
+               _PA_NARGS_OVERFLOW, _PA_NARGS_OVERFLOW, \
+               8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define _PA_NARGS_(_0_, _1_, _2_, _3_, _4_, _5_, _6_, _7_, _8_, \
+                   _9_, _10_, _11_, _12_, _13_, _14_, _15_, _16_, _n_, ...) _n_
+/** Argument count of a binary trace message with too many arguments */
+#define _PA_NARGS_OVERFLOW \
+    sizeof(struct { \
+       _Static_assert(0, "too many binary trace arguments, max is 8"); \
+       int _pa_; \
+    })
+
+/** Pack a trace source and a trace level into a single byte */
+#define _PA_SRCLVL(_src_, _lvl_) \
+    ((((unsigned int)(_src_)) << 3U) | (((unsigned int)(_lvl_)) & 0x7U))
+
 /** console carriage return, linefeed */
 #define CRLF "\n"
 #define EOL CRLF
@@ -149,16 +243,205 @@ extern void app_error_handler(uint32_t c, uint32_t l, const uint8_t * f);
 #error "Please define PTM_SOURCE before using pa_trace features"
 #endif // PTM_SOURCE
 
+#ifndef PTM_MIN_LEVEL
+#define PTM_MIN_LEVEL PTL_CHATTY
+#endif // PTM_MIN_LEVEL
+
+/*@{
+ * @internal
+ * Layout of the trace level masks
+ */
+#define DISABLE_ALL_TRACES_MASK   ((1ULL << 32U) - 1U)
+#define PTS_BITS                  (CHAR_BIT * sizeof(uint32_t))  // 32 bits
+#define PTS_MASK                  (PTS_BITS - 1)
+#define PTS_SHIFT                 5  // 32 bits = 2^5
+#define PTL_LVLBITS               3  // 8 level (3 bits)
+#define PTL_BITS                  4  // 8 level (3 bits) + 1 bit extra per src
+#define PTL_MASK                  ((1U << (PTL_LVLBITS)) -1)
+#define PTM_BITS                  (PTL_BITS * PTM_COUNT)
+#define PTN_WORDS                 ((PTM_BITS + (PTS_BITS - 1)) / PTS_BITS)
+/*@} */
+
+/** Reasons for a trace message not to be transmitted */
+enum pa_trace_drop {
+    PTD_UNINIT, /**< Trace subsystem is not initialized */
+    PTD_IRQ,    /**< Message emitted from an IRQ handler */
+    PTD_FULL,   /**< Trace queue is full */
+    PTD_SINK,   /**< Trace back-end has failed to transmit the message */
+    PTD_COUNT,  /**< Watermark, not a reason */
+};
+
+/** Trace statistics */
+struct pa_trace_stats {
+   /** Count of transmitted messages */
+   uint32_t st_sent;
+   /** Count of lost messages, per reason */
+   uint32_t st_drops[PTD_COUNT];
+   /**
+    * Count of lost messages, per trace source. Messages emitted without a
+    * source, such as with pa_printf(), and the ones discarded by the
+    * back-end are not accounted here.
+    */
+   uint32_t st_src_drops[PTM_COUNT];
+   /** Highest count of messages stored in the trace queue */
+   uint16_t st_hwm_count;
+   /** Highest count of bytes stored in the trace queue */
+   uint16_t st_hwm_bytes;
+   /** Shortest latency from enqueue to transmission, in RTC ticks */
+   uint16_t st_lat_min;
+   /** Longest latency from enqueue to transmission, in RTC ticks */
+   uint16_t st_lat_max;
+   /** Accumulated latency of transmitted messages, in RTC ticks */
+   uint32_t st_lat_sum;
+};
+
+/** Trace modes, which may be changed at runtime with pa_trace_set_modes() */
+enum pa_trace_mode {
+   PTF_BATCH = 1U << 0,  /**< Coalesce contiguous messages into a transfer */
+   PTF_PAUSE = 1U << 1,  /**< Hold messages back in the queue */
+   PTF_BINARY = 1U << 2, /**< Binary trace records, set at build time */
+};
+
+/**
+ * Trace control commands, see pa_trace_control(). Each command is an opcode
+ * byte followed by its arguments, several commands may be concatenated.
+ */
+enum pa_trace_command {
+   PTC_LEVEL = 1,    /**< Set a source level: source (0xff: all), level */
+   PTC_MODES = 2,    /**< Update modes: mask of modes to change, modes */
+   PTC_DEFAULTS = 3, /**< Restore the default levels and modes */
+};
+
+/** Source of #PTC_LEVEL standing for all the trace sources */
+#define PTC_ALL_SOURCES 0xffU
+
+/**
+ * Trace control status.
+ * This record is exposed as is over BLE, beware of item alignment.
+ */
+struct pa_trace_control {
+   /** Levels for each trace source, as #pa_trace_masks */
+   uint32_t tc_masks[PTN_WORDS];
+   /** Active modes, see #pa_trace_mode */
+   uint8_t tc_modes;
+   /** Non-zero if the settings have been restored at start up */
+   uint8_t tc_restored;
+   /** Reserved */
+   uint16_t tc_rsv;
+};
+
+int pa_trace_control(const uint8_t * buf, size_t length);
+void pa_trace_get_control(struct pa_trace_control * control);
+int pa_trace_set_modes(unsigned int mask, unsigned int modes);
+unsigned int pa_trace_get_modes(void);
+
+void pa_trace_get_stats(struct pa_trace_stats * stats, bool reset);
+void pa_trace_print_stats(void);
+size_t pa_trace_ram_size(void);
+
+//------------------------------------------------------------------------------
+// Profiling
+//------------------------------------------------------------------------------
+
+/**
+ * Profiling probe, for scoped hot-path measurements:
+ *
+ *    ADV_PROF_DEFINE(evt_prof);
+ *    adv_prof_begin(&evt_prof);
+ *    ...
+ *    adv_prof_end(&evt_prof);
+ *
+ * Durations are expressed in trace timestamp ticks. A probe should not be
+ * shared between contexts that may preempt each other.
+ */
+struct adv_prof {
+   const char * ap_name; /**< Probe name */
+   uint32_t ap_start; /**< Timestamp of the on-going measurement */
+   uint32_t ap_count; /**< Count of measurements */
+   uint32_t ap_min; /**< Shortest duration */
+   uint32_t ap_max; /**< Longest duration */
+   uint64_t ap_sum; /**< Accumulated duration */
+};
+
+/** Define a profiling probe */
+#define ADV_PROF_DEFINE(_name_) \
+    static struct adv_prof _name_ = { .ap_name = #_name_, .ap_min = UINT32_MAX }
+
+uint32_t pa_trace_timestamp(void);
+uint32_t pa_trace_timestamp_freq(void);
+void adv_prof_begin(struct adv_prof * prof);
+void adv_prof_end(struct adv_prof * prof);
+void adv_prof_print(struct adv_prof * prof, bool reset);
+
+/** Levels for each trace source, use pa_trace_set_source() to update */
+extern uint32_t pa_trace_masks[PTN_WORDS];
+
+/**
+ * Tells whether a message from a source and a verbosity level is enabled,
+ * without any sanity check.
+ *
+ * @param[in] source the source of the message
+ * @param[in] level the verbosity level
+ * @return a boolean value, set if message can be dumped out
+ */
+static inline bool
+_pa_trace_is_enabled(int source, enum pa_trace_level level)
+{
+   // bits in the trace mask array
+   unsigned int bit = PTL_BITS * (unsigned int)source;
+
+   return (unsigned int)level >=
+      ((pa_trace_masks[bit >> PTS_SHIFT] >> (bit & PTS_MASK)) & PTL_MASK);
+}
+
+/**
+ * Tells whether a message of the current source can be emitted.
+ * Levels below PTM_MIN_LEVEL are rejected at compile time, so that the
+ * compiler discards the whole trace statement.
+ *
+ * @param[in] _lvl_ the verbosity level, which should be a constant
+ */
+#define _PA_TRACEABLE(_lvl_) \
+    ((((int)(_lvl_)) >= ((int)(PTM_MIN_LEVEL))) && \
+     _pa_trace_is_enabled(PTM_SOURCE, (enum pa_trace_level)(_lvl_)))
+
 #ifdef TPRINTF
 #define ADV_TRACE_MSGV_ACTIVE 1
+#  ifdef ADV_TRACE_BINARY
+/**
+ * Emit a binary trace message: the format string is moved to a non-loaded
+ * section whose address is used as the message identifier.
+ * Arguments should be 32-bit values: 64-bit integers and doubles are not
+ * supported, and string arguments are only resolved by the host decoder if
+ * they reside in flash.
+ * The dead call to pa_printf is only used to let the compiler check the
+ * format string against its arguments.
+ */
+#    define _BTPRINTF(_lvl_, _fmt_, ...) \
+    do { \
+      static const char _pa_trace_fmt_[] \
+         __attribute__((section(_ADV_TRACE_FMT_SECTION), used)) = _fmt_; \
+      if ( false ) { pa_printf(_fmt_, ##__VA_ARGS__); } \
+      pa_trace_binary((uintptr_t)&_pa_trace_fmt_[0], \
+                      _PA_SRCLVL(PTM_SOURCE, _lvl_), \
+                      _PA_NARGS(__VA_ARGS__), ##__VA_ARGS__); \
+    } while (0)
+#    define _TMSGV(_lvl_, _pre_, _fmt_, ...) \
+    _BTPRINTF(_lvl_, _pre_ _MSGLOC_ " " _fmt_, ##__VA_ARGS__)
+#    define _TSMSGV(_lvl_, _fmt_, ...) \
+    _BTPRINTF(_lvl_, _fmt_, ##__VA_ARGS__)
+#  else // ADV_TRACE_BINARY
+#    define _TMSGV(_lvl_, _pre_, _fmt_, ...) \
+    TPRINTF(_lvl_, _pre_ _MSGLOC_ " %s() " _fmt_, \
+            __FUNCTIONNAME__, ##__VA_ARGS__)
+#    define _TSMSGV(_lvl_, _fmt_, ...) \
+    TPRINTF(_lvl_, _fmt_, ##__VA_ARGS__)
+#  endif // !ADV_TRACE_BINARY
+
 #  define _MSGV(_pre_, _fmt_, ...) \
     do { \
-      if ( pa_trace_is_irq() ) { \
-         app_error_handler(0xbadcaca0, __LINE__, (const uint8_t*) __FILE__); \
-      } \
-      if ( pa_trace_is_funcable(PTM_SOURCE) ) { \
-         TPRINTF(PTL_FUNC, _pre_ _MSGLOC_ " %s() " _fmt_, \
-                 __FUNCTIONNAME__, ##__VA_ARGS__); } \
+      if ( _PA_TRACEABLE(PTL_CHATTY) ) { \
+         _TMSGV(PTL_FUNC, _pre_, _fmt_, ##__VA_ARGS__); } \
     } while (false);
 
 /**
@@ -171,12 +454,8 @@ extern void app_error_handler(uint32_t c, uint32_t l, const uint8_t * f);
  */
 #  define MSGV(_lvl_, _fmt_, ...) \
     do { \
-      if ( pa_trace_is_irq() ) { \
-         app_error_handler(0xbadcaca1, __LINE__, (const uint8_t*) __FILE__); \
-      } \
-      if ( pa_trace_is_traceable(PTM_SOURCE, (enum pa_trace_level)_lvl_) ) { \
-         TPRINTF(_lvl_, _NOMSG _MSGLOC_ " %s() " _fmt_ EOL, \
-                 __FUNCTIONNAME__, ##__VA_ARGS__); } \
+      if ( _PA_TRACEABLE(_lvl_) ) { \
+         _TMSGV(_lvl_, _NOMSG, _fmt_ EOL, ##__VA_ARGS__); } \
     } while (false);
 
 /**
@@ -188,15 +467,14 @@ extern void app_error_handler(uint32_t c, uint32_t l, const uint8_t * f);
  * @param[in] _fmt_ printf-like formatter string
  */
 #  define SMSGV(_lvl_, _fmt_, ...) \
-    if ( pa_trace_is_traceable(PTM_SOURCE, (enum pa_trace_level)_lvl_) ) \
-        { TPRINTF(_lvl_, _fmt_ EOL, ##__VA_ARGS__); }
+    if ( _PA_TRACEABLE(_lvl_) ) \
+        { _TSMSGV(_lvl_, _fmt_ EOL, ##__VA_ARGS__); }
 #  define DPHX(_lvl_, _buf_, _len_) \
-    if ( pa_trace_is_traceable(PTM_SOURCE, (enum pa_trace_level)_lvl_) ) \
+    if ( _PA_TRACEABLE(_lvl_) ) \
         { pa_trace_dump_hex(_buf_, _len_) ; }
 #  define DPHXM(_lvl_, _buf_, _len_, _fmt_, ...) \
-    if ( pa_trace_is_traceable(PTM_SOURCE, (enum pa_trace_level)_lvl_) ) \
-        { TPRINTF(_lvl_, _NOMSG _MSGLOC_ " %s() " _fmt_ EOL, \
-            __FUNCTIONNAME__, ##__VA_ARGS__); \
+    if ( _PA_TRACEABLE(_lvl_) ) \
+        { _TMSGV(_lvl_, _NOMSG, _fmt_ EOL, ##__VA_ARGS__); \
           pa_trace_dump_hex(_buf_, _len_) ; }
 /**
  * Emit a function-entering trace message.
@@ -49,7 +49,9 @@ enum pa_trace_modules
 #define PTM_MAIN  PTM_SRC_00
 #define PTM_SYS   PTM_SRC_01
 #define PTM_BLE   PTM_SRC_02
-#define PTM_LAST  PTM_SRC_03
+#define PTM_POWER PTM_SRC_03
+#define PTM_BENCH PTM_SRC_04
+#define PTM_LAST  PTM_SRC_05
 /** @} */
 
 #endif // _ADV_TRACESRCS_H_
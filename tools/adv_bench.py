@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+
+"""Advertiser benchmark driver.
+
+Drive the benchmark firmware, built with BENCH, through its ``diag``
+characteristic: configure the trace bursts, the background worker load and
+the read completion delay, then read the characteristic at a set rate,
+with an occasional configuration write, and report the device results
+along with the latencies seen from the client.
+
+Background workers only run while no link is connected: soak runs repeat
+sessions separated by idle periods, during which the worker load runs.
+
+See src/adv_bench.h for the configuration and result record layouts.
+"""
+
+from argparse import ArgumentParser
+from asyncio import run, sleep
+from struct import Struct
+from sys import exit as sysexit, stderr
+from time import monotonic, sleep as wait
+
+from bleak import BleakClient
+from bleak.exc import BleakError
+
+
+class BenchClient:
+    """Run benchmark sessions against a device."""
+
+    DIAG_UUID = '38d11006-7b25-11e9-8f9e-2a86e4085a59'
+
+    CONFIG = Struct('<IHBBIHBB')
+    RESULTS = Struct('<Q11I4H5I')
+    RESULT_FIELDS = ('cycles', 'core_freq', 'freq', 'elapsed', 'wakeups',
+                     'bursts', 'msgs', 'msg_min', 'msg_max', 'msg_cycles',
+                     'sent', 'drops', 'hwm_count', 'hwm_bytes', 'lat_max',
+                     'rsv', 'loads', 'load_max', 'reqs', 'req_max',
+                     'req_sum')
+
+    SOURCES = ('main', 'sys', 'ble', 'power', 'bench')
+    LEVELS = 'CDIWE'
+
+    APP_TIMER_FREQ = 32768
+    RTC_FREQ = 32768
+
+    def __init__(self, address, timeout=10.0):
+        self._address = address
+        self._timeout = timeout
+
+    @classmethod
+    def parse_sources(cls, text):
+        """Build a trace source mask from a comma separated list of source
+           names or numbers.
+
+           :param text: the source list
+           :return: the source mask
+        """
+        mask = 0
+        for item in filter(None, text.split(',')):
+            item = item.strip().lower()
+            if item in cls.SOURCES:
+                mask |= 1 << cls.SOURCES.index(item)
+            elif item.isdigit() and int(item) < 32:
+                mask |= 1 << int(item)
+            else:
+                raise ValueError('Unknown trace source: %s' % item)
+        return mask
+
+    @classmethod
+    def build_config(cls, sources, period, burst, level, load, delay,
+                     reset):
+        """Encode a configuration record.
+
+           :param load: worker load, in CPU cycles
+           :return: the record bytes
+        """
+        if level not in cls.LEVELS:
+            raise ValueError('Invalid trace level: %s' % level)
+        return cls.CONFIG.pack(sources, period, burst,
+                               cls.LEVELS.index(level), load, delay,
+                               int(reset), 0)
+
+    @classmethod
+    def decode_results(cls, data):
+        """Decode a result record.
+
+           :param data: the record bytes
+           :return: a dictionary of result fields
+        """
+        if len(data) != cls.RESULTS.size:
+            raise ValueError('Unexpected result size: %d' % len(data))
+        return dict(zip(cls.RESULT_FIELDS, cls.RESULTS.unpack(data)))
+
+    async def read_results(self):
+        """Connect, read the results once, and disconnect.
+
+           :return: a dictionary of result fields
+        """
+        async with BleakClient(self._address, timeout=self._timeout) as cnx:
+            return self.decode_results(
+                await cnx.read_gatt_char(self.DIAG_UUID))
+
+    async def run_session(self, config, duration, rate, writes):
+        """Run a benchmark session.
+
+           :param config: the configuration record, written first
+           :param duration: session duration, in seconds
+           :param rate: count of requests per second
+           :param writes: issue a configuration write every this count of
+                          requests, 0 for reads only
+           :return: the last results, and the read and write latencies in
+                    seconds, with the count of failed requests
+        """
+        reads = []
+        wrlats = []
+        failures = 0
+        results = None
+        persist = bytearray(config)
+        # only the first write resets the results
+        persist[self.CONFIG.size - 2] = 0
+        async with BleakClient(self._address, timeout=self._timeout) as cnx:
+            await cnx.write_gatt_char(self.DIAG_UUID, config, response=True)
+            start = monotonic()
+            count = 0
+            while True:
+                now = monotonic()
+                if now - start >= duration:
+                    break
+                delay = start + count / rate - now
+                if delay > 0:
+                    await sleep(delay)
+                count += 1
+                try:
+                    begin = monotonic()
+                    if writes and not count % writes:
+                        await cnx.write_gatt_char(self.DIAG_UUID,
+                                                  bytes(persist),
+                                                  response=True)
+                        wrlats.append(monotonic() - begin)
+                        continue
+                    data = await cnx.read_gatt_char(self.DIAG_UUID)
+                    reads.append(monotonic() - begin)
+                    results = self.decode_results(data)
+                except BleakError as exc:
+                    failures += 1
+                    print('Request %d failed: %s' % (count, exc),
+                          file=stderr)
+        return results, reads, wrlats, failures
+
+    @classmethod
+    def report(cls, results, reads, wrlats, failures):
+        """Print out the outcome of a session."""
+        def stats(samples):
+            if not samples:
+                return 'none'
+            samples = sorted(samples)
+            p99 = samples[min(len(samples) - 1, int(len(samples) * 0.99))]
+            return '%d: min %.1f avg %.1f p99 %.1f max %.1f ms' % (
+                len(samples), samples[0] * 1e3,
+                sum(samples) * 1e3 / len(samples), p99 * 1e3,
+                samples[-1] * 1e3)
+
+        print('client reads  %s' % stats(reads))
+        print('client writes %s' % stats(wrlats))
+        print('client failures %d' % failures)
+        if not results:
+            return
+        res = results
+        elapsed = res['elapsed'] / res['freq'] if res['freq'] else 0.0
+        busy = res['cycles'] / res['core_freq'] if res['core_freq'] else 0.0
+        print('device time %.1f s, cpu %.3f s (%.2f%%), wakeups %d '
+              '(%.1f/s)' %
+              (elapsed, busy, 100.0 * busy / elapsed if elapsed else 0.0,
+               res['wakeups'], res['wakeups'] / elapsed if elapsed else 0.0))
+        avg = res['msg_cycles'] / res['msgs'] if res['msgs'] else 0.0
+        print('trace bursts %d msgs %d cycles min %d avg %.0f max %d' %
+              (res['bursts'], res['msgs'], res['msg_min'], avg,
+               res['msg_max']))
+        print('trace sent %d drops %d hwm %d msgs %d bytes, latency max '
+              '%.1f ms' %
+              (res['sent'], res['drops'], res['hwm_count'], res['hwm_bytes'],
+               res['lat_max'] * 1e3 / cls.RTC_FREQ))
+        print('worker loads %d max %d cycles' %
+              (res['loads'], res['load_max']))
+        req_avg = res['req_sum'] / res['reqs'] if res['reqs'] else 0.0
+        print('device reads %d avg %.1f max %.1f ms' %
+              (res['reqs'], req_avg * 1e3 / cls.APP_TIMER_FREQ,
+               res['req_max'] * 1e3 / cls.APP_TIMER_FREQ))
+
+
+def main():
+    """Entry point."""
+    argparser = ArgumentParser(description=__doc__.split('\n')[0])
+    argparser.add_argument('address', help='device BLE address')
+    argparser.add_argument('-s', '--sources', default='bench',
+                           help='trace sources to burst, comma separated '
+                                'names (%s) or numbers (default: bench)' %
+                                ', '.join(BenchClient.SOURCES))
+    argparser.add_argument('-p', '--period', type=int, default=1000,
+                           help='trace burst period in ms, 0 to disable '
+                                '(default: 1000)')
+    argparser.add_argument('-b', '--burst', type=int, default=4,
+                           help='messages per source and burst (default: 4)')
+    argparser.add_argument('-l', '--level', default='I',
+                           choices=list(BenchClient.LEVELS),
+                           help='trace level of burst messages (default: I)')
+    argparser.add_argument('-w', '--load', type=int, default=0,
+                           help='background worker load in microseconds '
+                                '(default: 0)')
+    argparser.add_argument('-d', '--delay', type=int, default=0,
+                           help='device read completion delay in ms '
+                                '(default: 0)')
+    argparser.add_argument('-r', '--rate', type=float, default=10.0,
+                           help='requests per second (default: 10)')
+    argparser.add_argument('-W', '--writes', type=int, default=0,
+                           help='issue a configuration write every N '
+                                'requests (default: 0, reads only)')
+    argparser.add_argument('-t', '--duration', type=float, default=60.0,
+                           help='session duration in seconds (default: 60)')
+    argparser.add_argument('-n', '--sessions', type=int, default=1,
+                           help='count of sessions, 0 to run forever '
+                                '(default: 1)')
+    argparser.add_argument('-i', '--idle', type=float, default=10.0,
+                           help='idle time between sessions in seconds, '
+                                'while the worker load runs (default: 10)')
+    argparser.add_argument('-k', '--keep', action='store_true',
+                           help='keep the device results of previous runs')
+    args = argparser.parse_args()
+    try:
+        if args.rate <= 0:
+            raise ValueError('Invalid rate: %s' % args.rate)
+        client = BenchClient(args.address)
+        # the load is expressed in cycles of the device CPU
+        results = run(client.read_results())
+        config = BenchClient.build_config(
+            BenchClient.parse_sources(args.sources), args.period,
+            args.burst, args.level,
+            args.load * results['core_freq'] // 1000000, args.delay,
+            not args.keep)
+        session = 0
+        while not args.sessions or session < args.sessions:
+            if session:
+                wait(args.idle)
+                # the results accumulate across sessions
+                config = config[:-2] + b'\x00\x00'
+            session += 1
+            print('session %d' % session)
+            outcome = run(client.run_session(config, args.duration,
+                                             args.rate, args.writes))
+            BenchClient.report(*outcome)
+    except KeyboardInterrupt:
+        pass
+    except (BleakError, OSError, ValueError) as exc:
+        print('Error: %s' % exc, file=stderr)
+        sysexit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+
+"""Advertiser binary trace decoder.
+
+When the application is built with TRACE_BINARY, trace messages are not
+formatted on the target: each record only carries the identifier of its
+format string, a timestamp, the source and level, a trace counter and the
+raw 32-bit arguments. Format strings are stored in the non-loaded
+``.trace_fmt`` section of the application ELF file, which this tool uses to
+rebuild the text messages. Plain text traces are forwarded as is.
+
+When the application uses high resolution timestamps, it periodically emits
+``sync:`` time correlation records, which are used to prefix decoded records
+with the elapsed time in seconds since the application has started.
+
+See pa_trace_binary() in src/adv_trace.c for the record layout.
+"""
+
+from argparse import ArgumentParser
+from re import compile as re_compile
+from struct import unpack_from
+from sys import exit as sysexit, stdin, stdout, stderr
+
+from elftools.elf.constants import SH_FLAGS
+from elftools.elf.elffile import ELFFile
+
+
+class TraceDecoder:
+    """Rebuild trace messages from a trace byte stream."""
+
+    MARKER = 0x80
+    HEADER_SIZE = 9
+    ARGS_MAX = 8
+    LEVELS = 'CDIWEF'
+    FMT_SECTION = '.trace_fmt'
+
+    RTC_FREQ = 32768
+    RTC_WRAP = 1 << 24
+
+    SYNC_CRE = re_compile(r'sync: time ([0-9a-f]{8}) rtc ([0-9a-f]{6}) '
+                          r'freq (\d+)')
+
+    FMT_CRE = re_compile(r'%([-+ #0]*)(\d+|\*)?(?:\.(\d+))?'
+                         r'(hh|h|ll|l|z|j|t)?([diouxXcsp%])')
+
+    def __init__(self, elf):
+        self._formats = b''
+        self._segments = []
+        self._buffer = bytearray()
+        self._line = ''
+        self._sync = None
+        self._rtc_last = 0
+        self._rtc_base = 0
+        self._load(elf)
+
+    def feed(self, data):
+        """Decode a chunk of the trace stream.
+
+           :param data: raw bytes received from the target
+           :return: an iterator over decoded text fragments
+        """
+        self._buffer.extend(data)
+        buf = self._buffer
+        pos = 0
+        while pos < len(buf):
+            code = buf[pos]
+            if code & self.MARKER and (code & ~self.MARKER) <= self.ARGS_MAX:
+                argc = code & ~self.MARKER
+                size = self.HEADER_SIZE + 4 * argc
+                if len(buf) - pos < size:
+                    # wait for the remaining bytes of the record
+                    break
+                yield self._decode_record(buf, pos, argc)
+                pos += size
+                continue
+            end = pos
+            while end < len(buf) and not buf[end] & self.MARKER:
+                end += 1
+            text = buf[pos:end].decode('ascii', errors='replace')
+            self._scan_text(text)
+            yield text
+            if end < len(buf) and (buf[end] & ~self.MARKER) > self.ARGS_MAX:
+                # not a valid record marker, skip it
+                end += 1
+            pos = end
+        del buf[:pos]
+
+    def _scan_text(self, text):
+        lines = (self._line + text).split('\n')
+        self._line = lines.pop()[-256:]
+        for line in lines:
+            match = self.SYNC_CRE.search(line)
+            if not match:
+                continue
+            time, rtc, freq = (int(match.group(1), 16),
+                               int(match.group(2), 16), int(match.group(3)))
+            if rtc < self._rtc_last:
+                self._rtc_base += self.RTC_WRAP
+            self._rtc_last = rtc
+            self._sync = (time, (self._rtc_base + rtc) / self.RTC_FREQ, freq)
+
+    def _wallclock(self, timestamp):
+        time, seconds, freq = self._sync
+        delta = (timestamp - time) & 0xffffffff
+        if delta & 0x80000000:
+            delta -= 1 << 32
+        return seconds + delta / freq
+
+    def _load(self, elf):
+        elffile = ELFFile(elf)
+        section = elffile.get_section_by_name(self.FMT_SECTION)
+        if not section:
+            raise ValueError('No %s section in ELF file' % self.FMT_SECTION)
+        self._formats = section.data()
+        for section in elffile.iter_sections():
+            if not section['sh_flags'] & SH_FLAGS.SHF_ALLOC:
+                continue
+            if section['sh_type'] != 'SHT_PROGBITS':
+                continue
+            self._segments.append((section['sh_addr'], section.data()))
+
+    def _string(self, data, offset):
+        end = data.find(b'\0', offset)
+        if end < 0:
+            end = len(data)
+        return data[offset:end].decode('ascii', errors='replace')
+
+    def _resolve(self, address):
+        for base, data in self._segments:
+            if base <= address < base + len(data):
+                return self._string(data, address - base)
+        return '<0x%08x>' % address
+
+    def _decode_record(self, buf, pos, argc):
+        fmt_id, timestamp, srclvl, count = unpack_from('<HIBB', buf, pos + 1)
+        args = list(unpack_from('<%dI' % argc, buf, pos + self.HEADER_SIZE))
+        if fmt_id < len(self._formats):
+            fmt = self._string(self._formats, fmt_id)
+        else:
+            fmt = '<unknown format 0x%04x>\n' % fmt_id
+        level = srclvl & 0x7
+        header = '^%08x ' % timestamp
+        if self._sync:
+            header += '@%.6f ' % self._wallclock(timestamp)
+        header += ':%02x ' % count
+        if level < len(self.LEVELS):
+            header += '%s ' % self.LEVELS[level]
+        return header + self._format(fmt, args)
+
+    def _format(self, fmt, args):
+        def convert(match):
+            flags, width, precision, _, conv = match.groups()
+            if conv == '%':
+                return '%'
+            if width == '*':
+                width = str(args.pop(0) if args else 0)
+            value = args.pop(0) if args else 0
+            spec = '%%%s%s%s' % (flags, width or '',
+                                 '.%s' % precision if precision else '')
+            if conv in 'di':
+                if value & 0x80000000:
+                    value -= 1 << 32
+                return (spec + 'd') % value
+            if conv == 'u':
+                return (spec + 'd') % value
+            if conv in 'oxX':
+                return (spec + conv) % value
+            if conv == 'c':
+                return (spec + 'c') % chr(value & 0xff)
+            if conv == 's':
+                return (spec + 's') % self._resolve(value)
+            return '0x%08x' % value
+        return self.FMT_CRE.sub(convert, fmt)
+
+
+def main():
+    """Entry point."""
+    argparser = ArgumentParser(description=__doc__.split('\n')[0])
+    argparser.add_argument('elf', help='application ELF file')
+    argparser.add_argument('input', nargs='?', default='-',
+                           help='trace capture file, or serial port with -s '
+                                '(default: stdin)')
+    argparser.add_argument('-s', '--serial', action='store_true',
+                           help='read traces from a serial port')
+    argparser.add_argument('-b', '--baudrate', type=int, default=1000000,
+                           help='serial port baudrate (default: 1000000)')
+    args = argparser.parse_args()
+    try:
+        with open(args.elf, 'rb') as elf:
+            decoder = TraceDecoder(elf)
+        if args.serial:
+            # pylint: disable=import-outside-toplevel
+            from serial import Serial
+            stream = Serial(args.input, baudrate=args.baudrate, timeout=0.1)
+        elif args.input == '-':
+            stream = stdin.buffer
+        else:
+            stream = open(args.input, 'rb')
+        with stream:
+            while True:
+                data = stream.read1(256) if hasattr(stream, 'read1') else \
+                    stream.read(256)
+                if not data:
+                    if args.serial:
+                        continue
+                    break
+                for text in decoder.feed(data):
+                    stdout.write(text)
+                stdout.flush()
+    except KeyboardInterrupt:
+        pass
+    except (OSError, ValueError) as exc:
+        print('Error: %s' % exc, file=stderr)
+        sysexit(1)
+
+
+if __name__ == '__main__':
+    main()